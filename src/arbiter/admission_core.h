@@ -95,4 +95,47 @@ struct admission_statistics *g_admission_stats(void) {
 
 #endif
 
+/* demand goes to the engine chosen at startup if there is one (see
+ * engine_admission_core.h), otherwise to the built-in algorithm */
+#include "engine_admission_core.h"
+
+/**
+ * Returns 0 on success, -1 if the allocator had no room for the flow and
+ *   nothing was added
+ */
+static inline
+int admission_add_backlog(uint16_t src, uint16_t dst, uint32_t amount,
+		uint8_t tclass, uint32_t deadline) {
+	if (g_admission_engine != NULL)
+		return g_admission_engine->add_backlog(g_admission_engine_state, src,
+				dst, amount, tclass, deadline);
+	else
+		return add_backlog_deadline(g_admissible_status(), src, dst, amount,
+				tclass, deadline);
+}
+
+static inline
+void admission_flush_backlog(void) {
+	if (g_admission_engine != NULL)
+		g_admission_engine->flush_backlog(g_admission_engine_state);
+	else
+		flush_backlog(g_admissible_status());
+}
+
+static inline
+void admission_handle_spent_demands(void) {
+	if (g_admission_engine != NULL)
+		g_admission_engine->handle_spent(g_admission_engine_state);
+	else
+		handle_spent_demands(g_admissible_status());
+}
+
+static inline
+void admission_reset_sender(uint16_t src) {
+	if (g_admission_engine != NULL)
+		g_admission_engine->reset_sender(g_admission_engine_state, src);
+	else
+		reset_sender(g_admissible_status(), src);
+}
+
 #endif /* ADMISSION_CORE_H */
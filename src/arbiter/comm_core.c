@@ -25,6 +25,9 @@
 #include "../protocol/stat_print.h"
 #include "igmp.h"
 #include "../protocol/topology.h"
+#ifdef ALLOC_TRACE_FILE
+#include "../graph-algo/alloc_trace.h"
+#endif
 
 /* number of elements to keep in the pktdesc local core cache */
 #define PKTDESC_MEMPOOL_CACHE_SIZE		256
@@ -102,10 +105,19 @@ struct comm_core_state ccore_state[RTE_MAX_LCORE];
 /* fpproto_pktdesc pool */
 struct rte_mempool* pktdesc_pool[NB_SOCKETS];
 
+#ifdef ALLOC_TRACE_FILE
+/* trace of demands and allocations for replay_trace, build with e.g.
+ * -DALLOC_TRACE_FILE=\"/tmp/arbiter.trace\". assumes a single comm core,
+ * which queues records in alloc_trace_buf for the log core to write */
+struct alloc_trace alloc_trace;
+struct alloc_trace_buf alloc_trace_buf;
+#endif
+
 static void handle_reset(void *param);
 static void trigger_request(struct end_node_state *en);
 static void trigger_request_voidp(void *param);
 static void handle_areq(void *param, u16 *dst_and_count, int n);
+static void handle_areq_deadline(void *param, u16 *dst_count_deadline, int n);
 static void set_retrans_timer(void *param, u64 when);
 static int cancel_retrans_timer(void *param);
 static void handle_neg_ack(void *param, struct fpproto_pktdesc *pd);
@@ -114,6 +126,7 @@ static void handle_ack(void *param, struct fpproto_pktdesc *pd);
 struct fpproto_ops proto_ops = {
 	.handle_reset	= &handle_reset,
 	.handle_areq	= &handle_areq,
+	.handle_areq_deadline = &handle_areq_deadline,
 	.handle_ack		= &handle_ack,
 	.handle_neg_ack	= &handle_neg_ack,
 	.trigger_request= &trigger_request_voidp,
@@ -147,6 +160,13 @@ void comm_init_global_structs(uint64_t first_time_slot)
 		pacer_init_full(&en->tx_pacer, now, send_cost, max_burst,
 				min_trigger_gap);
 	}
+
+#ifdef ALLOC_TRACE_FILE
+	if (alloc_trace_open_write(&alloc_trace, ALLOC_TRACE_FILE, NUM_NODES,
+				   BATCH_SIZE, first_time_slot) != 0)
+		rte_exit(EXIT_FAILURE, "cannot create trace %s\n", ALLOC_TRACE_FILE);
+	alloc_trace_buf_init(&alloc_trace_buf, first_time_slot);
+#endif
 }
 
 /* based on init_mem in main.c */
@@ -259,12 +279,17 @@ static void set_retrans_timer(void *param, u64 when)
 	comm_log_set_timer(node_id, when, when - now);
 }
 
-static void handle_areq(void *param, u16 *dst_and_count, int n)
+/**
+ * Handles @n A-REQs of @req_len 16-bit words each: a destination, a count,
+ *   and a deadline if @req_len is 3
+ */
+static void handle_areqs(void *param, u16 *reqs, int n, int req_len)
 {
 	int i;
 	struct end_node_state *en = (struct end_node_state *)param;
 	struct comm_core_state *core = &ccore_state[rte_lcore_id()];
-	u16 dst, count;
+	u16 dst, count, deadline;
+	u8 tclass;
 	u32 demand;
 	u32 orig_demand;
 	u32 node_id = en - end_nodes;
@@ -274,8 +299,11 @@ static void handle_areq(void *param, u16 *dst_and_count, int n)
 	COMM_DEBUG("handling A-REQ with %d destinations\n", n);
 
 	for (i = 0; i < n; i++) {
-		dst = rte_be_to_cpu_16(dst_and_count[2*i]);
-		count = rte_be_to_cpu_16(dst_and_count[2*i + 1]);
+		dst = rte_be_to_cpu_16(reqs[req_len*i]);
+		tclass = dst >> FASTPASS_AREQ_TCLASS_SHIFT;
+		dst &= FASTPASS_AREQ_DST_MASK;
+		count = rte_be_to_cpu_16(reqs[req_len*i + 1]);
+		deadline = (req_len > 2) ? rte_be_to_cpu_16(reqs[req_len*i + 2]) : 0;
 		if (unlikely(!(dst < MAX_NODES))) {
 			comm_log_areq_invalid_dst(node_id, dst);
 			return;
@@ -286,8 +314,18 @@ static void handle_areq(void *param, u16 *dst_and_count, int n)
 		demand += (count - demand) & 0xFFFF;
 		demand_diff = (s32)demand - (s32)orig_demand;
 		if (demand_diff > 0) {
+			if (unlikely(admission_add_backlog(node_id, dst, demand_diff,
+					tclass, deadline) != 0)) {
+				/* keep the old demand, so the endpoint's next A-REQ for dst
+				 * offers the increase again */
+				comm_log_demand_deferred(node_id, dst, orig_demand, demand);
+				continue;
+			}
 			comm_log_demand_increased(node_id, dst, orig_demand, demand, demand_diff);
-			add_backlog(g_admissible_status(), node_id, dst, demand_diff);
+#ifdef ALLOC_TRACE_FILE
+			alloc_trace_buf_write_demand(&alloc_trace_buf, core->latest_timeslot[0],
+					node_id, dst, demand_diff, tclass, deadline);
+#endif
 			en->demands[dst] = demand;
 			num_increases++;
 		} else {
@@ -298,6 +336,16 @@ static void handle_areq(void *param, u16 *dst_and_count, int n)
 	trigger_request(en);
 }
 
+static void handle_areq(void *param, u16 *dst_and_count, int n)
+{
+	handle_areqs(param, dst_and_count, n, 2);
+}
+
+static void handle_areq_deadline(void *param, u16 *dst_count_deadline, int n)
+{
+	handle_areqs(param, dst_count_deadline, n, 3);
+}
+
 static void handle_reset(void *param)
 {
 	struct end_node_state *en = (struct end_node_state *)param;
@@ -305,7 +353,7 @@ static void handle_reset(void *param)
 
 	comm_log_handle_reset(node_id, en->conn.in_sync);
 
-	reset_sender(g_admissible_status(), node_id);
+	admission_reset_sender(node_id);
 	memset(&en->demands[0], 0, MAX_NODES * sizeof(uint32_t));
 	memset(en->alloc_to_dst, 0, sizeof(en->alloc_to_dst));
 	memset(en->acked_allocs, 0, sizeof(en->acked_allocs));
@@ -649,6 +697,10 @@ static inline void process_allocated_traffic(struct comm_core_state *core,
 		current_timeslot = ++core->latest_timeslot[partition];
 		comm_log_got_admitted_tslot(get_num_admitted(admitted[i]),
 					    current_timeslot, partition);
+#ifdef ALLOC_TRACE_FILE
+		alloc_trace_buf_write_admitted(&alloc_trace_buf, current_timeslot,
+				admitted[i]);
+#endif
 		for (j = 0; j < get_num_admitted(admitted[i]); j++) {
 			/* process this node's allocation */
 #if defined(EMULATION_ALGO)
@@ -717,6 +769,9 @@ static inline void fill_packet_report(struct comm_core_state *core,
 		uint16_t node = report_pop(&en->report_queue);
 		pd->areq[pd->n_areq].src_dst_key = node;
 		pd->areq[pd->n_areq].tslots = en->alloc_to_dst[node];
+		/* reports only carry totals, not the class or deadline of demand */
+		pd->areq[pd->n_areq].tclass = 0;
+		pd->areq[pd->n_areq].deadline = 0;
 		pd->n_areq++;
 	}
 
@@ -761,7 +816,7 @@ next_alloc:
 
 	/* find the destination for this flow */
 	dst = en->allocs[wnd_pos(cur_tslot)];
-	index = (dst % NUM_NODES) + NUM_NODES * (dst >> 14);
+	index = (dst % NUM_NODES) + NUM_NODES * fp_alloc_path(dst);
 
 	if (core->alloc_enc_space[index] == 0) {
 		/* this is the first time seeing dst, need to add it to pd->dsts */
@@ -795,7 +850,7 @@ cleanup:
 	/* we set core->alloc_enc_space back to zeros */
 	for (i = 0; i < n_dsts; i++) {
 		dst = pd->dsts[i];
-		index = (dst % NUM_NODES) + NUM_NODES * (dst >> 14);
+		index = (dst % NUM_NODES) + NUM_NODES * fp_alloc_path(dst);
 		core->alloc_enc_space[index] = 0;
 	}
 
@@ -1012,11 +1067,11 @@ void exec_comm_core(struct comm_core_cmd * cmd)
 
 		/* Process the spent demands, launching a new demand for demands where
 		 * backlog increased while the original demand was being allocated */
-		handle_spent_demands(g_admissible_status());
+		admission_handle_spent_demands();
 
 		/* RX, retrans timers, and new traffic might push traffic into the
 		 * q_head buffer; flush it now. */
-		flush_backlog(g_admissible_status());
+		admission_flush_backlog();
 
 		/* process tx timers */
 		fp_timer_get_expired(&core->tx_timers, now, &lst);
@@ -19,7 +19,7 @@
 #define MAX_ADMITTED_PER_LOOP		(4*BATCH_SIZE)
 
 /* maximum number of paths possible */
-#define MAX_PATHS					4
+#define MAX_PATHS					(1 << FP_PATH_BITS)
 
 #define NODE_MAX_PKTS_PER_SEC		50000
 /* maximum burst of egress packets to a single node (must be >1, can be fraction) */
@@ -65,6 +65,14 @@ struct comm_core_state {
 };
 extern struct comm_core_state ccore_state[RTE_MAX_LCORE];
 
+#ifdef ALLOC_TRACE_FILE
+#include "../graph-algo/alloc_trace.h"
+/* the comm core queues trace records in alloc_trace_buf, the log core writes
+ * them to alloc_trace */
+extern struct alloc_trace alloc_trace;
+extern struct alloc_trace_buf alloc_trace_buf;
+#endif
+
 static inline uint32_t controller_ip(void)
 {
 	return IPv4(10,197,55,111);
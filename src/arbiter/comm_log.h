@@ -37,6 +37,7 @@ struct comm_log {
 	uint64_t areq_invalid_dst;
 	uint64_t demand_increased;
 	uint64_t demand_remained;
+	uint64_t demand_deferred;
 	uint64_t triggered_send;
 	uint64_t dequeue_admitted_failed;
 	uint64_t processed_tslots;
@@ -183,6 +184,15 @@ static inline void comm_log_demand_remained(uint32_t node_id, uint32_t dst,
 			node_id, dst, demand, orig_demand);
 }
 
+static inline void comm_log_demand_deferred(uint32_t node_id, uint32_t dst,
+		uint32_t orig_demand, uint32_t demand) {
+	(void)node_id;(void)dst;(void)orig_demand;(void)demand;
+	CL->demand_deferred++;
+	COMM_DEBUG("no room in backlog table for flow src %u dst %u, keeping demand"
+			" at 0x%X rather than 0x%X until the next A-REQ\n",
+			node_id, dst, orig_demand, demand);
+}
+
 static inline void comm_log_triggered_send(uint32_t node_id) {
 	(void)node_id;
 	CL->triggered_send++;
@@ -110,7 +110,7 @@ void launch_cores(void)
 	static uint64_t end_time;
 	int i; (void)i;
 	struct admission_core_cmd admission_cmd[N_ADMISSION_CORES];
-	struct path_sel_core_cmd path_sel_cmd;
+	struct path_sel_core_cmd path_sel_cmd[N_PATH_SEL_CORES + 1];
 	struct log_core_cmd log_cmd;
 	uint64_t first_time_slot;
 	uint64_t now;
@@ -148,21 +148,25 @@ void launch_cores(void)
 				"Cannot init q_path_selected: %s\n", rte_strerror(rte_errno));
 
 	/* initialize admission core global data */
-	admission_init_global(q_admitted);
+	if (g_admission_engine != NULL)
+		engine_admission_init_global(q_admitted);
+	else
+		admission_init_global(q_admitted);
 
 	// Calculate start and end times
 	start_time = rte_get_timer_cycles() + sec_to_hpet(0.2); /* start after last end */
 	end_time = start_time + sec_to_hpet(100*1000*1000);
 
 	/*** PATH_SELECTION CORES ***/
-	/* set commands */
-	path_sel_cmd.q_admitted = q_admitted;
-	path_sel_cmd.q_path_selected = q_path_selected;
-
-	/* launch admission core */
-	if (N_PATH_SEL_CORES > 0)
-		rte_eal_remote_launch(exec_path_sel_core, &path_sel_cmd,
-				enabled_lcore[FIRST_PATH_SEL_CORE]);
+	/* initialize path selection global data */
+	path_sel_init_global(q_admitted, q_path_selected);
+
+	/* launch path selection cores, all sharing one pipeline */
+	for (i = 0; i < N_PATH_SEL_CORES; i++) {
+		path_sel_cmd[i].pipeline = &g_path_sel_pipeline;
+		rte_eal_remote_launch(exec_path_sel_core, &path_sel_cmd[i],
+				enabled_lcore[FIRST_PATH_SEL_CORE + i]);
+	}
 
 	/*** ADMISSION CORES ***/
 	/* initialize core structures */
@@ -181,7 +185,9 @@ void launch_cores(void)
 		admission_cmd[i].start_timeslot = first_time_slot + i * BATCH_SIZE;
 
 		/* launch admission core */
-		rte_eal_remote_launch(exec_admission_core, &admission_cmd[i], lcore_id);
+		rte_eal_remote_launch(g_admission_engine != NULL ?
+				exec_engine_admission_core : exec_admission_core,
+				&admission_cmd[i], lcore_id);
 	}
 
 	/*** LOG CORE ***/
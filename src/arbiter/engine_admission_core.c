@@ -0,0 +1,115 @@
+/*
+ * engine_admission_core.c
+ *
+ * Admission through an allocation engine chosen at startup.
+ */
+
+#include "engine_admission_core.h"
+
+#include <rte_errno.h>
+#include <rte_string_fns.h>
+#include <string.h>
+#include <math.h>
+
+#include "main.h"
+#include "admission_core.h"
+#include "admission_core_common.h"
+#include "admission_log.h"
+#include "../protocol/platform.h"
+
+const struct alloc_engine *g_admission_engine;
+struct admissible_state *g_admission_engine_state;
+
+#ifndef NSEC_PER_SEC
+#define NSEC_PER_SEC (1000*1000*1000)
+#endif
+
+void engine_admission_init_global(struct rte_ring *q_admitted_out)
+{
+	int i;
+	char s[64];
+	struct alloc_engine_params params;
+
+	/* allocate admitted_traffic_pool */
+	uint32_t pool_index = 0;
+	uint32_t socketid = 0;
+	if (admitted_traffic_pool[pool_index] == NULL) {
+		snprintf(s, sizeof(s), "admitted_traffic_pool_%d", pool_index);
+		admitted_traffic_pool[pool_index] =
+			rte_mempool_create(s,
+				ADMITTED_TRAFFIC_MEMPOOL_SIZE, /* num elements */
+				sizeof(struct admitted_traffic), /* element size */
+				ADMITTED_TRAFFIC_CACHE_SIZE, /* cache size */
+				0, NULL, NULL, NULL, NULL, /* custom initialization, disabled */
+				socketid, 0);
+		if (admitted_traffic_pool[pool_index] == NULL)
+			rte_exit(EXIT_FAILURE,
+					"Cannot init admitted traffic pool on socket %d: %s\n", socketid,
+					rte_strerror(rte_errno));
+		else
+			RTE_LOG(INFO, ADMISSION, "Allocated admitted traffic pool on socket %d - %lu bufs\n",
+					socketid, (uint64_t)ADMITTED_TRAFFIC_MEMPOOL_SIZE);
+	}
+
+	/* init log */
+	for (i = 0; i < RTE_MAX_LCORE; i++)
+		admission_log_init(&admission_core_logs[i]);
+
+	/* init the engine's state, with the built-in algorithm's topology */
+	memset(&params, 0, sizeof(params));
+	params.num_nodes = NUM_NODES;
+#ifdef PIPELINED_ALGO
+	params.oversubscribed = OVERSUBSCRIBED;
+	params.inter_rack_capacity = INTER_RACK_CAPACITY;
+	params.out_of_boundary_capacity = OUT_OF_BOUNDARY_CAPACITY;
+#endif
+	params.q_admitted_out = q_admitted_out;
+	params.admitted_traffic_mempool = admitted_traffic_pool[0];
+	g_admission_engine_state = g_admission_engine->init(&params);
+	if (g_admission_engine_state == NULL)
+		rte_exit(EXIT_FAILURE, "Cannot init %s engine\n",
+				g_admission_engine->name);
+	RTE_LOG(INFO, ADMISSION, "Allocating with the %s engine\n",
+			g_admission_engine->name);
+}
+
+int exec_engine_admission_core(void *void_cmd_p)
+{
+	struct admission_core_cmd *cmd = (struct admission_core_cmd *)void_cmd_p;
+	uint32_t core_ind = cmd->admission_core_index;
+	uint64_t logical_timeslot = cmd->start_timeslot;
+	uint64_t start_time_first_timeslot;
+	/* calculate shift and mul for the rdtsc */
+	double tslot_len_seconds = ((double)(1 << TIMESLOT_SHIFT)) / ((double)TIMESLOT_MUL * NSEC_PER_SEC);
+	double tslot_len_rdtsc_cycles = tslot_len_seconds * rte_get_timer_hz();
+	uint32_t rdtsc_shift = (uint32_t)log(tslot_len_rdtsc_cycles) + 12;
+	uint32_t rdtsc_mul = ((double)(1 << rdtsc_shift)) / tslot_len_rdtsc_cycles;
+
+	/* engines allocate on a single core */
+	if (core_ind != 0)
+		return 0;
+
+	ADMISSION_DEBUG("core %d admission %d starting %s allocations\n",
+			rte_lcore_id(), core_ind, g_admission_engine->name);
+
+	/* do allocation loop */
+	while (1) {
+		/* re-calibrate clock */
+		uint64_t real_time = fp_get_time_ns();
+		uint64_t rdtsc_time = rte_get_timer_cycles();
+		uint64_t real_tslot = (real_time * TIMESLOT_MUL) >> TIMESLOT_SHIFT;
+		uint64_t rdtsc_tslot = (rdtsc_time * rdtsc_mul) >> rdtsc_shift;
+
+		/* perform allocation */
+		admission_log_allocation_begin(logical_timeslot,
+				start_time_first_timeslot);
+		g_admission_engine->get_admissible_traffic(g_admission_engine_state,
+				0, logical_timeslot + (rdtsc_tslot - real_tslot),
+				rdtsc_mul, rdtsc_shift);
+		admission_log_allocation_end(logical_timeslot);
+
+		logical_timeslot += g_admission_engine->batch_size;
+	}
+
+	return 0;
+}
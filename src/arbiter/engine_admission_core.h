@@ -0,0 +1,33 @@
+/*
+ * engine_admission_core.h
+ *
+ * Admission through an allocation engine chosen at startup (--engine, see
+ * alloc_engine.h), instead of the algorithm the arbiter was built with.
+ * Engines allocate on a single core, so only the first admission core runs.
+ */
+
+#ifndef ENGINE_ADMISSION_CORE_H
+#define ENGINE_ADMISSION_CORE_H
+
+#include <rte_ring.h>
+
+#include "../graph-algo/alloc_engine.h"
+
+/* the engine chosen at startup, NULL for the built-in algorithm */
+extern const struct alloc_engine *g_admission_engine;
+
+/* the engine's state, once engine_admission_init_global() ran */
+extern struct admissible_state *g_admission_engine_state;
+
+/**
+ * Creates the engine's state, admitting traffic to q_admitted_out
+ */
+void engine_admission_init_global(struct rte_ring *q_admitted_out);
+
+/**
+ * Runs the admission core
+ */
+int exec_engine_admission_core(void *void_cmd_p);
+
+
+#endif /* ENGINE_ADMISSION_CORE_H */
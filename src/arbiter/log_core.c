@@ -76,6 +76,9 @@ void print_comm_log(uint16_t lcore_id)
 	printf("\n  %lu informative acks for %lu allocations, %lu non-informative",
 			cl->acks_with_alloc, cl->total_acked_timeslots, cl->acks_without_alloc);
 	printf("\n  handled %lu resets", cl->handle_reset);
+#ifdef ALLOC_TRACE_FILE
+	printf("\n  %lu allocation trace records lost", alloc_trace_buf.lost_records);
+#endif
 
 	printf("\n  processed %lu tslots (%lu non-empty ptn) with %lu node-tslots, diff: %lu",
                cl->processed_tslots, cl->non_empty_tslots, cl->occupied_node_tslots, cl->total_demand - cl->occupied_node_tslots);
@@ -95,6 +98,9 @@ void print_comm_log(uint16_t lcore_id)
 		printf("\n  %lu rx packets were truncated", cl->rx_truncated_pkt);
 	if (cl->areq_invalid_dst)
 		printf("\n  %lu A-REQ payloads with invalid dst", cl->areq_invalid_dst);
+	if (cl->demand_deferred)
+		printf("\n  %lu A-REQ demands deferred, backlog table was full",
+				cl->demand_deferred);
 	if (cl->dequeue_admitted_failed)
 		printf("\n  %lu times couldn't dequeue a struct admitted_traffic!",
 				cl->dequeue_admitted_failed);
@@ -127,6 +133,13 @@ void print_global_admission_log() {
 	struct admission_statistics *sv = &saved_admission_statistics;
 	int i;
 
+	/* engines chosen at startup keep their statistics to themselves */
+	if (g_admission_engine != NULL) {
+		printf("\nadmission core (%s engine, %d batch size)\n",
+				g_admission_engine->name, g_admission_engine->batch_size);
+		return;
+	}
+
 #define D(X) (st->X - sv->X)
 	#ifdef PARALLEL_ALGO
 	printf("\nadmission core (pim with %d ptns, %d nodes per ptn)", N_PARTITIONS, PARTITION_N_NODES);
@@ -150,6 +163,9 @@ void print_global_admission_log() {
 			st->backlog_flush_forced);
 	printf("\n    %lu spent bins (+%lu), %lu spent demands (+%lu)",
 			st->spent_bins, D(spent_bins), st->spent_demands, D(spent_demands));
+	printf("\n    %lu backlog entries expired (+%lu), %lu demands dropped on full backlog table (+%lu)",
+			st->backlog_expired, D(backlog_expired),
+			st->backlog_table_full, D(backlog_table_full));
 	printf("\n");
 #undef D
 
@@ -175,7 +191,7 @@ void print_admission_core_log(uint16_t lcore, uint16_t adm_core_index) {
 			st->admitted_traffic_alloc_failed, st->wait_for_space_in_q_admitted_out,
 			st->out_bin_alloc_failed, st->wait_for_space_in_q_bin_out,
 			st->wait_for_space_in_q_spent, st->waiting_to_pass_token);
-	printf("\n  %lu flushed q_out (%lu automatic, %lu forced); %lu flushed q_spent (%lu automatic, %lu forced); processed from q_head %lu bins, %lu demands; run_passed %lu bins; wrap up passed %lu bins, internal %lu bins %lu demands",
+	printf("\n  %lu flushed q_out (%lu automatic, %lu forced); %lu flushed q_spent (%lu automatic, %lu forced); processed from q_head %lu bins, %lu demands; run_passed %lu bins; wrap up passed %lu bins, internal %lu bins %lu demands; %lu passed on chunk pool empty",
 			st->q_out_flush_bin_full + st->q_out_flush_batch_finished,
 			st->q_out_flush_bin_full, st->q_out_flush_batch_finished,
 			st->q_spent_flush_bin_full + st->q_spent_flush_batch_finished,
@@ -183,10 +199,13 @@ void print_admission_core_log(uint16_t lcore, uint16_t adm_core_index) {
 			st->new_request_bins, st->new_requests,
 			st->passed_bins_during_run,
 			st->passed_bins_during_wrap_up,
-				st->wrap_up_non_empty_bin, st->wrap_up_non_empty_bin_demands);
+				st->wrap_up_non_empty_bin, st->wrap_up_non_empty_bin_demands,
+			st->chunk_pool_empty);
 	#ifdef PARALLEL_ALGO
 	printf("\n    %lu phases completed, %lu not ready, %lu out of order",
                st->phase_finished, st->phase_none_ready, st->phase_out_of_order);
+	printf(", %lu stale accepts, %lu sender resets", st->pim_stale_accepts,
+               st->pim_sender_resets);
 	#endif
 	printf("\n");
 #undef D
@@ -226,6 +245,9 @@ int exec_log_core(void *void_cmd_p)
 	struct conn_log_struct conn_log;
 	FILE *fp;
 	char filename[MAX_FILENAME_LEN];
+#ifdef ALLOC_TRACE_FILE
+	bool trace_failed = false;
+#endif
 
 	snprintf(filename, MAX_FILENAME_LEN, "log/conn-%016llX.csv",
 			fp_get_time_ns());
@@ -249,9 +271,21 @@ int exec_log_core(void *void_cmd_p)
 				sizeof(saved_admission_core_statistics[i]));
 
 	while (1) {
-		/* wait until proper time */
-		while (next_ticks > rte_get_timer_cycles())
+		/* wait until proper time, writing out the allocation trace */
+		while (next_ticks > rte_get_timer_cycles()) {
+#ifdef ALLOC_TRACE_FILE
+			if (!trace_failed &&
+			    alloc_trace_drain(&alloc_trace, &alloc_trace_buf) != 0) {
+				LOGGING_ERR("couldn't write allocation trace, stopped writing it\n");
+				trace_failed = true;
+			}
+#endif
 			rte_pause();
+		}
+#ifdef ALLOC_TRACE_FILE
+		if (!trace_failed)
+			alloc_trace_flush(&alloc_trace);
+#endif
 
 		print_comm_log(enabled_lcore[FIRST_COMM_CORE]);
 		print_global_admission_log();
@@ -267,9 +301,9 @@ int exec_log_core(void *void_cmd_p)
 			conn_log.timestamp = fp_get_time_ns();
 			comm_dump_stat(i, &conn_log);
 
-			/* get backlog */
+			/* get backlog, engines' backlogs aren't visible */
 			conn_log.backlog = 0;
-			for (j = 0; j < MAX_NODES; j++)
+			for (j = 0; j < MAX_NODES && g_admission_engine == NULL; j++)
 				conn_log.backlog +=
 					backlog_get(g_admission_backlog(), i, j);
 
@@ -80,6 +80,7 @@
 #include "port_alloc.h"
 
 #include "control.h"
+#include "engine_admission_core.h"
 
 //#define MAIN_C_VERBOSE
 
@@ -754,6 +755,14 @@ print_usage(const char *prgname)
 		"  -p PORTMASK: hexadecimal bitmask of ports to configure\n"
 		"  --no-numa: optional, disable numa awareness\n",
 		prgname);
+#ifdef PIPELINED_ALGO
+	int i;
+
+	printf("  --engine NAME: optional, allocate with an engine instead of the built-in algorithm:");
+	for (i = 0; alloc_engines[i] != NULL; i++)
+		printf(" %s", alloc_engines[i]->name);
+	printf("\n");
+#endif
 }
 
 static int
@@ -783,6 +792,9 @@ parse_args(int argc, char **argv)
 	char *prgname = argv[0];
 	static struct option lgopts[] = {
 		{"no-numa", 0, 0, 0},
+#ifdef PIPELINED_ALGO
+		{"engine", 1, 0, 0},
+#endif
 		{NULL, 0, 0, 0}
 	};
 
@@ -812,6 +824,16 @@ parse_args(int argc, char **argv)
 				printf("numa is disabled \n");
 				numa_on = 0;
 			}
+#ifdef PIPELINED_ALGO
+			if (!strcmp(lgopts[option_index].name, "engine")) {
+				g_admission_engine = alloc_engine_by_name(optarg);
+				if (g_admission_engine == NULL) {
+					printf("unknown engine %s\n", optarg);
+					print_usage(prgname);
+					return -1;
+				}
+			}
+#endif
 			break;
 
 		default:
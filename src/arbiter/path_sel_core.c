@@ -1,24 +1,28 @@
-
 #include "path_sel_core.h"
 
 #include <rte_ip.h>
 #include "../graph-algo/fp_ring.h"
-#include "../graph-algo/path_selection.h"
+#include "../graph-algo/path_sel_pipeline.h"
 #include "control.h"
 
+struct path_sel_pipeline g_path_sel_pipeline;
+
+void path_sel_init_global(struct rte_ring *q_admitted,
+		struct rte_ring *q_path_selected)
+{
+	path_sel_pipeline_init(&g_path_sel_pipeline, q_admitted, q_path_selected,
+			NUM_RACKS);
+}
 
 int exec_path_sel_core(void *void_cmd_p)
 {
 	struct path_sel_core_cmd *cmd = (struct path_sel_core_cmd *)void_cmd_p;
-	struct admitted_traffic *admitted;
 
+	/* all path selection cores share the pipeline, which keeps timeslots
+	 * in order */
 	while (1) {
-		while (fp_ring_dequeue(cmd->q_admitted, (void **)&admitted) != 0)
+		while (!path_sel_pipeline_poll(cmd->pipeline))
 			/* busy wait */;
-
-		select_paths(admitted, NUM_RACKS);
-
-		fp_ring_enqueue(cmd->q_path_selected, (void *)admitted);
 	}
 	return 0;
 }
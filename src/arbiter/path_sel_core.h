@@ -8,12 +8,23 @@
 #ifndef PATH_SEL_CORE_H_
 #define PATH_SEL_CORE_H_
 
+struct path_sel_pipeline;
+struct rte_ring;
+
 /* Specifications for path selection core thread */
 struct path_sel_core_cmd {
-	struct rte_ring *q_admitted;
-	struct rte_ring *q_path_selected;
+	struct path_sel_pipeline *pipeline;
 };
 
+extern struct path_sel_pipeline g_path_sel_pipeline;
+
+/**
+ * Initialize the pipeline shared by all path selection cores, taking
+ *    timeslots from q_admitted and delivering them in order to q_path_selected
+ */
+void path_sel_init_global(struct rte_ring *q_admitted,
+		struct rte_ring *q_path_selected);
+
 int exec_path_sel_core(void *void_cmd_p);
 
 #endif /* PATH_SEL_CORE_H_ */
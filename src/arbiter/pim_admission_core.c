@@ -23,7 +23,7 @@ struct pim_state g_pim_state;
 struct rte_mempool* admitted_traffic_pool[NB_SOCKETS];
 struct admission_log admission_core_logs[RTE_MAX_LCORE];
 struct rte_ring *q_new_demands[N_ADMISSION_CORES];
-struct rte_ring *q_ready_partitions[N_ADMISSION_CORES];
+struct rte_ring *q_ready_partitions[PIM_N_READY_QUEUES];
 
 void pim_admission_init_global(struct rte_ring *q_admitted_out)
 {
@@ -85,7 +85,7 @@ void pim_admission_init_global(struct rte_ring *q_admitted_out)
 	}
 
 	/* init q_ready_partitions */
-	for (i = 0; i < N_ADMISSION_CORES; i++) {
+	for (i = 0; i < PIM_N_READY_QUEUES; i++) {
 		rte_snprintf(s, sizeof(s), "q_ready_partitions_%d", i);
 		q_ready_partitions[i] = rte_ring_create(s, Q_READY_PARTITIONS_RING_SIZE,
 							0, RING_F_SC_DEQ);
@@ -95,8 +95,12 @@ void pim_admission_init_global(struct rte_ring *q_admitted_out)
 	}
 
 	/* init pim_state */
-	pim_init_state(&g_pim_state, q_new_demands, q_admitted_out,
-                       bin_mempool, admitted_traffic_pool[0], q_ready_partitions);
+	if (pim_init_state(&g_pim_state, PARTITION_N_NODES, q_new_demands,
+			   q_admitted_out, bin_mempool, admitted_traffic_pool[0],
+			   q_ready_partitions) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot init pim state storage\n");
+	pim_set_policy(&g_pim_state, PIM_POLICY);
+	pim_set_iterations(&g_pim_state, PIM_ITERATIONS);
 }
 
 void pim_admission_init_core(uint16_t lcore_id)
@@ -135,7 +139,7 @@ int exec_pim_admission_core(void *void_cmd_p)
                 pim_do_accept(&g_pim_state, core_ind);
                 pim_process_accepts(&g_pim_state, core_ind);
                 uint8_t i;
-                for (i = 1; i < NUM_ITERATIONS; i++) {
+                for (i = 1; i < g_pim_state.num_iterations; i++) {
                         pim_do_grant(&g_pim_state, core_ind);
                         pim_do_accept(&g_pim_state, core_ind);
                         pim_process_accepts(&g_pim_state, core_ind);
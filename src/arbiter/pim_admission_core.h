@@ -16,6 +16,17 @@
 #define		BIN_MEMPOOL_SIZE			(64 * N_ADMISSION_CORES)
 #define		BIN_MEMPOOL_CACHE_SIZE			8
 
+/* how grants and accepts are chosen, e.g. build with
+ * -DPIM_POLICY=PIM_POLICY_ISLIP for round-robin pointers */
+#ifndef PIM_POLICY
+#define		PIM_POLICY				PIM_POLICY_RANDOM
+#endif
+
+/* grant and accept iterations per timeslot */
+#ifndef PIM_ITERATIONS
+#define		PIM_ITERATIONS				PIM_DEFAULT_ITERATIONS
+#endif
+
 /* pim state */
 extern struct pim_state g_pim_state;
 
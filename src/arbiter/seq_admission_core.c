@@ -102,10 +102,12 @@ void seq_admission_init_global(struct rte_ring *q_admitted_out)
 	}
 
 	/* init admissible_status */
-	seq_init_admissible_status(&g_seq_admissible_status, OVERSUBSCRIBED,
+	if (seq_init_admissible_status(&g_seq_admissible_status, OVERSUBSCRIBED,
 				   INTER_RACK_CAPACITY, OUT_OF_BOUNDARY_CAPACITY,
 				   NUM_NODES, q_head, q_admitted_out, q_spent, bin_mempool,
-				   admitted_traffic_pool[0], &q_bin[0]);
+				   admitted_traffic_pool[0], &q_bin[0]) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot init admissible status\n");
+	seq_set_bin_policy(&g_seq_admissible_status, ADMISSION_BIN_POLICY);
 
 }
 
@@ -7,10 +7,23 @@
 #include "main.h"
 #include "control.h"
 
+/* for oversubscribed ToR uplinks, build with e.g. -DOVERSUBSCRIBED=1
+ * -DSUPPORTS_OVERSUBSCRIPTION=1 -DINTER_RACK_CAPACITY=16 for 2:1 with racks
+ * of 32 (and -DTOR_SHIFT=5) */
+#ifndef OVERSUBSCRIBED
 #define		OVERSUBSCRIBED				0
+#endif
+#ifndef INTER_RACK_CAPACITY
 #define		INTER_RACK_CAPACITY			4
+#endif
 #define		OUT_OF_BOUNDARY_CAPACITY	16
 
+/* the order flows are allocated in within a traffic class, e.g. build with
+ * -DADMISSION_BIN_POLICY=BIN_POLICY_EDF to serve A-REQ deadlines first */
+#ifndef ADMISSION_BIN_POLICY
+#define		ADMISSION_BIN_POLICY		BIN_POLICY_LRU
+#endif
+
 #define		ADMITTED_TRAFFIC_MEMPOOL_SIZE	(BATCH_SIZE * 16 * 64)
 #define		ADMITTED_TRAFFIC_CACHE_SIZE		(2 * BATCH_SIZE)
 
@@ -84,10 +84,10 @@ static void add_initial_requests(struct comm_core_state *core,
 	uint32_t i;
 	for (src = 0; src < num_srcs; src++)
 		for (i = 0; i < num_dsts_per_src; i++)
-			add_backlog(g_admissible_status(),
-					src, (src + 1 + i) % num_srcs , flow_size);
+			admission_add_backlog(src, (src + 1 + i) % num_srcs,
+					flow_size, 0, 0);
 
-	flush_backlog(g_admissible_status());
+	admission_flush_backlog();
 }
 
 void exec_stress_test_core(struct stress_test_core_cmd * cmd,
@@ -205,8 +205,8 @@ void exec_stress_test_core(struct stress_test_core_cmd * cmd,
 				break;
 
 			/* enqueue the request */
-			add_backlog(g_admissible_status(),
-					next_request.src, next_request.dst, next_request.backlog);
+			admission_add_backlog(next_request.src, next_request.dst,
+					next_request.backlog, 0, 0);
 			comm_log_demand_increased(next_request.src, next_request.dst, 0,
 					next_request.backlog, next_request.backlog);
 
@@ -223,10 +223,10 @@ void exec_stress_test_core(struct stress_test_core_cmd * cmd,
 
 		/* Process the spent demands, launching a new demand for demands where
 		 * backlog increased while the original demand was being allocated */
-		handle_spent_demands(g_admissible_status());
+		admission_handle_spent_demands();
 
 		/* flush q_head's buffer into q_head */
-		flush_backlog(g_admissible_status());
+		admission_flush_backlog();
 
 		/* wait until at least loop_minimum_iteration_time has passed from
 		 * beginning of loop */
@@ -0,0 +1,192 @@
+/*
+ * benchmark_phase.c
+ *
+ * Measures how long partitions take to move from one phase to the next. A
+ * thread per partition repeatedly finishes a phase and then waits until all
+ * other partitions have finished it too, as PIM partitions do between grants
+ * and accepts, and the time per phase is reported for 2 to 16 partitions.
+ * Each partition count also runs with one thread playing all partitions in
+ * turn, which gives the cost of the bookkeeping alone, without cache lines
+ * moving between cores. benchmark_phase_rings is the same with
+ * PIM_PHASE_RINGS.
+ *
+ * usage: ./benchmark_phase [phases]
+ */
+
+#define _GNU_SOURCE /* for pthread_setaffinity_np */
+
+#include "phase.h"
+#include "../graph-algo/platform.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define READY_PARTITIONS_Q_SIZE                 6 /* two phases per partition,
+                                                     up to 32 partitions */
+#define NUM_PARTITION_COUNTS                    4
+#define DEFAULT_PHASES                          10000
+#define SPINS_BEFORE_YIELD                      1024
+
+#ifdef PIM_PHASE_RINGS
+#define MECHANISM_NAME                          "rings"
+#else
+#define MECHANISM_NAME                          "counters"
+#endif
+
+const uint16_t partition_counts [NUM_PARTITION_COUNTS] =
+        {2, 4, 8, 16};
+
+struct phase_state phase;
+struct fp_ring *q_ready[MAX_PARTITIONS];
+
+struct partition_thread {
+        pthread_t thread;
+        uint16_t partition;
+        uint32_t n_phases;
+        volatile bool *start;
+        struct admission_core_statistics stat;
+} __attribute__((aligned(64)));
+
+uint64_t time_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Pins a thread to a CPU, wrapping around if there are fewer CPUs
+void pin_thread_to_cpu(pthread_t thread, uint32_t cpu)
+{
+        cpu_set_t cpu_set;
+        long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpu % (num_cpus > 0 ? num_cpus : 1), &cpu_set);
+        if (pthread_setaffinity_np(thread, sizeof(cpu_set), &cpu_set) != 0)
+                fprintf(stderr, "could not pin thread to cpu %u\n", cpu);
+}
+
+// Finishes phases one after the other, each once all partitions finished the last
+void *run_partition(void *arg)
+{
+        struct partition_thread *t = (struct partition_thread *) arg;
+        uint32_t i, spins = 0;
+        uint16_t n_waiting;
+
+        fp_set_lcore_id(1 + t->partition);
+        while (!__atomic_load_n(t->start, __ATOMIC_ACQUIRE))
+                sched_yield();
+
+        for (i = 0; i < t->n_phases; i++) {
+                phase_finished(&phase, t->partition, &t->stat);
+                n_waiting = phase.n_partitions - 1;
+                while (n_waiting > 0) {
+                        if (phase_get_finished_partition(&phase, t->partition,
+                                                         &t->stat) != NONE_READY) {
+                                n_waiting--;
+                                continue;
+                        }
+
+                        /* let other partitions run when sharing a cpu */
+                        if (++spins == SPINS_BEFORE_YIELD) {
+                                sched_yield();
+                                spins = 0;
+                        }
+                        fp_pause();
+                }
+        }
+        return NULL;
+}
+
+// Runs all partitions in turn on this thread, returns the time taken in ns
+uint64_t run_one_thread(uint16_t n_partitions, uint32_t n_phases,
+                        struct admission_core_statistics *stat)
+{
+        uint32_t i;
+        uint16_t p, n_waiting;
+
+        uint64_t start_time = time_ns();
+        for (i = 0; i < n_phases; i++) {
+                for (p = 0; p < n_partitions; p++)
+                        phase_finished(&phase, p, stat);
+                for (p = 0; p < n_partitions; p++) {
+                        n_waiting = n_partitions - 1;
+                        while (n_waiting > 0) {
+                                if (phase_get_finished_partition(&phase, p, stat)
+                                    != NONE_READY)
+                                        n_waiting--;
+                        }
+                }
+        }
+        return time_ns() - start_time;
+}
+
+int main(int argc, char **argv) {
+        struct partition_thread threads[MAX_PARTITIONS];
+        uint32_t n_phases = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_PHASES;
+        uint16_t i, c;
+
+        fp_set_lcore_id(0);
+
+        for (i = 0; i < MAX_PARTITIONS; i++)
+                q_ready[i] = fp_ring_create(READY_PARTITIONS_Q_SIZE);
+
+        printf("mechanism, partitions, threads, phases, ns_per_phase, "
+               "none_ready_per_phase, out_of_order_per_phase\n");
+
+        for (c = 0; c < NUM_PARTITION_COUNTS; c++) {
+                uint16_t n_partitions = partition_counts[c];
+                volatile bool start = false;
+                uint64_t none_ready = 0, out_of_order = 0;
+
+                if (n_partitions > MAX_PARTITIONS)
+                        continue;
+
+                /* rings are empty again after every run, all entries were taken */
+                phase_state_init(&phase, n_partitions, &q_ready[0]);
+
+                for (i = 0; i < n_partitions; i++) {
+                        threads[i].partition = i;
+                        threads[i].n_phases = n_phases;
+                        threads[i].start = &start;
+                        memset(&threads[i].stat, 0, sizeof(threads[i].stat));
+                        if (pthread_create(&threads[i].thread, NULL, run_partition,
+                                           &threads[i]) != 0) {
+                                printf("Error creating partition thread\n");
+                                exit(-1);
+                        }
+                        pin_thread_to_cpu(threads[i].thread, i);
+                }
+
+                uint64_t start_time = time_ns();
+                __atomic_store_n(&start, true, __ATOMIC_RELEASE);
+                for (i = 0; i < n_partitions; i++)
+                        pthread_join(threads[i].thread, NULL);
+                uint64_t elapsed = time_ns() - start_time;
+
+                for (i = 0; i < n_partitions; i++) {
+                        none_ready += threads[i].stat.phase_none_ready;
+                        out_of_order += threads[i].stat.phase_out_of_order;
+                }
+
+                printf("%s, %u, %u, %u, %f, %f, %f\n", MECHANISM_NAME, n_partitions,
+                       n_partitions, n_phases, (double) elapsed / n_phases,
+                       (double) none_ready / n_phases / n_partitions,
+                       (double) out_of_order / n_phases / n_partitions);
+
+                /* the same with one thread */
+                struct admission_core_statistics stat;
+                memset(&stat, 0, sizeof(stat));
+                phase_state_init(&phase, n_partitions, &q_ready[0]);
+                elapsed = run_one_thread(n_partitions, n_phases, &stat);
+
+                printf("%s, %u, %u, %u, %f, %f, %f\n", MECHANISM_NAME, n_partitions,
+                       1, n_phases, (double) elapsed / n_phases,
+                       (double) stat.phase_none_ready / n_phases / n_partitions,
+                       (double) stat.phase_out_of_order / n_phases / n_partitions);
+        }
+}
@@ -0,0 +1,246 @@
+/*
+ * benchmark_pim.c
+ *
+ * Compares random PIM with iSLIP-style round-robin grants and accepts, for
+ * different numbers of iterations. Every src requests a fixed number of
+ * random dsts, with enough backlog to last the whole run, and the matching
+ * size and time to allocate each timeslot are reported. benchmark_pim_bitmap
+ * is the same with requests kept as bitmaps (PIM_BITMAP_ADJ).
+ *
+ * With 'geometry', instead sweeps the partition size, from the smallest to
+ * PARTITION_N_NODES, with the default number of iterations. Each partition's
+ * requests and grants are then walked on their own, so the sweep shows which
+ * partition size fits this host's caches best, and reports the fastest.
+ *
+ * usage: ./benchmark_pim [geometry]
+ */
+
+#include "pim.h"
+#include "pim_admissible_traffic.h"
+
+#include <time.h>
+#include <unistd.h>
+
+#define ADMITTED_TRAFFIC_MEMPOOL_SIZE           (4 * MAX_PARTITIONS)
+#define ADMITTED_OUT_RING_LOG_SIZE		16
+#define BIN_MEMPOOL_SIZE                        4096
+#define NEW_DEMANDS_Q_SIZE                      16
+#define READY_PARTITIONS_Q_SIZE                 2
+
+#define NUM_NODES                               MAX_NODES
+#define NUM_DEGREES                             4
+#define NUM_POLICIES                            2
+#define MAX_ITERATIONS                          4
+#define WARM_UP_TSLOTS                          1000
+#define MEASURED_TSLOTS                         10000
+#define FLOW_BACKLOG                            (1 << 20) /* never runs out */
+
+#ifdef PIM_BITMAP_ADJ
+#define ADJACENCY_NAME                          "bitmap"
+#else
+#define ADJACENCY_NAME                          "list"
+#endif
+
+const uint16_t degrees [NUM_DEGREES] =
+        {4, 16, 64, MAX_NODES - 1};
+const enum pim_policy policies [NUM_POLICIES] =
+        {PIM_POLICY_RANDOM, PIM_POLICY_ISLIP};
+const char *policy_names [NUM_POLICIES] =
+        {"random", "islip"};
+
+struct fp_ring *q_new_demands[MAX_PARTITIONS];
+struct fp_ring *q_admitted_out;
+struct fp_mempool *bin_mempool;
+struct fp_mempool *admitted_traffic_mempool;
+struct fp_ring *q_ready_partitions[PIM_MAX_READY_QUEUES];
+
+uint64_t time_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Allocates one timeslot, returns the number of admitted edges
+ */
+uint32_t run_timeslot(struct pim_state *state)
+{
+        uint32_t matching_size = 0;
+        uint16_t p;
+
+        pim_get_admissible_traffic(state);
+        for (p = 0; p < state->geometry.n_partitions; p++) {
+                struct admitted_traffic *admitted;
+                fp_ring_dequeue(state->q_admitted_out, (void **) &admitted);
+                matching_size += admitted->size;
+                fp_mempool_put(state->admitted_traffic_mempool, admitted);
+        }
+        return matching_size;
+}
+
+/**
+ * Returns the size in KB of the request rows of one partition, which its core
+ *    walks every iteration
+ */
+uint32_t partition_requests_kb(uint32_t partition_n_nodes)
+{
+        uint32_t row_bytes = sizeof(((struct ga_bitmap_adj *) 0)->neigh[0]);
+#ifndef PIM_BITMAP_ADJ
+        row_bytes += sizeof(((struct ga_adj *) 0)->neigh[0]);
+#endif
+        return partition_n_nodes * row_bytes / 1024;
+}
+
+/**
+ * Allocates MEASURED_TSLOTS timeslots after a warm up, with every src
+ *    requesting degrees[d] random dsts. Returns the time taken in ns and sets
+ *    'matched' to the number of admitted edges
+ */
+uint64_t run_config(uint16_t partition_n_nodes, enum pim_policy policy,
+                    uint8_t iterations, uint16_t d, uint64_t *matched)
+{
+        struct pim_state *state;
+        bool requested[NUM_NODES];
+        uint16_t i, src;
+        uint32_t t;
+
+        state = pim_create_state(partition_n_nodes, &q_new_demands[0], q_admitted_out,
+                                 bin_mempool, admitted_traffic_mempool,
+                                 q_ready_partitions);
+        if (state == NULL) {
+                printf("Error initializing pim state!\n");
+                exit(-1);
+        }
+        pim_set_policy(state, policy);
+        pim_set_iterations(state, iterations);
+
+        /* the same requests for every policy, iteration count and geometry */
+        srand(d + 1);
+        for (src = 0; src < NUM_NODES; src++) {
+                memset(requested, 0, sizeof(requested));
+                for (i = 0; i < degrees[d]; i++) {
+                        uint16_t dst;
+                        do {
+                                dst = rand() % NUM_NODES;
+                        } while (dst == src || requested[dst]);
+                        requested[dst] = true;
+                        pim_add_backlog(state, src, dst, FLOW_BACKLOG);
+                }
+        }
+        pim_flush_backlog(state);
+
+        for (t = 0; t < WARM_UP_TSLOTS; t++)
+                run_timeslot(state);
+
+        *matched = 0;
+        uint64_t start = time_ns();
+        for (t = 0; t < MEASURED_TSLOTS; t++)
+                *matched += run_timeslot(state);
+        uint64_t elapsed = time_ns() - start;
+
+        /* the bins the state holds stay out of bin_mempool */
+        pim_destroy_state(state);
+        return elapsed;
+}
+
+/**
+ * Runs every policy and degree with each partition size, then reports the
+ *    fastest partition size for each
+ */
+void sweep_geometry(void)
+{
+        uint16_t best_n_nodes[NUM_DEGREES][NUM_POLICIES];
+        double best_ns[NUM_DEGREES][NUM_POLICIES];
+        uint32_t n_nodes;
+        uint16_t d, p;
+
+        printf("# caches: l1d %ld KB, l2 %ld KB, l3 %ld KB\n",
+               sysconf(_SC_LEVEL1_DCACHE_SIZE) / 1024,
+               sysconf(_SC_LEVEL2_CACHE_SIZE) / 1024,
+               sysconf(_SC_LEVEL3_CACHE_SIZE) / 1024);
+        printf("adjacency, partitions, partition_nodes, partition_requests_kb, policy, "
+               "iterations, nodes, degree, matching_fraction, ns_per_tslot\n");
+
+        for (n_nodes = PARTITION_MIN_N_NODES; n_nodes <= PARTITION_N_NODES; n_nodes *= 2) {
+                if (!partition_n_nodes_is_valid(n_nodes))
+                        continue; /* too many partitions for MAX_PARTITIONS */
+
+                for (d = 0; d < NUM_DEGREES; d++) {
+                        for (p = 0; p < NUM_POLICIES; p++) {
+                                uint64_t matched;
+                                uint64_t elapsed = run_config(n_nodes, policies[p],
+                                                              PIM_DEFAULT_ITERATIONS, d,
+                                                              &matched);
+                                double ns = (double) elapsed / MEASURED_TSLOTS;
+
+                                printf("%s, %u, %u, %u, %s, %u, %u, %u, %f, %f\n",
+                                       ADJACENCY_NAME, (NUM_NODES + n_nodes - 1) / n_nodes,
+                                       n_nodes, partition_requests_kb(n_nodes),
+                                       policy_names[p], PIM_DEFAULT_ITERATIONS, NUM_NODES,
+                                       degrees[d],
+                                       (double) matched / MEASURED_TSLOTS / NUM_NODES, ns);
+
+                                if (n_nodes == PARTITION_MIN_N_NODES || ns < best_ns[d][p]) {
+                                        best_n_nodes[d][p] = n_nodes;
+                                        best_ns[d][p] = ns;
+                                }
+                        }
+                }
+        }
+
+        printf("\nadjacency, policy, degree, best_partitions, best_partition_nodes, "
+               "ns_per_tslot\n");
+        for (d = 0; d < NUM_DEGREES; d++) {
+                for (p = 0; p < NUM_POLICIES; p++) {
+                        printf("%s, %s, %u, %u, %u, %f\n", ADJACENCY_NAME, policy_names[p],
+                               degrees[d],
+                               (NUM_NODES + best_n_nodes[d][p] - 1) / best_n_nodes[d][p],
+                               best_n_nodes[d][p], best_ns[d][p]);
+                }
+        }
+}
+
+int main(int argc, char **argv) {
+        struct partition_geometry geometry;
+        uint16_t i, d, p, it;
+
+        for (i = 0; i < MAX_PARTITIONS; i++)
+                q_new_demands[i] = fp_ring_create(NEW_DEMANDS_Q_SIZE);
+        for (i = 0; i < PIM_MAX_READY_QUEUES; i++)
+                q_ready_partitions[i] = fp_ring_create(READY_PARTITIONS_Q_SIZE);
+        bin_mempool = fp_mempool_create(BIN_MEMPOOL_SIZE, bin_num_bytes(SMALL_BIN_SIZE),
+                                        0);
+        q_admitted_out = fp_ring_create(ADMITTED_OUT_RING_LOG_SIZE);
+        admitted_traffic_mempool = fp_mempool_create(ADMITTED_TRAFFIC_MEMPOOL_SIZE,
+                                                     sizeof(struct admitted_traffic), 0);
+
+        if (argc > 1 && strcmp(argv[1], "geometry") == 0) {
+                sweep_geometry();
+                return 0;
+        }
+
+        partition_geometry_init(&geometry, PARTITION_N_NODES);
+        printf("adjacency, state_kb, policy, iterations, nodes, degree, matching_size, "
+               "matching_fraction, ns_per_tslot\n");
+
+        for (d = 0; d < NUM_DEGREES; d++) {
+                for (p = 0; p < NUM_POLICIES; p++) {
+                        for (it = 1; it <= MAX_ITERATIONS; it++) {
+                                uint64_t matched;
+                                uint64_t elapsed = run_config(PARTITION_N_NODES,
+                                                              policies[p], it, d,
+                                                              &matched);
+
+                                printf("%s, %lu, %s, %u, %u, %u, %f, %f, %f\n",
+                                       ADJACENCY_NAME,
+                                       (sizeof(struct pim_state) +
+                                        pim_storage_size(&geometry)) / 1024,
+                                       policy_names[p], it, NUM_NODES, degrees[d],
+                                       (double) matched / MEASURED_TSLOTS,
+                                       (double) matched / MEASURED_TSLOTS / NUM_NODES,
+                                       (double) elapsed / MEASURED_TSLOTS);
+                        }
+                }
+        }
+}
@@ -0,0 +1,219 @@
+/*
+ * benchmark_pim_multicore.c
+ *
+ * Runs PIM with a thread per core, each allocating timeslots of its
+ * partitions with pim_run_pipeline(), and reports timeslots allocated per
+ * second. Every src requests a fixed number of random dsts, either with enough
+ * backlog to last the whole run or with a few timeslots each, so flows finish
+ * while several timeslots are in flight. The partition size and number of
+ * cores are picked on the command line, by default a core per partition of
+ * PARTITION_N_NODES nodes. Build variants set the timeslots each partition
+ * keeps in flight (PIM_PIPELINE_DEPTH), see the Makefile.
+ *
+ * usage: ./benchmark_pim_multicore_d2 [timeslots] [partition_nodes] [cores]
+ */
+
+#define _GNU_SOURCE /* for pthread_setaffinity_np */
+
+#include "pim.h"
+#include "pim_admissible_traffic.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ADMITTED_TRAFFIC_MEMPOOL_SIZE           (64 * PIM_MAX_READY_QUEUES)
+#define ADMITTED_OUT_RING_LOG_SIZE		16
+#define BIN_MEMPOOL_SIZE                        4096
+#define NEW_DEMANDS_Q_SIZE                      16
+#define READY_PARTITIONS_Q_SIZE                 6 /* two phases per partition,
+                                                     up to 32 partitions */
+
+#define NUM_NODES                               MAX_NODES
+#define NUM_DEGREES                             2
+#define NUM_POLICIES                            2
+#define NUM_BACKLOGS                            2
+#define DEFAULT_TSLOTS                          20000
+
+const uint16_t degrees [NUM_DEGREES] =
+        {16, MAX_NODES - 1};
+const enum pim_policy policies [NUM_POLICIES] =
+        {PIM_POLICY_RANDOM, PIM_POLICY_ISLIP};
+const char *policy_names [NUM_POLICIES] =
+        {"random", "islip"};
+const uint32_t flow_backlogs [NUM_BACKLOGS] =
+        {1 << 20 /* never runs out */, 4};
+
+struct core_thread {
+        pthread_t thread;
+        struct pim_state *state;
+        uint16_t core;
+        uint16_t n_cores;
+        uint64_t n_timeslots;
+        volatile bool *start;
+};
+
+uint64_t time_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Pins a thread to a CPU, wrapping around if there are fewer CPUs
+void pin_thread_to_cpu(pthread_t thread, uint32_t cpu)
+{
+        cpu_set_t cpu_set;
+        long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpu % (num_cpus > 0 ? num_cpus : 1), &cpu_set);
+        if (pthread_setaffinity_np(thread, sizeof(cpu_set), &cpu_set) != 0)
+                fprintf(stderr, "could not pin thread to cpu %u\n", cpu);
+}
+
+// Allocates all timeslots of one core's partitions, once the main thread says go
+void *run_core(void *arg)
+{
+        struct core_thread *t = (struct core_thread *) arg;
+
+        fp_set_lcore_id(1 + t->core);
+        while (!__atomic_load_n(t->start, __ATOMIC_ACQUIRE))
+                sched_yield();
+
+        pim_run_pipeline(t->state, t->core, t->n_cores, t->n_timeslots);
+        return NULL;
+}
+
+int main(int argc, char **argv) {
+        struct fp_ring *q_new_demands[MAX_PARTITIONS];
+        struct fp_ring *q_admitted_out;
+        struct fp_mempool *bin_mempool;
+        struct fp_mempool *admitted_traffic_mempool;
+        struct fp_ring *q_ready_partitions[PIM_MAX_READY_QUEUES];
+        struct core_thread threads[MAX_PARTITIONS];
+        bool requested[NUM_NODES];
+        uint64_t n_timeslots = (argc > 1) ? strtoull(argv[1], NULL, 10) : DEFAULT_TSLOTS;
+        uint32_t n_nodes = (argc > 2) ? atoi(argv[2]) : PARTITION_N_NODES;
+        uint32_t n_partitions = (NUM_NODES + n_nodes - 1) / n_nodes;
+        uint32_t n_cores = (argc > 3) ? atoi(argv[3]) : n_partitions;
+        uint16_t i, d, p, b, src;
+
+        if (!partition_n_nodes_is_valid(n_nodes)) {
+                printf("partition_nodes must be a power of two from %d to %d\n",
+                       PARTITION_MIN_N_NODES, PARTITION_N_NODES);
+                exit(-1);
+        }
+        if (n_cores < 1 || n_cores > n_partitions) {
+                printf("cores must be from 1 to the number of partitions, %u\n",
+                       n_partitions);
+                exit(-1);
+        }
+
+        fp_set_lcore_id(0);
+        pin_thread_to_cpu(pthread_self(), 0);
+
+        for (i = 0; i < MAX_PARTITIONS; i++)
+                q_new_demands[i] = fp_ring_create(NEW_DEMANDS_Q_SIZE);
+        for (i = 0; i < PIM_MAX_READY_QUEUES; i++)
+                q_ready_partitions[i] = fp_ring_create(READY_PARTITIONS_Q_SIZE);
+        bin_mempool = fp_mempool_create(BIN_MEMPOOL_SIZE, bin_num_bytes(SMALL_BIN_SIZE),
+                                        0);
+        q_admitted_out = fp_ring_create(ADMITTED_OUT_RING_LOG_SIZE);
+        admitted_traffic_mempool = fp_mempool_create(ADMITTED_TRAFFIC_MEMPOOL_SIZE,
+                                                     sizeof(struct admitted_traffic), 0);
+
+        printf("partitions, cores, pipeline_depth, policy, iterations, nodes, degree, "
+               "flow_backlog, matching_fraction, tslots_per_sec, stale_accepts, "
+               "phase_none_ready\n");
+
+        for (d = 0; d < NUM_DEGREES; d++) {
+                for (p = 0; p < NUM_POLICIES; p++) {
+                        for (b = 0; b < NUM_BACKLOGS; b++) {
+                                struct pim_state *state;
+                                volatile bool start = false;
+                                uint64_t matched = 0;
+                                uint64_t n_admitted = 0;
+                                uint64_t stale = 0, none_ready = 0;
+
+                                state = pim_create_state(n_nodes,
+                                                         &q_new_demands[0], q_admitted_out,
+                                                         bin_mempool, admitted_traffic_mempool,
+                                                         q_ready_partitions);
+                                if (state == NULL) {
+                                        printf("Error initializing pim state!\n");
+                                        exit(-1);
+                                }
+                                pim_set_policy(state, policies[p]);
+                                for (i = 0; i < n_partitions; i++)
+                                        memset(&state->cores[i].stat, 0,
+                                               sizeof(struct admission_core_statistics));
+
+                                /* the same requests for every policy and backlog */
+                                srand(d + 1);
+                                for (src = 0; src < NUM_NODES; src++) {
+                                        memset(requested, 0, sizeof(requested));
+                                        for (i = 0; i < degrees[d]; i++) {
+                                                uint16_t dst;
+                                                do {
+                                                        dst = rand() % NUM_NODES;
+                                                } while (dst == src || requested[dst]);
+                                                requested[dst] = true;
+                                                pim_add_backlog(state, src, dst,
+                                                                flow_backlogs[b]);
+                                        }
+                                }
+                                pim_flush_backlog(state);
+
+                                for (i = 0; i < n_cores; i++) {
+                                        threads[i].state = state;
+                                        threads[i].core = i;
+                                        threads[i].n_cores = n_cores;
+                                        threads[i].n_timeslots = n_timeslots;
+                                        threads[i].start = &start;
+                                        if (pthread_create(&threads[i].thread, NULL,
+                                                           run_core, &threads[i]) != 0) {
+                                                printf("Error creating core thread\n");
+                                                exit(-1);
+                                        }
+                                        pin_thread_to_cpu(threads[i].thread, 1 + i);
+                                }
+
+                                /* consume admitted traffic as the partitions output it */
+                                uint64_t start_time = time_ns();
+                                __atomic_store_n(&start, true, __ATOMIC_RELEASE);
+                                while (n_admitted < n_timeslots * n_partitions) {
+                                        struct admitted_traffic *admitted;
+                                        if (fp_ring_dequeue(q_admitted_out,
+                                                            (void **) &admitted) != 0) {
+                                                sched_yield();
+                                                continue;
+                                        }
+                                        matched += admitted->size;
+                                        n_admitted++;
+                                        fp_mempool_put(admitted_traffic_mempool, admitted);
+                                }
+                                for (i = 0; i < n_cores; i++)
+                                        pthread_join(threads[i].thread, NULL);
+                                uint64_t elapsed = time_ns() - start_time;
+
+                                for (i = 0; i < n_partitions; i++) {
+                                        stale += state->cores[i].stat.pim_stale_accepts;
+                                        none_ready += state->cores[i].stat.phase_none_ready;
+                                }
+
+                                printf("%u, %u, %u, %s, %u, %u, %u, %u, %f, %f, %lu, %lu\n",
+                                       n_partitions, n_cores, PIM_PIPELINE_DEPTH,
+                                       policy_names[p],
+                                       state->num_iterations, NUM_NODES, degrees[d],
+                                       flow_backlogs[b],
+                                       (double) matched / n_timeslots / NUM_NODES,
+                                       (double) n_timeslots * 1e9 / elapsed,
+                                       stale, none_ready);
+
+                                /* TODO: state to free up, but won't worry about it now */
+                        }
+                }
+        }
+}
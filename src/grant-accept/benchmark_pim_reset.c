@@ -0,0 +1,189 @@
+/*
+ * benchmark_pim_reset.c
+ *
+ * Measures the cost of pim_reset_sender() and its effect on allocation when
+ * endpoints reconnect often. Every src requests a fixed number of random dsts
+ * with enough backlog to last the whole run. Before each timeslot, a number
+ * of random srcs are reset and then request their dsts again, as an endpoint
+ * does after it reconnects. Reports the time per reset, the time to allocate
+ * each timeslot (which includes dropping the reset srcs' requests) and the
+ * matching size. benchmark_pim_reset_bitmap is the same with PIM_BITMAP_ADJ.
+ */
+
+#include "pim.h"
+#include "pim_admissible_traffic.h"
+
+#include <time.h>
+
+#define ADMITTED_TRAFFIC_MEMPOOL_SIZE           (4 * N_PARTITIONS)
+#define ADMITTED_OUT_RING_LOG_SIZE		16
+#define BIN_MEMPOOL_SIZE                        4096
+#define NEW_DEMANDS_Q_SIZE                      16
+#define READY_PARTITIONS_Q_SIZE                 2
+
+#define NUM_NODES                               MAX_NODES
+#define NUM_DEGREES                             3
+#define NUM_POLICIES                            2
+#define NUM_RESET_RATES                         4
+#define WARM_UP_TSLOTS                          1000
+#define MEASURED_TSLOTS                         10000
+#define FLOW_BACKLOG                            (1 << 20) /* never runs out */
+
+#ifdef PIM_BITMAP_ADJ
+#define ADJACENCY_NAME                          "bitmap"
+#else
+#define ADJACENCY_NAME                          "list"
+#endif
+
+const uint16_t degrees [NUM_DEGREES] =
+        {16, 64, MAX_NODES - 1};
+const enum pim_policy policies [NUM_POLICIES] =
+        {PIM_POLICY_RANDOM, PIM_POLICY_ISLIP};
+const char *policy_names [NUM_POLICIES] =
+        {"random", "islip"};
+/* each reset src re-requests up to MAX_NODES - 1 dsts. pim takes in only a
+ * few bins per partition each timeslot, so more resets would pile up bins */
+const uint16_t resets_per_tslot [NUM_RESET_RATES] =
+        {0, 1, 2, 4};
+
+uint16_t requested_dsts[NUM_NODES][NUM_NODES];
+
+uint64_t time_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Allocates one timeslot, returns the number of admitted edges
+ */
+uint32_t run_timeslot(struct pim_state *state)
+{
+        uint32_t matching_size = 0;
+        uint16_t p;
+
+        pim_get_admissible_traffic(state);
+        for (p = 0; p < N_PARTITIONS; p++) {
+                struct admitted_traffic *admitted;
+                fp_ring_dequeue(state->q_admitted_out, (void **) &admitted);
+                matching_size += admitted->size;
+                fp_mempool_put(state->admitted_traffic_mempool, admitted);
+        }
+        return matching_size;
+}
+
+/**
+ * Resets 'n_resets' random srcs, which then request all of their dsts again.
+ *    Returns the time spent in pim_reset_sender()
+ */
+uint64_t reconnect_senders(struct pim_state *state, uint16_t degree,
+                           uint16_t n_resets)
+{
+        uint64_t reset_time = 0;
+        uint16_t r, i;
+
+        for (r = 0; r < n_resets; r++) {
+                uint16_t src = rand() % NUM_NODES;
+
+                uint64_t start = time_ns();
+                pim_reset_sender(state, src);
+                reset_time += time_ns() - start;
+
+                for (i = 0; i < degree; i++)
+                        pim_add_backlog(state, src, requested_dsts[src][i], FLOW_BACKLOG);
+        }
+        pim_flush_backlog(state);
+        return reset_time;
+}
+
+int main() {
+        struct fp_ring *q_new_demands[N_PARTITIONS];
+        struct fp_ring *q_admitted_out;
+        struct fp_mempool *bin_mempool;
+        struct fp_mempool *admitted_traffic_mempool;
+        struct fp_ring *q_ready_partitions[PIM_N_READY_QUEUES];
+        bool requested[NUM_NODES];
+        uint16_t i, d, p, r, src;
+        uint32_t t;
+
+        for (i = 0; i < N_PARTITIONS; i++)
+                q_new_demands[i] = fp_ring_create(NEW_DEMANDS_Q_SIZE);
+        for (i = 0; i < PIM_N_READY_QUEUES; i++)
+                q_ready_partitions[i] = fp_ring_create(READY_PARTITIONS_Q_SIZE);
+        bin_mempool = fp_mempool_create(BIN_MEMPOOL_SIZE, bin_num_bytes(SMALL_BIN_SIZE),
+                                        0);
+        q_admitted_out = fp_ring_create(ADMITTED_OUT_RING_LOG_SIZE);
+        admitted_traffic_mempool = fp_mempool_create(ADMITTED_TRAFFIC_MEMPOOL_SIZE,
+                                                     sizeof(struct admitted_traffic), 0);
+
+        printf("adjacency, policy, nodes, degree, resets_per_tslot, ns_per_reset, "
+               "ns_per_tslot, matching_fraction, stale_accepts\n");
+
+        for (d = 0; d < NUM_DEGREES; d++) {
+                for (p = 0; p < NUM_POLICIES; p++) {
+                        for (r = 0; r < NUM_RESET_RATES; r++) {
+                                struct pim_state *state;
+                                uint64_t matched = 0;
+                                uint64_t reset_time = 0, alloc_time = 0;
+
+                                state = pim_create_state(PARTITION_N_NODES,
+                                                         &q_new_demands[0], q_admitted_out,
+                                                         bin_mempool, admitted_traffic_mempool,
+                                                         q_ready_partitions);
+                                if (state == NULL) {
+                                        printf("Error initializing pim state!\n");
+                                        exit(-1);
+                                }
+                                pim_set_policy(state, policies[p]);
+                                for (i = 0; i < N_PARTITIONS; i++)
+                                        memset(&state->cores[i].stat, 0,
+                                               sizeof(struct admission_core_statistics));
+
+                                /* the same requests and resets for every policy */
+                                srand(d + 1);
+                                for (src = 0; src < NUM_NODES; src++) {
+                                        memset(requested, 0, sizeof(requested));
+                                        for (i = 0; i < degrees[d]; i++) {
+                                                uint16_t dst;
+                                                do {
+                                                        dst = rand() % NUM_NODES;
+                                                } while (dst == src || requested[dst]);
+                                                requested[dst] = true;
+                                                requested_dsts[src][i] = dst;
+                                                pim_add_backlog(state, src, dst, FLOW_BACKLOG);
+                                        }
+                                }
+                                pim_flush_backlog(state);
+
+                                for (t = 0; t < WARM_UP_TSLOTS; t++) {
+                                        reconnect_senders(state, degrees[d], resets_per_tslot[r]);
+                                        run_timeslot(state);
+                                }
+
+                                for (t = 0; t < MEASURED_TSLOTS; t++) {
+                                        reset_time += reconnect_senders(state, degrees[d],
+                                                                        resets_per_tslot[r]);
+                                        uint64_t start = time_ns();
+                                        matched += run_timeslot(state);
+                                        alloc_time += time_ns() - start;
+                                }
+
+                                uint64_t stale = 0;
+                                for (i = 0; i < N_PARTITIONS; i++)
+                                        stale += state->cores[i].stat.pim_stale_accepts;
+                                uint32_t n_resets = resets_per_tslot[r] * MEASURED_TSLOTS;
+
+                                printf("%s, %s, %u, %u, %u, %f, %f, %f, %lu\n",
+                                       ADJACENCY_NAME, policy_names[p], NUM_NODES, degrees[d],
+                                       resets_per_tslot[r],
+                                       n_resets ? (double) reset_time / n_resets : 0.0,
+                                       (double) alloc_time / MEASURED_TSLOTS,
+                                       (double) matched / MEASURED_TSLOTS / NUM_NODES,
+                                       stale);
+
+                                /* TODO: state to free up, but won't worry about it now */
+                        }
+                }
+        }
+}
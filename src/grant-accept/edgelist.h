@@ -10,13 +10,11 @@
 
 #include "grant-accept.h"
 
-#define EDGELIST_PARTITION_MAX_EDGES		PARTITION_N_NODES
-
 /**
  * A container for edges from some paritition x to some partition y.
  *
- * Assumes each partition has at most GA_MAX_PARTITION_EDGES edges to
- *  another partition.
+ * Assumes each partition has at most as many edges to another partition
+ *  as it has nodes.
  *
  * @param n: number of edges
  * @param edge: the actual edges
@@ -25,22 +23,67 @@
  */
 struct ga_edgelist {
 	uint32_t n;
-	struct ga_edge edge[EDGELIST_PARTITION_MAX_EDGES];
+	struct ga_edge edge[];
 } __attribute__((aligned(64))) /* don't want sharing between cores */;
 
 /**
- * An edgelist partitioned by source
+ * A container for all edgelists in the graph, one per pair of partitions,
+ *   over storage of ga_partd_edgelist_storage_size() bytes set with
+ *   ga_partd_edgelist_init(). See ga_edgelist for assumptions.
  */
-struct ga_src_partd_edgelist {
-	struct ga_edgelist src[N_PARTITIONS];
+struct ga_partd_edgelist {
+	char *lists;
+	uint32_t list_size; /* bytes per edgelist, whole cache lines */
+	uint16_t n_partitions;
 };
 
 /**
- * A container for all edgelists in the graph. See ga_edgelist for assumptions.
+ * Returns the bytes of an edgelist with room for 'max_edges' edges
  */
-struct ga_partd_edgelist {
-	struct ga_src_partd_edgelist dst[N_PARTITIONS];
-};
+static inline
+uint32_t ga_edgelist_size(uint16_t max_edges)
+{
+	return GA_CACHE_ALIGN(offsetof(struct ga_edgelist, edge)
+			+ max_edges * sizeof(struct ga_edge));
+}
+
+/**
+ * Returns the bytes of storage for the edgelists between 'n_partitions'
+ *   partitions of 'partition_n_nodes' nodes
+ */
+static inline
+size_t ga_partd_edgelist_storage_size(uint16_t n_partitions,
+		uint16_t partition_n_nodes)
+{
+	return (size_t) n_partitions * n_partitions
+			* ga_edgelist_size(partition_n_nodes);
+}
+
+/**
+ * Sets up the edgelists between 'n_partitions' partitions of
+ *   'partition_n_nodes' nodes in 'storage', which should be cache line
+ *   aligned. Reset each source partition before use
+ */
+static inline
+void ga_partd_edgelist_init(struct ga_partd_edgelist *pedgelist,
+		void *storage, uint16_t n_partitions, uint16_t partition_n_nodes)
+{
+	pedgelist->lists = (char *) storage;
+	pedgelist->list_size = ga_edgelist_size(partition_n_nodes);
+	pedgelist->n_partitions = n_partitions;
+}
+
+/**
+ * Returns the edgelist from 'src_partition' to 'dst_partition'
+ */
+static inline
+struct ga_edgelist *ga_partd_edgelist_get(struct ga_partd_edgelist *pedgelist,
+		uint16_t dst_partition, uint16_t src_partition)
+{
+	uint32_t index = dst_partition * pedgelist->n_partitions + src_partition;
+	return (struct ga_edgelist *) (pedgelist->lists
+			+ (size_t) index * pedgelist->list_size);
+}
 
 /**
  * Adds edge to edgelist 'edgelist'
@@ -54,27 +97,28 @@ void ga_edgelist_add(struct ga_edgelist *edgelist, uint16_t src, uint16_t dst)
 }
 
 /**
- * Adds edge to the partitioned edgelist 'pedgelist'
+ * Adds edge to the partitioned edgelist 'pedgelist', partitioned by 'geometry'
  */
 static inline
 void ga_partd_edgelist_add(struct ga_partd_edgelist *pedgelist,
-		uint16_t src, uint16_t dst)
+		const struct partition_geometry *geometry, uint16_t src, uint16_t dst)
 {
         struct ga_edgelist *edgelist;
-        edgelist = &pedgelist->dst[PARTITION_OF(dst)].src[PARTITION_OF(src)];
+        edgelist = ga_partd_edgelist_get(pedgelist, partition_of(geometry, dst),
+                                         partition_of(geometry, src));
         ga_edgelist_add(edgelist, src, dst);
 }
 
 /**
- * Deletes all edges in source partition 'src_partition'
+ * Deletes all edges in source partition 'src_partition', of 'n_partitions'
  */
 static inline
 void ga_partd_edgelist_src_reset(struct ga_partd_edgelist *pedgelist,
-		uint16_t src_partition)
+		uint16_t n_partitions, uint16_t src_partition)
 {
 	uint16_t dst_partition;
-	for (dst_partition = 0; dst_partition < N_PARTITIONS; dst_partition++)
-		pedgelist->dst[dst_partition].src[src_partition].n = 0;
+	for (dst_partition = 0; dst_partition < n_partitions; dst_partition++)
+		ga_partd_edgelist_get(pedgelist, dst_partition, src_partition)->n = 0;
 }
 
 /**
@@ -82,32 +126,36 @@ void ga_partd_edgelist_src_reset(struct ga_partd_edgelist *pedgelist,
  */
 static inline
 void ga_edges_to_adj_by_dst(struct ga_edge *edges, uint32_t n_edges,
-		struct ga_adj *adj)
+		const struct partition_geometry *geometry, struct ga_adj *adj)
 {
 	uint32_t i;
 	for (i = 0; i < n_edges; i++)
 		ga_adj_add_edge_by_dst(adj, edges[i].src,
-                                       PARTITION_IDX(edges[i].dst));
+                                       partition_idx(geometry, edges[i].dst));
 }
 
 /**
  * Adds all edges destined for a destination partition to an adjacency
  *   structure, keyed by destination node.
  * @param pedgelist: the partitioned edgelist structure
+ * @param geometry: how nodes are partitioned
  * @param dst_partition: which destination partition to extract
  * @param dest_adj: the adjacency structure where edges to the destination will
  *    be added
  */
 static inline
 void ga_edgelist_to_adj_by_dst(struct ga_partd_edgelist *pedgelist,
+		const struct partition_geometry *geometry,
 		uint16_t dst_partition, struct ga_adj *dest_adj)
 {
 	uint16_t src_partition;
         struct ga_edgelist *edgelist;
 
-	for (src_partition = 0; src_partition < N_PARTITIONS; src_partition++) {
-                edgelist = &pedgelist->dst[dst_partition].src[src_partition];
-		ga_edges_to_adj_by_dst(&edgelist->edge[0], edgelist->n, dest_adj);
+	for (src_partition = 0; src_partition < geometry->n_partitions; src_partition++) {
+                edgelist = ga_partd_edgelist_get(pedgelist, dst_partition,
+                                                 src_partition);
+		ga_edges_to_adj_by_dst(&edgelist->edge[0], edgelist->n, geometry,
+                                       dest_adj);
 	}
 }
 
@@ -129,13 +177,15 @@ void ga_print_edgelist(struct ga_edgelist *edgelist)
  * Prints a partitioned edgelist to stdout for debugging
  */
 static inline
-void ga_print_partd_edgelist(struct ga_partd_edgelist *pedgelist)
+void ga_print_partd_edgelist(struct ga_partd_edgelist *pedgelist,
+                             uint16_t n_partitions)
 {
         uint16_t src_part, dst_part;
-        for (src_part = 0; src_part < N_PARTITIONS; src_part++) {
-                for (dst_part = 0; dst_part < N_PARTITIONS; dst_part++) {
+        for (src_part = 0; src_part < n_partitions; src_part++) {
+                for (dst_part = 0; dst_part < n_partitions; dst_part++) {
                         struct ga_edgelist *edgelist;
-                        edgelist = &pedgelist->dst[dst_part].src[src_part];
+                        edgelist = ga_partd_edgelist_get(pedgelist, dst_part,
+                                                         src_part);
 
                         if (edgelist->n == 0)
                                 continue;
@@ -8,33 +8,66 @@
 #ifndef GRANT_ACCEPT_H_
 #define GRANT_ACCEPT_H_
 
+#include <stddef.h>
 #include <stdint.h>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
 #include "../protocol/topology.h"
 #include "partitioning.h"
 
 #define GA_MAX_DEGREE			256
 
+/* storage of partitions written by different cores starts on its own cache
+ * line */
+#define GA_CACHE_LINE			64
+#define GA_CACHE_ALIGN(size)	(((size) + GA_CACHE_LINE - 1) & ~((size_t) GA_CACHE_LINE - 1))
+
 struct ga_edge {
 	uint16_t src;
 	uint16_t dst;
 } __attribute__((__packed__));
 
 /**
- * An adjacency structure for one partition of the graph.
+ * An adjacency structure for one partition of the graph, over storage of
+ *   ga_adj_storage_size() bytes set with ga_adj_init().
  *   degree: the number of neighbors of each node in the partition
  *   neigh:  the neighbors of each node
  */
 struct ga_adj {
-	uint16_t	degree[PARTITION_N_NODES];
-	uint16_t	neigh[PARTITION_N_NODES][GA_MAX_DEGREE];
-} __attribute__((aligned(64))) /* don't want sharing between cores */;
+	uint16_t	*degree;
+	uint16_t	(*neigh)[GA_MAX_DEGREE];
+	uint16_t	n_nodes;
+};
+
+/**
+ * Returns the bytes of storage an adjacency structure for 'n_nodes' nodes
+ *   takes, a whole number of cache lines
+ */
+static inline
+size_t ga_adj_storage_size(uint16_t n_nodes) {
+	return GA_CACHE_ALIGN(n_nodes * sizeof(uint16_t))
+			+ GA_CACHE_ALIGN(n_nodes * sizeof(uint16_t[GA_MAX_DEGREE]));
+}
+
+/**
+ * Sets up an adjacency structure for 'n_nodes' nodes in 'storage', which
+ *   should be cache line aligned. Call ga_reset_adj() before use
+ */
+static inline
+void ga_adj_init(struct ga_adj *adj, void *storage, uint16_t n_nodes) {
+	adj->degree = (uint16_t *) storage;
+	adj->neigh = (uint16_t (*)[GA_MAX_DEGREE]) ((char *) storage
+			+ GA_CACHE_ALIGN(n_nodes * sizeof(uint16_t)));
+	adj->n_nodes = n_nodes;
+}
 
 /**
  * Erases all edges from the adjacency structure
  */
 static inline
 void ga_reset_adj(struct ga_adj *adj) {
-	memset(&adj->degree[0], 0, sizeof(adj->degree));
+	memset(&adj->degree[0], 0, adj->n_nodes * sizeof(uint16_t));
 }
 
 /**
@@ -74,18 +107,166 @@ void ga_adj_delete_neigh(struct ga_adj *adj, uint16_t node_index,
 	adj->neigh[node_index][neigh_index] = adj->neigh[node_index][last_ind];
 }
 
+#define GA_BITMAP_WORDS			((MAX_NODES + 63) / 64)
+
+/**
+ * An adjacency structure for one partition of the graph, as bitmaps over all
+ *   nodes. Smaller than struct ga_adj, and has no order among neighbors.
+ *   Storage is set as for struct ga_adj, with ga_bitmap_adj_init().
+ *   degree: the number of neighbors of each node in the partition
+ *   neigh:  bit n of a node's bitmap is set if n is its neighbor
+ */
+struct ga_bitmap_adj {
+	uint16_t	*degree;
+	uint64_t	(*neigh)[GA_BITMAP_WORDS];
+	uint16_t	n_nodes;
+};
+
+/**
+ * Returns the bytes of storage a bitmap adjacency structure for 'n_nodes'
+ *   nodes takes, a whole number of cache lines
+ */
+static inline
+size_t ga_bitmap_adj_storage_size(uint16_t n_nodes) {
+	return GA_CACHE_ALIGN(n_nodes * sizeof(uint16_t))
+			+ GA_CACHE_ALIGN(n_nodes * sizeof(uint64_t[GA_BITMAP_WORDS]));
+}
+
+/**
+ * Sets up a bitmap adjacency structure for 'n_nodes' nodes in 'storage',
+ *   which should be cache line aligned. Call ga_reset_bitmap_adj() before use
+ */
+static inline
+void ga_bitmap_adj_init(struct ga_bitmap_adj *adj, void *storage,
+		uint16_t n_nodes) {
+	adj->degree = (uint16_t *) storage;
+	adj->neigh = (uint64_t (*)[GA_BITMAP_WORDS]) ((char *) storage
+			+ GA_CACHE_ALIGN(n_nodes * sizeof(uint16_t)));
+	adj->n_nodes = n_nodes;
+}
+
+/**
+ * Erases all edges from the bitmap adjacency structure
+ */
+static inline
+void ga_reset_bitmap_adj(struct ga_bitmap_adj *adj) {
+	memset(&adj->degree[0], 0, adj->n_nodes * sizeof(uint16_t));
+	memset(&adj->neigh[0][0], 0, adj->n_nodes * sizeof(adj->neigh[0]));
+}
+
+/**
+ * Adds neighbor 'neigh' to the node at node_index, if it isn't one already
+ */
+static inline
+void ga_bitmap_adj_add(struct ga_bitmap_adj *adj, uint16_t node_index,
+		uint16_t neigh)
+{
+	uint64_t mask = 1ULL << (neigh & 63);
+
+	if (adj->neigh[node_index][neigh >> 6] & mask)
+		return;
+	adj->neigh[node_index][neigh >> 6] |= mask;
+	adj->degree[node_index]++;
+}
+
+/**
+ * Returns true if 'neigh' is a neighbor of the node at node_index
+ */
+static inline
+bool ga_bitmap_adj_has(const struct ga_bitmap_adj *adj, uint16_t node_index,
+		uint16_t neigh)
+{
+	return (adj->neigh[node_index][neigh >> 6] >> (neigh & 63)) & 1;
+}
+
+/**
+ * Removes neighbor 'neigh' from the node at node_index
+ */
+static inline
+void ga_bitmap_adj_delete(struct ga_bitmap_adj *adj, uint16_t node_index,
+		uint16_t neigh)
+{
+	adj->neigh[node_index][neigh >> 6] &= ~(1ULL << (neigh & 63));
+	adj->degree[node_index]--;
+}
+
+/**
+ * Returns the position of the set bit of 'word' with 'rank' set bits below
+ *   it, 'rank' must be less than the number of set bits
+ */
+static inline __attribute__((always_inline))
+uint16_t ga_select_in_word(uint64_t word, uint32_t rank)
+{
+#ifdef __BMI2__
+	return __builtin_ctzll(_pdep_u64(1ULL << rank, word));
+#else
+	/* count the bits in each byte, then sum the counts up to each byte */
+	uint64_t counts = word - ((word >> 1) & 0x5555555555555555ULL);
+	counts = (counts & 0x3333333333333333ULL)
+			+ ((counts >> 2) & 0x3333333333333333ULL);
+	counts = (counts + (counts >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	uint64_t sums = counts * 0x0101010101010101ULL;
+
+	/* find the byte with the bit, then the bit in the byte */
+	uint16_t shift = 0;
+	while (((sums >> shift) & 0xff) <= rank)
+		shift += 8;
+	if (shift > 0)
+		rank -= (sums >> (shift - 8)) & 0xff;
+	uint32_t bits = (word >> shift) & 0xff;
+	while (rank-- > 0)
+		bits &= bits - 1;
+	return shift + __builtin_ctz(bits);
+#endif
+}
+
+/**
+ * Returns the node whose bit has 'rank' set bits before it in 'nodes' and
+ *   not in 'excluded', or MAX_NODES if there are not that many
+ */
+static inline __attribute__((always_inline))
+uint16_t ga_bitmap_select(const uint64_t *nodes, const uint64_t *excluded,
+		uint32_t rank)
+{
+	uint16_t w;
+
+	for (w = 0; w < GA_BITMAP_WORDS; w++) {
+		uint64_t bits = nodes[w] & ~excluded[w];
+		uint32_t count = __builtin_popcountll(bits);
+		if (rank < count)
+			return (w << 6) + ga_select_in_word(bits, rank);
+		rank -= count;
+	}
+	return MAX_NODES;
+}
+
+/**
+ * Returns the number of bits set in 'nodes' and not in 'excluded'
+ */
+static inline __attribute__((always_inline))
+uint32_t ga_bitmap_count(const uint64_t *nodes, const uint64_t *excluded)
+{
+	uint32_t count = 0;
+	uint16_t w;
+
+	for (w = 0; w < GA_BITMAP_WORDS; w++)
+		count += __builtin_popcountll(nodes[w] & ~excluded[w]);
+	return count;
+}
+
 /**
  * Prints an adjacency list to stdout for debugging
  */
 static inline
-void ga_print_adj(struct ga_adj *adj, uint16_t src_partition)
+void ga_print_adj(struct ga_adj *adj, const struct partition_geometry *geometry,
+                  uint16_t src_partition)
 {
         uint16_t i, j;
-        for (i = 0; i < PARTITION_N_NODES; i++) {
+        for (i = 0; i < partition_n_nodes(geometry); i++) {
                 if (adj->degree[i] == 0)
                         continue;
 
-                printf("neighbors of %d: ", i + first_in_partition(src_partition));
+                printf("neighbors of %d: ", i + first_in_partition(geometry, src_partition));
                 printf("%d", adj->neigh[i][0]);
                 for (j = 1; j < adj->degree[i]; j++) {
                         printf(", %d", adj->neigh[i][j]);
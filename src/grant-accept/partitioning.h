@@ -1,36 +1,107 @@
 #ifndef PARTITIONING_H_
 #define PARTITIONING_H_
 
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "../protocol/topology.h"
 
-/* to use a non-multiple-of-8 PARTITION_N_NODES, modify the packing of
- * bitmasks specified by macros in pim.h */
+/* the largest partition. the partition size used is picked at startup (see
+ * struct partition_geometry), up to this many nodes. must be a power of two */
+#ifndef PARTITION_N_NODES
 #define PARTITION_N_NODES	128
+#endif
+/* the number of partitions with the largest partition size, the default */
 #define N_PARTITIONS			((MAX_NODES + PARTITION_N_NODES - 1) / PARTITION_N_NODES)
 
-#if (PARTITION_N_NODES >= MAX_NODES)
-#define PARTITION_OF(node)		(0)
-#define PARTITION_IDX(node)		(node)
-#else
-#define PARTITION_OF(node)		(node / PARTITION_N_NODES)
-#define PARTITION_IDX(node)		(node % PARTITION_N_NODES)
+/* the smallest partition, bitmasks of a partition's nodes are packed into
+ * 8 bit words (see pim.h) */
+#define PARTITION_MIN_N_NODES	8
+
+/* the most partitions any geometry has. per-partition arrays are this long,
+ * their large structures are allocated for the geometry in use (see
+ * pim_init_state) */
+#ifndef MAX_PARTITIONS
+#define MAX_PARTITIONS		((MAX_NODES + PARTITION_MIN_N_NODES - 1) / PARTITION_MIN_N_NODES)
+#endif
+
+#if (MAX_PARTITIONS < N_PARTITIONS)
+#error "MAX_PARTITIONS must fit the partitions of size PARTITION_N_NODES"
 #endif
 
+/**
+ * How nodes are split into partitions: consecutive runs of node ids, of
+ *    the same power-of-two size
+ */
+struct partition_geometry {
+        uint16_t n_partitions;
+        uint16_t node_shift; /* log2 of the nodes per partition */
+};
+
+/**
+ * Returns true if partitions of 'partition_n_nodes' nodes can be used
+ */
+static inline
+bool partition_n_nodes_is_valid(uint32_t partition_n_nodes) {
+        return partition_n_nodes >= PARTITION_MIN_N_NODES
+                && partition_n_nodes <= PARTITION_N_NODES
+                && (partition_n_nodes & (partition_n_nodes - 1)) == 0
+                && (MAX_NODES + partition_n_nodes - 1) / partition_n_nodes <= MAX_PARTITIONS;
+}
+
+/**
+ * Initialize a geometry with partitions of 'partition_n_nodes' nodes
+ */
+static inline
+void partition_geometry_init(struct partition_geometry *geometry,
+                             uint16_t partition_n_nodes) {
+        assert(partition_n_nodes_is_valid(partition_n_nodes));
+        geometry->n_partitions = (MAX_NODES + partition_n_nodes - 1) / partition_n_nodes;
+        geometry->node_shift = __builtin_ctz(partition_n_nodes);
+}
+
+/**
+ * Returns the number of nodes in each partition
+ */
+static inline
+uint16_t partition_n_nodes(const struct partition_geometry *geometry) {
+        return 1 << geometry->node_shift;
+}
+
+/**
+ * Returns the partition of this node
+ */
+static inline
+uint16_t partition_of(const struct partition_geometry *geometry, uint16_t node) {
+        return node >> geometry->node_shift;
+}
+
+/**
+ * Returns the index of this node within its partition
+ */
+static inline
+uint16_t partition_idx(const struct partition_geometry *geometry, uint16_t node) {
+        return node & (partition_n_nodes(geometry) - 1);
+}
+
 /**
  * Returns the id of the first node in this partition
  */
 static inline
-uint16_t first_in_partition(uint16_t partition) {
-        return partition * PARTITION_N_NODES;
+uint16_t first_in_partition(const struct partition_geometry *geometry,
+                            uint16_t partition) {
+        return partition << geometry->node_shift;
 }
 
 /**
  * Returns the id of the last node in this partition
  */
 static inline
-uint16_t last_in_partition(uint16_t partition) {
-        return (partition == N_PARTITIONS - 1) ? (MAX_NODES - 1)
-                : (first_in_partition(partition + 1) - 1);
+uint16_t last_in_partition(const struct partition_geometry *geometry,
+                           uint16_t partition) {
+        return (partition == geometry->n_partitions - 1) ? (MAX_NODES - 1)
+                : (first_in_partition(geometry, partition + 1) - 1);
 }
 
 #endif /* PARTITIONING_H_ */
@@ -8,28 +8,45 @@
 #ifndef PHASE_H_
 #define PHASE_H_
 
+#include <string.h>
+
 #include "partitioning.h"
 #include "../graph-algo/admissible_algo_log.h"
 #include "../graph-algo/fp_ring.h"
 
-#define NONE_READY     N_PARTITIONS
+#define NONE_READY     MAX_PARTITIONS
+
+/* partitions announce finished phases by bumping a counter of their own, which
+ * the others poll. build with -DPIM_PHASE_RINGS to instead pass an entry per
+ * finished phase through a ring per partition, as before */
+#define PHASE_PENDING_WORDS ((MAX_PARTITIONS + 63) / 64)
 
 /**
  *  Tracks what phase a partition is in and which
  *  partitions are ready to be processed by it
  */
 struct partition_phase_state {
+#ifdef PIM_PHASE_RINGS
         struct fp_ring *q_ready;
         uint16_t phase;
+#else
+        uint32_t phase; /* phases finished so far, polled by other partitions */
+        /* the partitions yet to be seen finishing this partition's current
+         * phase. only this partition uses it, so it gets its own cache line */
+        uint64_t pending[PHASE_PENDING_WORDS] __attribute__((aligned(64)));
+#endif
 } __attribute__((aligned(64)));
 
 /**
  *  Tracks phase state for each partition
  */
 struct phase_state {
-        struct partition_phase_state partitions[N_PARTITIONS];
+        struct partition_phase_state partitions[MAX_PARTITIONS];
+        uint16_t n_partitions;
+        uint64_t all_partitions[PHASE_PENDING_WORDS]; /* bitmap */
 };
 
+#ifdef PIM_PHASE_RINGS
 static inline
 uint64_t create_queue_entry(uint16_t phase, uint16_t partition_index) {
         return (((uint64_t) phase) << 16) | partition_index;
@@ -44,16 +61,26 @@ static inline
 uint16_t get_partition_from_queue_entry(uint64_t queue_entry) {
         return queue_entry & 0xFFFF;
 }
+#endif
 
 /**
- * Initialize a phase_state structure
+ * Initialize a phase_state structure for 'n_partitions' partitions. With
+ *    PIM_PHASE_RINGS, each partition has its ring in 'q_ready'
  */
 static inline
-void phase_state_init(struct phase_state *phase,
+void phase_state_init(struct phase_state *phase, uint16_t n_partitions,
                      struct fp_ring **q_ready) {
         uint16_t i;
-        for (i = 0; i < N_PARTITIONS; i++) {
+        phase->n_partitions = n_partitions;
+        memset(&phase->all_partitions[0], 0, sizeof(phase->all_partitions));
+        for (i = 0; i < n_partitions; i++) {
+                phase->all_partitions[i >> 6] |= (1ULL << (i & 63));
+#ifdef PIM_PHASE_RINGS
                 phase->partitions[i].q_ready = q_ready[i];
+#else
+                memset(&phase->partitions[i].pending[0], 0,
+                       sizeof(phase->partitions[i].pending));
+#endif
                 phase->partitions[i].phase = 0;
         }
 }
@@ -67,26 +94,41 @@ void phase_finished(struct phase_state *phase_state,
                     struct admission_core_statistics *stat) {
         adm_log_phase_finished(stat);
 
+#ifdef PIM_PHASE_RINGS
         uint16_t phase = ++phase_state->partitions[partition_index].phase;
         uint64_t queue_entry = create_queue_entry(phase, partition_index);
 
         /* for each other partition, enqueue an entry */
+        uint16_t n_partitions = phase_state->n_partitions;
         uint16_t i, partition;
-        for (i = 1; i < N_PARTITIONS; i++) {
-                partition = (partition_index + i) % N_PARTITIONS;
+        for (i = 1; i < n_partitions; i++) {
+                partition = (partition_index + i) % n_partitions;
                 fp_ring_enqueue(phase_state->partitions[partition].q_ready,
                                 (void *) queue_entry);
         }
+#else
+        struct partition_phase_state *mine = &phase_state->partitions[partition_index];
+
+        /* wait for all other partitions to finish the new phase */
+        memcpy(&mine->pending[0], &phase_state->all_partitions[0],
+               sizeof(mine->pending));
+        mine->pending[partition_index >> 6] &= ~(1ULL << (partition_index & 63));
+
+        /* publish, after everything written in the phase */
+        __atomic_store_n(&mine->phase, mine->phase + 1, __ATOMIC_RELEASE);
+#endif
 }
 
 /**
  * Returns another partition that has finished the previous phase
- * or NONE_READY if none are done
+ * or NONE_READY if none are done. Each other partition is returned once
+ * per phase
  */
 static inline
 uint16_t phase_get_finished_partition(struct phase_state *phase_state,
                                       uint16_t partition_index,
                                       struct admission_core_statistics *stat) {
+#ifdef PIM_PHASE_RINGS
         uint64_t queue_entry;
         int ret = fp_ring_dequeue(phase_state->partitions[partition_index].q_ready,
                                   (void *) &queue_entry);
@@ -108,6 +150,31 @@ uint16_t phase_get_finished_partition(struct phase_state *phase_state,
         }
 
         return get_partition_from_queue_entry(queue_entry);
+#else
+        struct partition_phase_state *mine = &phase_state->partitions[partition_index];
+        uint32_t my_phase = mine->phase;
+        uint16_t word;
+
+        for (word = 0; word < PHASE_PENDING_WORDS; word++) {
+                uint64_t bits = mine->pending[word];
+                while (bits != 0) {
+                        uint16_t partition = (word << 6) + __builtin_ctzll(bits);
+                        bits &= bits - 1;
+
+                        /* others may be a phase or two ahead already */
+                        uint32_t phase = __atomic_load_n(
+                                        &phase_state->partitions[partition].phase,
+                                        __ATOMIC_ACQUIRE);
+                        if ((int32_t) (phase - my_phase) >= 0) {
+                                mine->pending[word] &= ~(1ULL << (partition & 63));
+                                return partition;
+                        }
+                }
+        }
+
+        adm_log_phase_none_ready(stat);
+        return NONE_READY;
+#endif
 }
 
 #endif /* PHASE_H_ */
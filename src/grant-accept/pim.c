@@ -16,11 +16,11 @@
 #define RING_DEQUEUE_BURST_SIZE		8
 
 /**
- * Return true if the src is already allocated, false otherwise.
+ * Return true if the src, at 'src_index' in its partition, is already
+ *    allocated, false otherwise.
  */
 static inline __attribute__((always_inline))
-bool src_is_allocated(struct pim_core_state *core, uint16_t src) {
-        uint16_t src_index = PARTITION_IDX(src);
+bool src_is_allocated(struct pim_core_slot_state *core, uint16_t src_index) {
         return ((core->src_endnodes[PIM_BITMASK_WORD(src_index)] >>
                  PIM_BITMASK_SHIFT(src_index)) & 0x1);
 }
@@ -29,36 +29,94 @@ bool src_is_allocated(struct pim_core_state *core, uint16_t src) {
  * Return true if the dst is already allocated, false otherwise.
  */
 static inline __attribute__((always_inline))
-bool dst_is_allocated(struct pim_state *state, uint16_t dst) {
+bool dst_is_allocated(struct pim_state *state, uint16_t slot, uint16_t dst) {
         /* this function may be called by a different core than
          * the core of dst */
-        struct pim_core_state *core = &state->cores[PARTITION_OF(dst)];
+        struct pim_core_slot_state *core =
+                &state->cores[partition_of(&state->geometry, dst)].slots[slot];
 
-        uint16_t dst_index = PARTITION_IDX(dst);
+        uint16_t dst_index = partition_idx(&state->geometry, dst);
         return ((core->dst_endnodes[PIM_BITMASK_WORD(dst_index)] >>
                  PIM_BITMASK_SHIFT(dst_index)) & 0x1);
 }
 
 /**
- * Mark the src as allocated.
+ * Mark the src, at 'src_index' in its partition, as allocated.
  */
 static inline __attribute__((always_inline))
-void mark_src_allocated(struct pim_core_state *core, uint16_t src) {
-        uint16_t src_index = PARTITION_IDX(src);
+void mark_src_allocated(struct pim_core_slot_state *core, uint16_t src_index) {
         core->src_endnodes[PIM_BITMASK_WORD(src_index)] |=
                 (0x1 << PIM_BITMASK_SHIFT(src_index));
 }
 
 /**
- * Mark the dst as allocated.
+ * Mark the dst, at 'dst_index' in its partition, as allocated.
  */
 static inline __attribute__((always_inline))
-void mark_dst_allocated(struct pim_core_state *core, uint16_t dst) {
-        uint16_t dst_index = PARTITION_IDX(dst);
+void mark_dst_allocated(struct pim_core_slot_state *core, uint16_t dst_index) {
         core->dst_endnodes[PIM_BITMASK_WORD(dst_index)]
                 |= (0x1 << PIM_BITMASK_SHIFT(dst_index));
 }
 
+/**
+ * Returns the index in 'neigh' of the first of the 'degree' nodes at or after
+ *    'ptr' in round-robin order
+ */
+static inline __attribute__((always_inline))
+uint16_t round_robin_index(const uint16_t *neigh, uint16_t degree, uint16_t ptr) {
+        uint16_t i, dist;
+        uint16_t best = 0;
+        uint16_t best_dist = MAX_NODES;
+
+        for (i = 0; i < degree; i++) {
+                dist = (neigh[i] - ptr) & (MAX_NODES - 1);
+                if (dist < best_dist) {
+                        best = i;
+                        best_dist = dist;
+                }
+        }
+        return best;
+}
+
+/**
+ * Returns the first node at or after 'ptr' in round-robin order that is set
+ *    in the bitmap 'nodes' and not in 'excluded', or MAX_NODES if none is.
+ */
+static inline __attribute__((always_inline))
+uint16_t round_robin_node(const uint64_t *nodes, const uint64_t *excluded,
+                          uint16_t ptr) {
+        uint16_t word = ptr >> 6;
+        uint64_t bits = nodes[word] & ~excluded[word] & (~0ULL << (ptr & 63));
+        uint16_t i;
+
+        /* the last pass wraps back to the bits before ptr in the first word */
+        for (i = 0; i <= GA_BITMAP_WORDS; i++) {
+                if (bits != 0)
+                        return (word << 6) + __builtin_ctzll(bits);
+                word = (word + 1 < GA_BITMAP_WORDS) ? word + 1 : 0;
+                bits = nodes[word] & ~excluded[word];
+        }
+        return MAX_NODES;
+}
+
+/**
+ * Gathers the dsts allocated so far in the timeslot of 'slot', from all
+ *    partitions, into the bitmap 'allocated'
+ */
+static inline __attribute__((always_inline))
+void get_allocated_dsts(struct pim_state *state, uint16_t slot, uint64_t *allocated) {
+        uint16_t node;
+
+        memset(allocated, 0, GA_BITMAP_WORDS * sizeof(uint64_t));
+        for (node = 0; node < MAX_NODES; node += PIM_BITMASKS_PER_8_BIT) {
+                struct pim_core_slot_state *core =
+                        &state->cores[partition_of(&state->geometry, node)].slots[slot];
+                uint64_t bits = core->dst_endnodes[PIM_BITMASK_WORD(
+                                partition_idx(&state->geometry, node))];
+                allocated[node >> 6] |= bits << (node & 63);
+        }
+}
+
 /**
  * Flushes the bin for a specific partition to state and allocates a new bin
  */
@@ -79,12 +137,28 @@ void _flush_backlog_now(struct pim_state *state, uint16_t partition_index) {
         init_bin(state->new_demands[partition_index]);
 }
 
+/**
+ * Enqueue an edge, or a PIM_RESET_DST, to new demands for the src partition.
+ *    Flushes the bin once full
+ */
+static inline __attribute__((always_inline))
+void enqueue_new_demand(struct pim_state *state, uint16_t src, uint16_t dst) {
+        /* leave the 'metric' unused */
+        uint16_t partition_index = partition_of(&state->geometry, src);
+        enqueue_bin(state->new_demands[partition_index], src, dst, 0, 0);
+
+        if (bin_size(state->new_demands[partition_index]) == SMALL_BIN_SIZE) {
+                adm_log_backlog_flush_bin_full(&state->stat);
+                _flush_backlog_now(state, partition_index);
+        }
+}
+
 /**
  * Flush the backlog to state, for all partitions
  */
 void pim_flush_backlog(struct pim_state *state) {
         uint16_t partition;
-        for (partition = 0; partition < N_PARTITIONS; partition++) {
+        for (partition = 0; partition < state->geometry.n_partitions; partition++) {
                 if (is_empty_bin(state->new_demands[partition]))
                     continue;
                 _flush_backlog_now(state, partition);
@@ -95,28 +169,82 @@ void pim_flush_backlog(struct pim_state *state) {
 /**
  * Increase the backlog from src to dst
  */
-void pim_add_backlog(struct pim_state *state, uint16_t src, uint16_t dst,
-                     uint32_t amount) {
-        if (backlog_increase(&state->backlog, src, dst, amount,
-                             &state->stat) == false)
-                return; /* no need to enqueue */
-
-        /* add to state->new_demands for the src partition
-         * leave the 'metric' unused */
-        uint16_t partition_index = PARTITION_OF(src);
-        enqueue_bin(state->new_demands[partition_index], src, dst, 0);
-
-        if (bin_size(state->new_demands[partition_index]) == SMALL_BIN_SIZE) {
-                adm_log_backlog_flush_bin_full(&state->stat);
-                _flush_backlog_now(state, partition_index);
-        }
+int pim_add_backlog(struct pim_state *state, uint16_t src, uint16_t dst,
+                    uint32_t amount) {
+        /* pim keeps all of the demand in the table, admission cores take
+         * from it as they allocate */
+        enum backlog_increase_result res =
+                backlog_increase_shared(&state->backlog, src, dst, amount,
+                                        &state->stat);
+        if (unlikely(res == BACKLOG_TABLE_FULL))
+                return -1;
+        if (res == BACKLOG_INCREASED)
+                return 0; /* the pair was already requested */
+
+        /* add to state->new_demands for the src partition */
+        enqueue_new_demand(state, src, dst);
+        state->requested_dsts[src][dst >> 6] |= (1ULL << (dst & 63));
+        return 0;
 }
 
 /**
  * Reset state of all flows for which src is the sender
  */
 void pim_reset_sender(struct pim_state *state, uint16_t src) {
-	/* TODO: implement this */
+        uint64_t *requested = &state->requested_dsts[src][0];
+        uint16_t word;
+
+        /* clear the backlog of every dst requested since the last reset.
+         * demand added from now on starts from zero */
+        for (word = 0; word < GA_BITMAP_WORDS; word++) {
+                uint64_t bits = requested[word];
+                while (bits != 0) {
+                        uint16_t dst = (word << 6) + __builtin_ctzll(bits);
+                        bits &= bits - 1;
+                        backlog_clear_shared(&state->backlog, src, dst);
+                }
+                requested[word] = 0;
+        }
+
+        /* the core owning the src's requests drops those left without backlog,
+         * after it takes in the demands enqueued so far */
+        enqueue_new_demand(state, src, PIM_RESET_DST);
+}
+
+/**
+ * Drop the requests of src that have no backlog left, after its sender was
+ *    reset. Requests re-added since keep their new backlog
+ */
+static inline __attribute__((always_inline))
+void reset_requests(struct pim_state *state, uint16_t partition_index, uint16_t src) {
+        struct ga_bitmap_adj *request_bits = &state->request_bits_by_src[partition_index];
+        uint16_t src_index = partition_idx(&state->geometry, src);
+        uint16_t dst;
+
+#ifndef PIM_BITMAP_ADJ
+        /* go backwards, deletes move the last neighbor into the hole */
+        struct ga_adj *requests = &state->requests_by_src[partition_index];
+        int32_t i;
+        for (i = requests->degree[src_index] - 1; i >= 0; i--) {
+                dst = requests->neigh[src_index][i];
+                if (backlog_get(&state->backlog, src, dst) != 0)
+                        continue;
+                ga_adj_delete_neigh(requests, src_index, i);
+                ga_bitmap_adj_delete(request_bits, src_index, dst);
+        }
+#else
+        uint16_t word;
+        for (word = 0; word < GA_BITMAP_WORDS; word++) {
+                uint64_t bits = request_bits->neigh[src_index][word];
+                while (bits != 0) {
+                        dst = (word << 6) + __builtin_ctzll(bits);
+                        bits &= bits - 1;
+                        if (backlog_get(&state->backlog, src, dst) == 0)
+                                ga_bitmap_adj_delete(request_bits, src_index, dst);
+                }
+        }
+#endif
+        adm_log_pim_sender_reset(&state->cores[partition_index].stat);
 }
 
 /**
@@ -125,12 +253,23 @@ void pim_reset_sender(struct pim_state *state, uint16_t src) {
 static inline __attribute__((always_inline))
 void process_incoming_bin(struct pim_state *state, uint16_t partition_index,
                           struct bin *bin) {
+        struct ga_bitmap_adj *request_bits = &state->request_bits_by_src[partition_index];
         uint32_t i;
         for (i = 0; i < bin_size(bin); i++) {
                 /* add the edge to requests for this partition */
                 struct backlog_edge *edge = bin_get(bin, i);
+                uint16_t src_index = partition_idx(&state->geometry, edge->src);
+                if (edge->dst == PIM_RESET_DST) {
+                        reset_requests(state, partition_index, edge->src);
+                        continue;
+                }
+                if (ga_bitmap_adj_has(request_bits, src_index, edge->dst))
+                        continue; /* re-requested before an earlier bin came in */
+#ifndef PIM_BITMAP_ADJ
                 ga_adj_add_edge_by_src(&state->requests_by_src[partition_index],
-                                       PARTITION_IDX(edge->src), edge->dst);
+                                       src_index, edge->dst);
+#endif
+                ga_bitmap_adj_add(request_bits, src_index, edge->dst);
         }
 }
 
@@ -159,198 +298,381 @@ void process_new_requests(struct pim_state *state, uint16_t partition_index) {
 }
 
 /**
- * Prepare data structures so they are ready to allocate the next timeslot
+ * Delete the edge from src to dst from requests, if it is still there
  */
-void pim_prepare(struct pim_state *state, uint16_t partition_index) {
+static inline __attribute__((always_inline))
+void delete_request(struct pim_state *state, struct pim_core_slot_state *core,
+                    uint16_t src, uint16_t dst) {
+        uint16_t src_partition = partition_of(&state->geometry, src);
+        uint16_t src_index = partition_idx(&state->geometry, src);
+        struct ga_bitmap_adj *request_bits = &state->request_bits_by_src[src_partition];
+
+        /* with several timeslots in the pipeline, an earlier one may have
+         * deleted it already */
+        if (!ga_bitmap_adj_has(request_bits, src_index, dst))
+                return;
+
+#ifndef PIM_BITMAP_ADJ
+        struct ga_adj *requests = &state->requests_by_src[src_partition];
+        uint16_t grant_adj_index = core->grant_adj_index[src_index];
+        if (state->policy == PIM_POLICY_ISLIP
+            || grant_adj_index >= requests->degree[src_index]
+            || requests->neigh[src_index][grant_adj_index] != dst) {
+                /* iSLIP grants from the bitmap, and resets and deletes in
+                 * other timeslots move edges around, find the edge's index */
+                grant_adj_index = 0;
+                while (requests->neigh[src_index][grant_adj_index] != dst)
+                        grant_adj_index++;
+        }
+        ga_adj_delete_neigh(requests, src_index, grant_adj_index);
+#endif
+        ga_bitmap_adj_delete(request_bits, src_index, dst);
+}
+
+/**
+ * Prepare the timeslot in 'slot' (see pim_prepare)
+ */
+static inline __attribute__((always_inline))
+void prepare_slot(struct pim_state *state, uint16_t partition_index, uint16_t slot) {
         struct pim_core_state *core = &state->cores[partition_index];
+        struct pim_core_slot_state *core_slot = &core->slots[slot];
         struct admission_core_statistics *core_stat = &core->stat;
 
         /* add new backlogs to requests */
         process_new_requests(state, partition_index);
 
         /* reset src and dst endnodes */
-        memset(&core->src_endnodes, 0, PIM_BITMASK_WORD(PARTITION_N_NODES));
-        memset(&core->dst_endnodes, 0, PIM_BITMASK_WORD(PARTITION_N_NODES));
+        uint16_t n_nodes = partition_n_nodes(&state->geometry);
+        memset(&core_slot->src_endnodes, 0, PIM_BITMASK_WORD(n_nodes));
+        memset(&core_slot->dst_endnodes, 0, PIM_BITMASK_WORD(n_nodes));
 
         /* get memory for admitted traffic, init it */
-        while (fp_mempool_get(state->admitted_traffic_mempool, (void**) &core->admitted) != 0)
+        while (fp_mempool_get(state->admitted_traffic_mempool,
+                              (void**) &core_slot->admitted) != 0)
 		adm_log_admitted_traffic_alloc_failed(core_stat);
-        init_admitted_traffic(core->admitted);
-        set_admitted_partition(core->admitted, partition_index);
+        init_admitted_traffic(core_slot->admitted);
+        set_admitted_partition(core_slot->admitted, partition_index);
 }
 
 /**
- * For all source (left-hand) nodes in partition 'partition_index',
- *    selects edges to grant. These are added to 'grants'. For the
- *    first iteration only.
+ * Prepare data structures so they are ready to allocate the next timeslot
  */
-void pim_do_grant_first_it(struct pim_state *state, uint16_t partition_index) {
-        uint16_t count, src_partition, dst_adj_index, dst;
+void pim_prepare(struct pim_state *state, uint16_t partition_index) {
+        prepare_slot(state, partition_index, 0);
+}
+
+/**
+ * The first grant iteration of the timeslot in 'slot' (see pim_do_grant_first_it)
+ */
+static inline __attribute__((always_inline))
+void grant_first_it_slot(struct pim_state *state, uint16_t partition_index,
+                         uint16_t slot) {
+        uint16_t dst_adj_index, dst;
         struct pim_core_state *core = &state->cores[partition_index];
-        struct admission_core_statistics *core_stat = &core->stat;
+        struct pim_core_slot_state *core_slot = &core->slots[slot];
+        struct ga_partd_edgelist *grants = &state->slots[slot].grants;
+        const struct partition_geometry *geometry = &state->geometry;
 
         /* reset grant edgelist */
-        ga_partd_edgelist_src_reset(&state->grants, partition_index);
+        ga_partd_edgelist_src_reset(grants, geometry->n_partitions, partition_index);
+        core_slot->first_iteration = true;
 
-        /* for each src in the partition, randomly choose a dst to grant to */
+        struct ga_bitmap_adj *request_bits = &state->request_bits_by_src[partition_index];
+        uint64_t no_nodes[GA_BITMAP_WORDS];
+        memset(no_nodes, 0, sizeof(no_nodes));
+
+        /* for each src in the partition, choose a dst to grant to */
         uint16_t src;
-        for (src = first_in_partition(partition_index);
-             src <= last_in_partition(partition_index);
+        for (src = first_in_partition(geometry, partition_index);
+             src <= last_in_partition(geometry, partition_index);
              src++) {
-                uint16_t src_index = PARTITION_IDX(src);
-                uint16_t degree = state->requests_by_src[partition_index].degree[src_index];
+                uint16_t src_index = partition_idx(geometry, src);
+                uint16_t degree = request_bits->degree[src_index];
                 if (degree == 0)
                         continue; /* no requests for this src */
 
-                /* pick a random destination to grant to */
+                /* pick a destination to grant to. all are un-allocated */
+                if (state->policy == PIM_POLICY_ISLIP) {
+                        dst = round_robin_node(request_bits->neigh[src_index], no_nodes,
+                                               core->grant_ptr[src_index]);
+                        ga_partd_edgelist_add(grants, geometry, src, dst);
+                        continue;
+                }
+#ifdef PIM_BITMAP_ADJ
+                dst = ga_bitmap_select(request_bits->neigh[src_index], no_nodes,
+                                       ga_rand(&core->rand_state, degree));
+                ga_partd_edgelist_add(grants, geometry, src, dst);
+#else
                 dst_adj_index = ga_rand(&core->rand_state, degree);
                 dst = state->requests_by_src[partition_index].neigh[src_index][dst_adj_index];
 
                 /* add the granted edge */
-                ga_partd_edgelist_add(&state->grants, src, dst);
+                ga_partd_edgelist_add(grants, geometry, src, dst);
 
                 /* record the index of the destination we granted to */
-                core->grant_adj_index[PARTITION_IDX(src)] = dst_adj_index;
+                core_slot->grant_adj_index[src_index] = dst_adj_index;
+#endif
         }
 }
 
 /**
  * For all source (left-hand) nodes in partition 'partition_index',
- *    selects edges to grant. These are added to 'grants'.
+ *    selects edges to grant. These are added to 'grants'. For the
+ *    first iteration only.
  */
-void pim_do_grant(struct pim_state *state, uint16_t partition_index) {
-        uint16_t count, src_partition;
+void pim_do_grant_first_it(struct pim_state *state, uint16_t partition_index) {
+        grant_first_it_slot(state, partition_index, 0);
+}
+
+/**
+ * A later grant iteration of the timeslot in 'slot' (see pim_do_grant)
+ */
+static inline __attribute__((always_inline))
+void grant_slot(struct pim_state *state, uint16_t partition_index, uint16_t slot) {
         struct pim_core_state *core = &state->cores[partition_index];
-        struct admission_core_statistics *core_stat = &core->stat;
+        struct pim_core_slot_state *core_slot = &core->slots[slot];
+        struct ga_partd_edgelist *grants = &state->slots[slot].grants;
+        const struct partition_geometry *geometry = &state->geometry;
 
         /* reset grant edgelist */
-        ga_partd_edgelist_src_reset(&state->grants, partition_index);
+        ga_partd_edgelist_src_reset(grants, geometry->n_partitions, partition_index);
+        core_slot->first_iteration = false;
 
-        /* for each src in the partition, randomly choose a dst to grant to */
+        struct ga_bitmap_adj *request_bits = &state->request_bits_by_src[partition_index];
+        uint64_t allocated_dsts[GA_BITMAP_WORDS];
+#ifndef PIM_BITMAP_ADJ
+        if (state->policy == PIM_POLICY_ISLIP)
+#endif
+                get_allocated_dsts(state, slot, allocated_dsts);
+
+        /* for each src in the partition, choose a dst to grant to */
         uint16_t src;
-        for (src = first_in_partition(partition_index);
-             src <= last_in_partition(partition_index);
+        for (src = first_in_partition(geometry, partition_index);
+             src <= last_in_partition(geometry, partition_index);
              src++) {
-                if (src_is_allocated(core, src))
+                uint16_t src_index = partition_idx(geometry, src);
+                if (src_is_allocated(core_slot, src_index))
                         continue; /* this src has been allocated in this timeslot */
 
-                uint16_t src_index = PARTITION_IDX(src);
-                uint16_t degree = state->requests_by_src[partition_index].degree[src_index];
+                uint16_t degree = request_bits->degree[src_index];
                 if (degree == 0)
                         continue; /* no requests for this src */
 
+                uint16_t dst_adj_index, dst;
+                if (state->policy == PIM_POLICY_ISLIP) {
+                        /* the next un-allocated destination after the pointer */
+                        dst = round_robin_node(request_bits->neigh[src_index], allocated_dsts,
+                                               core->grant_ptr[src_index]);
+                        if (dst == MAX_NODES)
+                                continue; /* all dsts are allocated */
+                        ga_partd_edgelist_add(grants, geometry, src, dst);
+                        continue;
+                }
+
+#ifdef PIM_BITMAP_ADJ
+                /* a random one of the un-allocated destinations */
+                uint32_t n_free = ga_bitmap_count(request_bits->neigh[src_index],
+                                                  allocated_dsts);
+                if (n_free == 0)
+                        continue; /* all dsts are allocated */
+                dst = ga_bitmap_select(request_bits->neigh[src_index], allocated_dsts,
+                                       ga_rand(&core->rand_state, n_free));
+                ga_partd_edgelist_add(grants, geometry, src, dst);
+#else
                 /* find an un-allocated destination to grant to */
                 uint8_t tries = MAX_TRIES;
-                uint16_t dst_adj_index, dst;
                 bool dst_is_alloc;
                 do {
                         dst_adj_index = ga_rand(&core->rand_state, degree);
                         dst = state->requests_by_src[partition_index].neigh[src_index][dst_adj_index];
-                        dst_is_alloc = dst_is_allocated(state, dst);
+                        dst_is_alloc = dst_is_allocated(state, slot, dst);
                 } while (dst_is_alloc && (--tries > 0));
 
                 if (dst_is_alloc)
                         continue; /* couldn't find a free dst*/
 
                 /* add the granted edge */
-                ga_partd_edgelist_add(&state->grants, src, dst);
+                ga_partd_edgelist_add(grants, geometry, src, dst);
 
                 /* record the index of the destination we granted to */
-                core->grant_adj_index[PARTITION_IDX(src)] = dst_adj_index;
+                core_slot->grant_adj_index[src_index] = dst_adj_index;
+#endif
         }
 }
 
 /**
- * For every destination (right-hand) node in partition 'partition_index',
- *    select among its granted edges which edge to accept. These edges are
- *    added to 'accepts'
+ * For all source (left-hand) nodes in partition 'partition_index',
+ *    selects edges to grant. These are added to 'grants'.
  */
-void pim_do_accept(struct pim_state *state, uint16_t partition_index) {
-        uint16_t count, src_partition;
-        struct ga_edgelist *edgelist;
-	struct pim_core_state *core = &state->cores[partition_index];
-        struct admission_core_statistics *core_stat = &core->stat;
+void pim_do_grant(struct pim_state *state, uint16_t partition_index) {
+        grant_slot(state, partition_index, 0);
+}
+
+/**
+ * Announce the grants of this partition in 'slot' and start sorting grants by
+ *    destination, with those of this partition
+ */
+static inline __attribute__((always_inline))
+void begin_accept(struct pim_state *state, uint16_t partition_index, uint16_t slot) {
+        struct pim_core_state *core = &state->cores[partition_index];
+        struct pim_slot_state *slot_state = &state->slots[slot];
+        struct ga_adj *dest_adj = &slot_state->grants_by_dst[partition_index];
 
 #ifndef PIM_SINGLE_ADMISSION_CORE
         /* indicate that this partition finished its phase */
-        phase_finished(&state->phase, partition_index, core_stat);
+        phase_finished(&slot_state->phase, partition_index, &core->stat);
 #endif
 
         /* reset grant adjacency list */
-        ga_reset_adj(&state->grants_by_dst[partition_index]);
-
-        /* sort grants from all src partitions by destination node */
-        struct ga_adj *dest_adj = &state->grants_by_dst[partition_index];
+        ga_reset_adj(dest_adj);
 
 #ifndef PIM_SINGLE_ADMISSION_CORE
         /* sort grants from this partition first */
-        edgelist = &state->grants.dst[partition_index].src[partition_index];
-        ga_edges_to_adj_by_dst(&edgelist->edge[0], edgelist->n, dest_adj);
-
-        /* sort grants from other partitions, as they are ready */
-        count = 0;
-        while (count < N_PARTITIONS - 1) {
-                src_partition = phase_get_finished_partition(&state->phase, partition_index,
-                                                             core_stat);
-                if (src_partition != NONE_READY) {
-                        count++;
-                        edgelist = &state->grants.dst[partition_index].src[src_partition];
-                        ga_edges_to_adj_by_dst(&edgelist->edge[0], edgelist->n, dest_adj);
-                } else
-                        process_new_requests(state, partition_index);
-        }
+        struct ga_edgelist *edgelist =
+                ga_partd_edgelist_get(&slot_state->grants, partition_index,
+                                      partition_index);
+        ga_edges_to_adj_by_dst(&edgelist->edge[0], edgelist->n, &state->geometry,
+                               dest_adj);
+        core->slots[slot].n_waiting = state->geometry.n_partitions - 1;
 #else
-        for (src_partition = 0; src_partition < N_PARTITIONS; src_partition++) {
-                edgelist = &state->grants.dst[partition_index].src[src_partition];
-                ga_edges_to_adj_by_dst(&edgelist->edge[0], edgelist->n, dest_adj);
-        }
+        ga_edgelist_to_adj_by_dst(&slot_state->grants, &state->geometry,
+                                  partition_index, dest_adj);
+        core->slots[slot].n_waiting = 0;
 #endif
+}
+
+/**
+ * Sort grants from other partitions that are ready, returns true once grants
+ *    from all partitions are sorted
+ */
+static inline __attribute__((always_inline))
+bool poll_grants(struct pim_state *state, uint16_t partition_index, uint16_t slot) {
+        struct pim_core_state *core = &state->cores[partition_index];
+        struct pim_core_slot_state *core_slot = &core->slots[slot];
+        struct pim_slot_state *slot_state = &state->slots[slot];
+        struct ga_edgelist *edgelist;
+        uint16_t src_partition;
+
+        while (core_slot->n_waiting > 0) {
+                src_partition = phase_get_finished_partition(&slot_state->phase,
+                                                             partition_index, &core->stat);
+                if (src_partition == NONE_READY)
+                        return false;
+                core_slot->n_waiting--;
+                edgelist = ga_partd_edgelist_get(&slot_state->grants, partition_index,
+                                                 src_partition);
+                ga_edges_to_adj_by_dst(&edgelist->edge[0], edgelist->n, &state->geometry,
+                                       &slot_state->grants_by_dst[partition_index]);
+        }
+        return true;
+}
+
+/**
+ * For each dst in the partition, choose among the sorted grants in 'slot'
+ *    a src to accept
+ */
+static inline __attribute__((always_inline))
+void select_accepts(struct pim_state *state, uint16_t partition_index, uint16_t slot) {
+        struct pim_core_state *core = &state->cores[partition_index];
+        struct pim_core_slot_state *core_slot = &core->slots[slot];
+        struct ga_adj *dest_adj = &state->slots[slot].grants_by_dst[partition_index];
+        struct ga_partd_edgelist *accepts = &state->slots[slot].accepts;
+        const struct partition_geometry *geometry = &state->geometry;
 
-        /* for each dst in the partition, randomly choose a src to accept */
         uint16_t dst;
-        for (dst = first_in_partition(partition_index);
-             dst <= last_in_partition(partition_index);
+        for (dst = first_in_partition(geometry, partition_index);
+             dst <= last_in_partition(geometry, partition_index);
              dst++) {
-                uint16_t dst_index = PARTITION_IDX(dst);
-                uint16_t degree = state->grants_by_dst[partition_index].degree[dst_index];
+                uint16_t dst_index = partition_idx(geometry, dst);
+                uint16_t degree = dest_adj->degree[dst_index];
                 if (degree == 0)
                         continue; /* no grants for this dst */
 
-                /* choose an edge and accept it */
-                uint16_t src_adj_index = ga_rand(&core->rand_state, degree);
-                uint16_t src = state->grants_by_dst[partition_index].neigh[dst_index][src_adj_index];
-                ga_partd_edgelist_add(&state->accepts, src, dst);
+                /* choose an edge and take its timeslot off the backlog. with
+                 * several timeslots in the pipeline, an earlier one may have
+                 * admitted the last of the backlog after this one granted
+                 * it, so drop such grants before the dst is marked allocated,
+                 * and choose among the rest */
+                uint16_t src_adj_index, src;
+                uint32_t backlog;
+                while (true) {
+                        if (state->policy == PIM_POLICY_ISLIP)
+                                src_adj_index = round_robin_index(dest_adj->neigh[dst_index],
+                                                                  degree, core->accept_ptr[dst_index]);
+                        else
+                                src_adj_index = ga_rand(&core->rand_state, degree);
+                        src = dest_adj->neigh[dst_index][src_adj_index];
+                        if (backlog_try_decrease(&state->backlog, src, dst, &backlog))
+                                break;
+                        adm_log_pim_stale_accept(&core->stat);
+                        ga_adj_delete_neigh(dest_adj, dst_index, src_adj_index);
+                        if (--degree == 0)
+                                break;
+                }
+                if (degree == 0)
+                        continue; /* all grants for this dst were stale */
+                ga_partd_edgelist_add(accepts, geometry, src, dst);
+
+                /* iSLIP moves the pointer past the src accepted in the first
+                 * iteration, so that src goes last next time */
+                if (state->policy == PIM_POLICY_ISLIP && core_slot->first_iteration)
+                        core->accept_ptr[dst_index] = (src + 1) & (MAX_NODES - 1);
 
                 /* mark the dst as allocated for this timeslot */
-                mark_dst_allocated(core, dst);
+                mark_dst_allocated(core_slot, dst_index);
         }
 }
 
+/**
+ * For every destination (right-hand) node in partition 'partition_index',
+ *    select among its granted edges which edge to accept. These edges are
+ *    added to 'accepts'
+ */
+void pim_do_accept(struct pim_state *state, uint16_t partition_index) {
+        begin_accept(state, partition_index, 0);
+
+        /* sort grants from other partitions, as they are ready */
+        while (!poll_grants(state, partition_index, 0))
+                process_new_requests(state, partition_index);
+
+        select_accepts(state, partition_index, 0);
+}
+
 /* Process accepts involving one source and one destination partition */
 static inline __attribute__((always_inline))
-void process_accepts_from_partition(struct pim_state *state, uint16_t src_partition,
-                                    uint16_t dst_partition) {
+void process_accepts_from_partition(struct pim_state *state, uint16_t slot,
+                                    uint16_t src_partition, uint16_t dst_partition) {
 	struct pim_core_state *core = &state->cores[src_partition];
+        struct pim_core_slot_state *core_slot = &core->slots[slot];
         struct admission_core_statistics *core_stat = &core->stat;
         struct ga_edgelist *edgelist;
         uint16_t i;
         uint32_t backlog;
 
-        struct admitted_traffic *admitted = core->admitted;
-        edgelist = &state->accepts.dst[dst_partition].src[src_partition];
+        struct admitted_traffic *admitted = core_slot->admitted;
+        edgelist = ga_partd_edgelist_get(&state->slots[slot].accepts, dst_partition,
+                                         src_partition);
 
         for (i = 0; i < edgelist->n; i++) {
                 struct ga_edge *edge = &edgelist->edge[i];
+                uint16_t src_index = partition_idx(&state->geometry, edge->src);
+
+                /* the dst's core took the timeslot off the backlog when it
+                 * accepted the edge */
+                backlog = backlog_get(&state->backlog, edge->src, edge->dst);
 
                 /* add edge to admitted traffic */
                 insert_admitted_edge(admitted, edge->src, edge->dst);
 
                 /* mark the src as allocated for this timeslot */
-                mark_src_allocated(core, edge->src);
+                mark_src_allocated(core_slot, src_index);
+
+                /* likewise the src's pointer moves past a dst that accepted its
+                 * first grant */
+                if (state->policy == PIM_POLICY_ISLIP && core_slot->first_iteration)
+                        core->grant_ptr[src_index] =
+                                (edge->dst + 1) & (MAX_NODES - 1);
 
-                /* decrease the backlog */
-                assert(backlog_get(&state->backlog, edge->src, edge->dst) != 0);
-                backlog = backlog_decrease(&state->backlog, edge->src, edge->dst);
                 if (backlog != 0) {
                         /* there is remaining backlog */
                         adm_log_allocated_backlog_remaining(core_stat, edge->src,
@@ -360,60 +682,195 @@ void process_accepts_from_partition(struct pim_state *state, uint16_t src_partit
 
                  /* no more backlog, delete the edge from requests */
                  adm_log_allocator_no_backlog(core_stat, edge->src, edge->dst);
-                 uint16_t grant_adj_index = core->grant_adj_index[PARTITION_IDX(edge->src)];
-                 ga_adj_delete_neigh(&state->requests_by_src[PARTITION_OF(edge->src)],
-                                     PARTITION_IDX(edge->src), grant_adj_index);
+                 delete_request(state, core_slot, edge->src, edge->dst);
         }
 }
 
 /**
- * Process all of the accepts, after each iteration
+ * Announce the accepts of this partition in 'slot' and process the accepts
+ *    of this partition's srcs made by this partition
  */
-void pim_process_accepts(struct pim_state *state, uint16_t partition_index) {
+static inline __attribute__((always_inline))
+void begin_process_accepts(struct pim_state *state, uint16_t partition_index,
+                           uint16_t slot) {
 	struct pim_core_state *core = &state->cores[partition_index];
-        struct admission_core_statistics *core_stat = &core->stat;
-        uint16_t dst_partition, count;
 
 #ifndef PIM_SINGLE_ADMISSION_CORE
         /* indicate that this partition finished its phase */
-        phase_finished(&state->phase, partition_index, core_stat);
-#endif
+        phase_finished(&state->slots[slot].phase, partition_index, &core->stat);
 
-        /* iterate through all accepted edges */
-#ifndef PIM_SINGLE_ADMISSION_CORE
         /* process accepts from this partition first */
-        process_accepts_from_partition(state, partition_index, partition_index);
-        
-        /* process accepts from other partitions, as they are ready */
-        count = 0;
-        while (count < N_PARTITIONS - 1) {
-                dst_partition = phase_get_finished_partition(&state->phase, partition_index,
-                                                             core_stat);
-                if (dst_partition != NONE_READY) {
-                        count++;
-                        process_accepts_from_partition(state, partition_index,
-                                                       dst_partition);
-                } else
-                        process_new_requests(state, partition_index);
-        }
+        process_accepts_from_partition(state, slot, partition_index, partition_index);
+        core->slots[slot].n_waiting = state->geometry.n_partitions - 1;
 #else
-        for (dst_partition = 0; dst_partition < N_PARTITIONS; dst_partition++) {
-                process_accepts_from_partition(state, partition_index, dst_partition);
-        }
+        uint16_t dst_partition;
+        for (dst_partition = 0; dst_partition < state->geometry.n_partitions; dst_partition++)
+                process_accepts_from_partition(state, slot, partition_index, dst_partition);
+        core->slots[slot].n_waiting = 0;
 #endif
+}
+
+/**
+ * Process accepts from other partitions that are ready, returns true once
+ *    accepts from all partitions are processed
+ */
+static inline __attribute__((always_inline))
+bool poll_accepts(struct pim_state *state, uint16_t partition_index, uint16_t slot) {
+	struct pim_core_state *core = &state->cores[partition_index];
+        struct pim_core_slot_state *core_slot = &core->slots[slot];
+        uint16_t dst_partition;
+
+        while (core_slot->n_waiting > 0) {
+                dst_partition = phase_get_finished_partition(&state->slots[slot].phase,
+                                                             partition_index, &core->stat);
+                if (dst_partition == NONE_READY)
+                        return false;
+                core_slot->n_waiting--;
+                process_accepts_from_partition(state, slot, partition_index,
+                                               dst_partition);
+        }
 
         /* reset accepts */
-        ga_partd_edgelist_src_reset(&state->accepts, partition_index);
+        ga_partd_edgelist_src_reset(&state->slots[slot].accepts,
+                                    state->geometry.n_partitions, partition_index);
+        return true;
 }
 
 /**
- * Clean-up after a timeslot is done being allocated
+ * Process all of the accepts, after each iteration
  */
-void pim_complete_timeslot(struct pim_state *state, uint16_t partition_index) {
+void pim_process_accepts(struct pim_state *state, uint16_t partition_index) {
+        begin_process_accepts(state, partition_index, 0);
+
+        /* process accepts from other partitions, as they are ready */
+        while (!poll_accepts(state, partition_index, 0))
+                process_new_requests(state, partition_index);
+}
+
+/**
+ * Send out the admitted traffic of the timeslot in 'slot'
+ */
+static inline __attribute__((always_inline))
+void complete_slot(struct pim_state *state, uint16_t partition_index, uint16_t slot) {
 	struct pim_core_state *core = &state->cores[partition_index];
         struct admission_core_statistics *core_stat = &core->stat;
 
         /* send out the admitted traffic */
-        while (fp_ring_enqueue(state->q_admitted_out, core->admitted) != 0)
+        while (fp_ring_enqueue(state->q_admitted_out, core->slots[slot].admitted) != 0)
                 adm_log_wait_for_space_in_q_admitted_traffic(core_stat);
 }
+
+/**
+ * Clean-up after a timeslot is done being allocated
+ */
+void pim_complete_timeslot(struct pim_state *state, uint16_t partition_index) {
+        complete_slot(state, partition_index, 0);
+}
+
+#ifndef PIM_SINGLE_ADMISSION_CORE
+/**
+ * Moves the timeslot in 'slot' as far as it can go without waiting for other
+ *    partitions, returns true if it moved at all
+ */
+static inline __attribute__((always_inline))
+bool step_slot(struct pim_state *state, uint16_t partition_index, uint16_t slot,
+               uint64_t *next_to_complete) {
+        struct pim_core_state *core = &state->cores[partition_index];
+        struct pim_core_slot_state *core_slot = &core->slots[slot];
+
+        switch (core_slot->step) {
+        case PIM_STEP_PREPARE:
+                /* iSLIP pointers must have moved for the timeslot before */
+                if (state->policy == PIM_POLICY_ISLIP &&
+                    core->first_iterations_done != core_slot->timeslot)
+                        return false;
+                prepare_slot(state, partition_index, slot);
+                grant_first_it_slot(state, partition_index, slot);
+                core_slot->iteration = 0;
+                break;
+        case PIM_STEP_GRANT:
+                grant_slot(state, partition_index, slot);
+                break;
+        case PIM_STEP_ACCEPT:
+                if (!poll_grants(state, partition_index, slot))
+                        return false;
+                select_accepts(state, partition_index, slot);
+                begin_process_accepts(state, partition_index, slot);
+                core_slot->step = PIM_STEP_PROCESS;
+                return true;
+        case PIM_STEP_PROCESS:
+                if (!poll_accepts(state, partition_index, slot))
+                        return false;
+                if (core_slot->iteration == 0)
+                        core->first_iterations_done++;
+                core_slot->step = (++core_slot->iteration < state->num_iterations) ?
+                        PIM_STEP_GRANT : PIM_STEP_COMPLETE;
+                return true;
+        case PIM_STEP_COMPLETE:
+                /* admitted traffic goes out in timeslot order */
+                if (core_slot->timeslot != *next_to_complete)
+                        return false;
+                complete_slot(state, partition_index, slot);
+                (*next_to_complete)++;
+                core_slot->timeslot += PIM_PIPELINE_DEPTH;
+                core_slot->step = PIM_STEP_PREPARE;
+                return true;
+        }
+
+        /* granted, on to accepts */
+        begin_accept(state, partition_index, slot);
+        core_slot->step = PIM_STEP_ACCEPT;
+        return true;
+}
+
+/**
+ * Allocates 'n_timeslots' timeslots in the partitions of core 'core_index' of
+ *    'n_cores', with up to PIM_PIPELINE_DEPTH consecutive timeslots in flight
+ *    per partition
+ */
+void pim_run_pipeline(struct pim_state *state, uint16_t core_index,
+                      uint16_t n_cores, uint64_t n_timeslots) {
+        uint16_t n_partitions = state->geometry.n_partitions;
+        uint64_t next_to_complete[MAX_PARTITIONS]; /* per partition */
+        uint16_t partition, slot;
+        uint16_t n_done = 0, n_owned = 0;
+        bool progress;
+
+        /* slot s allocates timeslots s, s + PIM_PIPELINE_DEPTH, ... */
+        for (partition = core_index; partition < n_partitions; partition += n_cores) {
+                struct pim_core_state *core = &state->cores[partition];
+                for (slot = 0; slot < PIM_PIPELINE_DEPTH; slot++) {
+                        core->slots[slot].timeslot = slot;
+                        core->slots[slot].step = PIM_STEP_PREPARE;
+                }
+                core->first_iterations_done = 0;
+                next_to_complete[partition] = 0;
+                n_owned++;
+        }
+
+        while (n_done < n_owned) {
+                progress = false;
+                n_done = 0;
+                for (partition = core_index; partition < n_partitions;
+                     partition += n_cores) {
+                        struct pim_core_state *core = &state->cores[partition];
+                        if (next_to_complete[partition] >= n_timeslots) {
+                                n_done++;
+                                continue; /* this partition is done */
+                        }
+                        for (slot = 0; slot < PIM_PIPELINE_DEPTH; slot++) {
+                                if (core->slots[slot].timeslot >= n_timeslots)
+                                        continue; /* this slot is done */
+                                progress |= step_slot(state, partition, slot,
+                                                      &next_to_complete[partition]);
+                        }
+                }
+
+                if (!progress) {
+                        for (partition = core_index; partition < n_partitions;
+                             partition += n_cores)
+                                process_new_requests(state, partition);
+                }
+        }
+}
+#endif
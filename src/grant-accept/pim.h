@@ -18,45 +18,120 @@
 #include "../graph-algo/fp_ring.h"
 #include "../graph-algo/platform.h"
 
-#define NUM_ITERATIONS 3
+#define PIM_DEFAULT_ITERATIONS 3
 #define SMALL_BIN_SIZE (MAX_NODES / N_PARTITIONS)
 
+/* consecutive timeslots each core keeps in flight in pim_run_pipeline(). 1 by
+ * default, so pipelining is off. building with e.g. -DPIM_PIPELINE_DEPTH=2 lets
+ * a core that waits for other partitions in one timeslot work on the next one
+ * meanwhile. under iSLIP only the later iterations overlap. it is opt-in
+ * until its speedup has been measured on a host with a core per partition */
+#ifndef PIM_PIPELINE_DEPTH
+#define PIM_PIPELINE_DEPTH 1
+#endif
+
+/* in place of a dst in new demands, asks the src's core to drop the src's
+ * requests that have no backlog left (see pim_reset_sender) */
+#define PIM_RESET_DST MAX_NODES
+
+/* the number of q_ready_partitions rings pim_init_state() takes, with the
+ * default geometry and with the most partitions */
+#define PIM_N_READY_QUEUES (N_PARTITIONS * PIM_PIPELINE_DEPTH)
+#define PIM_MAX_READY_QUEUES (MAX_PARTITIONS * PIM_PIPELINE_DEPTH)
+
 /* packing of bitmasks into 8 bit words */
 #define PIM_BITMASKS_PER_8_BIT      8
 #define PIM_BITMASK_WORD(node)      (node >> 3)
 #define PIM_BITMASK_SHIFT(node)     (node & (PIM_BITMASKS_PER_8_BIT - 1))
 
-/* Data structures associated with one allocation core */
-struct pim_core_state {
-        u32 rand_state;
+/* build with -DPIM_BITMAP_ADJ to keep requests only as bitmaps (see struct
+ * ga_bitmap_adj), and pick random grants among the free dsts directly */
+
+/* how srcs choose a dst to grant to, and dsts a grant to accept */
+enum pim_policy {
+        PIM_POLICY_RANDOM,      /* uniformly at random, as in PIM */
+        PIM_POLICY_ISLIP,       /* the first node at or after a per-node
+                                   round-robin pointer, as in iSLIP */
+};
+
+/* where a core is in allocating the timeslot of one pipeline slot */
+enum pim_step {
+        PIM_STEP_PREPARE,
+        PIM_STEP_GRANT,
+        PIM_STEP_ACCEPT,        /* waiting for grants from other partitions */
+        PIM_STEP_PROCESS,       /* waiting for accepts from other partitions */
+        PIM_STEP_COMPLETE,      /* waiting for earlier timeslots to complete */
+};
+
+/* One core's state for the timeslot in one pipeline slot */
+struct pim_core_slot_state {
         struct admitted_traffic *admitted;
+#ifndef PIM_BITMAP_ADJ
         uint16_t grant_adj_index[PARTITION_N_NODES]; /* per src adj index of grant */
+#endif
+        bool first_iteration; /* iSLIP only moves pointers in the first */
         uint8_t src_endnodes[PARTITION_N_NODES / PIM_BITMASKS_PER_8_BIT];
         uint8_t dst_endnodes[PARTITION_N_NODES / PIM_BITMASKS_PER_8_BIT];
+        uint16_t n_waiting; /* partitions yet to finish the phase waited for */
+        enum pim_step step; /* for pim_run_pipeline() */
+        uint8_t iteration;
+        uint64_t timeslot; /* index in the pipeline */
+};
+
+/* Data structures associated with one allocation core */
+struct pim_core_state {
+        u32 rand_state;
+        /* iSLIP pointers are shared by the timeslots in flight, and only move
+         * in the first iteration. pim_run_pipeline() starts a timeslot once
+         * the one before it finished its first iteration, so they move in
+         * timeslot order as without pipelining */
+        uint16_t grant_ptr[PARTITION_N_NODES]; /* per src, for PIM_POLICY_ISLIP */
+        uint16_t accept_ptr[PARTITION_N_NODES]; /* per dst, for PIM_POLICY_ISLIP */
+        uint64_t first_iterations_done; /* timeslots past their first iteration */
+        struct pim_core_slot_state slots[PIM_PIPELINE_DEPTH];
         struct fp_ring *q_new_demands;
         struct admission_core_statistics stat;
 } __attribute__((aligned(64))) /* don't want sharing between cores */;
 
-/* A structure for the state of a grant partition */
-struct pim_state {
-        struct ga_adj requests_by_src[N_PARTITIONS]; /* per src partition */
+/* Grants and accepts for the timeslot in one pipeline slot */
+struct pim_slot_state {
         struct ga_partd_edgelist grants;
-        struct ga_adj grants_by_dst[N_PARTITIONS]; /* per dst partition */
+        struct ga_adj grants_by_dst[MAX_PARTITIONS]; /* per dst partition */
         struct ga_partd_edgelist accepts;
+        struct phase_state phase;
+};
+
+/* A structure for the state of a grant partition. The adjacency structures
+ * and edgelists are sized for the geometry, in 'storage' */
+struct pim_state {
+        struct partition_geometry geometry;
+        void *storage; /* of pim_storage_size() bytes, see pim_init_state */
+#ifndef PIM_BITMAP_ADJ
+        struct ga_adj requests_by_src[MAX_PARTITIONS]; /* per src partition */
+#endif
+        struct ga_bitmap_adj request_bits_by_src[MAX_PARTITIONS]; /* the same
+                                        requests, for iSLIP and PIM_BITMAP_ADJ */
+        struct pim_slot_state slots[PIM_PIPELINE_DEPTH];
         struct backlog backlog;
-        struct bin *new_demands[N_PARTITIONS]; /* per src partition */
+        uint64_t requested_dsts[MAX_NODES][GA_BITMAP_WORDS]; /* per src, dsts
+                        enqueued since its last reset. only for the thread
+                        adding backlog */
+        struct bin *new_demands[MAX_PARTITIONS]; /* per src partition */
         struct fp_ring *q_admitted_out;
         struct fp_mempool *bin_mempool;
         struct fp_mempool *admitted_traffic_mempool;
-        struct pim_core_state cores[N_PARTITIONS];
+        struct pim_core_state cores[MAX_PARTITIONS]; /* per partition */
         struct admission_statistics stat;
-        struct phase_state phase;
+        enum pim_policy policy;
+        uint8_t num_iterations; /* of grant and accept per timeslot */
 };
 
 /**
  * Increase the backlog from src to dst
+ * Returns 0 on success, -1 if the backlog table has no room for the flow. In
+ *    that case nothing was added.
  */
-void pim_add_backlog(struct pim_state *state, uint16_t src, uint16_t dst,
+int pim_add_backlog(struct pim_state *state, uint16_t src, uint16_t dst,
                      uint32_t amount);
 
 /**
@@ -65,7 +140,10 @@ void pim_add_backlog(struct pim_state *state, uint16_t src, uint16_t dst,
 void pim_flush_backlog(struct pim_state *state);
 
 /**
- * Reset state of all flows for which src is the sender
+ * Reset state of all flows for which src is the sender. The backlog is
+ *    cleared right away, atomically with the admission cores taking from it,
+ *    and the src's requests by its partition's core the next time it takes
+ *    in new demands. Call from the thread adding backlog
  */
 void pim_reset_sender(struct pim_state *state, uint16_t src);
 
@@ -104,44 +182,170 @@ void pim_process_accepts(struct pim_state *state, uint16_t partition_index);
  */
 void pim_complete_timeslot(struct pim_state *state, uint16_t partition_index);
 
+#ifndef PIM_SINGLE_ADMISSION_CORE
+/**
+ * Allocates 'n_timeslots' timeslots in the partitions of core 'core_index' of
+ *    'n_cores', those with an index equal to 'core_index' modulo 'n_cores'.
+ *    Each partition has up to PIM_PIPELINE_DEPTH consecutive timeslots in
+ *    flight. Whenever a partition would wait for other partitions in one
+ *    timeslot, the core works on its other timeslots and partitions. Each
+ *    partition's timeslots still complete in order. Each core must run this
+ *    on its own thread, with the same 'n_cores' and 'n_timeslots'.
+ */
+void pim_run_pipeline(struct pim_state *state, uint16_t core_index,
+                      uint16_t n_cores, uint64_t n_timeslots);
+#endif
+
 /**
  * Initialize all demands to zero
  */
 static inline
 void pim_reset_state(struct pim_state *state)
 {
-        uint16_t src_partition;
-        for (src_partition = 0; src_partition < N_PARTITIONS; src_partition++) {
+        uint16_t n_partitions = state->geometry.n_partitions;
+        uint16_t src_partition, slot;
+        for (src_partition = 0; src_partition < n_partitions; src_partition++) {
+#ifndef PIM_BITMAP_ADJ
                 ga_reset_adj(&state->requests_by_src[src_partition]);
-                ga_partd_edgelist_src_reset(&state->accepts, src_partition);
+#endif
+                ga_reset_bitmap_adj(&state->request_bits_by_src[src_partition]);
+                for (slot = 0; slot < PIM_PIPELINE_DEPTH; slot++)
+                        ga_partd_edgelist_src_reset(&state->slots[slot].accepts,
+                                                    n_partitions, src_partition);
         }
-        backlog_init(&state->backlog);
+        backlog_init_shared(&state->backlog);
+        memset(&state->requested_dsts[0][0], 0, sizeof(state->requested_dsts));
 }
 
 /**
- * Initialize pim state
+ * Returns the bytes of storage the adjacency structures and edgelists of a
+ *    pim state with 'geometry' take, with room to align them
  */
 static inline
-void pim_init_state(struct pim_state *state, struct fp_ring **q_new_demands,
-                    struct fp_ring *q_admitted_out,
-                    struct fp_mempool *bin_mempool,
-                    struct fp_mempool *admitted_traffic_mempool,
-                    struct fp_ring **q_ready_partitions)
+size_t pim_storage_size(const struct partition_geometry *geometry)
 {
+        uint16_t n_partitions = geometry->n_partitions;
+        uint16_t n_nodes = partition_n_nodes(geometry);
+        size_t slot_size = n_partitions * ga_adj_storage_size(n_nodes)
+                + 2 * ga_partd_edgelist_storage_size(n_partitions, n_nodes);
+        size_t size = GA_CACHE_LINE
+                + n_partitions * ga_bitmap_adj_storage_size(n_nodes)
+                + PIM_PIPELINE_DEPTH * slot_size;
+#ifndef PIM_BITMAP_ADJ
+        size += n_partitions * ga_adj_storage_size(n_nodes);
+#endif
+        return size;
+}
+
+/**
+ * Initialize pim state, with partitions of 'partition_n_nodes' nodes (see
+ *    partition_n_nodes_is_valid). 'q_new_demands' has a ring per partition,
+ *    and 'q_ready_partitions' PIM_PIPELINE_DEPTH rings per partition
+ *    (PIM_N_READY_QUEUES with PARTITION_N_NODES nodes per partition). The
+ *    rings in 'q_ready_partitions' are only used with PIM_PHASE_RINGS.
+ *    Returns 0 on success, or -1 if the storage for the geometry could not
+ *    be allocated. Free it with pim_free_state()
+ */
+static inline
+int pim_init_state(struct pim_state *state, uint16_t partition_n_nodes,
+                   struct fp_ring **q_new_demands,
+                   struct fp_ring *q_admitted_out,
+                   struct fp_mempool *bin_mempool,
+                   struct fp_mempool *admitted_traffic_mempool,
+                   struct fp_ring **q_ready_partitions)
+{
+        partition_geometry_init(&state->geometry, partition_n_nodes);
+
+        uint16_t n_partitions = state->geometry.n_partitions;
+        uint16_t partition, slot;
+        char *storage;
+
+        state->storage = fp_malloc("pim_storage", pim_storage_size(&state->geometry));
+        if (state->storage == NULL)
+                return -1;
+
+        /* lay out the adjacency structures and edgelists, cache line aligned */
+        storage = (char *) GA_CACHE_ALIGN((uintptr_t) state->storage);
+        for (partition = 0; partition < n_partitions; partition++) {
+#ifndef PIM_BITMAP_ADJ
+                ga_adj_init(&state->requests_by_src[partition], storage,
+                            partition_n_nodes);
+                storage += ga_adj_storage_size(partition_n_nodes);
+#endif
+                ga_bitmap_adj_init(&state->request_bits_by_src[partition], storage,
+                                   partition_n_nodes);
+                storage += ga_bitmap_adj_storage_size(partition_n_nodes);
+        }
+        for (slot = 0; slot < PIM_PIPELINE_DEPTH; slot++) {
+                struct pim_slot_state *slot_state = &state->slots[slot];
+                for (partition = 0; partition < n_partitions; partition++) {
+                        ga_adj_init(&slot_state->grants_by_dst[partition], storage,
+                                    partition_n_nodes);
+                        storage += ga_adj_storage_size(partition_n_nodes);
+                }
+                ga_partd_edgelist_init(&slot_state->grants, storage, n_partitions,
+                                       partition_n_nodes);
+                storage += ga_partd_edgelist_storage_size(n_partitions,
+                                                          partition_n_nodes);
+                ga_partd_edgelist_init(&slot_state->accepts, storage, n_partitions,
+                                       partition_n_nodes);
+                storage += ga_partd_edgelist_storage_size(n_partitions,
+                                                          partition_n_nodes);
+        }
+
         pim_reset_state(state);
 
         state->q_admitted_out = q_admitted_out;
         state->bin_mempool = bin_mempool;
         state->admitted_traffic_mempool = admitted_traffic_mempool;
 
-        uint16_t partition;
-        for (partition = 0; partition < N_PARTITIONS; partition++) {
+        state->policy = PIM_POLICY_RANDOM;
+        state->num_iterations = PIM_DEFAULT_ITERATIONS;
+
+        for (partition = 0; partition < n_partitions; partition++) {
+                struct pim_core_state *core = &state->cores[partition];
                 fp_mempool_get(bin_mempool, (void**) &state->new_demands[partition]);
                 init_bin(state->new_demands[partition]);
-                state->cores[partition].q_new_demands = q_new_demands[partition];
-                ga_srand(&state->cores[partition].rand_state, rand());
+                core->q_new_demands = q_new_demands[partition];
+                ga_srand(&core->rand_state, rand());
+                memset(&core->grant_ptr[0], 0, sizeof(core->grant_ptr));
+                memset(&core->accept_ptr[0], 0, sizeof(core->accept_ptr));
         }
-        phase_state_init(&state->phase, q_ready_partitions);
+
+        /* each pipeline slot synchronizes on its own rings */
+        for (slot = 0; slot < PIM_PIPELINE_DEPTH; slot++)
+                phase_state_init(&state->slots[slot].phase, n_partitions,
+                                 &q_ready_partitions[slot * n_partitions]);
+        return 0;
+}
+
+/**
+ * Frees the storage pim_init_state() allocated
+ */
+static inline
+void pim_free_state(struct pim_state *state)
+{
+        fp_free(state->storage);
+        state->storage = NULL;
+}
+
+/**
+ * Sets how srcs choose grants and dsts choose accepts, from the next timeslot
+ */
+static inline
+void pim_set_policy(struct pim_state *state, enum pim_policy policy)
+{
+        state->policy = policy;
+}
+
+/**
+ * Sets the number of grant and accept iterations per timeslot, at least one
+ */
+static inline
+void pim_set_iterations(struct pim_state *state, uint8_t num_iterations)
+{
+        assert(num_iterations >= 1);
+        state->num_iterations = num_iterations;
 }
 
 #endif /* PIM_H_ */
@@ -16,28 +16,30 @@
  */
 void pim_get_admissible_traffic(struct pim_state *state)
 {
+        uint16_t n_partitions = state->geometry.n_partitions;
+
         /* reset per-timeslot state */
         uint16_t partition;
-        for (partition = 0; partition < N_PARTITIONS; partition++)
+        for (partition = 0; partition < n_partitions; partition++)
                 pim_prepare(state, partition);
 
         /* run multiple iterations of pim and print out accepted edges */
-        for (partition = 0; partition < N_PARTITIONS; partition++)
+        for (partition = 0; partition < n_partitions; partition++)
                 pim_do_grant_first_it(state, partition);
-        for (partition = 0; partition < N_PARTITIONS; partition++)
+        for (partition = 0; partition < n_partitions; partition++)
                 pim_do_accept(state, partition);
-        for (partition = 0; partition < N_PARTITIONS; partition++)
+        for (partition = 0; partition < n_partitions; partition++)
                 pim_process_accepts(state, partition);
         uint8_t i;
-        for (i = 1; i < NUM_ITERATIONS; i++) {
-                for (partition = 0; partition < N_PARTITIONS; partition++)
+        for (i = 1; i < state->num_iterations; i++) {
+                for (partition = 0; partition < n_partitions; partition++)
                         pim_do_grant(state, partition);
-                for (partition = 0; partition < N_PARTITIONS; partition++)
+                for (partition = 0; partition < n_partitions; partition++)
                         pim_do_accept(state, partition);
-                for (partition = 0; partition < N_PARTITIONS; partition++)
+                for (partition = 0; partition < n_partitions; partition++)
                         pim_process_accepts(state, partition);
         }
-        for (partition = 0; partition < N_PARTITIONS; partition++)
+        for (partition = 0; partition < n_partitions; partition++)
                 pim_complete_timeslot(state, partition);
 }
 
@@ -55,7 +57,7 @@ bool pim_is_valid_admitted_traffic(struct pim_state *state)
         printf("PIM finished. Accepted edges:\n");
         uint16_t partition;
         struct admitted_traffic *admitted;
-        for (partition = 0; partition < N_PARTITIONS; partition++) {
+        for (partition = 0; partition < state->geometry.n_partitions; partition++) {
                 fp_ring_dequeue(state->q_admitted_out, (void **) &admitted);
 
                 uint16_t j;
@@ -21,10 +21,12 @@ void pim_get_admissible_traffic(struct pim_state *state);
 bool pim_is_valid_admitted_traffic(struct pim_state *state);
 
 /**
- * Returns an initialized struct pim state, or NULL on error
+ * Returns an initialized struct pim state, with partitions of
+ *    'partition_n_nodes' nodes, or NULL on error (see pim_init_state)
  */
 static inline
-struct pim_state *pim_create_state(struct fp_ring **q_new_demands,
+struct pim_state *pim_create_state(uint16_t partition_n_nodes,
+                                   struct fp_ring **q_new_demands,
                                    struct fp_ring *q_admitted_out,
                                    struct fp_mempool *bin_mempool,
                                    struct fp_mempool *admitted_traffic_mempool,
@@ -34,8 +36,22 @@ struct pim_state *pim_create_state(struct fp_ring **q_new_demands,
         if (state == NULL)
                 return NULL;
 
-        pim_init_state(state, q_new_demands, q_admitted_out, bin_mempool,
-                       admitted_traffic_mempool, q_ready_partitions);
+        if (pim_init_state(state, partition_n_nodes, q_new_demands, q_admitted_out,
+                           bin_mempool, admitted_traffic_mempool,
+                           q_ready_partitions) != 0) {
+                fp_free(state);
+                return NULL;
+        }
 
         return state;
 }
+
+/**
+ * Frees a struct pim_state from pim_create_state
+ */
+static inline
+void pim_destroy_state(struct pim_state *state)
+{
+        pim_free_state(state);
+        fp_free(state);
+}
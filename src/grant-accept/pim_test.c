@@ -28,18 +28,20 @@ int main() {
         struct fp_ring *q_admitted_out;
         struct fp_mempool *bin_mempool;
         struct fp_mempool *admitted_traffic_mempool;
-        struct fp_ring *q_ready_partitions[N_PARTITIONS];
+        struct fp_ring *q_ready_partitions[PIM_N_READY_QUEUES];
 
         uint16_t i;
-        for (i = 0; i < N_PARTITIONS; i++) {
+        for (i = 0; i < N_PARTITIONS; i++)
                 q_new_demands[i] = fp_ring_create(NEW_DEMANDS_Q_SIZE);
+        for (i = 0; i < PIM_N_READY_QUEUES; i++)
                 q_ready_partitions[i] = fp_ring_create(READY_PARTITIONS_Q_SIZE);
-        }
-        bin_mempool = fp_mempool_create(BIN_MEMPOOL_SIZE, bin_num_bytes(SMALL_BIN_SIZE));
+        bin_mempool = fp_mempool_create(BIN_MEMPOOL_SIZE, bin_num_bytes(SMALL_BIN_SIZE),
+                                         0);
         q_admitted_out = fp_ring_create(ADMITTED_OUT_RING_LOG_SIZE);
         admitted_traffic_mempool = fp_mempool_create(ADMITTED_TRAFFIC_MEMPOOL_SIZE,
-                                                     sizeof(struct admitted_traffic));
-        struct pim_state *state = pim_create_state(&q_new_demands[0], q_admitted_out,
+                                                     sizeof(struct admitted_traffic), 0);
+        struct pim_state *state = pim_create_state(PARTITION_N_NODES, &q_new_demands[0],
+                                                   q_admitted_out,
                                                    bin_mempool,
                                                    admitted_traffic_mempool,
                                                    q_ready_partitions);
@@ -62,7 +64,7 @@ int main() {
 
                 /* return admitted to mempool */
                 uint16_t p;
-                for (p = 0; p < N_PARTITIONS; p++) {
+                for (p = 0; p < state->geometry.n_partitions; p++) {
                         struct admitted_traffic *admitted;
                         fp_ring_dequeue(state->q_admitted_out, (void **) &admitted);
                         fp_mempool_put(state->admitted_traffic_mempool, admitted);
@@ -0,0 +1,31 @@
+#!/bin/bash
+
+# this script runs the multicore pim benchmark with 4, 8 and 16 partitions of
+# 256 nodes on a given number of cores (4 by default), with one or two
+# timeslots in flight per partition, and collects timeslots per second and
+# matching size for each into one csv file. needs a cpu per core. build first
+# with make.
+
+OUTPUT_FILE="pipeline_sweep.csv"
+TIMESLOTS=${1:-20000}
+CORES=${2:-4}
+
+HEADER_WRITTEN=0
+for BINARY in benchmark_pim_multicore_d1 benchmark_pim_multicore_d2; do
+    if [ ! -x "./$BINARY" ]; then
+        echo "missing ./$BINARY, run make first"
+        exit 1
+    fi
+
+    for PARTITION_NODES in 64 32 16; do
+        echo "running $BINARY with $PARTITION_NODES nodes per partition"
+        if [ $HEADER_WRITTEN -eq 0 ]; then
+            ./$BINARY $TIMESLOTS $PARTITION_NODES $CORES > $OUTPUT_FILE
+            HEADER_WRITTEN=1
+        else
+            ./$BINARY $TIMESLOTS $PARTITION_NODES $CORES | tail -n +2 >> $OUTPUT_FILE
+        fi
+    done
+done
+
+echo "results in $OUTPUT_FILE"
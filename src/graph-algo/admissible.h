@@ -29,9 +29,24 @@ struct admissible_state;
 #define BIN_RING_SHIFT 16
 
 static inline
-void add_backlog(struct admissible_state *state, uint16_t src,
+int add_backlog(struct admissible_state *state, uint16_t src,
                  uint16_t dst, uint32_t amount) {
-        pim_add_backlog((struct pim_state *) state, src, dst, amount);
+        return pim_add_backlog((struct pim_state *) state, src, dst, amount);
+}
+
+/* pim has no traffic classes */
+static inline
+int add_backlog_tclass(struct admissible_state *state, uint16_t src,
+                       uint16_t dst, uint32_t amount, uint8_t tclass) {
+        return pim_add_backlog((struct pim_state *) state, src, dst, amount);
+}
+
+/* nor deadlines */
+static inline
+int add_backlog_deadline(struct admissible_state *state, uint16_t src,
+                         uint16_t dst, uint32_t amount, uint8_t tclass,
+                         uint32_t deadline) {
+        return pim_add_backlog((struct pim_state *) state, src, dst, amount);
 }
 
 static inline
@@ -56,7 +71,8 @@ create_admissible_state(bool a, uint16_t b, uint16_t c, uint16_t d,
                         struct fp_ring **q_ready_partitions)
 {
 		(void) q_spent; /* unused */
-        struct pim_state *state = pim_create_state(q_new_demands, q_admitted_out,
+        struct pim_state *state = pim_create_state(PARTITION_N_NODES, q_new_demands,
+                                                   q_admitted_out,
                                                    bin_mempool,
                                                    admitted_traffic_mempool,
                                                    q_ready_partitions);
@@ -89,6 +105,12 @@ struct fp_mempool *get_admitted_traffic_mempool(struct admissible_state *state)
         struct pim_state *pim_state = (struct pim_state *) state;
         return pim_state->admitted_traffic_mempool;
 }
+
+/* pim keeps all demand in its backlog table, there are no spent demands */
+static inline
+void handle_spent_demands(struct admissible_state *state)
+{
+}
 #endif
 
 /* pipelined algo */
@@ -102,9 +124,25 @@ struct fp_mempool *get_admitted_traffic_mempool(struct admissible_state *state)
 #define BIN_RING_SHIFT 0
 
 static inline
-void add_backlog(struct admissible_state *status, uint16_t src,
+int add_backlog(struct admissible_state *status, uint16_t src,
                  uint16_t dst, uint32_t amount) {
-        seq_add_backlog((struct seq_admissible_status *) status, src, dst, amount);
+        return seq_add_backlog((struct seq_admissible_status *) status, src,
+                               dst, amount);
+}
+
+static inline
+int add_backlog_tclass(struct admissible_state *status, uint16_t src,
+                       uint16_t dst, uint32_t amount, uint8_t tclass) {
+        return seq_add_backlog_tclass((struct seq_admissible_status *) status,
+                                      src, dst, amount, tclass);
+}
+
+static inline
+int add_backlog_deadline(struct admissible_state *status, uint16_t src,
+                         uint16_t dst, uint32_t amount, uint8_t tclass,
+                         uint32_t deadline) {
+        return seq_add_backlog_deadline((struct seq_admissible_status *) status,
+                                        src, dst, amount, tclass, deadline);
 }
 
 static inline
@@ -147,6 +185,59 @@ void reset_admissible_state(struct admissible_state *status,
                                     inter_rack_capacity, out_of_boundary_capacity, num_nodes);
 }
 
+static inline
+void set_admission_n_cores(struct admissible_state *status, uint16_t n_cores)
+{
+        seq_set_n_cores((struct seq_admissible_status *) status, n_cores);
+}
+
+static inline
+void set_admission_prefetch_offset(struct admissible_state *status,
+                                   uint16_t prefetch_offset)
+{
+        seq_set_prefetch_offset((struct seq_admissible_status *) status,
+                                prefetch_offset);
+}
+
+static inline
+void set_admission_work_stealing(struct admissible_state *status,
+                                 bool work_stealing)
+{
+        seq_set_work_stealing((struct seq_admissible_status *) status,
+                              work_stealing);
+}
+
+static inline
+int claim_admission_batch(struct admissible_state *status, uint32_t core_index)
+{
+        return seq_claim_batch((struct seq_admissible_status *) status,
+                               core_index);
+}
+
+static inline
+uint64_t get_admission_next_batch(struct admissible_state *status,
+                                  uint32_t core_index)
+{
+        return seq_next_batch((struct seq_admissible_status *) status,
+                              core_index);
+}
+
+static inline
+void set_admission_bin_policy(struct admissible_state *status,
+                              enum bin_policy policy)
+{
+        seq_set_bin_policy((struct seq_admissible_status *) status, policy);
+}
+
+static inline
+void set_admission_tclass_policy(struct admissible_state *status,
+                                 enum tclass_policy policy, uint16_t n_tclasses,
+                                 const uint16_t *weights)
+{
+        seq_set_tclass_policy((struct seq_admissible_status *) status, policy,
+                              n_tclasses, weights);
+}
+
 static inline
 void reset_sender(struct admissible_state *status, uint16_t src)
 {
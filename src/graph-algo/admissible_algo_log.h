@@ -50,11 +50,17 @@ struct admission_core_statistics {
 	uint64_t passed_bins_during_run;
 	uint64_t wrap_up_non_empty_bin;
 	uint64_t wrap_up_non_empty_bin_demands;
+	uint64_t chunk_pool_empty;
+	uint64_t stolen_batches;
+	uint64_t given_batches;
+	uint64_t wait_for_batch_queue;
 
         /* pim-specific statistics */
         uint64_t phase_finished;
         uint64_t phase_none_ready;
         uint64_t phase_out_of_order;
+        uint64_t pim_stale_accepts;
+        uint64_t pim_sender_resets;
 };
 
 /**
@@ -76,6 +82,9 @@ struct admission_statistics {
 	/* spent demand handling */
 	uint64_t spent_bins;
 	uint64_t spent_demands;
+	/* backlog table */
+	uint64_t backlog_expired;
+	uint64_t backlog_table_full;
 };
 
 /* GLOBAL STATS (in admissible_status) */
@@ -137,6 +146,20 @@ void adm_log_processed_spent_demands(
 	}
 }
 
+static inline __attribute__((always_inline))
+void adm_log_backlog_expired(
+		struct admission_statistics *st, uint32_t num_expired) {
+	if (MAINTAIN_ADM_LOG_COUNTERS)
+		st->backlog_expired += num_expired;
+}
+
+static inline __attribute__((always_inline))
+void adm_log_backlog_table_full(
+		struct admission_statistics *st) {
+	if (MAINTAIN_ADM_LOG_COUNTERS)
+		st->backlog_table_full++;
+}
+
 /* PER CORE STATS */
 
 static inline __attribute__((always_inline))
@@ -221,6 +244,34 @@ void adm_log_passed_bins_during_run(
 	}
 }
 
+static inline __attribute__((always_inline))
+void adm_log_chunk_pool_empty(struct admission_core_statistics *st) {
+	if (MAINTAIN_ADM_LOG_COUNTERS) {
+		st->chunk_pool_empty++;
+	}
+}
+
+static inline __attribute__((always_inline))
+void adm_log_stole_batch(struct admission_core_statistics *st) {
+	if (MAINTAIN_ADM_LOG_COUNTERS) {
+		st->stolen_batches++;
+	}
+}
+
+static inline __attribute__((always_inline))
+void adm_log_gave_batch(struct admission_core_statistics *st) {
+	if (MAINTAIN_ADM_LOG_COUNTERS) {
+		st->given_batches++;
+	}
+}
+
+static inline __attribute__((always_inline))
+void adm_log_wait_for_batch_queue(struct admission_core_statistics *st) {
+	if (MAINTAIN_ADM_LOG_COUNTERS) {
+		st->wait_for_batch_queue++;
+	}
+}
+
 static inline __attribute__((always_inline))
 void adm_log_wrap_up_non_empty_bin(
 		struct admission_core_statistics *st, uint32_t bin_size) {
@@ -331,4 +382,18 @@ void adm_log_phase_out_of_order(
 		st->phase_out_of_order++;
 }
 
+static inline __attribute__((always_inline))
+void adm_log_pim_stale_accept(
+		struct admission_core_statistics *st) {
+	if (MAINTAIN_ADM_LOG_COUNTERS)
+		st->pim_stale_accepts++;
+}
+
+static inline __attribute__((always_inline))
+void adm_log_pim_sender_reset(
+		struct admission_core_statistics *st) {
+	if (MAINTAIN_ADM_LOG_COUNTERS)
+		st->pim_sender_resets++;
+}
+
 #endif /* ADMISSIBLE_ALGO_LOG_H_ */
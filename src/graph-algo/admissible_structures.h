@@ -21,28 +21,99 @@
 
 #include "backlog.h"
 #include "batch.h"
+#include "batch_simd.h"
 #include "bin.h"
+#include "chunk_bin.h"
 #include "admitted.h"
 
 #define SMALL_BIN_SIZE (32) // TODO: try smaller values
-#define LARGE_BIN_SIZE (MAX_NODES * MAX_NODES) // TODO: try smaller values
+/* a flow is in at most one bin, and only active flows have backlog entries */
+#if (MAX_NODES * MAX_NODES < BACKLOG_MAX_FLOWS)
+#define LARGE_BIN_SIZE (MAX_NODES * MAX_NODES)
+#else
+#define LARGE_BIN_SIZE BACKLOG_MAX_FLOWS
+#endif
+/* free chunks each core keeps between batches (96 KB). Cores had at most
+ * ~120 chunks in use at 256 nodes and ~330 at 4096 nodes in
+ * benchmark_graph_algo types 0, 3, 4 and 9, they take more from the shared
+ * mempool when needed */
+#ifndef CORE_CHUNK_POOL_CHUNKS
+#define CORE_CHUNK_POOL_CHUNKS	128
+#endif
+/* chunks in the mempool shared by all cores: enough for every flow to be in
+ * a bin with each bin of one core's last chunk partly full, plus the free
+ * chunks the cores keep (1.3 MB at 256 nodes, 9.9 MB at 4096 nodes on one
+ * core, 2.7 MB at 256 nodes on 16 cores). A flow is in one bin at a time, so
+ * this bounds the cores together. Should the mempool still run out, e.g.
+ * with partly full chunks in several cores, cores pass demand on to the next
+ * core as if they did not get to it */
+#ifndef CHUNK_MEMPOOL_CHUNKS
+#define CHUNK_MEMPOOL_CHUNKS	\
+	(((LARGE_BIN_SIZE + CHUNK_BIN_CHUNK_MASK) >> CHUNK_BIN_CHUNK_SHIFT) \
+			+ NUM_CORE_BINS + ALGO_N_CORES * CORE_CHUNK_POOL_CHUNKS)
+#endif
 #define NUM_BINS_SHIFT 5
 #define NUM_BINS 32 // 2^NUM_BINS_SHIFT
-#define NUM_SRC_DST_PAIRS (MAX_NODES * (MAX_NODES))  // include dst == out of boundary
 
-#define BIN_MASK_SIZE		((NUM_BINS + BATCH_SIZE + 63) / 64)
+/* bins of one class range: under BIN_POLICY_LRU and BIN_POLICY_SJF,
+ * NUM_BINS + BATCH_SIZE bins. BIN_POLICY_EDF has NUM_BINS bins for flows with
+ * a deadline before those */
+#define RANGE_BINS			(NUM_BINS + BATCH_SIZE)
+#define EDF_RANGE_BINS		(NUM_BINS + RANGE_BINS)
+#define BIN_MASK_SIZE		((EDF_RANGE_BINS + 63) / 64)
+
+/* traffic classes carried in A-REQs. every class in use has its own range of
+ * BIN_MASK_SIZE words of bins. each batch processes the ranges in some order,
+ * and a range is only allowed to be processed after the ranges before it */
+#define NUM_TCLASSES		4
+/* under BIN_POLICY_EDF, edges of flows with a deadline carry it as their
+ * metric and have this bit set in their tclass. other edges carry the
+ * timeslot the flow was last allocated, as under BIN_POLICY_LRU */
+#define TCLASS_HAS_DEADLINE	0x80
+#define TCLASS_MASK			(TCLASS_HAS_DEADLINE - 1)
+#define TCLASS_BIN_STRIDE	(64 * BIN_MASK_SIZE)
+#define NUM_CORE_BINS		(NUM_TCLASSES * TCLASS_BIN_STRIDE)
+#define TCLASS_MAX_WEIGHT	255
+
+/* rings that pass demand between batches: batch b reads q_bin[b % n_queues]
+ * and passes what it did not allocate to the ring of batch b + 1. work
+ * stealing uses two rings per core, see seq_set_work_stealing */
+#define Q_BIN_RINGS			(2 * ALGO_N_CORES)
+#define NO_BATCH			(~0ULL)
+
+enum tclass_policy {
+	TCLASS_POLICY_STRICT,	/* a class is served before all higher classes */
+	TCLASS_POLICY_WEIGHTED,	/* each class is served first in a share of
+							   batches proportional to its weight */
+};
+
+/* the order flows of the same traffic class are allocated in */
+enum bin_policy {
+	BIN_POLICY_LRU,	/* least recently allocated flow first */
+	BIN_POLICY_SJF,	/* flow with the least remaining backlog first */
+	BIN_POLICY_EDF,	/* flow with the earliest deadline first, then flows
+					   without a deadline, least recently allocated
+					   first */
+};
 
 // Data structures associated with one allocation core
 struct seq_admission_core_state {
-	struct bin *new_request_bins[NUM_BINS + BATCH_SIZE]; // pool of backlog bins for incoming requests
-	uint64_t non_empty_bins[BIN_MASK_SIZE];
-	uint64_t allowed_bins[BIN_MASK_SIZE];
+	struct chunk_bin new_request_bins[NUM_CORE_BINS]; // backlog bins for incoming requests
+	struct chunk_pool chunk_pool; // chunks for new_request_bins
+	uint64_t non_empty_bins[NUM_TCLASSES * BIN_MASK_SIZE];
+	uint64_t allowed_bins[NUM_TCLASSES * BIN_MASK_SIZE];
+	uint8_t tclass_order[NUM_TCLASSES]; /* class ranges in processing order */
 	struct batch_state batch_state;
     struct admitted_traffic *admitted[BATCH_SIZE];
     struct bin *out_bin;
     struct bin *spent_bin;
     struct admission_core_statistics stat;
     uint64_t current_timeslot;
+    uint64_t stolen_batch; /* batch taken from another core, allocated by the
+                              core's next call, or NO_BATCH */
+    /* the core's next batch while another core may take it, else NO_BATCH.
+     * claimed by other cores, so on its own line */
+    uint64_t offered_batch __attribute__((aligned(64)));
 }  __attribute__((aligned(64))) /* don't want sharing between cores */;
 
 // Tracks status for admissible traffic (last send time and demand for all flows, etc.)
@@ -52,17 +123,31 @@ struct seq_admissible_status {
     uint16_t out_of_boundary_capacity;
     uint16_t inter_rack_capacity;  // Only valid if oversubscribed is true
     uint16_t num_nodes;
-    uint64_t last_alloc_tslot[NUM_SRC_DST_PAIRS];
-    struct backlog backlog;
+    uint16_t n_cores; /* cores running the allocation, at most ALGO_N_CORES */
+    enum batch_simd_level simd_level; /* vector instructions to allocate with */
+    enum tclass_policy tclass_policy;
+    enum bin_policy bin_policy;
+    uint16_t n_tclass_ranges; /* traffic classes in use, each with a bin range */
+    uint16_t tclass_wrr_len;
+    uint8_t tclass_wrr[NUM_TCLASSES * TCLASS_MAX_WEIGHT]; /* class served first,
+                                                           by batch number */
+    uint16_t prefetch_offset; /* edges ahead to prefetch backlog entries */
+    bool work_stealing; /* idle cores take batches busy cores offer */
+    uint16_t n_queues; /* q_bin rings in use */
+    struct backlog backlog; // also holds each flow's last allocated timeslot
     struct bin *new_demands;
     struct fp_ring *q_head;
     struct fp_ring *q_admitted_out;
     struct fp_ring *q_spent;
     struct fp_mempool *bin_mempool;
     struct fp_mempool *core_bin_mempool;
+    struct fp_mempool *chunk_mempool; /* bin chunks for all cores' pools */
     struct fp_mempool *admitted_traffic_mempool;
     struct seq_admission_core_state cores[ALGO_N_CORES];
-    struct fp_ring *q_bin[ALGO_N_CORES];
+    struct fp_ring *q_bin[Q_BIN_RINGS];
+    /* first timeslot of the batch that may use each ring next, so a ring
+     * has one reader and one writer at a time */
+    uint64_t queue_next_batch[Q_BIN_RINGS];
     struct admission_statistics stat;
 };
 
@@ -85,19 +170,9 @@ void seq_reset_admissible_status(struct seq_admissible_status *status, bool over
     status->out_of_boundary_capacity = out_of_boundary_capacity;
     status->num_nodes = num_nodes;
 
-    uint32_t i;
-    for (i = 0; i < NUM_SRC_DST_PAIRS; i++)
-        status->last_alloc_tslot[i] = 0;
-
     backlog_init(&status->backlog);
 }
 
-// Get the index of this flow in the status data structure
-static inline
-uint32_t get_status_index(uint16_t src, uint16_t dst) {
-    return (src << FP_NODES_SHIFT) + dst;
-}
-
 // Initializes data structures associated with one allocation core for
 // a new batch of processing
 static inline
@@ -106,12 +181,35 @@ void alloc_core_reset(struct seq_admission_core_state *core,
     assert(core != NULL);
 
     uint16_t i;
-	for (i = 0; i < NUM_BINS + BATCH_SIZE; i++)
-		init_bin(core->new_request_bins[i]);
 
-	core->allowed_bins[0] = 0x1;
-	for (i = 1; i < BIN_MASK_SIZE; i++)
+	/* only bins marked non-empty hold chunks: the last batch either took
+	 * the edges out of a bin and reset it, or left its bit set */
+	for (i = 0; i < NUM_TCLASSES * BIN_MASK_SIZE; i++) {
+		uint64_t mask = core->non_empty_bins[i];
+		while (mask) {
+			uint16_t bin_index = 64 * i + __builtin_ctzll(mask);
+			mask &= mask - 1;
+			chunk_bin_reset(&core->new_request_bins[bin_index],
+					&core->chunk_pool);
+		}
+	}
+	/* give chunks from a burst back to the other cores */
+	if (unlikely(core->chunk_pool.n_free
+			> CORE_CHUNK_POOL_CHUNKS + CHUNK_POOL_GROW_CHUNKS))
+		chunk_pool_trim(&core->chunk_pool, CORE_CHUNK_POOL_CHUNKS);
+
+	/* this batch's first class, then the rest in priority order */
+	uint8_t first = status->tclass_wrr[(core->current_timeslot >> BATCH_SHIFT)
+	                                   % status->tclass_wrr_len];
+	uint8_t tclass, n = 0;
+	core->tclass_order[n++] = first;
+	for (tclass = 0; tclass < NUM_TCLASSES; tclass++)
+		if (tclass != first)
+			core->tclass_order[n++] = tclass;
+
+	for (i = 0; i < NUM_TCLASSES * BIN_MASK_SIZE; i++)
 		core->allowed_bins[i] = 0;
+	core->allowed_bins[first * BIN_MASK_SIZE] = 0x1;
 
 	batch_state_init(&core->batch_state, status->oversubscribed,
                      status->inter_rack_capacity, status->out_of_boundary_capacity,
@@ -130,7 +228,7 @@ void alloc_core_reset(struct seq_admission_core_state *core,
 /**
  * Initializes the alloc core.
  * Returns: 0 if successful, -1 on error.
- * @note: doesn't clean up memory on error - may leak!
+ * @note: doesn't clean up on error, the caller frees the chunk pool
  */
 static inline int alloc_core_init(struct seq_admissible_status *status,
                                   uint32_t core_index, uint64_t timeslot)
@@ -138,11 +236,12 @@ static inline int alloc_core_init(struct seq_admissible_status *status,
 	int j;
 	struct seq_admission_core_state* core = &status->cores[core_index];
 
-	for (j = 0; j < NUM_BINS + BATCH_SIZE; j++) {
-		core->new_request_bins[j] = create_bin(LARGE_BIN_SIZE);
-		if (core->new_request_bins[j] == NULL)
-			return -1;
-	}
+	if (chunk_pool_init(&core->chunk_pool, status->chunk_mempool,
+			CORE_CHUNK_POOL_CHUNKS) != 0)
+		return -1;
+	for (j = 0; j < NUM_CORE_BINS; j++)
+		chunk_bin_init(&core->new_request_bins[j]);
+	memset(core->non_empty_bins, 0, sizeof(core->non_empty_bins));
 
 	 if (fp_mempool_get(status->bin_mempool,
 			 (void**)&core->out_bin) != 0)
@@ -155,12 +254,45 @@ static inline int alloc_core_init(struct seq_admissible_status *status,
 	init_bin(core->spent_bin);
 
 	core->current_timeslot = timeslot;
+	core->stolen_batch = NO_BATCH;
+	core->offered_batch = NO_BATCH;
 
 	return 0;
 }
 
+// Returns the q_bin ring that the batch starting at @timeslot reads from
+static inline __attribute__((always_inline))
+uint16_t batch_queue(struct seq_admissible_status *status, uint64_t timeslot)
+{
+	/* cores' batches start at NUM_BINS + a multiple of BATCH_SIZE */
+	return ((timeslot - NUM_BINS) >> BATCH_SHIFT) % status->n_queues;
+}
+
+/**
+ * Withdraws all offered and taken batches and sets which batch uses each
+ *   ring next, from the cores' current timeslots. Cores must not be running.
+ */
+static inline
+void seq_reset_batch_queues(struct seq_admissible_status *status)
+{
+    uint64_t base = status->cores[0].current_timeslot;
+    uint32_t i;
+
+    for (i = 0; i < ALGO_N_CORES; i++) {
+    	status->cores[i].stolen_batch = NO_BATCH;
+    	status->cores[i].offered_batch = NO_BATCH;
+    	if (i < status->n_cores && status->cores[i].current_timeslot < base)
+    		base = status->cores[i].current_timeslot;
+    }
+    for (i = 0; i < status->n_queues; i++) {
+    	uint64_t timeslot = base + i * BATCH_SIZE;
+    	status->queue_next_batch[batch_queue(status, timeslot)] = timeslot;
+    }
+}
+
 /**
  * Initializes an already-allocated struct admissible_status.
+ * @param q_bin: Q_BIN_RINGS single-producer, single-consumer rings
  */
 static inline
 int seq_init_admissible_status(struct seq_admissible_status *status,
@@ -190,14 +322,170 @@ int seq_init_admissible_status(struct seq_admissible_status *status,
     fp_mempool_get(bin_mempool, (void**)&status->new_demands);
     init_bin(status->new_demands);
 
+    status->chunk_mempool = fp_mempool_create(CHUNK_MEMPOOL_CHUNKS,
+                                              sizeof(struct bin_chunk), 0);
+    if (status->chunk_mempool == NULL)
+        return -1;
+
+    status->n_cores = ALGO_N_CORES;
+#ifdef BATCH_SIMD
+    status->simd_level = batch_simd_detect();
+#else
+    /* one edge at a time is faster on the CPUs measured so far (microbench) */
+    status->simd_level = BATCH_SIMD_NONE;
+#endif
+    status->tclass_policy = TCLASS_POLICY_STRICT;
+    status->bin_policy = BIN_POLICY_LRU;
+    status->n_tclass_ranges = 1;
+    status->tclass_wrr_len = 1;
+    status->tclass_wrr[0] = 0;
+    status->prefetch_offset = BACKLOG_PREFETCH_OFFSET;
+    status->work_stealing = false;
+    status->n_queues = status->n_cores;
     for (i = 0; i < ALGO_N_CORES; i++) {
     	rc = alloc_core_init(status, i, NUM_BINS + i * BATCH_SIZE);
     	if (rc != 0)
     		return -1;
     }
+    seq_reset_batch_queues(status);
     return 0;
 }
 
+/**
+ * Sets the number of cores that run the allocation, each taking every
+ *   n_cores'th batch. Re-aligns the cores' timeslots so core i allocates the
+ *   batch after core i-1, without moving any core back in time.
+ */
+static inline
+void seq_set_n_cores(struct seq_admissible_status *status, uint16_t n_cores)
+{
+    assert(status != NULL);
+    assert(n_cores >= 1 && n_cores <= ALGO_N_CORES);
+    uint64_t base = 0;
+    uint32_t i;
+
+    for (i = 0; i < ALGO_N_CORES; i++) {
+    	uint64_t core_base = status->cores[i].current_timeslot - i * BATCH_SIZE;
+    	if (core_base > base)
+    		base = core_base;
+    }
+    for (i = 0; i < ALGO_N_CORES; i++)
+    	status->cores[i].current_timeslot = base + i * BATCH_SIZE;
+
+    status->n_cores = n_cores;
+    status->n_queues = status->work_stealing ? 2 * n_cores : n_cores;
+    seq_reset_batch_queues(status);
+}
+
+/**
+ * Enables or disables work stealing between cores. Each core then offers its
+ *   next batch while it allocates the current one, and a core that is waiting
+ *   for its own next batch can take an offered batch that comes before it
+ *   (seq_claim_batch). The owner skips batches taken from it.
+ *
+ *   Batches use twice as many q_bin rings as there are cores, so a batch can
+ *   start while the batch n_cores before it is still allocating. A batch
+ *   waits for the one that used its ring before to finish.
+ *
+ *   Meant for allocation that is not paced by the clock, e.g. the NO_DPDK
+ *   benchmarks; with the arbiter's clock, a core's own batch is always due
+ *   first. Cores must not be running.
+ */
+static inline
+void seq_set_work_stealing(struct seq_admissible_status *status,
+		bool work_stealing)
+{
+    assert(status != NULL);
+    status->work_stealing = work_stealing;
+    status->n_queues = work_stealing ? 2 * status->n_cores : status->n_cores;
+    seq_reset_batch_queues(status);
+}
+
+/**
+ * Sets how many edges ahead the comm core prefetches backlog entries when
+ *   handling spent demands, 0 to not prefetch
+ */
+static inline
+void seq_set_prefetch_offset(struct seq_admissible_status *status,
+		uint16_t prefetch_offset)
+{
+    assert(status != NULL);
+    status->prefetch_offset = prefetch_offset;
+}
+
+/**
+ * Sets the order flows are allocated in within each traffic class. Cores bin
+ *   their flows anew every batch, so the policy applies from the next batch.
+ */
+static inline
+void seq_set_bin_policy(struct seq_admissible_status *status,
+		enum bin_policy policy)
+{
+    assert(status != NULL);
+    status->bin_policy = policy;
+}
+
+/**
+ * Sets how traffic classes share the allocation.
+ * @param n_tclasses: classes in use, higher classes are treated as the last
+ * @param weights: with TCLASS_POLICY_WEIGHTED, the first n_tclasses weights,
+ *   in 1..TCLASS_MAX_WEIGHT. A class of weight w is served first in w out of
+ *   every sum-of-weights batches, interleaved smoothly. Ignored with
+ *   TCLASS_POLICY_STRICT.
+ */
+static inline
+void seq_set_tclass_policy(struct seq_admissible_status *status,
+		enum tclass_policy policy, uint16_t n_tclasses, const uint16_t *weights)
+{
+    assert(status != NULL);
+    assert(n_tclasses >= 1 && n_tclasses <= NUM_TCLASSES);
+    int32_t credit[NUM_TCLASSES] = {0};
+    uint32_t total = 0;
+    uint32_t i, c, best;
+
+    status->tclass_policy = policy;
+    status->n_tclass_ranges = n_tclasses;
+    if (policy == TCLASS_POLICY_STRICT) {
+    	status->tclass_wrr_len = 1;
+    	status->tclass_wrr[0] = 0;
+    	return;
+    }
+
+    for (c = 0; c < n_tclasses; c++) {
+    	assert(weights[c] >= 1 && weights[c] <= TCLASS_MAX_WEIGHT);
+    	total += weights[c];
+    }
+
+    /* smooth weighted round robin, so no class waits long to go first */
+    for (i = 0; i < total; i++) {
+    	best = 0;
+    	for (c = 0; c < n_tclasses; c++) {
+    		credit[c] += weights[c];
+    		if (credit[c] > credit[best])
+    			best = c;
+    	}
+    	credit[best] -= total;
+    	status->tclass_wrr[i] = best;
+    }
+    status->tclass_wrr_len = total;
+}
+
+/**
+ * Frees a struct seq_admissible_status from seq_create_admissible_status.
+ *   The queues and mempools it was created with are the caller's, bins taken
+ *   from them aren't put back.
+ */
+static inline
+void seq_destroy_admissible_status(struct seq_admissible_status *status)
+{
+    uint32_t i;
+
+    for (i = 0; i < ALGO_N_CORES; i++)
+        chunk_pool_free(&status->cores[i].chunk_pool);
+    fp_mempool_destroy(status->chunk_mempool);
+    fp_free(status);
+}
+
 /**
  * Returns an initialized struct admissible_status, or NULL on error.
  */
@@ -212,15 +500,18 @@ seq_create_admissible_status(bool oversubscribed, uint16_t inter_rack_capacity,
                              struct fp_ring **q_bin)
 {
     struct seq_admissible_status *status =
-            fp_malloc("seq_admissible_status", sizeof(struct seq_admissible_status));
+            fp_calloc("seq_admissible_status", 1, sizeof(struct seq_admissible_status));
 
     if (status == NULL)
     	return NULL;
 
-    seq_init_admissible_status(status, oversubscribed, inter_rack_capacity,
-                               out_of_boundary_capacity, num_nodes, q_head,
-                               q_admitted_out, q_spent, head_bin_mempool,
-                               admitted_traffic_mempool, q_bin);
+    if (seq_init_admissible_status(status, oversubscribed, inter_rack_capacity,
+                                   out_of_boundary_capacity, num_nodes, q_head,
+                                   q_admitted_out, q_spent, head_bin_mempool,
+                                   admitted_traffic_mempool, q_bin) != 0) {
+        seq_destroy_admissible_status(status);
+        return NULL;
+    }
 
     return status;
 }
@@ -23,12 +23,20 @@
 
 #define Q_IN_Q_OUT_BURST_SIZE			16
 
-#define MAX_DEMANDS_PER_BATCH		(MAX_NODES * BATCH_SIZE * ALGO_N_CORES)
+#define MAX_DEMANDS_PER_BATCH(n_cores)		(MAX_NODES * BATCH_SIZE * (n_cores))
 
 #define TIMESLOT_SHIFT_PER_PRIORITY		1
 #define TIMESLOTS_START_BEFORE			((BATCH_SIZE + NUM_BINS) << TIMESLOT_SHIFT_PER_PRIORITY)
 
-#define SPENT_RING_DEQUEUE_SIZE		256
+/* bins taken from queue_in per loop iteration: one, plus one per 2^SHIFT
+ * nodes, so leftover demand of large clusters keeps up with new demand */
+#define NODES_PER_Q_IN_BIN_SHIFT		8
+#define Q_IN_BINS_PER_ITERATION(num_nodes)	\
+	(1 + ((num_nodes) >> NODES_PER_Q_IN_BIN_SHIFT))
+
+/* enough for the spent demands of a full batch (MAX_NODES * BATCH_SIZE edges
+ * in bins of SMALL_BIN_SIZE) */
+#define SPENT_RING_DEQUEUE_SIZE		MAX_NODES
 
 /**
  * Flushes bin to queue, and allocates a new bin
@@ -51,10 +59,10 @@ void core_flush_q_spent(struct seq_admission_core_state *core,
 static inline __attribute__((always_inline))
 void core_enqueue_to_q_spent(struct seq_admission_core_state *core,
 		struct fp_ring *queue_spent, struct fp_mempool *bin_mempool,
-		uint16_t src, uint16_t dst, uint32_t metric)
+		uint16_t src, uint16_t dst, uint32_t metric, uint8_t tclass)
 {
 	/* add to status->new_demands */
-	enqueue_bin(core->spent_bin, src, dst, 0, metric);
+	enqueue_bin_tclass(core->spent_bin, src, dst, 0, metric, tclass);
 
 	if (unlikely(bin_size(core->spent_bin) == SMALL_BIN_SIZE)) {
 		adm_log_q_spent_flush_bin_full(&core->stat);
@@ -83,10 +91,11 @@ void core_flush_q_out(struct seq_admission_core_state *core,
 static inline __attribute__((always_inline))
 void core_enqueue_to_q_out(struct seq_admission_core_state *core,
 		struct fp_ring *queue_out, struct fp_mempool *bin_mempool,
-		uint16_t src, uint16_t dst, uint16_t backlog, uint32_t metric)
+		uint16_t src, uint16_t dst, uint16_t backlog, uint32_t metric,
+		uint8_t tclass)
 {
 	/* add to status->new_demands */
-	enqueue_bin(core->out_bin, src, dst, backlog, metric);
+	enqueue_bin_tclass(core->out_bin, src, dst, backlog, metric, tclass);
 
 	if (unlikely(bin_size(core->out_bin) == SMALL_BIN_SIZE)) {
 		adm_log_q_out_flush_bin_full(&core->stat);
@@ -135,11 +144,11 @@ void seq_flush_backlog(struct seq_admissible_status *status) {
 }
 
 void enqueue_new_demand(struct seq_admissible_status* status, uint16_t src,
-		uint16_t dst, uint32_t amount)
+		uint16_t dst, uint32_t amount, uint32_t last_alloc, uint8_t tclass)
 {
 	/* add to status->new_demands */
-	enqueue_bin(status->new_demands, src, dst, amount,
-			status->last_alloc_tslot[get_status_index(src, dst)]);
+	enqueue_bin_tclass(status->new_demands, src, dst, amount, last_alloc,
+			tclass);
 
 	if (unlikely(bin_size(status->new_demands) == SMALL_BIN_SIZE)) {
 		adm_log_backlog_flush_bin_full(&status->stat);
@@ -147,15 +156,91 @@ void enqueue_new_demand(struct seq_admissible_status* status, uint16_t src,
 	}
 }
 
-void seq_add_backlog(struct seq_admissible_status *status,
-		uint16_t src, uint16_t dst, uint32_t amount)
+/**
+ * Returns the first timeslot of the earliest batch the admission cores will
+ *   allocate next. Read from other cores, so it can lag by a batch.
+ */
+static inline
+uint64_t admission_timeslot(struct seq_admissible_status *status)
 {
-	if (backlog_increase(&status->backlog, src, dst, amount,
-			&status->stat) == false)
-		return; /* no need to enqueue */
+	uint64_t timeslot = status->cores[0].current_timeslot;
+	uint32_t i;
+
+	/* n_cores is at most ALGO_N_CORES (seq_set_n_cores), the second bound
+	 * tells the compiler so */
+	for (i = 1; i < status->n_cores && i < ALGO_N_CORES; i++)
+		if (status->cores[i].current_timeslot < timeslot)
+			timeslot = status->cores[i].current_timeslot;
+	return timeslot;
+}
+
+int seq_add_backlog_deadline(struct seq_admissible_status *status,
+		uint16_t src, uint16_t dst, uint32_t amount, uint8_t tclass,
+		uint32_t deadline)
+{
+	uint32_t due = BACKLOG_NO_DEADLINE;
+	uint32_t metric;
+	enum backlog_increase_result res;
+
+	assert(tclass < NUM_TCLASSES);
+
+	if (deadline != 0) {
+		/* the backlog keeps deadlines relative to the current timeslot */
+		if (unlikely(deadline > BACKLOG_MAX_DEADLINE))
+			deadline = BACKLOG_MAX_DEADLINE;
+		due = (uint32_t)(admission_timeslot(status) + deadline);
+		/* don't let the timeslot wrap-around turn the deadline off */
+		if (unlikely((uint16_t)due == BACKLOG_NO_DEADLINE))
+			due++;
+	}
+
+	res = backlog_increase(&status->backlog, src, dst, amount, tclass,
+			(uint16_t)due, &status->stat);
+	if (unlikely(res == BACKLOG_TABLE_FULL))
+		return -1;
+	if (res == BACKLOG_INCREASED)
+		return 0; /* no need to enqueue */
 
 	/* add to status->new_demands */
-	enqueue_new_demand(status, src, dst, amount);
+	if (status->bin_policy == BIN_POLICY_EDF && deadline != 0) {
+		metric = due;
+		tclass |= TCLASS_HAS_DEADLINE;
+	} else {
+		metric = backlog_get_last_alloc(&status->backlog, src, dst);
+	}
+	enqueue_new_demand(status, src, dst, amount, metric, tclass);
+	return 0;
+}
+
+int seq_add_backlog_tclass(struct seq_admissible_status *status,
+		uint16_t src, uint16_t dst, uint32_t amount, uint8_t tclass)
+{
+	return seq_add_backlog_deadline(status, src, dst, amount, tclass, 0);
+}
+
+int seq_add_backlog(struct seq_admissible_status *status,
+		uint16_t src, uint16_t dst, uint32_t amount)
+{
+	return seq_add_backlog_tclass(status, src, dst, amount, 0);
+}
+
+/**
+ * Prefetches the backlog entry of the edge at (@pf_bin, @pf_i) and advances
+ *   the position to the next edge, moving on to the next bin as needed
+ */
+static inline __attribute__((always_inline))
+void prefetch_spent_edge(struct seq_admissible_status *status,
+		struct bin **bins, int n, int *pf_bin, uint32_t *pf_i)
+{
+	while (*pf_bin < n && *pf_i >= bin_size(bins[*pf_bin])) {
+		(*pf_bin)++;
+		*pf_i = 0;
+	}
+	if (*pf_bin == n)
+		return;
+
+	struct backlog_edge *edge = bin_get(bins[*pf_bin], (*pf_i)++);
+	backlog_prefetch(&status->backlog, edge->src, edge->dst);
 }
 
 void seq_handle_spent(struct seq_admissible_status *status)
@@ -166,30 +251,57 @@ void seq_handle_spent(struct seq_admissible_status *status)
     int n, bin, i;
     uint32_t num_entries = 0;
     uint32_t num_bins = 0;
+    int pf_bin = 0;
+    uint32_t pf_i = 0;
+    bool edf = (status->bin_policy == BIN_POLICY_EDF);
+    /* under EDF edges of flows with a deadline carry it, so those flows are
+     * stamped with the current batch instead */
+    uint32_t now = edf ? (uint32_t)admission_timeslot(status) : 0;
 
     n = fp_ring_dequeue_burst(status->q_spent, (void **)&bins[0],
     		SPENT_RING_DEQUEUE_SIZE);
 
+    /* lookups are software pipelined: the entry of the edge prefetch_offset
+     * ahead is prefetched before handling each edge */
+    for (i = 0; i < status->prefetch_offset; i++)
+    	prefetch_spent_edge(status, bins, n, &pf_bin, &pf_i);
+
     for (bin = 0; bin < n; bin++) {
     	num_entries += bin_size(bins[bin]);
     	num_bins++;
     	for (i = 0; i < bin_size(bins[bin]); i++) {
+    		if (status->prefetch_offset > 0)
+    			prefetch_spent_edge(status, bins, n, &pf_bin, &pf_i);
     		struct backlog_edge *edge = bin_get(bins[bin], i);
     		uint16_t src = edge->src;
     		uint16_t dst = edge->dst;
-    		uint32_t backlog = backlog_get(&status->backlog, src, dst);
+    		struct backlog_entry *entry = backlog_find(&status->backlog,
+    				src, dst);
+    		if (unlikely(entry == NULL))
+    			continue; /* status was reset while the flow was in flight */
+    		uint32_t backlog = entry->n;
 
     		if (backlog == 0) {
-    			status->last_alloc_tslot[get_status_index(src, dst)] = edge->metric;
-    			backlog_non_active(&status->backlog, src, dst);
+    			backlog_entry_set_last_alloc(&status->backlog, entry,
+    					(edge->tclass & TCLASS_HAS_DEADLINE) ? now
+    							: edge->metric);
+    			entry->is_active = 0;
     		} else {
-    			backlog_reset_pair(&status->backlog, src, dst);
-    			enqueue_new_demand(status, src, dst, backlog);
+    			uint32_t metric = entry->last_alloc;
+    			uint8_t tclass = entry->tclass;
+    			if (edf && entry->deadline != BACKLOG_NO_DEADLINE) {
+    				metric = backlog_deadline_to_timeslot(entry->deadline, now);
+    				tclass |= TCLASS_HAS_DEADLINE;
+    			}
+    			entry->n = 0;
+    			enqueue_new_demand(status, src, dst, backlog, metric, tclass);
+    			entry->deadline = BACKLOG_NO_DEADLINE;
     		}
     	}
 		fp_mempool_put(status->bin_mempool, bins[bin]);
     }
     adm_log_processed_spent_demands(&status->stat, num_bins, num_entries);
+
 }
 
 static inline __attribute__((always_inline))
@@ -198,6 +310,45 @@ void set_bin_non_empty(struct seq_admission_core_state *core, uint16_t bin_index
 	asm("bts %1,%0" : "+m" (*(uint64_t *)&core->non_empty_bins[0]) : "r" (bin_index));
 }
 
+/**
+ * Allows processing the bin at position @order, counting the bins of all
+ *   traffic class ranges in this batch's class order
+ */
+static inline __attribute__((always_inline))
+void set_bin_allowed(struct seq_admission_core_state *core, uint16_t order,
+		uint16_t n_range_bins)
+{
+	uint8_t tclass = core->tclass_order[order / n_range_bins];
+	uint16_t bin_index = tclass * TCLASS_BIN_STRIDE
+			+ (order % n_range_bins);
+	asm("bts %1,%0" : "+m" (*(uint64_t *)&core->allowed_bins[0]) : "r" (bin_index));
+}
+
+/**
+ * Puts an edge in the core's bin @bin_index. If the core's chunk pool is
+ *   empty, passes the edge on to the next core instead, like demand this core
+ *   did not get to.
+ */
+static inline __attribute__((always_inline))
+void core_enqueue_to_bin(struct seq_admissible_status *status,
+		struct seq_admission_core_state *core, uint16_t bin_index,
+		uint16_t src, uint16_t dst, uint16_t backlog, uint32_t metric,
+		uint8_t tclass)
+{
+	if (likely(chunk_bin_enqueue(&core->new_request_bins[bin_index],
+			&core->chunk_pool, src, dst, backlog, metric, tclass) == 0)) {
+		/* mark that the bin is non-empty */
+		set_bin_non_empty(core, bin_index);
+		return;
+	}
+
+	adm_log_chunk_pool_empty(&core->stat);
+	core_enqueue_to_q_out(core,
+			status->q_bin[batch_queue(status,
+					core->current_timeslot + BATCH_SIZE)],
+			status->bin_mempool, src, dst, backlog, metric, tclass);
+}
+
 static inline __attribute__((always_inline))
 void incoming_bin_to_core(struct seq_admissible_status *status,
 		struct seq_admission_core_state *core, struct bin *bin)
@@ -206,24 +357,31 @@ void incoming_bin_to_core(struct seq_admissible_status *status,
 	uint32_t i;
 	for (i = 0; i < n; i++) {
 		/* where to put the entry? */
-		uint16_t bin_index = bin_index_from_timeslot(bin_get(bin, i)->metric,
-													core->current_timeslot);
+		struct backlog_edge *edge = bin_get(bin, i);
+		uint16_t bin_index = tclass_bin_index(status, edge->tclass,
+				edge->metric, edge->backlog, core->current_timeslot);
 		/* put it there */
-		enqueue_bin_edge(core->new_request_bins[bin_index], bin_get(bin, i));
-		/* mark that the bin is non-empty */
-		set_bin_non_empty(core, bin_index);
+		core_enqueue_to_bin(status, core, bin_index, edge->src, edge->dst,
+				edge->backlog, edge->metric, edge->tclass);
 	}
 }
 
 static inline __attribute__((always_inline))
 void move_bin_to_q_out(struct seq_admissible_status *status,
 		struct seq_admission_core_state *core, struct fp_ring *queue_out,
-        struct fp_mempool *bin_mp_out, struct bin *bin)
+        struct fp_mempool *bin_mp_out, struct chunk_bin *bin)
 {
-	uint32_t n = bin_size(bin);
+	uint32_t n = chunk_bin_size(bin);
+	struct bin_chunk *chunk = bin->head;
 	uint32_t i;
-	for (i = 0; i < n; i++)
-		core_enqueue_to_q_out_edge(core, queue_out, bin_mp_out, bin_get(bin, i));
+	for (i = 0; i < n; i++) {
+		uint32_t j = i & CHUNK_BIN_CHUNK_MASK;
+		core_enqueue_to_q_out(core, queue_out, bin_mp_out, chunk->src[j],
+				chunk->dst[j], chunk->backlog[j], chunk->metric[j],
+				chunk->tclass[j]);
+		if (j == CHUNK_BIN_CHUNK_MASK)
+			chunk = chunk->next;
+	}
 }
 
 static inline __attribute__((always_inline))
@@ -233,7 +391,8 @@ void move_core_to_q_out(struct seq_admissible_status *status,
 {
 	uint32_t bin_mask_ind;
 
-	for (bin_mask_ind = 0; bin_mask_ind < BIN_MASK_SIZE; bin_mask_ind++) {
+	for (bin_mask_ind = 0; bin_mask_ind < NUM_TCLASSES * BIN_MASK_SIZE;
+			bin_mask_ind++) {
 		uint64_t mask = core->non_empty_bins[bin_mask_ind];
 		uint64_t bin_index;
 		while (mask) {
@@ -242,30 +401,28 @@ void move_core_to_q_out(struct seq_admissible_status *status,
 			/* turn off the set bit in the mask */
 			mask &= (mask - 1);
 			bin_index += 64 * bin_mask_ind;
-			struct bin *bin = core->new_request_bins[bin_index];
-			adm_log_wrap_up_non_empty_bin(&core->stat, bin_size(bin));
+			struct chunk_bin *bin = &core->new_request_bins[bin_index];
+			adm_log_wrap_up_non_empty_bin(&core->stat, chunk_bin_size(bin));
 			move_bin_to_q_out(status, core, queue_out, bin_mp_out, bin);
 		}
 	}
 }
 
 /**
- * Try to allocate the given edge
+ * Try to allocate the given edge, given its available timeslots
  * Returns false, if the flow will be handled internally,
  * 		   true, if more backlog remains and should be handled by the caller
  */
 static inline __attribute__((always_inline))
-bool try_allocation(uint16_t src, uint16_t dst, uint16_t backlog,
-		uint32_t metric, struct seq_admission_core_state *core,
+bool try_allocation_with_bitmap(uint16_t src, uint16_t dst, uint16_t backlog,
+		uint32_t metric, uint8_t tclass, uint64_t timeslot_bitmap,
+		struct seq_admission_core_state *core,
 		struct seq_admissible_status *status)
 {
 
     assert(core != NULL);
     assert(status != NULL);
 
-	uint64_t timeslot_bitmap = batch_state_get_avail_bitmap(
-			&core->batch_state, src, dst);
-
     if (timeslot_bitmap == 0ULL) {
     	adm_algo_log_no_available_timeslots_for_bin_entry(&core->stat, src, dst);
     	/* caller should handle allocation of this flow */
@@ -285,47 +442,129 @@ bool try_allocation(uint16_t src, uint16_t dst, uint16_t backlog,
 	// We can allocate this edge now
 	backlog--;
 	batch_state_set_occupied_conditional(&core->batch_state, src, dst, batch_timeslot, set_bit);
-	metric = new_metric_after_alloc(src, dst, metric, batch_timeslot, core, status);
+	metric = new_metric_after_alloc(src, dst, metric, tclass, batch_timeslot,
+			core, status);
 
 	insert_admitted_edge(core->admitted[batch_timeslot], src, dst);
 
 	if (backlog != 0) {
     	adm_log_allocated_backlog_remaining(&core->stat, src, dst, backlog);
-    	uint16_t bin_index = bin_after_alloc(src, dst, metric, batch_timeslot,
-    			core, status);
-		enqueue_bin(core->new_request_bins[bin_index], src, dst, backlog, metric);
-		set_bin_non_empty(core, bin_index);
+    	uint16_t bin_index = bin_after_alloc(src, dst, metric, backlog, tclass,
+    			batch_timeslot, core, status);
+		core_enqueue_to_bin(status, core, bin_index, src, dst, backlog,
+				metric, tclass);
 	} else {
 		adm_log_allocator_no_backlog(&core->stat, src, dst);
 		core_enqueue_to_q_spent(core, status->q_spent, status->bin_mempool,
-				src, dst, metric);
+				src, dst, metric, tclass);
 	}
 
 	return false;
 }
 
+/**
+ * Try to allocate the given edge
+ * Returns false, if the flow will be handled internally,
+ * 		   true, if more backlog remains and should be handled by the caller
+ */
+static inline __attribute__((always_inline))
+bool try_allocation(uint16_t src, uint16_t dst, uint16_t backlog,
+		uint32_t metric, uint8_t tclass, struct seq_admission_core_state *core,
+		struct seq_admissible_status *status)
+{
+	uint64_t timeslot_bitmap = batch_state_get_avail_bitmap(
+			&core->batch_state, src, dst);
+
+	return try_allocation_with_bitmap(src, dst, backlog, metric, tclass,
+			timeslot_bitmap, core, status);
+}
+
+static inline __attribute__((always_inline))
+void try_allocation_edge(struct seq_admission_core_state *core,
+		uint16_t src, uint16_t dst, uint16_t backlog, uint32_t metric,
+		uint8_t tclass, struct fp_ring *queue_out,
+		struct seq_admissible_status *status, struct fp_mempool *bin_mp_out)
+{
+	if (try_allocation(src, dst, backlog, metric, tclass, core, status) == true) {
+		// We cannot allocate this edge now - copy to queue_out
+		core_enqueue_to_q_out(core, queue_out, bin_mp_out,
+				src, dst, backlog, metric, tclass);
+	}
+}
+
+/**
+ * Allocates the first @n_elem edges of a chunk a group at a time: available
+ *   timeslots for the whole group are computed with vector instructions, then
+ *   edges are allocated in order. Edges that share an endpoint with an
+ *   earlier edge of the group re-read their timeslots, so allocations match
+ *   try_allocation().
+ * @returns the number of edges handled
+ */
 static inline __attribute__((always_inline))
-void try_allocation_bin(struct seq_admission_core_state *core, uint64_t bin_index,
+uint32_t try_allocation_chunk_simd(struct seq_admission_core_state *core,
+		struct bin_chunk *chunk, uint32_t n_elem, struct fp_ring *queue_out,
+		struct seq_admissible_status *status, struct fp_mempool *bin_mp_out)
+{
+	uint64_t bitmaps[BATCH_SIMD_MAX_GROUP];
+	enum batch_simd_level level = status->simd_level;
+	uint32_t group_size = batch_simd_group_size(level);
+	uint32_t i, j;
+
+	for (i = 0; i + group_size <= n_elem; i += group_size) {
+		uint32_t conflicts = batch_state_get_avail_bitmaps(level,
+				&core->batch_state, &chunk->src[i], &chunk->dst[i], bitmaps);
+
+		for (j = 0; j < group_size; j++) {
+			uint16_t src = chunk->src[i + j];
+			uint16_t dst = chunk->dst[i + j];
+			uint16_t backlog = chunk->backlog[i + j];
+			uint32_t metric = chunk->metric[i + j];
+			uint8_t tclass = chunk->tclass[i + j];
+			uint64_t timeslot_bitmap = bitmaps[j];
+
+			if (conflicts & (1 << j))
+				timeslot_bitmap = batch_state_get_avail_bitmap(
+						&core->batch_state, src, dst);
+
+			if (try_allocation_with_bitmap(src, dst, backlog, metric, tclass,
+					timeslot_bitmap, core, status) == true) {
+				// We cannot allocate this edge now - copy to queue_out
+				core_enqueue_to_q_out(core, queue_out, bin_mp_out,
+						src, dst, backlog, metric, tclass);
+			}
+		}
+	}
+
+	return i;
+}
+
+static inline __attribute__((always_inline))
+void try_allocation_bin(struct seq_admission_core_state *core, struct chunk_bin *bin,
                     struct fp_ring *queue_out, struct seq_admissible_status *status,
                     struct fp_mempool *bin_mp_out)
 {
-	bool rc;
-    uint32_t i;
-    struct bin *bin = core->new_request_bins[bin_index];
-    uint32_t n_elem = bin_size(bin);
-
-    for (i = 0; i < n_elem; i++) {
-		uint16_t src = bin_get(bin,i)->src;
-		uint16_t dst = bin_get(bin,i)->dst;
-		uint32_t backlog = bin_get(bin, i)->backlog;
-		uint32_t metric = bin_get(bin, i)->metric;
-
-        rc = try_allocation(src, dst, backlog, metric, core, status);
-        if (rc == true) {
-			// We cannot allocate this edge now - copy to queue_out
-			core_enqueue_to_q_out(core, queue_out, bin_mp_out,
-					src, dst, backlog, metric);
-        }
+    struct bin_chunk *chunk = bin->head;
+    uint32_t n_elem = chunk_bin_size(bin);
+    uint32_t i, j, n;
+
+    /* rack bitmaps are not vectorized */
+    bool use_simd = (status->simd_level != BATCH_SIMD_NONE
+    		&& !(SUPPORTS_OVERSUBSCRIPTION && status->oversubscribed));
+
+    for (i = 0; i < n_elem; i += CHUNK_BIN_CHUNK_SIZE, chunk = chunk->next) {
+    	n = n_elem - i;
+    	if (n > CHUNK_BIN_CHUNK_SIZE)
+    		n = CHUNK_BIN_CHUNK_SIZE;
+
+    	j = 0;
+    	if (use_simd)
+    		j = try_allocation_chunk_simd(core, chunk, n, queue_out, status,
+    				bin_mp_out);
+
+    	for (; j < n; j++)
+    		try_allocation_edge(core, chunk->src[j], chunk->dst[j],
+    				chunk->backlog[j], chunk->metric[j], chunk->tclass[j],
+    				queue_out, status, bin_mp_out);
     }
 }
 
@@ -334,9 +573,12 @@ void try_allocation_core(struct seq_admission_core_state *core,
                     struct fp_ring *queue_out, struct seq_admissible_status *status,
                     struct fp_mempool *bin_mp_out)
 {
-	uint32_t bin_mask_ind;
+	uint32_t i, bin_mask_ind;
 
-	for (bin_mask_ind = 0; bin_mask_ind < BIN_MASK_SIZE; bin_mask_ind++) {
+	/* go over the class ranges in this batch's order */
+	for (i = 0; i < status->n_tclass_ranges * BIN_MASK_SIZE; i++) {
+		bin_mask_ind = core->tclass_order[i / BIN_MASK_SIZE] * BIN_MASK_SIZE
+				+ (i % BIN_MASK_SIZE);
 		uint64_t allowed = core->allowed_bins[bin_mask_ind];
 		uint64_t mask = core->non_empty_bins[bin_mask_ind] & allowed;
 		uint64_t bin_index;
@@ -347,11 +589,15 @@ void try_allocation_core(struct seq_admission_core_state *core,
 			core->non_empty_bins[bin_mask_ind] ^= (mask & (-mask));
 			bin_index += 64 * bin_mask_ind;
 
+			/* take the edges out of the bin first: under SJF, an edge with
+			 * backlog left can go back to the bin it came from */
+			struct chunk_bin bin = core->new_request_bins[bin_index];
+			chunk_bin_init(&core->new_request_bins[bin_index]);
+
 			adm_log_processed_core_bin(&core->stat, bin_index,
-					bin_size(core->new_request_bins[bin_index]));
-			try_allocation_bin(core, bin_index,
-					queue_out, status, bin_mp_out);
-			init_bin(core->new_request_bins[bin_index]);
+					chunk_bin_size(&bin));
+			try_allocation_bin(core, &bin, queue_out, status, bin_mp_out);
+			chunk_bin_reset(&bin, &core->chunk_pool);
 
 			/* re-read mask */
 			mask = core->non_empty_bins[bin_mask_ind] & allowed;
@@ -386,6 +632,28 @@ static inline uint32_t process_new_requests(struct seq_admissible_status *status
     return num_entries;
 }
 
+/**
+ * Moves one bin from queue_in into the core's bins, if there is one.
+ * @returns the number of demands moved
+ */
+static inline __attribute__((always_inline))
+uint32_t process_bin_from_q_in(struct seq_admissible_status *status,
+		struct seq_admission_core_state *core, struct fp_ring *queue_in,
+		struct fp_mempool *bin_mp_in)
+{
+	struct bin *bin_in;
+	uint32_t n;
+
+	if (fp_ring_dequeue(queue_in, (void **)&bin_in) != 0)
+		return 0;
+
+	n = bin_size(bin_in);
+	adm_log_dequeued_bin_in(&core->stat, n);
+	incoming_bin_to_core(status, core, bin_in);
+	fp_mempool_put(bin_mp_in, bin_in);
+	return n;
+}
+
 int32_t burst_q_in_to_q_out(struct seq_admission_core_state* core,
 		struct fp_ring* queue_in, struct fp_ring* queue_out)
 {
@@ -402,6 +670,53 @@ int32_t burst_q_in_to_q_out(struct seq_admission_core_state* core,
 	return n;
 }
 
+int seq_claim_batch(struct seq_admissible_status *status, uint32_t core_index)
+{
+	struct seq_admission_core_state *core = &status->cores[core_index];
+	struct seq_admission_core_state *owner = NULL;
+	uint64_t batch = core->current_timeslot;
+	uint64_t offered;
+	uint32_t i;
+
+	if (!status->work_stealing || core->stolen_batch != NO_BATCH)
+		return -1;
+
+	/* the earliest batch offered before this core's own */
+	for (i = 0; i < status->n_cores && i < ALGO_N_CORES; i++) {
+		offered = __atomic_load_n(&status->cores[i].offered_batch,
+				__ATOMIC_ACQUIRE);
+		if (offered < batch) {
+			batch = offered;
+			owner = &status->cores[i];
+		}
+	}
+	if (owner == NULL)
+		return -1;
+
+	/* the ring must be free, or the batch would wait for the batch before it
+	 * in the ring. only the batch's core frees the ring for it */
+	if (__atomic_load_n(&status->queue_next_batch[batch_queue(status, batch)],
+			__ATOMIC_ACQUIRE) != batch)
+		return -1;
+
+	/* the owner withdraws the offer with the same compare-and-swap, so
+	 * exactly one of the two gets the batch */
+	if (!__atomic_compare_exchange_n(&owner->offered_batch, &batch, NO_BATCH,
+			false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		return -1;
+
+	core->stolen_batch = batch;
+	return 0;
+}
+
+uint64_t seq_next_batch(struct seq_admissible_status *status,
+		uint32_t core_index)
+{
+	struct seq_admission_core_state *core = &status->cores[core_index];
+	return (core->stolen_batch != NO_BATCH) ? core->stolen_batch
+			: core->current_timeslot;
+}
+
 // Determine admissible traffic for one timeslot from queue_in
 // Puts unallocated traffic in queue_out
 // Allocate BATCH_SIZE timeslots at once
@@ -412,15 +727,38 @@ void seq_get_admissible_traffic(struct seq_admissible_status *status,
     assert(status != NULL);
 
     struct seq_admission_core_state *core = &status->cores[core_index];
+    uint64_t own_timeslot = core->current_timeslot;
+    uint64_t next_timeslot = own_timeslot + status->n_cores * BATCH_SIZE;
 
-    struct fp_ring *queue_in = status->q_bin[core_index];
-    struct fp_ring *queue_out = status->q_bin[(core_index + 1) % ALGO_N_CORES];
+    /* a batch taken from another core goes before the core's own */
+    if (core->stolen_batch != NO_BATCH) {
+    	core->current_timeslot = core->stolen_batch;
+    	first_timeslot += core->stolen_batch - own_timeslot;
+    }
+
+    uint16_t queue_index = batch_queue(status, core->current_timeslot);
+    struct fp_ring *queue_in = status->q_bin[queue_index];
+    struct fp_ring *queue_out =
+    		status->q_bin[(queue_index + 1) % status->n_queues];
     struct fp_ring *queue_spent = status->q_spent;
     struct fp_mempool *bin_mp_in = status->bin_mempool;
     struct fp_mempool *bin_mp_out = status->bin_mempool;
     struct fp_mempool *bin_mp_spent = status->bin_mempool;
     int32_t n;
 
+    if (status->work_stealing) {
+    	/* wait for the batch that used these rings before */
+    	while (__atomic_load_n(&status->queue_next_batch[queue_index],
+    			__ATOMIC_ACQUIRE) != core->current_timeslot) {
+    		adm_log_wait_for_batch_queue(&core->stat);
+    		fp_pause();
+    	}
+    	/* let an idle core take the next batch while this one runs */
+    	if (core->stolen_batch == NO_BATCH)
+    		__atomic_store_n(&core->offered_batch, next_timeslot,
+    				__ATOMIC_RELEASE);
+    }
+
     // Initialize this core for a new batch of processing
     alloc_core_reset(core, status);
 
@@ -431,10 +769,12 @@ void seq_get_admissible_traffic(struct seq_admissible_status *status,
 
     // Process all bins from previous core, then process all bins from
     // residual backlog from traffic admitted in this batch
-    struct bin *bin_in, *bin_out;
+    struct bin *bin_out;
     uint16_t bin = 0;
     uint16_t processed_bins = 0;
     uint16_t admitted_bins = 0;
+    uint16_t n_ranges = status->n_tclass_ranges;
+    uint16_t n_range_bins = range_bins(status);
 	uint32_t i;
     bool should_process_new_req = false;
     uint64_t n_processed = 0;
@@ -503,16 +843,20 @@ update_allowed:
 		if (slot_gap < 0)
 			goto handle_inputs;
 
+		/* the bins of all class ranges are allowed in the same time as a
+		 * single range */
 		uint16_t new_processed_bins =
-				(slot_gap > TIMESLOTS_START_BEFORE) ? (BATCH_SIZE + NUM_BINS) : (slot_gap >> TIMESLOT_SHIFT_PER_PRIORITY);
+				(slot_gap > TIMESLOTS_START_BEFORE) ? n_ranges * n_range_bins
+						: ((slot_gap * n_ranges * n_range_bins)
+								/ TIMESLOTS_START_BEFORE);
 
 		/* allow more bins to be processed */
 		for (bin = processed_bins; bin < new_processed_bins; bin++)
-			asm("bts %1,%0" : "+m" (*(uint64_t *)&core->allowed_bins[0]) : "r" (bin));
+			set_bin_allowed(core, bin, n_range_bins);
 		processed_bins = new_processed_bins;
 
 handle_inputs:
-		if (unlikely(n_processed >= MAX_DEMANDS_PER_BATCH)) {
+		if (unlikely(n_processed >= MAX_DEMANDS_PER_BATCH(status->n_cores))) {
 			n = burst_q_in_to_q_out(core, queue_in, queue_out);
 			adm_log_passed_bins_during_run(&core->stat, n);
 			goto try_alloc;
@@ -522,13 +866,11 @@ handle_inputs:
 		if (should_process_new_req)
 			n_processed += process_new_requests(status, core, processed_bins - 1);
 
-		/* try to dequeue a bin from queue_in */
-		if (likely(fp_ring_dequeue(queue_in, (void **)&bin_in) == 0))
-		{
-			adm_log_dequeued_bin_in(&core->stat, bin_size(bin_in));
-			n_processed += bin_size(bin_in);
-			incoming_bin_to_core(status, core, bin_in);
-			fp_mempool_put(bin_mp_in, bin_in);
+		/* try to dequeue bins from queue_in */
+		n = 1;
+		for (i = 0; n != 0 && i < Q_IN_BINS_PER_ITERATION(status->num_nodes); i++) {
+			n = process_bin_from_q_in(status, core, queue_in, bin_mp_in);
+			n_processed += n;
 		}
 
 try_alloc:
@@ -552,8 +894,31 @@ wrap_up:
 	/* get unhandled bins, for handing off to next core */
 	n = burst_q_in_to_q_out(core, queue_in, queue_out);
 	adm_log_passed_bins_during_wrap_up(&core->stat, n);
+
+	if (status->work_stealing) {
+		/* the batch n_queues later can use the rings now */
+		__atomic_store_n(&status->queue_next_batch[queue_index],
+				core->current_timeslot + status->n_queues * BATCH_SIZE,
+				__ATOMIC_RELEASE);
+
+		if (core->stolen_batch != NO_BATCH) {
+			adm_log_stole_batch(&core->stat);
+			core->stolen_batch = NO_BATCH;
+			core->current_timeslot = own_timeslot;
+			return;
+		}
+
+		/* withdraw the offer. if another core took the next batch, skip it */
+		uint64_t offered = next_timeslot;
+		if (!__atomic_compare_exchange_n(&core->offered_batch, &offered,
+				NO_BATCH, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			adm_log_gave_batch(&core->stat);
+			next_timeslot += status->n_cores * BATCH_SIZE;
+		}
+	}
+
 	// Update current timeslot
-    core->current_timeslot += ALGO_N_CORES * BATCH_SIZE;
+    core->current_timeslot = next_timeslot;
 }
 
 // Reset state of all flows for which src is the sender
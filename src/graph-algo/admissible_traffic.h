@@ -13,11 +13,24 @@
 
 #include <inttypes.h>
 
-// Increase the backlog from src to dst
-void seq_add_backlog(struct seq_admissible_status *status,
+// Increase the backlog from src to dst. The seq_add_backlog functions return 0
+// on success, -1 if the backlog table has no room for the flow, in which case
+// nothing was added and the demand should be offered again later
+int seq_add_backlog(struct seq_admissible_status *status,
                      uint16_t src, uint16_t dst,
                      uint32_t amount);
 
+// Increase the backlog from src to dst, for a flow of traffic class tclass
+int seq_add_backlog_tclass(struct seq_admissible_status *status,
+                           uint16_t src, uint16_t dst,
+                           uint32_t amount, uint8_t tclass);
+
+// Increase the backlog from src to dst, for demand that should be allocated
+// within deadline timeslots from now (0 for no deadline)
+int seq_add_backlog_deadline(struct seq_admissible_status *status,
+                             uint16_t src, uint16_t dst, uint32_t amount,
+                             uint8_t tclass, uint32_t deadline);
+
 // Flushes the backlog into admissible_status
 void seq_flush_backlog(struct seq_admissible_status *status);
 
@@ -26,6 +39,19 @@ void seq_get_admissible_traffic(struct seq_admissible_status *status,
 				uint32_t core_index, uint64_t first_timeslot,
                                 uint32_t tslot_mul, uint32_t tslot_shift);
 
+/**
+ * Takes the earliest batch another core offers that comes before this core's
+ *   own next batch, if work stealing is on. The core's next
+ *   seq_get_admissible_traffic allocates it, then the core goes on with its
+ *   own batches. Call only between batches of the core.
+ * @returns 0 if the core took a batch, -1 otherwise
+ */
+int seq_claim_batch(struct seq_admissible_status *status, uint32_t core_index);
+
+// Returns the first timeslot of the batch the core allocates next
+uint64_t seq_next_batch(struct seq_admissible_status *status,
+		uint32_t core_index);
+
 // Reset state of all flows for which src is the sender
 void seq_reset_sender(struct seq_admissible_status *status, uint16_t src);
 
@@ -71,20 +97,125 @@ uint16_t bin_index_from_timeslot(uint32_t last_allocated,
 	return BATCH_SIZE - 1 - (bin_gap & (BATCH_SIZE-1));
 }
 
+/**
+ * Returns the bin index of a flow with @backlog timeslots left, for the
+ *   shortest-job-first policy. Each backlog of up to NUM_BINS has its own bin,
+ *   larger backlogs share a bin per power of two.
+ */
+static inline __attribute__((always_inline))
+uint16_t bin_index_from_backlog(uint16_t backlog)
+{
+	uint16_t bin;
+
+	if (backlog <= NUM_BINS)
+		return (backlog == 0) ? 0 : backlog - 1;
+
+	/* backlog - 1 >= NUM_BINS, so its log2 is at least NUM_BINS_SHIFT */
+	bin = NUM_BINS + (31 - __builtin_clz(backlog - 1)) - NUM_BINS_SHIFT;
+	return (bin < NUM_BINS + BATCH_SIZE) ? bin : NUM_BINS + BATCH_SIZE - 1;
+}
+
+/**
+ * Returns the bin index of a flow due before timeslot @deadline, for the
+ *   earliest-deadline-first policy, when allocating a batch that starts with
+ *   @current_timeslot. Flows past their deadline go first, then each of the
+ *   next NUM_BINS / 2 timeslots has its own bin and later deadlines share a
+ *   bin per power of two, NUM_BINS bins in all. Flows without a deadline go
+ *   after these, binned by bin_index_from_timeslot().
+ */
+static inline __attribute__((always_inline))
+uint16_t bin_index_from_deadline(uint32_t deadline, uint64_t current_timeslot)
+{
+	int32_t slack = (int32_t)(deadline - (uint32_t)current_timeslot);
+	uint16_t bin;
+
+	if (slack <= NUM_BINS / 2)
+		return (slack <= 0) ? 0 : slack;
+
+	/* slack - 1 >= NUM_BINS / 2, so its log2 is at least NUM_BINS_SHIFT - 1 */
+	bin = NUM_BINS / 2 + 1 + (31 - __builtin_clz(slack - 1))
+			- (NUM_BINS_SHIFT - 1);
+	return (bin < NUM_BINS) ? bin : NUM_BINS - 1;
+}
+
+// Returns the number of bins in each class range under the status' bin policy
+static inline __attribute__((always_inline))
+uint16_t range_bins(struct seq_admissible_status *status)
+{
+	return (status->bin_policy == BIN_POLICY_EDF) ? EDF_RANGE_BINS
+			: RANGE_BINS;
+}
+
+// Returns the first core bin of the range that holds flows of class tclass
+static inline __attribute__((always_inline))
+uint16_t tclass_bin_base(struct seq_admissible_status *status, uint8_t tclass)
+{
+	tclass &= TCLASS_MASK;
+	if (tclass >= status->n_tclass_ranges)
+		tclass = status->n_tclass_ranges - 1;
+	return tclass * TCLASS_BIN_STRIDE;
+}
+
+/**
+ * Returns the core bin a flow of traffic class @tclass with metric @metric
+ *   and @backlog timeslots left should fit in, under the status' bin policy.
+ *   The metric is the flow's deadline under BIN_POLICY_EDF if @tclass has
+ *   TCLASS_HAS_DEADLINE, and the timeslot it was last allocated otherwise.
+ */
+static inline __attribute__((always_inline))
+uint16_t tclass_bin_index(struct seq_admissible_status *status,
+		uint8_t tclass, uint32_t metric, uint16_t backlog,
+		uint64_t current_timeslot)
+{
+	if (status->bin_policy == BIN_POLICY_SJF)
+		return tclass_bin_base(status, tclass)
+				+ bin_index_from_backlog(backlog);
+	if (status->bin_policy == BIN_POLICY_EDF) {
+		if (tclass & TCLASS_HAS_DEADLINE)
+			return tclass_bin_base(status, tclass)
+					+ bin_index_from_deadline(metric, current_timeslot);
+		return tclass_bin_base(status, tclass) + NUM_BINS
+				+ bin_index_from_timeslot(metric, current_timeslot);
+	}
+
+	return tclass_bin_base(status, tclass)
+			+ bin_index_from_timeslot(metric, current_timeslot);
+}
+
 static inline __attribute__((always_inline))
 uint32_t new_metric_after_alloc(uint16_t src, uint16_t dst, uint32_t old_metric,
-		uint16_t batch_timeslot,
+		uint8_t tclass, uint16_t batch_timeslot,
 		struct seq_admission_core_state *core, struct seq_admissible_status *status)
 {
+	/* the rest of the flow's backlog is due at the same deadline */
+	if (status->bin_policy == BIN_POLICY_EDF && (tclass & TCLASS_HAS_DEADLINE))
+		return old_metric;
 	return core->current_timeslot + batch_timeslot;
 }
 
 static inline __attribute__((always_inline))
 uint32_t bin_after_alloc(uint16_t src, uint16_t dst, uint32_t metric,
-		uint16_t batch_timeslot,
+		uint16_t backlog, uint8_t tclass, uint16_t batch_timeslot,
 		struct seq_admission_core_state *core, struct seq_admissible_status *status)
 {
-	return NUM_BINS + batch_timeslot;
+	if (status->bin_policy == BIN_POLICY_SJF)
+		return tclass_bin_base(status, tclass)
+				+ bin_index_from_backlog(backlog);
+	if (status->bin_policy == BIN_POLICY_EDF) {
+		/* flows that can still make their deadline stay in deadline order.
+		 * late flows and flows without one are spread over the batch as
+		 * under LRU, so a backlog of late flows doesn't take every timeslot
+		 * from the rest */
+		if ((tclass & TCLASS_HAS_DEADLINE)
+				&& (int32_t)(metric - (uint32_t)(core->current_timeslot
+						+ batch_timeslot)) > 0)
+			return tclass_bin_base(status, tclass)
+					+ bin_index_from_deadline(metric, core->current_timeslot);
+		return tclass_bin_base(status, tclass) + NUM_BINS + NUM_BINS
+				+ batch_timeslot;
+	}
+
+	return tclass_bin_base(status, tclass) + NUM_BINS + batch_timeslot;
 }
 
 #endif /* ADMISSIBLE_TRAFFIC_H_ */
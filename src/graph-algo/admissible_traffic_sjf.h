@@ -3,6 +3,10 @@
  *
  *  Created on: January 14, 2013
  *      Author: aousterh
+ *
+ * The original standalone SJF allocator, kept for the python bindings. The
+ * C benchmarks and allocator engines use BIN_POLICY_SJF of the pipelined
+ * allocator instead.
  */
 
 #ifndef ADMISSIBLE_TRAFFIC_SJF_H_
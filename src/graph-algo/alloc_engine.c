@@ -0,0 +1,52 @@
+/*
+ * alloc_engine.c
+ *
+ * The list of allocation engines, and helpers shared by them that need the
+ * common struct admitted_traffic.
+ */
+
+#include "alloc_engine.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "admitted.h"
+#include "fp_ring.h"
+#include "platform.h"
+
+const struct alloc_engine *const alloc_engines[] = {
+	&pipelined_engine,
+	&pim_engine,
+	&islip_engine,
+	&sjf_engine,
+	&maxmin_engine,
+	NULL
+};
+
+const struct alloc_engine *alloc_engine_by_name(const char *name)
+{
+	uint32_t i;
+
+	for (i = 0; alloc_engines[i] != NULL; i++)
+		if (strcmp(alloc_engines[i]->name, name) == 0)
+			return alloc_engines[i];
+	return NULL;
+}
+
+int alloc_engine_output_admitted(struct fp_ring *q_admitted_out,
+		struct fp_mempool *admitted_traffic_mempool,
+		const struct admitted_edge *edges, uint16_t n)
+{
+	struct admitted_traffic *admitted;
+
+	if (fp_mempool_get(admitted_traffic_mempool, (void **) &admitted) != 0)
+		return -1;
+
+	init_admitted_traffic(admitted);
+	memcpy(admitted->edges, edges, n * sizeof(struct admitted_edge));
+	admitted->size = n;
+
+	while (fp_ring_enqueue(q_admitted_out, admitted) == -ENOBUFS)
+		;
+	return 0;
+}
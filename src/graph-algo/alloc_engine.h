@@ -0,0 +1,90 @@
+/*
+ * alloc_engine.h
+ *
+ * A common interface to the allocation engines, so one binary can choose the
+ * engine at startup. Each engine is built in its own translation unit with
+ * the defines it needs (see alloc_engine_*.c), so this header must not depend
+ * on PIPELINED_ALGO, PARALLEL_ALGO or any engine's structures.
+ */
+
+#ifndef ALLOC_ENGINE_H_
+#define ALLOC_ENGINE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct admissible_state;
+struct admitted_edge;
+struct fp_ring;
+struct fp_mempool;
+
+// Parameters for creating an engine's state
+struct alloc_engine_params {
+	uint16_t num_nodes;
+	bool oversubscribed;
+	uint16_t inter_rack_capacity;
+	uint16_t out_of_boundary_capacity;
+	/* the engine enqueues struct admitted_traffic (admitted.h) from
+	 * admitted_traffic_mempool to q_admitted_out; the caller puts them back */
+	struct fp_ring *q_admitted_out;
+	struct fp_mempool *admitted_traffic_mempool;
+};
+
+// An allocation engine. The state is opaque and only passed back to the engine.
+struct alloc_engine {
+	const char *name;
+	uint16_t batch_size;		/* timeslots per get_admissible_traffic */
+	uint16_t admitted_per_batch;	/* admitted_traffic per get_admissible_traffic */
+
+	/**
+	 * Creates the engine's state, with its own internal queues and pools.
+	 * Returns NULL on error.
+	 */
+	struct admissible_state *(*init)(const struct alloc_engine_params *params);
+	/**
+	 * Adds amount timeslots of demand from src to dst, due within deadline
+	 *   timeslots (0 for none). Engines without traffic classes or deadlines
+	 *   ignore them.
+	 * Returns 0 on success, -1 if the engine has no room for the flow. Nothing
+	 *   was added then, and the caller should offer the demand again later.
+	 */
+	int (*add_backlog)(struct admissible_state *state, uint16_t src,
+			uint16_t dst, uint32_t amount, uint8_t tclass, uint32_t deadline);
+	void (*flush_backlog)(struct admissible_state *state);
+	void (*get_admissible_traffic)(struct admissible_state *state,
+			uint32_t core_index, uint64_t first_timeslot, uint32_t tslot_mul,
+			uint32_t tslot_shift);
+	void (*handle_spent)(struct admissible_state *state);
+	void (*reset_sender)(struct admissible_state *state, uint16_t src);
+	/**
+	 * Frees the state, with the queues and pools init created. The caller's
+	 * q_admitted_out and admitted_traffic_mempool are left alone.
+	 */
+	void (*destroy)(struct admissible_state *state);
+};
+
+extern const struct alloc_engine pipelined_engine;
+extern const struct alloc_engine pim_engine;
+extern const struct alloc_engine islip_engine;
+extern const struct alloc_engine sjf_engine;
+extern const struct alloc_engine maxmin_engine;
+
+/* all engines, ending with NULL. the first is the default */
+extern const struct alloc_engine *const alloc_engines[];
+
+/**
+ * Returns the engine called name, or NULL if there is none.
+ */
+const struct alloc_engine *alloc_engine_by_name(const char *name);
+
+/**
+ * Takes an admitted_traffic from admitted_traffic_mempool, fills it with the
+ *   n edges and enqueues it to q_admitted_out. For engines with their own
+ *   admitted_traffic layout.
+ * @returns 0 on success, -1 if the mempool is empty
+ */
+int alloc_engine_output_admitted(struct fp_ring *q_admitted_out,
+		struct fp_mempool *admitted_traffic_mempool,
+		const struct admitted_edge *edges, uint16_t n);
+
+#endif /* ALLOC_ENGINE_H_ */
@@ -0,0 +1,319 @@
+/*
+ * alloc_engine_maxmin.c
+ *
+ * An allocator that converges to max-min fair shares, behind the alloc_engine
+ * interface. At the start of a batch, if flows arrived or finished, or a flow's
+ * backlog went above or below a batch, it recomputes every flow's max-min fair
+ * rate over the backlog (see maxmin.h), capping each flow at its backlog
+ * spread over the batch. Each
+ * timeslot, flows earn their rate in credit and flows with a whole timeslot
+ * of credit are granted first; free endpoints are then filled with any other
+ * backlogged flow, so the allocation stays work-conserving.
+ */
+
+#include "alloc_engine.h"
+
+#include <string.h>
+
+#include "admitted.h"
+#include "batch.h"
+#include "maxmin.h"
+#include "platform.h"
+
+/* credit is bounded, so a flow that was blocked can't burst for long, and a
+ * flow that was backfilled doesn't wait for long */
+#define MAXMIN_MAX_CREDIT		2.0
+
+#define NO_FLOW					(~0U)
+
+struct maxmin_engine_state {
+	uint16_t num_nodes;
+	uint32_t n_flows;
+	uint32_t *flow_index;		/* per src-dst pair, NO_FLOW if not active */
+	struct maxmin_flow *flows;	/* the active flows */
+	uint32_t *backlog;			/* per active flow */
+	double *credit;				/* per active flow */
+	bool rates_stale;			/* demands changed since rates were computed */
+	uint32_t *src_flows;		/* active flows by source, set with the rates */
+	uint32_t src_first[MAX_NODES + 1];	/* of each source's flows in src_flows */
+	uint32_t next_first;		/* rotates where each timeslot starts */
+	uint64_t src_busy[(MAX_NODES + 63) / 64];
+	uint64_t dst_busy[(MAX_NODES + 63) / 64];
+	struct admitted_edge edges[MAX_NODES];
+	struct fp_ring *q_admitted_out;	/* the caller's */
+	struct fp_mempool *admitted_traffic_mempool;
+};
+
+static void maxmin_engine_destroy(struct admissible_state *engine_state)
+{
+	struct maxmin_engine_state *state =
+			(struct maxmin_engine_state *) engine_state;
+
+	fp_free(state->src_flows);
+	fp_free(state->credit);
+	fp_free(state->backlog);
+	fp_free(state->flows);
+	fp_free(state->flow_index);
+	fp_free(state);
+}
+
+static struct admissible_state *
+maxmin_engine_init(const struct alloc_engine_params *params)
+{
+	struct maxmin_engine_state *state;
+	uint32_t n_pairs = (uint32_t) MAX_NODES * MAX_NODES;
+	uint32_t i;
+
+	state = fp_calloc("maxmin_engine_state", 1,
+			sizeof(struct maxmin_engine_state));
+	if (state == NULL)
+		return NULL;
+
+	state->flow_index = fp_malloc("maxmin_flow_index",
+			n_pairs * sizeof(uint32_t));
+	state->flows = fp_malloc("maxmin_flows",
+			n_pairs * sizeof(struct maxmin_flow));
+	state->backlog = fp_malloc("maxmin_backlog", n_pairs * sizeof(uint32_t));
+	state->credit = fp_malloc("maxmin_credit", n_pairs * sizeof(double));
+	state->src_flows = fp_malloc("maxmin_src_flows", n_pairs * sizeof(uint32_t));
+	if (state->flow_index == NULL || state->flows == NULL ||
+	    state->backlog == NULL || state->credit == NULL ||
+	    state->src_flows == NULL)
+		goto cannot_alloc;
+
+	for (i = 0; i < n_pairs; i++)
+		state->flow_index[i] = NO_FLOW;
+
+	/* no rack uplinks, every endpoint link carries a timeslot per timeslot */
+	state->num_nodes = params->num_nodes;
+	state->q_admitted_out = params->q_admitted_out;
+	state->admitted_traffic_mempool = params->admitted_traffic_mempool;
+	return (struct admissible_state *) state;
+
+cannot_alloc:
+	maxmin_engine_destroy((struct admissible_state *) state);
+	return NULL;
+}
+
+/* maxmin has no traffic classes or deadlines */
+static int maxmin_engine_add_backlog(struct admissible_state *engine_state,
+		uint16_t src, uint16_t dst, uint32_t amount, uint8_t tclass,
+		uint32_t deadline)
+{
+	struct maxmin_engine_state *state =
+			(struct maxmin_engine_state *) engine_state;
+	uint32_t *index = &state->flow_index[src * MAX_NODES + dst];
+
+	if (*index == NO_FLOW) {
+		*index = state->n_flows++;
+		state->flows[*index].src = src;
+		state->flows[*index].dst = dst;
+		state->flows[*index].rate = 0;
+		state->backlog[*index] = 0;
+		state->credit[*index] = 0;
+	}
+	/* flows with a batch of backlog or more already have a demand of 1 */
+	if (state->backlog[*index] < BATCH_SIZE)
+		state->rates_stale = true;
+	state->backlog[*index] += amount;
+	return 0;
+}
+
+/* maxmin takes demands into its flow table as they arrive */
+static void maxmin_engine_flush_backlog(struct admissible_state *engine_state)
+{
+}
+
+// Removes the flows with no backlog left
+static void remove_idle_flows(struct maxmin_engine_state *state)
+{
+	uint32_t i = 0;
+
+	while (i < state->n_flows) {
+		struct maxmin_flow *flow = &state->flows[i];
+		uint32_t last = state->n_flows - 1;
+
+		if (state->backlog[i] != 0) {
+			i++;
+			continue;
+		}
+
+		/* move the last flow into this one's place */
+		state->flow_index[flow->src * MAX_NODES + flow->dst] = NO_FLOW;
+		if (i != last) {
+			state->flows[i] = state->flows[last];
+			state->backlog[i] = state->backlog[last];
+			state->credit[i] = state->credit[last];
+			state->flow_index[state->flows[i].src * MAX_NODES
+					+ state->flows[i].dst] = i;
+		}
+		state->n_flows--;
+		state->rates_stale = true;
+	}
+}
+
+// Recomputes the rates, and lists the flows by source. Flows only arrive and
+// leave between batches, and the rates are then stale.
+static void recompute_rates(struct maxmin_engine_state *state)
+{
+	uint32_t next[MAX_NODES];
+	uint32_t i;
+	uint16_t src;
+
+	memset(state->src_first, 0, sizeof(state->src_first));
+	for (i = 0; i < state->n_flows; i++) {
+		double demand = (double) state->backlog[i] / BATCH_SIZE;
+		state->flows[i].demand = (demand < 1.0) ? demand : 1.0;
+		state->src_first[state->flows[i].src + 1]++;
+	}
+	for (src = 0; src < state->num_nodes; src++) {
+		state->src_first[src + 1] += state->src_first[src];
+		next[src] = state->src_first[src];
+	}
+	for (i = 0; i < state->n_flows; i++)
+		state->src_flows[next[state->flows[i].src]++] = i;
+
+	maxmin_fair_rates(state->flows, state->n_flows, state->num_nodes);
+	state->rates_stale = false;
+}
+
+static inline __attribute__((always_inline))
+bool src_free(struct maxmin_engine_state *state, uint16_t src)
+{
+	return !(state->src_busy[src >> 6] & (1ULL << (src & 63)));
+}
+
+static inline __attribute__((always_inline))
+bool endpoints_free(struct maxmin_engine_state *state, uint16_t src,
+		uint16_t dst)
+{
+	return src_free(state, src)
+			&& !(state->dst_busy[dst >> 6] & (1ULL << (dst & 63)));
+}
+
+static inline __attribute__((always_inline))
+void grant(struct maxmin_engine_state *state, uint32_t i, uint16_t *n_edges)
+{
+	struct maxmin_flow *flow = &state->flows[i];
+
+	state->src_busy[flow->src >> 6] |= (1ULL << (flow->src & 63));
+	state->dst_busy[flow->dst >> 6] |= (1ULL << (flow->dst & 63));
+	state->edges[*n_edges].src = flow->src;
+	state->edges[*n_edges].dst = flow->dst;
+	(*n_edges)++;
+
+	if (--state->backlog[i] == BATCH_SIZE - 1)
+		state->rates_stale = true;
+	state->credit[i] -= 1.0;
+	if (state->credit[i] < -MAXMIN_MAX_CREDIT)
+		state->credit[i] = -MAXMIN_MAX_CREDIT;
+}
+
+// Allocates one timeslot into state->edges, returns the number of edges
+static uint16_t allocate_timeslot(struct maxmin_engine_state *state)
+{
+	uint16_t num_nodes = state->num_nodes;
+	uint16_t first_src = state->next_first % num_nodes;
+	uint16_t n_edges = 0;
+	uint16_t k, src;
+	uint32_t i, j, n;
+
+	memset(state->src_busy, 0, sizeof(state->src_busy));
+	memset(state->dst_busy, 0, sizeof(state->dst_busy));
+
+	for (i = 0; i < state->n_flows; i++) {
+		state->credit[i] += state->flows[i].rate;
+		if (state->credit[i] > MAXMIN_MAX_CREDIT)
+			state->credit[i] = MAXMIN_MAX_CREDIT;
+	}
+
+	/* a flow per source that earned a timeslot, then any backlogged flow on
+	 * endpoints left free. sources and each source's flows start from a
+	 * different one every timeslot, so conflicts don't always go the same way */
+	for (k = 0, src = first_src; k < num_nodes;
+			k++, src = (src + 1 < num_nodes) ? src + 1 : 0) {
+		n = state->src_first[src + 1] - state->src_first[src];
+		for (j = 0; j < n; j++) {
+			i = state->src_flows[state->src_first[src]
+					+ (state->next_first + j) % n];
+			if (state->credit[i] >= 1.0 && state->backlog[i] != 0
+					&& endpoints_free(state, src, state->flows[i].dst)) {
+				grant(state, i, &n_edges);
+				break;
+			}
+		}
+	}
+	for (k = 0, src = first_src; k < num_nodes;
+			k++, src = (src + 1 < num_nodes) ? src + 1 : 0) {
+		if (!src_free(state, src))
+			continue;
+		n = state->src_first[src + 1] - state->src_first[src];
+		for (j = 0; j < n; j++) {
+			i = state->src_flows[state->src_first[src]
+					+ (state->next_first + j) % n];
+			if (state->backlog[i] != 0
+					&& endpoints_free(state, src, state->flows[i].dst)) {
+				grant(state, i, &n_edges);
+				break;
+			}
+		}
+	}
+
+	state->next_first++;
+	return n_edges;
+}
+
+static void maxmin_engine_get_admissible_traffic(
+		struct admissible_state *engine_state, uint32_t core_index,
+		uint64_t first_timeslot, uint32_t tslot_mul, uint32_t tslot_shift)
+{
+	struct maxmin_engine_state *state =
+			(struct maxmin_engine_state *) engine_state;
+	uint16_t n_edges;
+	uint32_t t;
+
+	if (state->rates_stale)
+		recompute_rates(state);
+
+	for (t = 0; t < BATCH_SIZE; t++) {
+		n_edges = allocate_timeslot(state);
+		while (alloc_engine_output_admitted(state->q_admitted_out,
+				state->admitted_traffic_mempool, state->edges, n_edges) != 0)
+			;
+	}
+
+	remove_idle_flows(state);
+}
+
+/* maxmin keeps all demand in its flow table, there are no spent demands */
+static void maxmin_engine_handle_spent(struct admissible_state *engine_state)
+{
+}
+
+static void maxmin_engine_reset_sender(struct admissible_state *engine_state,
+		uint16_t src)
+{
+	struct maxmin_engine_state *state =
+			(struct maxmin_engine_state *) engine_state;
+	uint16_t dst;
+
+	for (dst = 0; dst < state->num_nodes; dst++) {
+		uint32_t index = state->flow_index[src * MAX_NODES + dst];
+		if (index != NO_FLOW)
+			state->backlog[index] = 0;
+	}
+	remove_idle_flows(state);
+}
+
+const struct alloc_engine maxmin_engine = {
+	.name = "maxmin",
+	.batch_size = BATCH_SIZE,
+	.admitted_per_batch = BATCH_SIZE,
+	.init = maxmin_engine_init,
+	.add_backlog = maxmin_engine_add_backlog,
+	.flush_backlog = maxmin_engine_flush_backlog,
+	.get_admissible_traffic = maxmin_engine_get_admissible_traffic,
+	.handle_spent = maxmin_engine_handle_spent,
+	.reset_sender = maxmin_engine_reset_sender,
+	.destroy = maxmin_engine_destroy,
+};
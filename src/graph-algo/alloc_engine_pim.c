@@ -0,0 +1,126 @@
+/*
+ * alloc_engine_pim.c
+ *
+ * PIM behind the alloc_engine interface, with random or iSLIP-style
+ * round-robin grants and accepts. Build with PARALLEL_ALGO and
+ * PIM_SINGLE_ADMISSION_CORE, so each get_admissible_traffic allocates a
+ * timeslot in every partition.
+ */
+
+#include "alloc_engine.h"
+
+#include "admissible.h"
+#include "fp_ring.h"
+#include "platform.h"
+
+/* pim holds a bin per partition, and the ones flushed in the last timeslot */
+#define BIN_MEMPOOL_SIZE		(16 * N_PARTITIONS)
+#define BIN_MEMPOOL_CACHE_SIZE	NUM_BINS
+#define READY_PARTITIONS_Q_SIZE	2
+
+/* pim's state, with the queues and pool it was created with */
+struct pim_engine_state {
+	struct pim_state pim; /* first, the engine ops take it as a pim_state */
+	struct fp_ring *q_new_demands[NUM_BIN_RINGS];
+	struct fp_ring *q_ready_partitions[PIM_N_READY_QUEUES];
+	struct fp_mempool *bin_mempool;
+};
+
+static void pim_engine_destroy(struct admissible_state *state)
+{
+	struct pim_engine_state *engine_state = (struct pim_engine_state *) state;
+	uint32_t i;
+
+	pim_free_state(&engine_state->pim);
+	/* bins left in the queues and state are freed with bin_mempool */
+	fp_mempool_destroy(engine_state->bin_mempool);
+	for (i = 0; i < PIM_N_READY_QUEUES; i++)
+		fp_ring_destroy(engine_state->q_ready_partitions[i]);
+	for (i = 0; i < NUM_BIN_RINGS; i++)
+		fp_ring_destroy(engine_state->q_new_demands[i]);
+	fp_free(engine_state);
+}
+
+static struct admissible_state *
+pim_engine_init(const struct alloc_engine_params *params)
+{
+	struct pim_engine_state *engine_state;
+	uint32_t i;
+
+	engine_state = fp_calloc("pim_engine_state", 1,
+			sizeof(struct pim_engine_state));
+	if (engine_state == NULL)
+		return NULL;
+
+	for (i = 0; i < NUM_BIN_RINGS; i++) {
+		engine_state->q_new_demands[i] = fp_ring_create(BIN_RING_SHIFT);
+		if (engine_state->q_new_demands[i] == NULL)
+			goto cannot_alloc;
+	}
+	for (i = 0; i < PIM_N_READY_QUEUES; i++) {
+		engine_state->q_ready_partitions[i] =
+				fp_ring_create(READY_PARTITIONS_Q_SIZE);
+		if (engine_state->q_ready_partitions[i] == NULL)
+			goto cannot_alloc;
+	}
+	engine_state->bin_mempool = fp_mempool_create(BIN_MEMPOOL_SIZE,
+			bin_num_bytes(SMALL_BIN_SIZE), BIN_MEMPOOL_CACHE_SIZE);
+	if (engine_state->bin_mempool == NULL)
+		goto cannot_alloc;
+
+	/* pim allocates among all MAX_NODES nodes, and has no rack uplinks */
+	if (pim_init_state(&engine_state->pim, PARTITION_N_NODES,
+			&engine_state->q_new_demands[0], params->q_admitted_out,
+			engine_state->bin_mempool, params->admitted_traffic_mempool,
+			&engine_state->q_ready_partitions[0]) != 0)
+		goto cannot_alloc;
+	return (struct admissible_state *) engine_state;
+
+cannot_alloc:
+	pim_engine_destroy((struct admissible_state *) engine_state);
+	return NULL;
+}
+
+/* the same, with iSLIP-style round-robin grants and accepts */
+static struct admissible_state *
+islip_engine_init(const struct alloc_engine_params *params)
+{
+	struct admissible_state *state = pim_engine_init(params);
+
+	if (state != NULL)
+		pim_set_policy((struct pim_state *) state, PIM_POLICY_ISLIP);
+	return state;
+}
+
+static int pim_engine_add_backlog(struct admissible_state *state,
+		uint16_t src, uint16_t dst, uint32_t amount, uint8_t tclass,
+		uint32_t deadline)
+{
+	return add_backlog_deadline(state, src, dst, amount, tclass, deadline);
+}
+
+const struct alloc_engine pim_engine = {
+	.name = "pim",
+	.batch_size = BATCH_SIZE,
+	.admitted_per_batch = ADMITTED_PER_BATCH,
+	.init = pim_engine_init,
+	.add_backlog = pim_engine_add_backlog,
+	.flush_backlog = flush_backlog,
+	.get_admissible_traffic = get_admissible_traffic,
+	.handle_spent = handle_spent_demands,
+	.reset_sender = reset_sender,
+	.destroy = pim_engine_destroy,
+};
+
+const struct alloc_engine islip_engine = {
+	.name = "islip",
+	.batch_size = BATCH_SIZE,
+	.admitted_per_batch = ADMITTED_PER_BATCH,
+	.init = islip_engine_init,
+	.add_backlog = pim_engine_add_backlog,
+	.flush_backlog = flush_backlog,
+	.get_admissible_traffic = get_admissible_traffic,
+	.handle_spent = handle_spent_demands,
+	.reset_sender = reset_sender,
+	.destroy = pim_engine_destroy,
+};
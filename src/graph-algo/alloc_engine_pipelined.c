@@ -0,0 +1,127 @@
+/*
+ * alloc_engine_pipelined.c
+ *
+ * The pipelined allocator behind the alloc_engine interface, as two engines:
+ * one allocating flows least recently allocated first, one shortest remaining
+ * backlog first. Build with PIPELINED_ALGO. Allocates on a single admission
+ * core.
+ */
+
+#include "alloc_engine.h"
+
+#include <string.h>
+
+#include "admissible.h"
+#include "fp_ring.h"
+#include "platform.h"
+
+#define BIN_MEMPOOL_SIZE		(2 * LARGE_BIN_SIZE / SMALL_BIN_SIZE)
+#define BIN_MEMPOOL_CACHE_SIZE	NUM_BINS
+#define BIN_RING_LOG_SIZE		16 /* must hold BIN_MEMPOOL_SIZE bins */
+
+static struct admissible_state *
+pipelined_engine_init(const struct alloc_engine_params *params)
+{
+	struct admissible_state *status;
+	struct fp_ring *q_bin[Q_BIN_RINGS] = {NULL};
+	struct fp_ring *q_head = NULL;
+	struct fp_ring *q_spent = NULL;
+	struct fp_mempool *bin_mempool = NULL;
+	uint32_t i;
+
+	for (i = 0; i < Q_BIN_RINGS; i++) {
+		q_bin[i] = fp_ring_create_flags(BIN_RING_LOG_SIZE,
+				FP_RING_F_SP_ENQ | FP_RING_F_SC_DEQ);
+		if (q_bin[i] == NULL)
+			goto cannot_alloc;
+	}
+	q_head = fp_ring_create(BIN_RING_LOG_SIZE);
+	q_spent = fp_ring_create(BIN_RING_LOG_SIZE);
+	bin_mempool = fp_mempool_create(BIN_MEMPOOL_SIZE,
+			bin_num_bytes(SMALL_BIN_SIZE), BIN_MEMPOOL_CACHE_SIZE);
+	if (q_head == NULL || q_spent == NULL || bin_mempool == NULL)
+		goto cannot_alloc;
+
+	status = create_admissible_state(params->oversubscribed,
+			params->inter_rack_capacity, params->out_of_boundary_capacity,
+			params->num_nodes, q_head, params->q_admitted_out, q_spent,
+			bin_mempool, params->admitted_traffic_mempool, &q_bin[0], NULL,
+			NULL);
+	if (status == NULL)
+		goto cannot_alloc;
+
+	set_admission_n_cores(status, 1);
+	return status;
+
+cannot_alloc:
+	fp_mempool_destroy(bin_mempool);
+	fp_ring_destroy(q_spent);
+	fp_ring_destroy(q_head);
+	for (i = 0; i < Q_BIN_RINGS; i++)
+		fp_ring_destroy(q_bin[i]);
+	return NULL;
+}
+
+static struct admissible_state *
+sjf_engine_init(const struct alloc_engine_params *params)
+{
+	struct admissible_state *status = pipelined_engine_init(params);
+
+	if (status != NULL)
+		set_admission_bin_policy(status, BIN_POLICY_SJF);
+	return status;
+}
+
+static void pipelined_engine_destroy(struct admissible_state *state)
+{
+	struct seq_admissible_status *status =
+			(struct seq_admissible_status *) state;
+	struct fp_mempool *bin_mempool = status->bin_mempool;
+	struct fp_ring *q_head = status->q_head;
+	struct fp_ring *q_spent = status->q_spent;
+	struct fp_ring *q_bin[Q_BIN_RINGS];
+	uint32_t i;
+
+	memcpy(q_bin, status->q_bin, sizeof(q_bin));
+	seq_destroy_admissible_status(status);
+
+	/* bins left in the queues are freed with bin_mempool */
+	fp_mempool_destroy(bin_mempool);
+	fp_ring_destroy(q_spent);
+	fp_ring_destroy(q_head);
+	for (i = 0; i < Q_BIN_RINGS; i++)
+		fp_ring_destroy(q_bin[i]);
+}
+
+static int pipelined_engine_add_backlog(struct admissible_state *state,
+		uint16_t src, uint16_t dst, uint32_t amount, uint8_t tclass,
+		uint32_t deadline)
+{
+	return add_backlog_deadline(state, src, dst, amount, tclass, deadline);
+}
+
+const struct alloc_engine pipelined_engine = {
+	.name = "pipelined",
+	.batch_size = BATCH_SIZE,
+	.admitted_per_batch = ADMITTED_PER_BATCH,
+	.init = pipelined_engine_init,
+	.add_backlog = pipelined_engine_add_backlog,
+	.flush_backlog = flush_backlog,
+	.get_admissible_traffic = get_admissible_traffic,
+	.handle_spent = handle_spent_demands,
+	.reset_sender = reset_sender,
+	.destroy = pipelined_engine_destroy,
+};
+
+const struct alloc_engine sjf_engine = {
+	.name = "sjf",
+	.batch_size = BATCH_SIZE,
+	.admitted_per_batch = ADMITTED_PER_BATCH,
+	.init = sjf_engine_init,
+	.add_backlog = pipelined_engine_add_backlog,
+	.flush_backlog = flush_backlog,
+	.get_admissible_traffic = get_admissible_traffic,
+	.handle_spent = handle_spent_demands,
+	.reset_sender = reset_sender,
+	.destroy = pipelined_engine_destroy,
+};
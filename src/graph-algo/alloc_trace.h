@@ -0,0 +1,404 @@
+/*
+ * alloc_trace.h
+ *
+ * Binary traces of allocator input and output, for replaying an arbiter's
+ * workload offline (see replay_trace.c).
+ *
+ * A trace is a header followed by records, each starting with a one-byte
+ * type. Timeslot records set the clock for the records that follow them and
+ * are written only when the clock changes, so a busy trace is mostly demand
+ * and admitted records. All fields are in host byte order.
+ *
+ * The arbiter's comm core does not write the file itself: it encodes records
+ * into a preallocated ring (struct alloc_trace_buf), which the log core
+ * drains to the file.
+ */
+
+#ifndef ALLOC_TRACE_H_
+#define ALLOC_TRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "admitted.h"
+
+#define ALLOC_TRACE_MAGIC		"FPTRACE1"
+#define ALLOC_TRACE_VERSION		2
+/* version 1 traces have no deadlines in demand records, and still replay */
+#define ALLOC_TRACE_VERSION_NO_DEADLINE	1
+
+/* bytes in the ring between the comm core and the log core */
+#ifndef ALLOC_TRACE_BUF_SHIFT
+#define ALLOC_TRACE_BUF_SHIFT	24
+#endif
+#define ALLOC_TRACE_BUF_SIZE	(1ULL << ALLOC_TRACE_BUF_SHIFT)
+#define ALLOC_TRACE_BUF_MASK	(ALLOC_TRACE_BUF_SIZE - 1)
+
+enum alloc_trace_record_type {
+	ALLOC_TRACE_TIMESLOT = 1,	/* u64 timeslot */
+	ALLOC_TRACE_DEMAND = 2,		/* u8 tclass, u16 src, u16 dst, u32 amount,
+					   u16 deadline */
+	ALLOC_TRACE_ADMITTED = 3,	/* u8 partition, u16 n, n x (u16 src, u16 dst) */
+};
+
+struct alloc_trace_header {
+	char magic[8];
+	uint16_t version;
+	uint16_t num_nodes;
+	uint16_t batch_size;
+	uint16_t reserved;
+	uint64_t first_timeslot;
+} __attribute__((packed));
+
+// A demand increase, as passed to add_backlog
+struct alloc_trace_demand {
+	uint16_t src;
+	uint16_t dst;
+	uint32_t amount;
+	uint8_t tclass;
+	uint16_t deadline;	/* timeslots from the demand's timeslot, 0 for none */
+};
+
+// One record read from a trace. For admitted records, edges points into the
+// trace's buffer and is valid until the next read.
+struct alloc_trace_record {
+	uint8_t type;
+	uint64_t timeslot;
+	struct alloc_trace_demand demand;
+	uint8_t partition;
+	uint16_t n_edges;
+	struct admitted_edge *edges;
+};
+
+// An open trace, either for writing or for reading
+struct alloc_trace {
+	FILE *f;
+	struct alloc_trace_header header;
+	uint64_t timeslot;	/* clock of the last record written or read */
+	struct admitted_edge edges[MAX_NODES];
+};
+
+/**
+ * Trace records waiting to be written, a single-producer single-consumer ring
+ *   of bytes in the trace format
+ *    head: bytes written by the producer, only it updates head
+ *    tail: bytes written out by the consumer, only it updates tail
+ *    timeslot: clock of the last record the producer wrote
+ *    lost_records: records the producer dropped because the ring was full
+ */
+struct alloc_trace_buf {
+	uint64_t head;
+	uint64_t tail;
+	uint64_t timeslot;
+	uint64_t lost_records;
+	uint8_t data[ALLOC_TRACE_BUF_SIZE];
+};
+
+static inline int _alloc_trace_write(struct alloc_trace *trace, const void *buf,
+		size_t len)
+{
+	return (fwrite(buf, len, 1, trace->f) == 1) ? 0 : -1;
+}
+
+static inline int _alloc_trace_read(struct alloc_trace *trace, void *buf,
+		size_t len)
+{
+	return (fread(buf, len, 1, trace->f) == 1) ? 0 : -1;
+}
+
+// Writes a timeslot record if the clock moved. Returns 0 on success.
+static inline int _alloc_trace_set_timeslot(struct alloc_trace *trace,
+		uint64_t timeslot)
+{
+	uint8_t type = ALLOC_TRACE_TIMESLOT;
+
+	if (timeslot == trace->timeslot)
+		return 0;
+	trace->timeslot = timeslot;
+	if (_alloc_trace_write(trace, &type, sizeof(type)) != 0)
+		return -1;
+	return _alloc_trace_write(trace, &timeslot, sizeof(timeslot));
+}
+
+/**
+ * Creates the trace file at path and writes its header. Returns 0 on success,
+ * -1 if the file could not be written.
+ */
+static inline int alloc_trace_open_write(struct alloc_trace *trace,
+		const char *path, uint16_t num_nodes, uint16_t batch_size,
+		uint64_t first_timeslot)
+{
+	trace->f = fopen(path, "wb");
+	if (trace->f == NULL)
+		return -1;
+
+	memset(&trace->header, 0, sizeof(trace->header));
+	memcpy(trace->header.magic, ALLOC_TRACE_MAGIC, sizeof(trace->header.magic));
+	trace->header.version = ALLOC_TRACE_VERSION;
+	trace->header.num_nodes = num_nodes;
+	trace->header.batch_size = batch_size;
+	trace->header.first_timeslot = first_timeslot;
+	trace->timeslot = first_timeslot;
+
+	if (_alloc_trace_write(trace, &trace->header, sizeof(trace->header)) != 0) {
+		fclose(trace->f);
+		trace->f = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Opens the trace file at path and checks its header. Returns 0 on success,
+ * -1 if the file could not be read or is not a trace.
+ */
+static inline int alloc_trace_open_read(struct alloc_trace *trace,
+		const char *path)
+{
+	trace->f = fopen(path, "rb");
+	if (trace->f == NULL)
+		return -1;
+
+	if (_alloc_trace_read(trace, &trace->header, sizeof(trace->header)) != 0 ||
+	    memcmp(trace->header.magic, ALLOC_TRACE_MAGIC,
+	           sizeof(trace->header.magic)) != 0 ||
+	    (trace->header.version != ALLOC_TRACE_VERSION &&
+	     trace->header.version != ALLOC_TRACE_VERSION_NO_DEADLINE)) {
+		fclose(trace->f);
+		trace->f = NULL;
+		return -1;
+	}
+	trace->timeslot = trace->header.first_timeslot;
+	return 0;
+}
+
+// Records a demand increase of amount from src to dst at timeslot
+static inline int alloc_trace_write_demand(struct alloc_trace *trace,
+		uint64_t timeslot, uint16_t src, uint16_t dst, uint32_t amount,
+		uint8_t tclass, uint16_t deadline)
+{
+	uint8_t type = ALLOC_TRACE_DEMAND;
+
+	if (_alloc_trace_set_timeslot(trace, timeslot) != 0 ||
+	    _alloc_trace_write(trace, &type, sizeof(type)) != 0 ||
+	    _alloc_trace_write(trace, &tclass, sizeof(tclass)) != 0 ||
+	    _alloc_trace_write(trace, &src, sizeof(src)) != 0 ||
+	    _alloc_trace_write(trace, &dst, sizeof(dst)) != 0 ||
+	    _alloc_trace_write(trace, &amount, sizeof(amount)) != 0 ||
+	    _alloc_trace_write(trace, &deadline, sizeof(deadline)) != 0)
+		return -1;
+	return 0;
+}
+
+// Records the traffic admitted in timeslot
+static inline int alloc_trace_write_admitted(struct alloc_trace *trace,
+		uint64_t timeslot, struct admitted_traffic *admitted)
+{
+	uint8_t type = ALLOC_TRACE_ADMITTED;
+	uint8_t partition = get_admitted_partition(admitted);
+	uint16_t n = admitted->size;
+
+	if (_alloc_trace_set_timeslot(trace, timeslot) != 0 ||
+	    _alloc_trace_write(trace, &type, sizeof(type)) != 0 ||
+	    _alloc_trace_write(trace, &partition, sizeof(partition)) != 0 ||
+	    _alloc_trace_write(trace, &n, sizeof(n)) != 0 ||
+	    (n > 0 && _alloc_trace_write(trace, admitted->edges,
+	                                 n * sizeof(struct admitted_edge)) != 0))
+		return -1;
+	return 0;
+}
+
+static inline void alloc_trace_buf_init(struct alloc_trace_buf *buf,
+		uint64_t first_timeslot)
+{
+	buf->head = 0;
+	buf->tail = 0;
+	buf->timeslot = first_timeslot;
+	buf->lost_records = 0;
+}
+
+/**
+ * Internal. Makes room for @len bytes of records, plus a timeslot record if
+ *   the clock moved. Returns the position to write at, or ~0ULL if the ring is
+ *   too full, in which case the record is lost.
+ */
+static inline uint64_t _alloc_trace_buf_reserve(struct alloc_trace_buf *buf,
+		uint64_t timeslot, uint32_t len)
+{
+	uint64_t tail = __atomic_load_n(&buf->tail, __ATOMIC_ACQUIRE);
+
+	if (timeslot != buf->timeslot)
+		len += sizeof(uint8_t) + sizeof(uint64_t);
+	if (buf->head + len - tail > ALLOC_TRACE_BUF_SIZE) {
+		buf->lost_records++;
+		return ~0ULL;
+	}
+	return buf->head;
+}
+
+// Internal. Copies @len bytes to the ring at @pos, returns the next position
+static inline uint64_t _alloc_trace_buf_put(struct alloc_trace_buf *buf,
+		uint64_t pos, const void *src, uint32_t len)
+{
+	const uint8_t *bytes = (const uint8_t *) src;
+	uint64_t offset = pos & ALLOC_TRACE_BUF_MASK;
+	uint32_t first = len;
+
+	if (first > ALLOC_TRACE_BUF_SIZE - offset)
+		first = ALLOC_TRACE_BUF_SIZE - offset;
+	memcpy(&buf->data[offset], bytes, first);
+	memcpy(&buf->data[0], bytes + first, len - first);
+	return pos + len;
+}
+
+// Internal. Writes a timeslot record at @pos if the clock moved
+static inline uint64_t _alloc_trace_buf_set_timeslot(
+		struct alloc_trace_buf *buf, uint64_t pos, uint64_t timeslot)
+{
+	uint8_t type = ALLOC_TRACE_TIMESLOT;
+
+	if (timeslot == buf->timeslot)
+		return pos;
+	buf->timeslot = timeslot;
+	pos = _alloc_trace_buf_put(buf, pos, &type, sizeof(type));
+	return _alloc_trace_buf_put(buf, pos, &timeslot, sizeof(timeslot));
+}
+
+/**
+ * Queues a demand record, like alloc_trace_write_demand. Never blocks.
+ * @returns 0 on success, -1 if the ring was full and the record was lost
+ */
+static inline int alloc_trace_buf_write_demand(struct alloc_trace_buf *buf,
+		uint64_t timeslot, uint16_t src, uint16_t dst, uint32_t amount,
+		uint8_t tclass, uint16_t deadline)
+{
+	uint8_t type = ALLOC_TRACE_DEMAND;
+	uint64_t pos = _alloc_trace_buf_reserve(buf, timeslot,
+			sizeof(type) + sizeof(tclass) + sizeof(src) + sizeof(dst)
+			+ sizeof(amount) + sizeof(deadline));
+
+	if (pos == ~0ULL)
+		return -1;
+	pos = _alloc_trace_buf_set_timeslot(buf, pos, timeslot);
+	pos = _alloc_trace_buf_put(buf, pos, &type, sizeof(type));
+	pos = _alloc_trace_buf_put(buf, pos, &tclass, sizeof(tclass));
+	pos = _alloc_trace_buf_put(buf, pos, &src, sizeof(src));
+	pos = _alloc_trace_buf_put(buf, pos, &dst, sizeof(dst));
+	pos = _alloc_trace_buf_put(buf, pos, &amount, sizeof(amount));
+	pos = _alloc_trace_buf_put(buf, pos, &deadline, sizeof(deadline));
+	__atomic_store_n(&buf->head, pos, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/**
+ * Queues an admitted record, like alloc_trace_write_admitted. Never blocks.
+ * @returns 0 on success, -1 if the ring was full and the record was lost
+ */
+static inline int alloc_trace_buf_write_admitted(struct alloc_trace_buf *buf,
+		uint64_t timeslot, struct admitted_traffic *admitted)
+{
+	uint8_t type = ALLOC_TRACE_ADMITTED;
+	uint8_t partition = get_admitted_partition(admitted);
+	uint16_t n = admitted->size;
+	uint64_t pos = _alloc_trace_buf_reserve(buf, timeslot,
+			sizeof(type) + sizeof(partition) + sizeof(n)
+			+ n * sizeof(struct admitted_edge));
+
+	if (pos == ~0ULL)
+		return -1;
+	pos = _alloc_trace_buf_set_timeslot(buf, pos, timeslot);
+	pos = _alloc_trace_buf_put(buf, pos, &type, sizeof(type));
+	pos = _alloc_trace_buf_put(buf, pos, &partition, sizeof(partition));
+	pos = _alloc_trace_buf_put(buf, pos, &n, sizeof(n));
+	pos = _alloc_trace_buf_put(buf, pos, admitted->edges,
+			n * sizeof(struct admitted_edge));
+	__atomic_store_n(&buf->head, pos, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/**
+ * Writes the records queued in @buf to the trace, from the consumer thread.
+ *   The trace must have been opened with the same first timeslot as @buf.
+ * @returns 0 on success, -1 if the file could not be written
+ */
+static inline int alloc_trace_drain(struct alloc_trace *trace,
+		struct alloc_trace_buf *buf)
+{
+	uint64_t head = __atomic_load_n(&buf->head, __ATOMIC_ACQUIRE);
+	uint64_t tail = buf->tail;
+
+	while (tail != head) {
+		uint64_t offset = tail & ALLOC_TRACE_BUF_MASK;
+		uint64_t len = head - tail;
+		if (len > ALLOC_TRACE_BUF_SIZE - offset)
+			len = ALLOC_TRACE_BUF_SIZE - offset;
+		if (_alloc_trace_write(trace, &buf->data[offset], len) != 0)
+			return -1;
+		tail += len;
+		__atomic_store_n(&buf->tail, tail, __ATOMIC_RELEASE);
+	}
+	return 0;
+}
+
+/**
+ * Reads the next demand or admitted record into rec, consuming any timeslot
+ * records before it. Returns 1 if a record was read, 0 at the end of the
+ * trace and -1 if the trace is corrupt.
+ */
+static inline int alloc_trace_read_record(struct alloc_trace *trace,
+		struct alloc_trace_record *rec)
+{
+	uint8_t type;
+
+	while (_alloc_trace_read(trace, &type, sizeof(type)) == 0) {
+		rec->type = type;
+		switch (type) {
+		case ALLOC_TRACE_TIMESLOT:
+			if (_alloc_trace_read(trace, &trace->timeslot,
+			                      sizeof(trace->timeslot)) != 0)
+				return -1;
+			continue;
+		case ALLOC_TRACE_DEMAND:
+			rec->timeslot = trace->timeslot;
+			if (_alloc_trace_read(trace, &rec->demand.tclass, sizeof(uint8_t)) != 0 ||
+			    _alloc_trace_read(trace, &rec->demand.src, sizeof(uint16_t)) != 0 ||
+			    _alloc_trace_read(trace, &rec->demand.dst, sizeof(uint16_t)) != 0 ||
+			    _alloc_trace_read(trace, &rec->demand.amount, sizeof(uint32_t)) != 0)
+				return -1;
+			rec->demand.deadline = 0;
+			if (trace->header.version != ALLOC_TRACE_VERSION_NO_DEADLINE &&
+			    _alloc_trace_read(trace, &rec->demand.deadline, sizeof(uint16_t)) != 0)
+				return -1;
+			return 1;
+		case ALLOC_TRACE_ADMITTED:
+			rec->timeslot = trace->timeslot;
+			if (_alloc_trace_read(trace, &rec->partition, sizeof(uint8_t)) != 0 ||
+			    _alloc_trace_read(trace, &rec->n_edges, sizeof(uint16_t)) != 0 ||
+			    rec->n_edges > MAX_NODES ||
+			    (rec->n_edges > 0 &&
+			     _alloc_trace_read(trace, trace->edges,
+			                       rec->n_edges * sizeof(struct admitted_edge)) != 0))
+				return -1;
+			rec->edges = trace->edges;
+			return 1;
+		default:
+			return -1;
+		}
+	}
+	return feof(trace->f) ? 0 : -1;
+}
+
+static inline int alloc_trace_flush(struct alloc_trace *trace)
+{
+	return (fflush(trace->f) == 0) ? 0 : -1;
+}
+
+static inline int alloc_trace_close(struct alloc_trace *trace)
+{
+	int ret = (fclose(trace->f) == 0) ? 0 : -1;
+	trace->f = NULL;
+	return ret;
+}
+
+#endif /* ALLOC_TRACE_H_ */
@@ -12,43 +12,411 @@
 #include "admissible_algo_log.h"
 #include "../protocol/topology.h"
 #include "bitasm.h"
+#include "platform.h"
 
 #include <assert.h>
 
 /**
- * Keeps backlogs between every source and destination
- *    n: the backlog for each pair
+ * BACKLOG_SPARSE: selects the layout of the backlog table at compile time.
+ *   0: a dense table with an entry for every (src,dst) pair, indexed by the
+ *      pair. Lookups take no probing and never fail. Default up to 256 nodes,
+ *      where the table is at most 1MB.
+ *   1: an open-addressing hash table with linear probing. Only pairs that
+ *      have had demand recently occupy an entry, so memory scales with the
+ *      number of active flows rather than MAX_NODES^2. Default for larger
+ *      clusters, where a dense table would not fit in cache (256MB at 4096
+ *      nodes).
+ *
+ * BACKLOG_TABLE_SHIFT: log2 of the number of entries. The sparse table is
+ *   sized for an average of 256 concurrently active flows per node.
+ * BACKLOG_MAX_FLOWS: max number of entries in use. The sparse table is kept
+ *   at 3/4 of its size, to keep probe sequences short.
+ * BACKLOG_EXPIRY_HORIZON: idle entries whose last allocation is older than
+ *   this many timeslots are removed. Flows that old all fall into the oldest
+ *   allocation bin anyway, so forgetting them does not change the order in
+ *   which flows are served.
+ * BACKLOG_EXPIRE_SCAN_PER_INSERT: slots swept for expired entries on every
+ *   insertion, so the sweep keeps pace with the rate new flows appear.
+ * BACKLOG_PREFETCH_OFFSET: default for how many edges ahead loops over bins
+ *   prefetch the entries they will look up. The table outgrows L2 from 256
+ *   nodes, so without prefetching most lookups are cache misses.
+ *
+ * Ownership (sparse table): a single thread inserts entries and removes
+ *   expired ones. The sequential allocators touch the table only from that
+ *   thread. In a shared table (backlog_init_shared, used by pim), admission
+ *   cores also look up entries concurrently, so entries are never expired
+ *   there: keys are published only once an entry is initialized, and an
+ *   entry never moves after that, so a concurrent probe either finds it or
+ *   stops at an empty slot. Entries of the dense table never move either.
+ */
+#ifndef BACKLOG_SPARSE
+#if (FP_NODES_SHIFT <= 8)
+#define BACKLOG_SPARSE			0
+#else
+#define BACKLOG_SPARSE			1
+#endif
+#endif
+
+#if BACKLOG_SPARSE
+#ifndef BACKLOG_TABLE_SHIFT
+#define BACKLOG_TABLE_SHIFT		(FP_NODES_SHIFT + 8)
+#endif
+#define BACKLOG_TABLE_SIZE		(1UL << BACKLOG_TABLE_SHIFT)
+#define BACKLOG_MAX_FLOWS		(BACKLOG_TABLE_SIZE - (BACKLOG_TABLE_SIZE >> 2))
+#else
+#define BACKLOG_TABLE_SHIFT		(2 * FP_NODES_SHIFT)
+#define BACKLOG_TABLE_SIZE		(1UL << BACKLOG_TABLE_SHIFT)
+#define BACKLOG_MAX_FLOWS		BACKLOG_TABLE_SIZE
+#endif
+#define BACKLOG_TABLE_MASK		(BACKLOG_TABLE_SIZE - 1)
+
+#ifndef BACKLOG_EXPIRY_HORIZON
+#define BACKLOG_EXPIRY_HORIZON	1024
+#endif
+#define BACKLOG_EXPIRE_SCAN_PER_INSERT	8
+
+#ifndef BACKLOG_PREFETCH_OFFSET
+#define BACKLOG_PREFETCH_OFFSET	8
+#endif
+
+#define BACKLOG_EMPTY_KEY		(~0U)
+
+/**
+ * Deadlines are kept as the low 16 bits of the timeslot they are due, like
+ *   A-REQs carry them, with BACKLOG_NO_DEADLINE reserved for none. They are
+ *   compared and expanded relative to a timeslot close to them, so they must
+ *   be at most BACKLOG_MAX_DEADLINE timeslots away from it.
+ */
+#define BACKLOG_NO_DEADLINE		0
+#define BACKLOG_MAX_DEADLINE	((1 << 15) - 1)
+
+/* outcome of adding backlog to a pair */
+enum backlog_increase_result {
+	BACKLOG_INCREASED,		/* added to backlog the pair already had */
+	BACKLOG_NEWLY_ACTIVE,	/* the pair had no backlog before, the caller
+							   should hand it to the allocator */
+	BACKLOG_TABLE_FULL,		/* no entry for the pair, nothing was added */
+};
+
+/**
+ * State kept for one src-dst pair
+ *    key: (src << FP_NODES_SHIFT) + dst, or BACKLOG_EMPTY_KEY if unused
+ *    n: backlog that has not yet been handed to the allocator
+ *    last_alloc: timeslot of the most recent allocation to the pair
+ *    is_active: non-zero while the pair's demand is held by the allocator
+ *    tclass: traffic class of the pair's most recent demand
+ *    deadline: earliest deadline of the backlog in n, or BACKLOG_NO_DEADLINE
+ *
+ * Entries are 16 bytes, so four share a cache line.
+ */
+struct backlog_entry {
+	uint32_t key;
+	uint32_t n;
+	uint32_t last_alloc;
+	uint16_t deadline;
+	uint8_t is_active;
+	uint8_t tclass;
+};
+
+/**
+ * Keeps backlogs and allocation history for active source/destination pairs
+ *    n_entries: number of used entries in the table
+ *    latest_alloc: most recent last_alloc written, used as the clock for expiry
+ *    expire_cursor: where the incremental expiry sweep will continue from
+ *    shared: non-zero if other threads look up entries, disables expiry
  */
 struct backlog {
-	uint32_t n[MAX_NODES * MAX_NODES];
-	uint64_t is_active[(MAX_NODES * MAX_NODES + 63) / 64];
+	uint32_t n_entries;
+	uint32_t latest_alloc;
+	uint32_t expire_cursor;
+	uint32_t shared;
+	struct backlog_entry table[BACKLOG_TABLE_SIZE];
 };
 
-static void backlog_init(struct backlog *backlog) {
-	int i;
-	memset(backlog->n, 0 , sizeof(backlog->n));
-	memset(backlog->is_active, 0, sizeof(backlog->is_active));
+static inline
+void backlog_init(struct backlog *backlog) {
+	uint32_t i;
+
+	backlog->n_entries = 0;
+	backlog->latest_alloc = 0;
+	backlog->expire_cursor = 0;
+	backlog->shared = 0;
+	for (i = 0; i < BACKLOG_TABLE_SIZE; i++) {
+		backlog->table[i].key = BACKLOG_EMPTY_KEY;
+		backlog->table[i].n = 0;
+		backlog->table[i].last_alloc = 0;
+		backlog->table[i].is_active = 0;
+		backlog->table[i].tclass = 0;
+		backlog->table[i].deadline = BACKLOG_NO_DEADLINE;
+	}
+}
+
+/**
+ * Initializes a table that admission cores look up while the owning thread
+ *   inserts entries. Entries are kept until the table is reinitialized.
+ */
+static inline
+void backlog_init_shared(struct backlog *backlog) {
+	backlog_init(backlog);
+	backlog->shared = 1;
+}
+
+// Internal. Get the key of this flow in the table
+static inline __attribute__((always_inline))
+uint32_t _backlog_key(uint16_t src, uint16_t dst) {
+    return ((uint32_t)src << FP_NODES_SHIFT) + dst;
+}
+
+// Internal. Get the preferred table slot for a key (Fibonacci hashing)
+static inline __attribute__((always_inline))
+uint32_t _backlog_slot(uint32_t key) {
+#if BACKLOG_SPARSE
+	return (uint32_t)(key * 2654435769U) >> (32 - BACKLOG_TABLE_SHIFT);
+#else
+	return key;
+#endif
+}
+
+/**
+ * Returns the entry for (src,dst), or NULL if the pair has no entry. The dense
+ *   table has an entry for every pair.
+ */
+static inline __attribute__((always_inline))
+struct backlog_entry *backlog_find(struct backlog *backlog, uint16_t src,
+		uint16_t dst)
+{
+	uint32_t key = _backlog_key(src, dst);
+	uint32_t slot = _backlog_slot(key);
+
+	if (!BACKLOG_SPARSE)
+		return &backlog->table[slot];
+
+	while (1) {
+		struct backlog_entry *entry = &backlog->table[slot];
+		/* pairs with the release in backlog_find_or_insert, for shared tables */
+		uint32_t entry_key = __atomic_load_n(&entry->key, __ATOMIC_ACQUIRE);
+		if (entry_key == key)
+			return entry;
+		if (entry_key == BACKLOG_EMPTY_KEY)
+			return NULL;
+		slot = (slot + 1) & BACKLOG_TABLE_MASK;
+	}
 }
 
-// Internal. Get the index of this flow in the status data structure
+/**
+ * Prefetches the preferred slot of (src,dst), where its entry usually is
+ */
 static inline __attribute__((always_inline))
-uint32_t _backlog_index(uint16_t src, uint16_t dst) {
-    return (src << FP_NODES_SHIFT) + dst;
+void backlog_prefetch(struct backlog *backlog, uint16_t src, uint16_t dst)
+{
+	fp_prefetch0(&backlog->table[_backlog_slot(_backlog_key(src, dst))]);
+}
+
+/**
+ * Removes the entry at @slot, shifting back later entries of the same probe
+ *   sequence so lookups never need tombstones.
+ */
+static inline
+void _backlog_remove_slot(struct backlog *backlog, uint32_t slot)
+{
+	uint32_t next = slot;
+
+	while (1) {
+		next = (next + 1) & BACKLOG_TABLE_MASK;
+		struct backlog_entry *entry = &backlog->table[next];
+		if (entry->key == BACKLOG_EMPTY_KEY)
+			break;
+
+		/* can the entry at next move back to slot? only if its preferred
+		 * slot is not in the cyclic range (slot, next] */
+		uint32_t home = _backlog_slot(entry->key);
+		if (((next - home) & BACKLOG_TABLE_MASK)
+				>= ((next - slot) & BACKLOG_TABLE_MASK)) {
+			backlog->table[slot] = *entry;
+			slot = next;
+		}
+	}
+
+	backlog->table[slot].key = BACKLOG_EMPTY_KEY;
+	backlog->table[slot].n = 0;
+	backlog->table[slot].last_alloc = 0;
+	backlog->table[slot].is_active = 0;
+	backlog->table[slot].tclass = 0;
+	backlog->table[slot].deadline = BACKLOG_NO_DEADLINE;
+	backlog->n_entries--;
+}
+
+/**
+ * Scans up to @max_scan slots from where the previous call stopped, removing
+ *   idle entries whose last allocation is older than BACKLOG_EXPIRY_HORIZON.
+ * @return the number of entries removed
+ * @note does nothing on shared tables, where removal could move an entry
+ *   under a concurrent lookup, nor on dense tables
+ */
+static inline
+uint32_t backlog_expire(struct backlog *backlog, uint32_t max_scan)
+{
+	uint32_t slot = backlog->expire_cursor;
+	uint32_t n_removed = 0;
+	uint32_t i;
+
+	if (!BACKLOG_SPARSE || backlog->shared)
+		return 0;
+
+	for (i = 0; i < max_scan; i++) {
+		struct backlog_entry *entry = &backlog->table[slot];
+		if (entry->key != BACKLOG_EMPTY_KEY
+				&& !entry->is_active
+				&& entry->n == 0
+				&& (int32_t)(backlog->latest_alloc - entry->last_alloc)
+							> BACKLOG_EXPIRY_HORIZON) {
+			_backlog_remove_slot(backlog, slot);
+			n_removed++;
+			/* another entry might have moved into slot, re-examine it */
+			continue;
+		}
+		slot = (slot + 1) & BACKLOG_TABLE_MASK;
+	}
+
+	backlog->expire_cursor = slot;
+	return n_removed;
+}
+
+/**
+ * Returns the entry for (src,dst), creating it if necessary.
+ * @return NULL if the table holds BACKLOG_MAX_FLOWS entries and none could be
+ *   expired. Never NULL for dense tables.
+ */
+static inline __attribute__((always_inline))
+struct backlog_entry *backlog_find_or_insert(struct backlog *backlog,
+		uint16_t src, uint16_t dst, struct admission_statistics *stat)
+{
+	uint32_t key = _backlog_key(src, dst);
+	uint32_t slot = _backlog_slot(key);
+
+	if (!BACKLOG_SPARSE) {
+		/* entries are ready from init, only count the pairs seen */
+		if (unlikely(backlog->table[slot].key == BACKLOG_EMPTY_KEY)) {
+			backlog->table[slot].key = key;
+			backlog->n_entries++;
+		}
+		return &backlog->table[slot];
+	}
+
+	while (1) {
+		struct backlog_entry *entry = &backlog->table[slot];
+		if (entry->key == key)
+			return entry;
+		if (entry->key == BACKLOG_EMPTY_KEY)
+			break;
+		slot = (slot + 1) & BACKLOG_TABLE_MASK;
+	}
+
+	/* a new flow: sweep some more of the table, and if that wasn't enough to
+	 * stay under BACKLOG_MAX_FLOWS, all of it */
+	uint32_t n_removed = backlog_expire(backlog,
+			BACKLOG_EXPIRE_SCAN_PER_INSERT);
+	if (unlikely(backlog->n_entries >= BACKLOG_MAX_FLOWS)) {
+		n_removed += backlog_expire(backlog, BACKLOG_TABLE_SIZE);
+		if (backlog->n_entries >= BACKLOG_MAX_FLOWS) {
+			adm_log_backlog_expired(stat, n_removed);
+			adm_log_backlog_table_full(stat);
+			return NULL;
+		}
+	}
+	if (n_removed != 0) {
+		/* entries might have moved, look for a free slot again */
+		adm_log_backlog_expired(stat, n_removed);
+		slot = _backlog_slot(key);
+		while (backlog->table[slot].key != BACKLOG_EMPTY_KEY)
+			slot = (slot + 1) & BACKLOG_TABLE_MASK;
+	}
+
+	backlog->n_entries++;
+	backlog->table[slot].n = 0;
+	backlog->table[slot].last_alloc = 0;
+	backlog->table[slot].is_active = 0;
+	backlog->table[slot].tclass = 0;
+	backlog->table[slot].deadline = BACKLOG_NO_DEADLINE;
+	/* publish the key last, lookups on other threads see a ready entry */
+	__atomic_store_n(&backlog->table[slot].key, key, __ATOMIC_RELEASE);
+	return &backlog->table[slot];
 }
 
 static inline __attribute__((always_inline))
 uint32_t backlog_get(struct backlog *backlog, uint16_t src, uint16_t dst) {
-	uint32_t index = _backlog_index(src, dst);
-	return backlog->n[index];
+	struct backlog_entry *entry = backlog_find(backlog, src, dst);
+	return (entry == NULL) ? 0 : __atomic_load_n(&entry->n, __ATOMIC_RELAXED);
 }
 
 /**
- * Decreases backlog for the (src,dst) pair by 1
+ * Returns the timeslot of the last allocation to (src,dst), or 0 if there is
+ *   no recent allocation
+ */
+static inline __attribute__((always_inline))
+uint32_t backlog_get_last_alloc(struct backlog *backlog, uint16_t src,
+		uint16_t dst)
+{
+	struct backlog_entry *entry = backlog_find(backlog, src, dst);
+	return (entry == NULL) ? 0 : entry->last_alloc;
+}
+
+/**
+ * Records the timeslot of the last allocation to the flow of @entry
+ */
+static inline __attribute__((always_inline))
+void backlog_entry_set_last_alloc(struct backlog *backlog,
+		struct backlog_entry *entry, uint32_t timeslot)
+{
+	entry->last_alloc = timeslot;
+	if ((int32_t)(timeslot - backlog->latest_alloc) > 0)
+		backlog->latest_alloc = timeslot;
+}
+
+/**
+ * Returns the deadline to keep for demand due at @timeslot
+ */
+static inline __attribute__((always_inline))
+uint16_t backlog_deadline_from_timeslot(uint32_t timeslot)
+{
+	uint16_t deadline = (uint16_t)timeslot;
+
+	/* don't let the wrap-around turn the deadline off */
+	return (deadline == BACKLOG_NO_DEADLINE) ? deadline + 1 : deadline;
+}
+
+/**
+ * Returns the timeslot @deadline is due, given a timeslot @near at most
+ *   BACKLOG_MAX_DEADLINE timeslots away from it
+ */
+static inline __attribute__((always_inline))
+uint32_t backlog_deadline_to_timeslot(uint16_t deadline, uint32_t near)
+{
+	return near + (int16_t)(deadline - (uint16_t)near);
+}
+
+/**
+ * Returns the earlier of two deadlines, BACKLOG_NO_DEADLINE if neither is set.
+ *   Deadlines are compared with wrap-around.
+ */
+static inline __attribute__((always_inline))
+uint16_t backlog_earlier_deadline(uint16_t a, uint16_t b)
+{
+	if (a == BACKLOG_NO_DEADLINE)
+		return b;
+	if (b == BACKLOG_NO_DEADLINE)
+		return a;
+	return ((int16_t)(a - b) < 0) ? a : b;
+}
+
+/**
+ * Marks the (src,dst) pair as no longer held by the allocator
  */
 static inline __attribute__((always_inline))
 void backlog_non_active(struct backlog *backlog, uint16_t src, uint16_t dst) {
-	uint32_t index = _backlog_index(src, dst);
-	arr_unset_bit(backlog->is_active, index);
+	struct backlog_entry *entry = backlog_find(backlog, src, dst);
+	if (entry != NULL)
+		entry->is_active = 0;
 }
 
 // Resets the flow for this src/dst pair
@@ -58,39 +426,130 @@ void backlog_reset_pair(struct backlog *backlog, uint16_t src,
 {
     assert(backlog != NULL);
 
-    backlog->n[_backlog_index(src, dst)] = 0;
+    struct backlog_entry *entry = backlog_find(backlog, src, dst);
+    if (entry != NULL) {
+    	entry->n = 0;
+    	entry->deadline = BACKLOG_NO_DEADLINE;
+    }
 }
 
 /**
  * Increases backlog for (src,dst) by 'amount'.
- * @return true if backlog was 0 before the increase, false o/w
+ * @return BACKLOG_NEWLY_ACTIVE if the pair was not active before the increase,
+ *   BACKLOG_INCREASED if it was, and BACKLOG_TABLE_FULL if the table has no
+ *   room for a new pair. In that case nothing is added, and the caller should
+ *   offer the demand again later.
  * @param backlog: the backlog struct
  * @param src: source endpoint
  * @param dst: destination endpoint
  * @param amount: the amount by which to increase the backlog
+ * @param tclass: traffic class of the demand, the pair keeps the latest one
+ * @param deadline: when the demand is due (see backlog_deadline_from_timeslot),
+ *   or BACKLOG_NO_DEADLINE. While the pair is active, the earliest deadline of
+ *   the added backlog is kept.
  * @param stat: statistics object, to keep aggregate stats on the increase
  */
 static inline
-bool backlog_increase(struct backlog *backlog, uint16_t src,
-        uint16_t dst, uint32_t amount, struct admission_statistics *stat)
+enum backlog_increase_result backlog_increase(struct backlog *backlog,
+        uint16_t src,
+        uint16_t dst, uint32_t amount, uint8_t tclass, uint16_t deadline,
+        struct admission_statistics *stat)
 {
     assert(backlog != NULL);
     assert(amount != 0);
 
-    // Get full quantity from 16-bit LSB
-    uint32_t index = _backlog_index(src, dst);
+    struct backlog_entry *entry = backlog_find_or_insert(backlog, src, dst,
+    		stat);
+    if (unlikely(entry == NULL))
+    	return BACKLOG_TABLE_FULL;
 
-    set_and_jmp_if_was_set(backlog->is_active, index, already_active);
+    entry->tclass = tclass;
+    if (entry->is_active)
+    	goto already_active;
 
-    assert(backlog->n[index] == 0);
+    entry->is_active = 1;
+    assert(entry->n == 0);
     adm_log_increased_backlog_to_queue(stat, amount, amount);
-	return true;
+	return BACKLOG_NEWLY_ACTIVE;
 
 already_active:
 	/* the new backlog will get enqueued as the current one is spent */
-	backlog->n[index] += amount;
-	adm_log_increased_backlog_atomically(stat, amount, backlog->n[index]);
-	return false;
+	entry->n += amount;
+	entry->deadline = backlog_earlier_deadline(entry->deadline, deadline);
+	adm_log_increased_backlog_atomically(stat, amount, entry->n);
+	return BACKLOG_INCREASED;
+}
+
+/**
+ * Allocators that keep all of a pair's demand in the table (pim) share n
+ *   between the thread adding backlog, which adds to it and clears it on
+ *   resets, and the admission cores, which take allocated timeslots off it.
+ *   The three functions below update n atomically, and a pair is active
+ *   exactly when its n is non-zero (is_active is unused).
+ */
+
+/**
+ * Adds 'amount' to the backlog of (src,dst)
+ * @return BACKLOG_NEWLY_ACTIVE if the pair had no backlog before,
+ *   BACKLOG_INCREASED if it had, BACKLOG_TABLE_FULL if nothing was added
+ *   because the table has no room for the pair
+ */
+static inline
+enum backlog_increase_result backlog_increase_shared(struct backlog *backlog,
+        uint16_t src, uint16_t dst, uint32_t amount,
+        struct admission_statistics *stat)
+{
+    assert(backlog != NULL);
+    assert(amount != 0);
+
+    struct backlog_entry *entry = backlog_find_or_insert(backlog, src, dst,
+    		stat);
+    if (unlikely(entry == NULL))
+    	return BACKLOG_TABLE_FULL;
+
+    uint32_t old = __atomic_fetch_add(&entry->n, amount, __ATOMIC_RELAXED);
+    if (old == 0) {
+    	adm_log_increased_backlog_to_queue(stat, amount, amount);
+    	return BACKLOG_NEWLY_ACTIVE;
+    }
+    adm_log_increased_backlog_atomically(stat, amount, old + amount);
+    return BACKLOG_INCREASED;
+}
+
+/**
+ * Drops all of the backlog of (src,dst)
+ */
+static inline
+void backlog_clear_shared(struct backlog *backlog, uint16_t src, uint16_t dst)
+{
+    struct backlog_entry *entry = backlog_find(backlog, src, dst);
+    if (entry != NULL)
+    	__atomic_store_n(&entry->n, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * Takes one allocated timeslot off the backlog of (src,dst), unless there is
+ *   none left, e.g. because the pair was just cleared
+ * @return false if there was no backlog to take, true o/w, with the backlog
+ *   that remains in @remaining
+ */
+static inline __attribute__((always_inline))
+bool backlog_try_decrease(struct backlog *backlog, uint16_t src, uint16_t dst,
+		uint32_t *remaining)
+{
+    struct backlog_entry *entry = backlog_find(backlog, src, dst);
+    if (entry == NULL)
+    	return false;
+
+    uint32_t n = __atomic_load_n(&entry->n, __ATOMIC_RELAXED);
+    do {
+    	if (n == 0)
+    		return false;
+    } while (!__atomic_compare_exchange_n(&entry->n, &n, n - 1, true,
+    		__ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    *remaining = n - 1;
+    return true;
 }
 
 #endif /* BACKLOG_H_ */
@@ -14,14 +14,32 @@
 
 #include "bitasm.h"
 
-#ifndef BATCH_SIZE
-#define BATCH_SIZE 16  // must be consistent with bitmaps in batch_state
-#endif
+/* batch width, in timeslots. build with -DBATCH_SHIFT=5 or 6 for 32 or 64 */
 #ifndef BATCH_SHIFT
 #define BATCH_SHIFT 4  // 2^BATCH_SHIFT = BATCH_SIZE
 #endif
+#ifndef BATCH_SIZE
+#define BATCH_SIZE (1 << BATCH_SHIFT)  // must be consistent with bitmaps in batch_state
+#endif
+
+#if (BATCH_SIZE != (1 << BATCH_SHIFT)) || (BATCH_SHIFT > 6)
+#error "BATCH_SIZE must be 2^BATCH_SHIFT, and at most 64 to fit the timeslot bitmaps"
+#endif
+
+/* a bit for each timeslot in the batch (1ULL << 64 is undefined) */
+#define BATCH_MASK				(~0ULL >> (64 - BATCH_SIZE))
 
+/* rack uplink capacity checks, used only if batch_state is oversubscribed.
+ * off by default, since they add rack_pair_bitmaps and the rack counts to
+ * every batch_state; build with -DSUPPORTS_OVERSUBSCRIPTION=1 to use them
+ * (the _racks objects in the Makefile do) */
+#ifndef SUPPORTS_OVERSUBSCRIPTION
 #define SUPPORTS_OVERSUBSCRIPTION		0
+#endif
+
+#if SUPPORTS_OVERSUBSCRIPTION && ((MAX_NODES >> TOR_SHIFT) > MAX_RACKS)
+#error "MAX_NODES / 2^TOR_SHIFT racks don't fit in MAX_RACKS"
+#endif
 
 /* packing of bitmasks into 64 bit words */
 #if 0
@@ -37,19 +55,37 @@
 #define MAX_DSTS MAX_NODES  // include dst == out of boundary
 #define MAX_SRCS MAX_NODES
 
-// Tracks which srcs/dsts and src/dst racks are available for this batch
+/* columns of rack_pair_bitmaps: a column per dst rack, then out of boundary */
+#define RACK_PAIR_COLUMNS		(MAX_RACKS + 1)
+#define OUT_OF_BOUNDARY_RACK	MAX_RACKS
+
+/**
+ * Tracks which srcs/dsts and src/dst racks are available for this batch.
+ *   When oversubscribed, every rack can send and receive at most
+ *   inter_rack_capacity edges to other racks per timeslot. Traffic within a
+ *   rack does not use the uplinks. rack_pair_bitmaps has a bit set for each
+ *   timeslot where a src rack can still reach a dst rack, so a lookup costs
+ *   one load; it is only updated when a rack uses up a timeslot.
+ */
 struct batch_state {
     bool oversubscribed;
     uint64_t allowed_mask;
     uint64_t src_endnodes [MAX_SRCS / BITMASKS_PER_64_BIT];
     uint64_t dst_endnodes [MAX_DSTS / BITMASKS_PER_64_BIT];
-    uint64_t src_rack_bitmaps [MAX_RACKS];
-    uint64_t dst_rack_bitmaps [MAX_RACKS];
+    uint64_t rack_pair_bitmaps [MAX_RACKS * RACK_PAIR_COLUMNS];  // rows are src racks
     uint16_t src_rack_counts [MAX_RACKS * BATCH_SIZE];  // rows are racks
     uint16_t dst_rack_counts [MAX_RACKS * BATCH_SIZE];
     uint16_t out_of_boundary_counts [BATCH_SIZE];
 };
 
+// Returns the column of rack_pair_bitmaps for traffic to dst
+static inline __attribute__((always_inline))
+uint16_t batch_dst_rack(uint16_t dst)
+{
+    return (dst == OUT_OF_BOUNDARY_NODE_ID) ? OUT_OF_BOUNDARY_RACK
+                                            : fp_rack_from_node_id(dst);
+}
+
 // Initialize an admitted bitmap
 static inline
 void batch_state_init(struct batch_state *state, bool oversubscribed,
@@ -59,7 +95,7 @@ void batch_state_init(struct batch_state *state, bool oversubscribed,
     assert(num_nodes <= MAX_NODES);
 
     state->oversubscribed = oversubscribed;
-    state->allowed_mask = (1ULL << BATCH_SIZE) - 1;
+    state->allowed_mask = BATCH_MASK;
 
     uint16_t i;
     for (i = 0; i < num_nodes / BITMASKS_PER_64_BIT; i++) {
@@ -68,13 +104,15 @@ void batch_state_init(struct batch_state *state, bool oversubscribed,
     }
     state->dst_endnodes[BITMASK_WORD(OUT_OF_BOUNDARY_NODE_ID)] = ~0ULL;
 
-    if (oversubscribed) {
-        for (i = 0; i < (num_nodes >> TOR_SHIFT); i++) {
-            state->src_rack_bitmaps[i] = ~0ULL;
-            state->dst_rack_bitmaps[i] = ~0ULL;
-        }
+    if (SUPPORTS_OVERSUBSCRIPTION && oversubscribed) {
+        /* the last rack may be partial */
+        uint16_t num_racks = fp_rack_from_node_id(num_nodes - 1) + 1;
+        assert(inter_rack_capacity > 0);
 
-        for (i = 0; i < MAX_RACKS * BATCH_SIZE; i++) {
+        for (i = 0; i < num_racks * RACK_PAIR_COLUMNS; i++)
+            state->rack_pair_bitmaps[i] = ~0ULL;
+
+        for (i = 0; i < num_racks * BATCH_SIZE; i++) {
             state->src_rack_counts[i] = inter_rack_capacity;
             state->dst_rack_counts[i] = inter_rack_capacity;
         }
@@ -99,20 +137,35 @@ uint64_t batch_state_get_avail_bitmap(struct batch_state *state,
     		& (state->src_endnodes[BITMASK_WORD(src)] >> BITMASK_SHIFT(src))
     		& (state->dst_endnodes[BITMASK_WORD(dst)] >> BITMASK_SHIFT(dst));
 
-    if (SUPPORTS_OVERSUBSCRIPTION && state->oversubscribed) {
-        uint64_t rack_bitmap;
-        if (dst == OUT_OF_BOUNDARY_NODE_ID)
-            rack_bitmap = state->src_rack_bitmaps[fp_rack_from_node_id(src)];
-        else
-            rack_bitmap = state->src_rack_bitmaps[fp_rack_from_node_id(src)] &
-                state->dst_rack_bitmaps[fp_rack_from_node_id(dst)];
-
-        return endnode_bitmap & rack_bitmap;
-    }
+    if (SUPPORTS_OVERSUBSCRIPTION && state->oversubscribed)
+        return endnode_bitmap & state->rack_pair_bitmaps[
+                fp_rack_from_node_id(src) * RACK_PAIR_COLUMNS + batch_dst_rack(dst)];
 
     return endnode_bitmap;
 }
 
+// Internal. Clears @bit for all traffic from @src_rack to other racks
+static inline
+void _batch_state_src_rack_full(struct batch_state *state, uint16_t src_rack,
+                                uint64_t bit)
+{
+    uint16_t col;
+    for (col = 0; col < RACK_PAIR_COLUMNS; col++)
+        if (col != src_rack)
+            state->rack_pair_bitmaps[src_rack * RACK_PAIR_COLUMNS + col] &= ~bit;
+}
+
+// Internal. Clears @bit for all traffic to @dst_rack from other racks
+static inline
+void _batch_state_dst_rack_full(struct batch_state *state, uint16_t dst_rack,
+                                uint64_t bit)
+{
+    uint16_t row;
+    for (row = 0; row < MAX_RACKS; row++)
+        if (row != dst_rack)
+            state->rack_pair_bitmaps[row * RACK_PAIR_COLUMNS + dst_rack] &= ~bit;
+}
+
 // Sets a timeslot as occupied for src and dst, only if set_bit != 0.
 // assumes if set_bit != 0 then set_bit = (1 << timeslot).
 static inline __attribute__((always_inline))
@@ -142,15 +195,15 @@ void batch_state_set_occupied_conditional(struct batch_state *state, uint16_t sr
 
     if (SUPPORTS_OVERSUBSCRIPTION && state->oversubscribed && is_set) {
         uint16_t src_rack = fp_rack_from_node_id(src);
-        state->src_rack_counts[BATCH_SIZE * src_rack + timeslot] -= 1;
-        if (state->src_rack_counts[BATCH_SIZE * src_rack + timeslot] == 0)
-            state->src_rack_bitmaps[src_rack] &= ~(0x1ULL << timeslot);
-
-        if (dst != OUT_OF_BOUNDARY_NODE_ID) {
-            uint16_t dst_rack = fp_rack_from_node_id(dst);
-            state->dst_rack_counts[BATCH_SIZE * dst_rack + timeslot] -= 1;
-            if (state->dst_rack_counts[BATCH_SIZE * dst_rack + timeslot] == 0)
-                state->dst_rack_bitmaps[dst_rack] &= ~(0x1ULL << timeslot);
+        uint16_t dst_rack = batch_dst_rack(dst);
+
+        /* out of boundary traffic only uses the src rack's uplink */
+        if (src_rack != dst_rack) {
+            if (--state->src_rack_counts[BATCH_SIZE * src_rack + timeslot] == 0)
+                _batch_state_src_rack_full(state, src_rack, set_bitmask);
+            if (dst_rack != OUT_OF_BOUNDARY_RACK &&
+                --state->dst_rack_counts[BATCH_SIZE * dst_rack + timeslot] == 0)
+                _batch_state_dst_rack_full(state, dst_rack, set_bitmask);
         }
     }
 }
@@ -158,7 +211,7 @@ void batch_state_set_occupied_conditional(struct batch_state *state, uint16_t sr
 static inline
 void batch_state_disallow_lsb_timeslot(struct batch_state *state) {
 	state->allowed_mask <<= 1;
-	state->allowed_mask &= (1ULL << BATCH_SIZE) - 1;
+	state->allowed_mask &= BATCH_MASK;
 }
 
 #endif /* BATCH_H_ */
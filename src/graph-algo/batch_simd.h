@@ -0,0 +1,135 @@
+/*
+ * batch_simd.h
+ *
+ * Vectorized lookup of available timeslots for groups of backlog edges,
+ *   given as arrays of srcs and dsts (see chunk_bin.h). The src and dst
+ *   masks of a group of edges are gathered and ANDed in one go; edges that
+ *   share a src or dst with an earlier edge of the group are flagged, since
+ *   allocating the earlier edge changes their masks. The caller allocates
+ *   the group's edges in order, re-reading the masks of flagged edges, so
+ *   the outcome is the same as allocating one at a time.
+ *
+ * The allocator uses this only when built with -DBATCH_SIMD, picking the
+ *   widest level the CPU supports at runtime.
+ */
+
+#ifndef BATCH_SIMD_H_
+#define BATCH_SIMD_H_
+
+#include <immintrin.h>
+#include <stdint.h>
+
+#include "batch.h"
+
+/* max number of edges handled together */
+#define BATCH_SIMD_MAX_GROUP		8
+
+enum batch_simd_level {
+	BATCH_SIMD_NONE = 0,	/* one edge at a time */
+	BATCH_SIMD_AVX2,		/* groups of 4 edges */
+	BATCH_SIMD_AVX512,		/* groups of 8 edges */
+};
+
+/**
+ * Returns the widest vector implementation supported by this CPU
+ */
+static inline enum batch_simd_level batch_simd_detect(void)
+{
+#if (BITMASKS_PER_64_BIT == 1)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512cd")
+			&& __builtin_cpu_supports("avx512vl"))
+		return BATCH_SIMD_AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return BATCH_SIMD_AVX2;
+#endif
+	/* packed bitmasks are not vectorized */
+	return BATCH_SIMD_NONE;
+}
+
+// Returns the number of edges handled together at this level
+static inline uint32_t batch_simd_group_size(enum batch_simd_level level)
+{
+	switch (level) {
+	case BATCH_SIMD_AVX512:
+		return 8;
+	case BATCH_SIMD_AVX2:
+		return 4;
+	default:
+		return 1;
+	}
+}
+
+/**
+ * Computes the available timeslot bitmaps of 4 consecutive edges, like
+ *   batch_state_get_avail_bitmap() (oversubscription is not supported).
+ * @param src, dst: the edges' endpoints
+ * @param bitmaps: receives the bitmap of each edge
+ * @returns a mask of the edges sharing a src or dst with an earlier edge in
+ *   the group; their bitmaps are only valid if earlier edges aren't allocated
+ */
+static inline __attribute__((target("avx2")))
+uint32_t batch_state_get_avail_bitmaps_avx2(struct batch_state *state,
+		const uint16_t *src, const uint16_t *dst, uint64_t *bitmaps)
+{
+	__m128i srcs = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)src));
+	__m128i dsts = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)dst));
+	/* src in the low 16 bits, dst in the high 16 bits of each lane */
+	__m128i keys = _mm_or_si128(srcs, _mm_slli_epi32(dsts, 16));
+
+	__m256i avail = _mm256_set1_epi64x(state->allowed_mask);
+	avail = _mm256_and_si256(avail,
+			_mm256_i32gather_epi64((const long long *)state->src_endnodes, srcs, 8));
+	avail = _mm256_and_si256(avail,
+			_mm256_i32gather_epi64((const long long *)state->dst_endnodes, dsts, 8));
+	_mm256_storeu_si256((__m256i *)bitmaps, avail);
+
+	/* compare each lane to the 1, 2 and 3 lanes before it. lanes shifted in
+	 * are all-ones, which no src or dst matches */
+	__m128i ones = _mm_set1_epi32(-1);
+	__m128i eq = _mm_cmpeq_epi16(keys, _mm_alignr_epi8(keys, ones, 12));
+	eq = _mm_or_si128(eq, _mm_cmpeq_epi16(keys, _mm_alignr_epi8(keys, ones, 8)));
+	eq = _mm_or_si128(eq, _mm_cmpeq_epi16(keys, _mm_alignr_epi8(keys, ones, 4)));
+	__m128i no_conflict = _mm_cmpeq_epi32(eq, _mm_setzero_si128());
+	return ~_mm_movemask_ps(_mm_castsi128_ps(no_conflict)) & 0xF;
+}
+
+/**
+ * Computes the available timeslot bitmaps of 8 consecutive edges. Same
+ *   semantics as batch_state_get_avail_bitmaps_avx2().
+ */
+static inline __attribute__((target("avx512f,avx512cd,avx512vl")))
+uint32_t batch_state_get_avail_bitmaps_avx512(struct batch_state *state,
+		const uint16_t *src, const uint16_t *dst, uint64_t *bitmaps)
+{
+	__m256i srcs = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)src));
+	__m256i dsts = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)dst));
+
+	__m512i avail = _mm512_set1_epi64(state->allowed_mask);
+	avail = _mm512_and_si512(avail,
+			_mm512_i32gather_epi64(srcs, (const void *)state->src_endnodes, 8));
+	avail = _mm512_and_si512(avail,
+			_mm512_i32gather_epi64(dsts, (const void *)state->dst_endnodes, 8));
+	_mm512_storeu_si512((void *)bitmaps, avail);
+
+	/* each lane of conflict_epi32 has a bit for every earlier equal lane */
+	__m256i conflicts = _mm256_or_si256(_mm256_conflict_epi32(srcs),
+			_mm256_conflict_epi32(dsts));
+	return _mm256_test_epi32_mask(conflicts, conflicts);
+}
+
+/**
+ * Computes available timeslot bitmaps for a group of batch_simd_group_size()
+ *   edges at the given level. See batch_state_get_avail_bitmaps_avx2().
+ */
+static inline __attribute__((always_inline))
+uint32_t batch_state_get_avail_bitmaps(enum batch_simd_level level,
+		struct batch_state *state, const uint16_t *src, const uint16_t *dst,
+		uint64_t *bitmaps)
+{
+	if (level == BATCH_SIMD_AVX512)
+		return batch_state_get_avail_bitmaps_avx512(state, src, dst, bitmaps);
+	return batch_state_get_avail_bitmaps_avx2(state, src, dst, bitmaps);
+}
+
+#endif /* BATCH_SIMD_H_ */
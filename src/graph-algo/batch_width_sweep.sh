@@ -0,0 +1,25 @@
+#!/bin/bash
+
+# this script runs the admissible traffic benchmark with 16, 32 and 64
+# timeslot batches and collects throughput and per-batch allocation
+# latency for each width into one csv file. build first with make.
+
+OUTPUT_FILE="batch_width_sweep.csv"
+
+HEADER_WRITTEN=0
+for BINARY in benchmark_graph_algo benchmark_graph_algo_batch32 benchmark_graph_algo_batch64; do
+    if [ ! -x "./$BINARY" ]; then
+        echo "missing ./$BINARY, run make first"
+        exit 1
+    fi
+
+    echo "running $BINARY"
+    if [ $HEADER_WRITTEN -eq 0 ]; then
+        ./$BINARY 5 > $OUTPUT_FILE
+        HEADER_WRITTEN=1
+    else
+        ./$BINARY 5 | tail -n +2 >> $OUTPUT_FILE
+    fi
+done
+
+echo "results in $OUTPUT_FILE"
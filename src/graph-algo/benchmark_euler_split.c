@@ -0,0 +1,217 @@
+/*
+ * benchmark_euler_split.c
+ *
+ * Measures the time to Euler split one rack graph with each implementation:
+ * neighbor bitmaps (euler_split.c, used by path selection), a matrix of edge
+ * counts (euler_split_matrix.c), and bit-sliced counts of 64 graphs at once
+ * (euler_split_sliced.c). Graphs are random regular bipartite multigraphs,
+ * and every split is checked to halve each vertex's degree.
+ *
+ * usage: ./benchmark_euler_split [reps]
+ */
+
+#include "benchmark_euler_split.h"
+#include "euler_split.h"
+#include "euler_split_sliced.h"
+#include "graph.h"
+#include "graph_sliced.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_SHAPES                      5
+#define DEFAULT_REPS                    200
+
+// Racks and degree of the graphs of each run
+const uint8_t shape_racks [NUM_SHAPES] =
+        {8, 8, 16, 32, 32};
+const uint8_t shape_degrees [NUM_SHAPES] =
+        {16, 32, 16, 16, 32};
+
+bench_counts counts[BENCH_GRAPHS];
+bench_counts counts_1[BENCH_GRAPHS];
+bench_counts counts_2[BENCH_GRAPHS];
+
+struct graph_structure structures[BENCH_GRAPHS];
+struct graph_edges edges[BENCH_GRAPHS];
+struct graph_sliced sliced, sliced_1, sliced_2;
+
+// Fills counts with BENCH_GRAPHS random d-regular bipartite multigraphs, each
+// the union of d random perfect matchings
+void generate_graphs(uint8_t n, uint8_t d)
+{
+        uint8_t dsts[BENCH_MAX_RACKS];
+        uint8_t i, j, k, tmp;
+        uint32_t g;
+
+        for (g = 0; g < BENCH_GRAPHS; g++) {
+                for (i = 0; i < n; i++) {
+                        dsts[i] = i;
+                        for (j = 0; j < n; j++)
+                                counts[g][i][j] = 0;
+                }
+                for (k = 0; k < d; k++) {
+                        for (i = n - 1; i > 0; i--) {
+                                j = rand() % (i + 1);
+                                tmp = dsts[i];
+                                dsts[i] = dsts[j];
+                                dsts[j] = tmp;
+                        }
+                        for (i = 0; i < n; i++)
+                                counts[g][i][dsts[i]]++;
+                }
+        }
+}
+
+// Returns the number of graphs whose halves in counts_1 and counts_2 don't
+// add up to the graph in counts or don't have degree d / 2 at every vertex
+uint32_t count_invalid_splits(uint8_t n, uint8_t d)
+{
+        uint32_t g, n_invalid = 0;
+        uint8_t u, v;
+
+        for (g = 0; g < BENCH_GRAPHS; g++) {
+                uint16_t degrees_1[2 * BENCH_MAX_RACKS] = {0};
+                uint16_t degrees_2[2 * BENCH_MAX_RACKS] = {0};
+                bool valid = true;
+
+                for (u = 0; u < n; u++) {
+                        for (v = 0; v < n; v++) {
+                                if (counts_1[g][u][v] + counts_2[g][u][v] !=
+                                    counts[g][u][v])
+                                        valid = false;
+                                degrees_1[u] += counts_1[g][u][v];
+                                degrees_1[n + v] += counts_1[g][u][v];
+                                degrees_2[u] += counts_2[g][u][v];
+                                degrees_2[n + v] += counts_2[g][u][v];
+                        }
+                }
+                for (u = 0; u < 2 * n; u++) {
+                        if (degrees_1[u] != d / 2 || degrees_2[u] != d / 2)
+                                valid = false;
+                }
+                n_invalid += !valid;
+        }
+        return n_invalid;
+}
+
+// Converts the active edges of a graph_structure to counts
+void counts_from_edges(bench_counts counts_out, struct graph_structure *structure,
+                       struct graph_edges *edges_in)
+{
+        uint8_t n = structure->n;
+        uint8_t u, v;
+        int w;
+
+        for (u = 0; u < n; u++)
+                for (v = 0; v < n; v++)
+                        counts_out[u][v] = 0;
+        for (u = 0; u < n; u++) {
+                for (w = 0; w < DEGREE_WORDS; w++) {
+                        uint64_t bitmap = edges_in->neighbor_bitmaps[u][w];
+                        for (; bitmap != 0; bitmap &= bitmap - 1) {
+                                int i = w * 64 + __builtin_ctzll(bitmap);
+                                counts_out[u][structure->vertices[u].neighbors[i].id - n]++;
+                        }
+                }
+        }
+}
+
+// Splits the graphs with split from euler_split.c n_reps times, returns the
+// time taken in ns
+uint64_t run_bitmap_splits(uint8_t n, uint32_t n_reps)
+{
+        struct graph_edges edges_in, edges_1, edges_2;
+        uint32_t rep, g;
+        uint8_t u, v, k;
+
+        for (g = 0; g < BENCH_GRAPHS; g++) {
+                graph_structure_init(&structures[g], n);
+                graph_edges_init(&edges[g], n);
+                for (u = 0; u < n; u++)
+                        for (v = 0; v < n; v++)
+                                for (k = 0; k < counts[g][u][v]; k++)
+                                        add_edge(&structures[g], &edges[g], u, n + v);
+        }
+
+        uint64_t start_time = time_ns();
+        for (rep = 0; rep < n_reps; rep++) {
+                for (g = 0; g < BENCH_GRAPHS; g++) {
+                        /* split consumes its input */
+                        copy_edges(&edges[g], &edges_in, n);
+                        graph_edges_init(&edges_1, n);
+                        graph_edges_init(&edges_2, n);
+                        split(&structures[g], &edges_in, &edges_1, &edges_2);
+
+                        if (rep == n_reps - 1) {
+                                counts_from_edges(counts_1[g], &structures[g], &edges_1);
+                                counts_from_edges(counts_2[g], &structures[g], &edges_2);
+                        }
+                }
+        }
+        return time_ns() - start_time;
+}
+
+// Splits the graphs, all at once, with split_sliced n_reps times, returns
+// the time taken in ns
+uint64_t run_sliced_splits(uint8_t n, uint32_t n_reps)
+{
+        uint32_t rep, g;
+        uint8_t u, v, k;
+
+        graph_sliced_init(&sliced, n);
+        for (g = 0; g < BENCH_GRAPHS; g++)
+                for (u = 0; u < n; u++)
+                        for (v = 0; v < n; v++)
+                                for (k = 0; k < counts[g][u][v]; k++)
+                                        graph_sliced_add_edges(&sliced, u, v, 0x1ULL << g);
+
+        uint64_t start_time = time_ns();
+        for (rep = 0; rep < n_reps; rep++) {
+                /* split_sliced leaves its input as it was */
+                split_sliced(&sliced, &sliced_1, &sliced_2);
+        }
+        uint64_t elapsed = time_ns() - start_time;
+
+        for (g = 0; g < BENCH_GRAPHS; g++) {
+                for (u = 0; u < n; u++) {
+                        for (v = 0; v < n; v++) {
+                                counts_1[g][u][v] = graph_sliced_get_count(&sliced_1, g, u, v);
+                                counts_2[g][u][v] = graph_sliced_get_count(&sliced_2, g, u, v);
+                        }
+                }
+        }
+        return elapsed;
+}
+
+void print_result(const char *kernel, uint8_t n, uint8_t d, uint32_t n_reps,
+                  uint64_t elapsed)
+{
+        printf("%s, %u, %u, %u, %f, %u\n", kernel, n, d, BENCH_GRAPHS * n_reps,
+               (double) elapsed / (BENCH_GRAPHS * n_reps),
+               count_invalid_splits(n, d));
+}
+
+int main(int argc, char **argv) {
+        uint32_t n_reps = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_REPS;
+        uint64_t elapsed;
+        uint32_t s;
+
+        srand(1);
+        printf("kernel, racks, degree, graphs, ns_per_graph, invalid\n");
+        for (s = 0; s < NUM_SHAPES; s++) {
+                uint8_t n = shape_racks[s];
+                uint8_t d = shape_degrees[s];
+
+                generate_graphs(n, d);
+
+                elapsed = run_bitmap_splits(n, n_reps);
+                print_result("bitmap", n, d, n_reps, elapsed);
+
+                elapsed = run_matrix_splits(counts, n, n_reps, counts_1, counts_2);
+                print_result("matrix", n, d, n_reps, elapsed);
+
+                elapsed = run_sliced_splits(n, n_reps);
+                print_result("sliced", n, d, n_reps, elapsed);
+        }
+}
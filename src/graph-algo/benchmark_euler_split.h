@@ -0,0 +1,35 @@
+/*
+ * benchmark_euler_split.h
+ *
+ * Shared by the two halves of benchmark_euler_split, which can't be in one
+ * file because graph.h and graph_matrix.h define the same names. Graphs are
+ * passed between them as matrices of edge counts.
+ */
+
+#ifndef BENCHMARK_EULER_SPLIT_H_
+#define BENCHMARK_EULER_SPLIT_H_
+
+#include <inttypes.h>
+#include <time.h>
+
+#define BENCH_GRAPHS                    64  // one batch of graph_sliced
+#define BENCH_MAX_RACKS                 32
+
+// Edge counts from left vertex u to right vertex v of one graph
+typedef uint8_t bench_counts[BENCH_MAX_RACKS][BENCH_MAX_RACKS];
+
+static inline
+uint64_t time_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Splits the BENCH_GRAPHS graphs in counts with split_matrix n_reps times,
+// writes the halves from the last time to counts_1 and counts_2, and returns
+// the time taken in ns
+uint64_t run_matrix_splits(bench_counts *counts, uint8_t n, uint32_t n_reps,
+                           bench_counts *counts_1, bench_counts *counts_2);
+
+#endif /* BENCHMARK_EULER_SPLIT_H_ */
@@ -0,0 +1,61 @@
+/*
+ * benchmark_euler_split_matrix.c
+ *
+ * The euler_split_matrix.c half of benchmark_euler_split.
+ */
+
+#include "benchmark_euler_split.h"
+#include "euler_split_matrix.h"
+#include "graph_matrix.h"
+
+static struct graph graphs[BENCH_GRAPHS];
+
+// Converts counts to a graph
+static void graph_from_counts(struct graph *graph, bench_counts counts,
+                              uint8_t n)
+{
+        uint8_t u, v, k;
+
+        graph_init(graph, n);
+        for (u = 0; u < n; u++)
+                for (v = 0; v < n; v++)
+                        for (k = 0; k < counts[u][v]; k++)
+                                add_edge(graph, u, n + v);
+}
+
+// Converts a graph to counts
+static void counts_from_graph(bench_counts counts, struct graph *graph)
+{
+        uint8_t u, v;
+
+        for (u = 0; u < graph->n; u++)
+                for (v = 0; v < graph->n; v++)
+                        counts[u][v] = graph->edges[u][v];
+}
+
+uint64_t run_matrix_splits(bench_counts *counts, uint8_t n, uint32_t n_reps,
+                           bench_counts *counts_1, bench_counts *counts_2)
+{
+        struct graph graph_in, graph_1, graph_2;
+        uint32_t rep, g;
+
+        for (g = 0; g < BENCH_GRAPHS; g++)
+                graph_from_counts(&graphs[g], counts[g], n);
+
+        uint64_t start_time = time_ns();
+        for (rep = 0; rep < n_reps; rep++) {
+                for (g = 0; g < BENCH_GRAPHS; g++) {
+                        /* split consumes its input */
+                        copy_graph(&graphs[g], &graph_in);
+                        graph_init(&graph_1, n);
+                        graph_init(&graph_2, n);
+                        split_matrix(&graph_in, &graph_1, &graph_2);
+
+                        if (rep == n_reps - 1) {
+                                counts_from_graph(counts_1[g], &graph_1);
+                                counts_from_graph(counts_2[g], &graph_2);
+                        }
+                }
+        }
+        return time_ns() - start_time;
+}
@@ -0,0 +1,241 @@
+/*
+ * benchmark_fairness.c
+ *
+ * Compares how the allocation engines (see alloc_engine.h) share the network
+ * among long-lived flows. Every flow is kept backlogged for the whole run, and
+ * its throughput is compared with its max-min fair share (see maxmin.h) using
+ * Jain's fairness index. Also reports the time to recompute max-min fair rates
+ * for each set of flows.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fp_ring.h"
+#include "admitted.h"
+#include "alloc_engine.h"
+#include "maxmin.h"
+#include "platform.h"
+
+#define NUM_NODES					256
+#define NUM_FLOW_COUNTS				3
+#define NUM_WORKLOADS				2
+#define NUM_ENGINES					2
+#define HOTSPOT_NODES				16   /* destinations of the hotspot workload */
+#define WARM_UP_TSLOTS				2048
+#define MEASURED_TSLOTS				8192
+#define RECOMPUTE_REPEATS			10
+#define ADMITTED_TRAFFIC_MEMPOOL_SIZE(engine)	(4 * (engine)->admitted_per_batch)
+#define ADMITTED_TRAFFIC_CACHE_SIZE(engine)		(2 * (engine)->batch_size)
+#define ADMITTED_OUT_RING_LOG_SIZE	16
+#define NO_FLOW						(~0U)
+
+const uint32_t flow_counts [NUM_FLOW_COUNTS] =
+    {1024, 4096, 16384};
+const char *workload_names [NUM_WORKLOADS] =
+    {"uniform", "hotspot"};
+const char *engine_names [NUM_ENGINES] =
+    {"pipelined", "maxmin"};
+
+// Results of running one engine on a set of flows
+struct fairness_stats {
+    double utilization;
+    double jain;            // of throughputs
+    double jain_maxmin;     // of throughputs over max-min fair shares
+    double min_share;       // lowest throughput over max-min fair share
+    double ns_per_tslot;
+};
+
+uint64_t time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Returns Jain's fairness index of x[0..n-1], 1 when all are equal
+double jain_index(const double *x, uint32_t n)
+{
+    double sum = 0, sum_sq = 0;
+    uint32_t i;
+
+    for (i = 0; i < n; i++) {
+        sum += x[i];
+        sum_sq += x[i] * x[i];
+    }
+    return (sum_sq > 0) ? (sum * sum) / (n * sum_sq) : 1.0;
+}
+
+// Picks n_flows distinct src-dst pairs. Under the hotspot workload, half of
+// the flows go to one of HOTSPOT_NODES destinations.
+void generate_flows(struct maxmin_flow *flows, uint32_t n_flows, uint16_t num_nodes,
+                    int workload, uint32_t *flow_of_pair)
+{
+    uint32_t i = 0;
+
+    memset(flow_of_pair, 0xff, (uint32_t) num_nodes * num_nodes * sizeof(uint32_t));
+    while (i < n_flows) {
+        uint16_t src = rand() % num_nodes;
+        uint16_t dst = (workload == 1 && (rand() & 1)) ? rand() % HOTSPOT_NODES
+                                                       : rand() % num_nodes;
+        if (src == dst || flow_of_pair[src * num_nodes + dst] != NO_FLOW)
+            continue;
+        flows[i].src = src;
+        flows[i].dst = dst;
+        flows[i].demand = 1.0;
+        flow_of_pair[src * num_nodes + dst] = i++;
+    }
+}
+
+// Runs the flows through engine, topping up every flow's backlog before each
+// batch so none runs dry, and compares throughputs with the fair shares.
+void run_engine(const struct alloc_engine *engine, struct maxmin_flow *flows,
+                uint32_t n_flows, uint16_t num_nodes, uint32_t *flow_of_pair,
+                struct fairness_stats *stats)
+{
+    struct alloc_engine_params params;
+    struct admissible_state *status;
+    struct fp_ring *q_admitted_out;
+    struct fp_mempool *admitted_traffic_mempool;
+    uint32_t *outstanding = calloc(n_flows, sizeof(uint32_t));
+    uint32_t *admitted_tslots = calloc(n_flows, sizeof(uint32_t));
+    double *tput = malloc(n_flows * sizeof(double));
+    double *share = malloc(n_flows * sizeof(double));
+    uint32_t batch_size = engine->batch_size;
+    uint32_t num_batches = (WARM_UP_TSLOTS + MEASURED_TSLOTS) / batch_size;
+    uint64_t alloc_ns = 0, num_admitted = 0;
+    uint32_t b, a, e, f;
+
+    assert(outstanding && admitted_tslots && tput && share);
+
+    q_admitted_out = fp_ring_create(ADMITTED_OUT_RING_LOG_SIZE);
+    admitted_traffic_mempool = fp_mempool_create(ADMITTED_TRAFFIC_MEMPOOL_SIZE(engine),
+            sizeof(struct admitted_traffic), ADMITTED_TRAFFIC_CACHE_SIZE(engine));
+    if (!q_admitted_out || !admitted_traffic_mempool) exit(-1);
+
+    memset(&params, 0, sizeof(params));
+    params.num_nodes = num_nodes;
+    params.q_admitted_out = q_admitted_out;
+    params.admitted_traffic_mempool = admitted_traffic_mempool;
+    status = engine->init(&params);
+    if (status == NULL) {
+        printf("Error initializing %s engine!\n", engine->name);
+        exit(-1);
+    }
+
+    for (b = 0; b < num_batches; b++) {
+        bool measured = (b * batch_size >= WARM_UP_TSLOTS);
+
+        // keep at least two batches of backlog in every flow
+        for (f = 0; f < n_flows; f++) {
+            if (outstanding[f] < 2 * batch_size) {
+                engine->add_backlog(status, flows[f].src, flows[f].dst,
+                                    4 * batch_size, 0, 0);
+                outstanding[f] += 4 * batch_size;
+            }
+        }
+        engine->flush_backlog(status);
+
+        uint64_t start = time_ns();
+        engine->get_admissible_traffic(status, 0, 0, 1, 0);
+        engine->handle_spent(status);
+        if (measured)
+            alloc_ns += time_ns() - start;
+
+        for (a = 0; a < engine->admitted_per_batch; a++) {
+            struct admitted_traffic *admitted;
+            fp_ring_dequeue(q_admitted_out, (void **) &admitted);
+            for (e = 0; e < admitted->size; e++) {
+                f = flow_of_pair[admitted->edges[e].src * num_nodes +
+                                 admitted->edges[e].dst];
+                assert(f != NO_FLOW);
+                outstanding[f]--;
+                if (measured)
+                    admitted_tslots[f]++;
+            }
+            if (measured)
+                num_admitted += admitted->size;
+            fp_mempool_put(admitted_traffic_mempool, admitted);
+        }
+    }
+
+    // the fair shares of flows that always have demand
+    for (f = 0; f < n_flows; f++)
+        flows[f].demand = 1.0;
+    maxmin_fair_rates(flows, n_flows, num_nodes);
+
+    stats->min_share = -1;
+    for (f = 0; f < n_flows; f++) {
+        tput[f] = (double) admitted_tslots[f] / MEASURED_TSLOTS;
+        share[f] = tput[f] / flows[f].rate;
+        if (stats->min_share < 0 || share[f] < stats->min_share)
+            stats->min_share = share[f];
+    }
+    stats->utilization = (double) num_admitted / ((double) MEASURED_TSLOTS * num_nodes);
+    stats->jain = jain_index(tput, n_flows);
+    stats->jain_maxmin = jain_index(share, n_flows);
+    stats->ns_per_tslot = (double) alloc_ns / MEASURED_TSLOTS;
+
+    engine->destroy(status);
+    fp_mempool_destroy(admitted_traffic_mempool);
+    fp_ring_destroy(q_admitted_out);
+    free(outstanding);
+    free(admitted_tslots);
+    free(tput);
+    free(share);
+}
+
+int main(void)
+{
+    uint16_t num_nodes = NUM_NODES;
+    uint32_t max_flows = flow_counts[NUM_FLOW_COUNTS - 1];
+    struct maxmin_flow *flows = malloc(max_flows * sizeof(struct maxmin_flow));
+    uint32_t *flow_of_pair = malloc((uint32_t) num_nodes * num_nodes * sizeof(uint32_t));
+    uint32_t i, w, k, r;
+
+    assert(flows != NULL && flow_of_pair != NULL);
+    if (num_nodes > MAX_NODES) {
+        fprintf(stderr, "need %u nodes, MAX_NODES is %u\n", num_nodes, MAX_NODES);
+        return -1;
+    }
+
+    printf("workload, nodes, flows, engine, observed_utilization, jain_index, "
+           "jain_index_vs_maxmin, min_share_vs_maxmin, ns_per_tslot, recompute_us, "
+           "recompute_rounds\n");
+
+    for (w = 0; w < NUM_WORKLOADS; w++) {
+        for (i = 0; i < NUM_FLOW_COUNTS; i++) {
+            uint32_t n_flows = flow_counts[i];
+            uint32_t rounds = 0;
+
+            // the same flows for every engine
+            srand(i * NUM_WORKLOADS + w + 1);
+            generate_flows(flows, n_flows, num_nodes, w, flow_of_pair);
+
+            // time the rate computation on its own
+            uint64_t start = time_ns();
+            for (r = 0; r < RECOMPUTE_REPEATS; r++)
+                rounds = maxmin_fair_rates(flows, n_flows, num_nodes);
+            double recompute_us = (time_ns() - start) / (1e3 * RECOMPUTE_REPEATS);
+
+            for (k = 0; k < NUM_ENGINES; k++) {
+                const struct alloc_engine *engine = alloc_engine_by_name(engine_names[k]);
+                struct fairness_stats stats;
+
+                assert(engine != NULL);
+                srand(1);
+                run_engine(engine, flows, n_flows, num_nodes, flow_of_pair, &stats);
+                printf("%s, %u, %u, %s, %f, %f, %f, %f, %f, %f, %u\n",
+                       workload_names[w], num_nodes, n_flows, engine->name,
+                       stats.utilization, stats.jain, stats.jain_maxmin,
+                       stats.min_share, stats.ns_per_tslot, recompute_us, rounds);
+            }
+        }
+    }
+
+    free(flows);
+    free(flow_of_pair);
+}
@@ -5,17 +5,27 @@
  *      Author: aousterh
  */
 
+#define _GNU_SOURCE /* for pthread_setaffinity_np */
+#include <getopt.h>
 #include <inttypes.h>
 #include <math.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
+#include <sys/resource.h>
+#include <unistd.h>
 
 #include "algo_config.h"
+#ifdef BENCHMARK_ALLOC_ENGINES
+#include "alloc_engine.h"
+#endif
 #include "fp_ring.h"
 #include "generate_requests.h"
 #include "admissible.h"
 #include "path_selection.h"
 #include "platform.h"
 #include "rdtsc.h"  // For timing
+#include "request_completion.h"
 
 #define NUM_FRACTIONS_A 11
 #define NUM_SIZES_A 1
@@ -23,9 +33,38 @@
 #define NUM_CAPACITIES_P 4
 #define NUM_RACKS_P 4
 #define NUM_NODES_P 1024
+#define NUM_FRACTIONS_S 3
+#define NUM_SIZES_S 3
+#define NUM_FRACTIONS_M 3
+#define NUM_CORES_M 5
+#define NUM_NODES_M 256
+#define NUM_FRACTIONS_B 4
+#define NUM_FRACTIONS_T 3
+#define NUM_POLICIES_T 3
+#define NUM_TCLASSES_T 2 /* latency-sensitive and bulk */
+#define NUM_FRACTIONS_O 3
+#define NUM_RATIOS_O 4
+#define NUM_FRACTIONS_F 2
+#define NUM_OFFSETS_F 5
+#define NUM_FRACTIONS_D 3
+#define NUM_POLICIES_D 3
+#define SHORT_FLOW_TSLOTS_D 10 /* flows up to this size have a deadline */
+#define DEADLINE_STRETCH_D 4 /* and are due within this many times their size */
+#define NUM_FRACTIONS_W 2
+#define NUM_WORKLOADS_W 3
+#define NUM_CORES_W 2
+#define NUM_INCAST_DSTS_W 4 /* receivers of the incast workload */
+#define HOT_NODES_SHIFT_W 4 /* 1 in 16 nodes is hot in the hotspot workload */
 #define PROCESSOR_SPEED 2.8
-#define BIN_MEMPOOL_SIZE 2048
+#define BIN_MEMPOOL_SIZE (2 * LARGE_BIN_SIZE / SMALL_BIN_SIZE)
+#define BIN_MEMPOOL_CACHE_SIZE			NUM_BINS
+#define BIN_RING_LOG_SIZE				16 /* must hold BIN_MEMPOOL_SIZE bins */
 #define ADMITTED_TRAFFIC_MEMPOOL_SIZE	(51*1000)
+#define ADMITTED_TRAFFIC_MEMPOOL_SIZE_SMALL	(4 * ADMITTED_PER_BATCH)
+#define ADMITTED_TRAFFIC_CACHE_SIZE		(2 * BATCH_SIZE)
+/* every core can hold a batch while the comm core catches up, plus caches */
+#define ADMITTED_TRAFFIC_MEMPOOL_SIZE_MULTICORE	(4 * ALGO_N_CORES * ADMITTED_PER_BATCH + \
+		(ALGO_N_CORES + 1) * 2 * ADMITTED_TRAFFIC_CACHE_SIZE)
 #define ADMITTED_OUT_RING_LOG_SIZE		16
 #define READY_PARTITIONS_Q_SIZE                 2
 
@@ -39,13 +78,135 @@ const uint16_t path_capacities [NUM_CAPACITIES_P] =
     {4, 8, 16, 32};  // inter-rack capacities (32 machines per rack)
 const uint8_t path_num_racks [NUM_RACKS_P] =
     {32, 16, 8, 4};
+const double scaling_fractions [NUM_FRACTIONS_S] =
+    {0.3, 0.6, 0.9};
+const uint32_t scaling_sizes [NUM_SIZES_S] =
+    {256, 1024, 4096};
+const double multicore_fractions [NUM_FRACTIONS_M] =
+    {0.5, 0.8, 0.95};
+const uint32_t multicore_cores [NUM_CORES_M] =
+    {1, 2, 4, 8, 16};
+const double batch_width_fractions [NUM_FRACTIONS_B] =
+    {0.5, 0.8, 0.9, 0.95};
+const double tclass_fractions [NUM_FRACTIONS_T] =
+    {0.7, 0.9, 0.99};
+const char *tclass_policy_names [NUM_POLICIES_T] =
+    {"none", "strict", "weighted"};
+const uint16_t tclass_weights [NUM_TCLASSES] =
+    {4, 1, 1, 1};
+const double oversub_fractions [NUM_FRACTIONS_O] =
+    {0.5, 0.8, 0.95};
+const uint32_t oversub_ratios [NUM_RATIOS_O] =
+    {0, 1, 2, 3};  // uplink oversubscription, 0 for no capacity check
+const double prefetch_fractions [NUM_FRACTIONS_F] =
+    {0.9, 0.99};
+const uint32_t prefetch_offsets [NUM_OFFSETS_F] =
+    {0, 2, 4, 8, 16};  // edges ahead to prefetch backlog entries, 0 for none
+const double deadline_fractions [NUM_FRACTIONS_D] =
+    {0.8, 0.9, 0.95};
+const enum bin_policy deadline_policies [NUM_POLICIES_D] =
+    {BIN_POLICY_LRU, BIN_POLICY_SJF, BIN_POLICY_EDF};
+const char *deadline_policy_names [NUM_POLICIES_D] =
+    {"lru", "sjf", "edf"};
+const double stealing_fractions [NUM_FRACTIONS_W] =
+    {0.8, 0.95};
+const char *stealing_workload_names [NUM_WORKLOADS_W] =
+    {"uniform", "incast", "hotspot"};
+const uint32_t stealing_cores [NUM_CORES_W] =
+    {2, 4};
 
 enum benchmark_type {
     ADMISSIBLE,
     PATH_SELECTION_OVERSUBSCRIPTION,
-    PATH_SELECTION_RACKS
+    PATH_SELECTION_RACKS,
+    ADMISSIBLE_SCALING,
+    ADMISSIBLE_MULTICORE,
+    ADMISSIBLE_BATCH_WIDTH,
+    ADMISSIBLE_TCLASS,
+    ADMISSIBLE_OVERSUBSCRIPTION,
+    ADMISSIBLE_PREFETCH,
+    ADMISSIBLE_DEADLINE,
+    ADMISSIBLE_WORK_STEALING
+};
+
+enum stealing_workload {
+    WORKLOAD_UNIFORM,
+    WORKLOAD_INCAST,
+    WORKLOAD_HOTSPOT
+};
+
+// State shared by the threads of a multi-core run. Batch b is allocated by
+// core b % n_cores, as in the arbiter, unless another core took it.
+struct multicore_run {
+    struct admissible_state *status;
+    uint32_t n_cores;
+    bool work_stealing;
+    uint64_t first_timeslot;   // first timeslot of batch 0
+    uint32_t num_batches;
+    uint32_t batches_issued;   // requests for batches < batches_issued were added
+    uint32_t batches_started;  // batches < batches_started started allocating
+    uint64_t *batch_start;     // per-batch start and end times
+    uint64_t *batch_end;
+};
+
+struct multicore_core {
+    struct multicore_run *run;
+    uint32_t core_index;
+    pthread_t thread;
+};
+
+// Results of a multi-core run, over the batches after warm-up
+struct multicore_stats {
+    uint32_t num_admitted;
+    uint64_t q_bin_samples;
+    uint64_t q_bin_sum;
+    uint32_t q_bin_max;
+    uint64_t stolen_batches;
 };
 
+// Results of a traffic class run, per class, over the timeslots after warm-up
+struct tclass_stats {
+    uint64_t requested[NUM_TCLASSES_T];     // timeslots requested
+    uint64_t admitted[NUM_TCLASSES_T];      // timeslots admitted
+    uint64_t queued_tslots[NUM_TCLASSES_T]; // unadmitted demand, summed over timeslots
+};
+
+// Traffic class of a flow in the traffic class benchmark: about 1 in 5 flows
+// is latency-sensitive (class 0), the rest are bulk (class 1)
+static inline uint16_t benchmark_flow_tclass(uint16_t src, uint16_t dst)
+{
+    return ((src + dst) % 5 == 0) ? 0 : 1;
+}
+
+// Skews generated requests for the work stealing benchmark, keeping their
+// times and sizes. Incast sends every other request to one of a few receivers.
+// Hotspot sends every fourth request to, and every fourth from, a small set of
+// hot nodes.
+void skew_requests(struct request_info *requests, uint32_t num_requests,
+                   uint32_t num_nodes, enum stealing_workload workload)
+{
+    uint32_t num_hot = num_nodes >> HOT_NODES_SHIFT_W;
+    uint32_t i;
+
+    for (i = 0; i < num_requests; i++) {
+        struct request_info *req = &requests[i];
+        uint16_t src = req->src;
+        uint16_t dst = req->dst;
+
+        if (workload == WORKLOAD_INCAST && i % 2 == 0)
+            dst = (i / 2) % NUM_INCAST_DSTS_W;
+        else if (workload == WORKLOAD_HOTSPOT && i % 4 == 0)
+            dst = (i / 4) % num_hot;
+        else if (workload == WORKLOAD_HOTSPOT && i % 4 == 1)
+            src = (i / 4) % num_hot;
+
+        if (src != dst) {
+            req->src = src;
+            req->dst = dst;
+        }
+    }
+}
+
 // Runs one experiment. Returns the number of packets admitted.
 uint32_t run_experiment(struct request_info *requests, uint32_t start_time, uint32_t end_time,
                         uint32_t num_requests, struct admissible_state *status,
@@ -100,6 +261,91 @@ uint32_t run_experiment(struct request_info *requests, uint32_t start_time, uint
 	return num_admitted;
 }
 
+#ifdef BENCHMARK_ALLOC_ENGINES
+// Runs one experiment like run_experiment, on an engine chosen with -e, in
+// batches of the engine's size. Returns the number of packets admitted.
+uint32_t run_experiment_engine(const struct alloc_engine *engine,
+                               struct admissible_state *state,
+                               struct request_info *requests, uint32_t start_time,
+                               uint32_t end_time, uint32_t num_requests,
+                               struct fp_ring *q_admitted_out,
+                               struct fp_mempool *admitted_traffic_mempool,
+                               struct request_info **next_request)
+{
+    struct admitted_traffic *admitted;
+    struct request_info *current_request = requests;
+    uint32_t batch_size = engine->batch_size;
+    uint32_t num_admitted = 0;
+    uint32_t t, i;
+
+    for (t = start_time; t < end_time; t += batch_size) {
+        // Issue all new requests for this batch
+        while (current_request < requests + num_requests &&
+               (current_request->timeslot / batch_size) == (t / batch_size) % (65536 / batch_size)) {
+            engine->add_backlog(state, current_request->src, current_request->dst,
+                                current_request->backlog, 0, 0);
+            current_request++;
+        }
+        engine->flush_backlog(state);
+
+        // Get admissible traffic
+        engine->get_admissible_traffic(state, 0, 0, 1, 0);
+        engine->handle_spent(state);
+
+        for (i = 0; i < engine->admitted_per_batch; i++) {
+            fp_ring_dequeue(q_admitted_out, (void **)&admitted);
+            num_admitted += admitted->size;
+            fp_mempool_put(admitted_traffic_mempool, admitted);
+        }
+    }
+
+    *next_request = current_request;
+    return num_admitted;
+}
+#endif
+
+// Runs one experiment like run_experiment, also measuring the time spent handling
+// spent demands. Returns the number of packets admitted.
+uint32_t run_experiment_prefetch(struct request_info *requests, uint32_t start_time,
+                                 uint32_t end_time, uint32_t num_requests,
+                                 struct admissible_state *status,
+                                 struct request_info **next_request,
+                                 uint64_t *spent_time)
+{
+    struct admitted_traffic *admitted;
+    struct request_info *current_request = requests;
+    uint32_t num_admitted = 0;
+    uint32_t b, i;
+
+    *spent_time = 0;
+    for (b = (start_time >> BATCH_SHIFT); b < (end_time >> BATCH_SHIFT); b++) {
+        // Issue all new requests for this batch
+        while ((current_request->timeslot >> BATCH_SHIFT) == (b % (65536 >> BATCH_SHIFT)) &&
+               current_request < requests + num_requests) {
+            add_backlog(status, current_request->src, current_request->dst,
+                        current_request->backlog);
+            current_request++;
+        }
+        flush_backlog(status);
+
+        // Get admissible traffic
+        get_admissible_traffic(status, 0, 0, 1, 0);
+
+        uint64_t spent_start = current_time();
+        handle_spent_demands(status);
+        *spent_time += current_time() - spent_start;
+
+        for (i = 0; i < ADMITTED_PER_BATCH; i++) {
+            fp_ring_dequeue(get_q_admitted_out(status), (void **)&admitted);
+            num_admitted += admitted->size;
+            fp_mempool_put(get_admitted_traffic_mempool(status), admitted);
+        }
+    }
+
+    *next_request = current_request;
+    return num_admitted;
+}
+
 // Runs the admissible algorithm for many timeslots, saving the admitted traffic for
 // further benchmarking
 void run_admissible(struct request_info *requests, uint32_t start_time, uint32_t end_time,
@@ -134,20 +380,322 @@ void run_admissible(struct request_info *requests, uint32_t start_time, uint32_t
     *next_request = current_request;
 }
 
+// Runs a traffic class experiment, warm-up included, recording per-class
+// statistics for batches after warm_up_time. If use_tclass is false, all flows
+// are requested in class 0 but are still counted in their own class.
+void run_experiment_tclass(struct request_info *requests, uint32_t warm_up_time,
+                           uint32_t end_time, uint32_t num_requests,
+                           struct admissible_state *status, bool use_tclass,
+                           struct tclass_stats *stats)
+{
+    struct admitted_traffic *admitted;
+    struct request_info *current_request = requests;
+    int64_t outstanding[NUM_TCLASSES_T] = {0};
+    uint32_t b, i, e;
+    uint16_t c;
+
+    memset(stats, 0, sizeof(*stats));
+
+    for (b = 0; b < (end_time >> BATCH_SHIFT); b++) {
+        bool measured = (b >= (warm_up_time >> BATCH_SHIFT));
+
+        // Issue all new requests for this batch
+        while ((current_request->timeslot >> BATCH_SHIFT) == (b % (65536 >> BATCH_SHIFT)) &&
+               current_request < requests + num_requests) {
+            c = benchmark_flow_tclass(current_request->src, current_request->dst);
+            add_backlog_tclass(status, current_request->src, current_request->dst,
+                               current_request->backlog, use_tclass ? c : 0);
+            outstanding[c] += current_request->backlog;
+            if (measured)
+                stats->requested[c] += current_request->backlog;
+            current_request++;
+        }
+        flush_backlog(status);
+
+        // Get admissible traffic
+        get_admissible_traffic(status, 0, 0, 1, 0);
+        handle_spent_demands(status);
+
+        for (i = 0; i < ADMITTED_PER_BATCH; i++) {
+            fp_ring_dequeue(get_q_admitted_out(status), (void **)&admitted);
+            for (e = 0; e < admitted->size; e++) {
+                struct admitted_edge *edge = get_admitted_edge(admitted, e);
+                c = benchmark_flow_tclass(edge->src, edge->dst);
+                outstanding[c]--;
+                if (measured)
+                    stats->admitted[c]++;
+            }
+            fp_mempool_put(get_admitted_traffic_mempool(status), admitted);
+
+            // by Little's law, the mean delay is the queued demand over throughput
+            if (measured) {
+                for (c = 0; c < NUM_TCLASSES_T; c++)
+                    stats->queued_tslots[c] += outstanding[c];
+            }
+        }
+    }
+}
+
+// Relative deadline of a request in the deadline benchmark, or 0 for none.
+// Short flows are due within DEADLINE_STRETCH_D times their size, plus a batch
+// since requests are only issued at batch boundaries.
+static inline uint32_t benchmark_request_deadline(struct request_info *request)
+{
+    if (request->backlog > SHORT_FLOW_TSLOTS_D)
+        return 0;
+    return BATCH_SIZE + DEADLINE_STRETCH_D * request->backlog;
+}
+
+// Runs a deadline experiment, warm-up included, issuing requests with their
+// deadlines and recording request completion in fs. Returns the number of
+// packets admitted after warm_up_time.
+uint32_t run_experiment_deadline(struct request_info *requests, uint32_t warm_up_time,
+                                 uint32_t end_time, uint32_t num_requests,
+                                 struct admissible_state *status, struct fct_state *fs)
+{
+    struct admitted_traffic *admitted;
+    struct request_info *current_request = requests;
+    uint32_t num_admitted = 0;
+    uint32_t b, i, e;
+
+    for (b = 0; b < (end_time >> BATCH_SHIFT); b++) {
+        // Issue all new requests for this batch
+        while ((current_request->timeslot >> BATCH_SHIFT) == (b % (65536 >> BATCH_SHIFT)) &&
+               current_request < requests + num_requests) {
+            add_backlog_deadline(status, current_request->src, current_request->dst,
+                                 current_request->backlog, 0,
+                                 benchmark_request_deadline(current_request));
+            current_request++;
+        }
+        flush_backlog(status);
+
+        // Get admissible traffic
+        get_admissible_traffic(status, 0, 0, 1, 0);
+        handle_spent_demands(status);
+
+        for (i = 0; i < ADMITTED_PER_BATCH; i++) {
+            uint32_t timeslot = b * BATCH_SIZE + i * BATCH_SIZE / ADMITTED_PER_BATCH;
+
+            fp_ring_dequeue(get_q_admitted_out(status), (void **)&admitted);
+            if (b >= (warm_up_time >> BATCH_SHIFT))
+                num_admitted += admitted->size;
+            for (e = 0; e < admitted->size; e++) {
+                struct admitted_edge *edge = get_admitted_edge(admitted, e);
+                fct_admit(fs, requests, edge->src, edge->dst, timeslot);
+            }
+            fp_mempool_put(get_admitted_traffic_mempool(status), admitted);
+        }
+    }
+
+    return num_admitted;
+}
+
+// Pins a thread to a CPU, wrapping around if there are fewer CPUs
+void pin_thread_to_cpu(pthread_t thread, uint32_t cpu)
+{
+    cpu_set_t cpu_set;
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu % (num_cpus > 0 ? num_cpus : 1), &cpu_set);
+    if (pthread_setaffinity_np(thread, sizeof(cpu_set), &cpu_set) != 0)
+        fprintf(stderr, "could not pin thread to cpu %u\n", cpu);
+}
+
+// Runs one admission core: allocates batches core_index, core_index + n_cores, ...
+// Each batch starts after its requests were issued and the previous batch started.
+// With work stealing, a core that waits for its batch may take an earlier batch
+// from a busy core, and skips the batches other cores took from it.
+void *run_admission_core(void *arg)
+{
+    struct multicore_core *core = (struct multicore_core *) arg;
+    struct multicore_run *run = core->run;
+    uint32_t b;
+
+    fp_set_lcore_id(1 + core->core_index);
+
+    while (1) {
+        b = (get_admission_next_batch(run->status, core->core_index) -
+             run->first_timeslot) >> BATCH_SHIFT;
+        if (b >= run->num_batches)
+            break;
+
+        while (__atomic_load_n(&run->batches_issued, __ATOMIC_ACQUIRE) <= b ||
+               __atomic_load_n(&run->batches_started, __ATOMIC_ACQUIRE) != b) {
+            if (run->work_stealing &&
+                claim_admission_batch(run->status, core->core_index) == 0)
+                b = (get_admission_next_batch(run->status, core->core_index) -
+                     run->first_timeslot) >> BATCH_SHIFT;
+            sched_yield();
+        }
+        __atomic_store_n(&run->batches_started, b + 1, __ATOMIC_RELEASE);
+
+        run->batch_start[b] = current_time();
+        get_admissible_traffic(run->status, core->core_index, 0, 1, 0);
+        run->batch_end[b] = current_time();
+    }
+
+    return NULL;
+}
+
+// Runs the allocator on n_cores threads for num_batches batches, while this
+// thread acts as the comm core: it issues requests up to n_cores batches
+// ahead of allocation, handles spent demands and consumes admitted traffic.
+void run_experiment_multicore(struct request_info *requests, uint32_t num_requests,
+                              struct admissible_state *status, uint32_t n_cores,
+                              bool work_stealing, uint32_t num_batches,
+                              uint32_t warm_up_batches, struct fp_ring **q_bin,
+                              uint64_t *batch_start, uint64_t *batch_end,
+                              struct multicore_stats *stats)
+{
+    struct seq_admissible_status *seq_status = (struct seq_admissible_status *) status;
+    struct multicore_run run;
+    struct multicore_core cores[ALGO_N_CORES];
+    struct request_info *current_request = requests;
+    struct admitted_traffic *admitted;
+    uint32_t admitted_seen = 0;
+    uint32_t b_issue = 0;
+    uint32_t i;
+
+    assert(n_cores <= ALGO_N_CORES);
+
+    run.status = status;
+    run.n_cores = n_cores;
+    run.work_stealing = work_stealing;
+    run.first_timeslot = get_admission_next_batch(status, 0);
+    run.num_batches = num_batches;
+    run.batches_issued = 0;
+    run.batches_started = 0;
+    run.batch_start = batch_start;
+    run.batch_end = batch_end;
+    memset(stats, 0, sizeof(*stats));
+
+    set_admission_work_stealing(status, work_stealing);
+    for (i = 0; i < n_cores; i++)
+        stats->stolen_batches -= seq_status->cores[i].stat.stolen_batches;
+
+    for (i = 0; i < n_cores; i++) {
+        cores[i].run = &run;
+        cores[i].core_index = i;
+        if (pthread_create(&cores[i].thread, NULL, run_admission_core, &cores[i]) != 0) {
+            printf("Error creating admission core thread\n");
+            exit(-1);
+        }
+        pin_thread_to_cpu(cores[i].thread, 1 + i);
+    }
+
+    while (admitted_seen < num_batches * ADMITTED_PER_BATCH) {
+        uint32_t started = __atomic_load_n(&run.batches_started, __ATOMIC_ACQUIRE);
+        bool idle = true;
+
+        // Issue all new requests for the next batch, if it is close enough
+        if (b_issue < num_batches && b_issue < started + n_cores) {
+            while (current_request < requests + num_requests &&
+                   (current_request->timeslot >> BATCH_SHIFT) == (b_issue % (65536 >> BATCH_SHIFT))) {
+                add_backlog(status, current_request->src, current_request->dst,
+                            current_request->backlog);
+                current_request++;
+            }
+            flush_backlog(status);
+            __atomic_store_n(&run.batches_issued, ++b_issue, __ATOMIC_RELEASE);
+            idle = false;
+        }
+
+        handle_spent_demands(status);
+
+        while (fp_ring_dequeue(get_q_admitted_out(status), (void **)&admitted) == 0) {
+            if (admitted_seen >= warm_up_batches * ADMITTED_PER_BATCH)
+                stats->num_admitted += admitted->size;
+            admitted_seen++;
+            fp_mempool_put(get_admitted_traffic_mempool(status), admitted);
+            idle = false;
+        }
+
+        // Sample occupancy of the queues between cores
+        if (started > warm_up_batches) {
+            for (i = 0; i < seq_status->n_queues; i++) {
+                uint32_t count = fp_ring_count(q_bin[i]);
+                stats->q_bin_sum += count;
+                if (count > stats->q_bin_max)
+                    stats->q_bin_max = count;
+            }
+            stats->q_bin_samples += seq_status->n_queues;
+        }
+
+        if (idle)
+            sched_yield();
+    }
+
+    for (i = 0; i < n_cores; i++)
+        pthread_join(cores[i].thread, NULL);
+
+    for (i = 0; i < n_cores; i++)
+        stats->stolen_batches += seq_status->cores[i].stat.stolen_batches;
+    set_admission_work_stealing(status, false);
+}
+
+int compare_uint64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
 void print_usage(char **argv) {
+#ifdef BENCHMARK_ALLOC_ENGINES
+    uint32_t i;
+
+    printf("usage: %s [-e engine] benchmark_type\n", argv[0]);
+    printf("\t-e engine runs benchmark_type=0 with an allocation engine:");
+    for (i = 0; alloc_engines[i] != NULL; i++)
+        printf(" %s", alloc_engines[i]->name);
+    printf(" (default: the pipelined allocator, called directly)\n");
+#else
     printf("usage: %s benchmark_type\n", argv[0]);
-    printf("\tbenchmark_type=0 for admissible traffic benchmark, benchmark_type=1 for path selection benchmark (vary oversubscription ratio), benchmark_type=2 for path selection (vary #racks)\n");
+#endif
+    printf("\tbenchmark_type=0 for admissible traffic benchmark, benchmark_type=1 for path selection benchmark (vary oversubscription ratio), benchmark_type=2 for path selection (vary #racks), benchmark_type=3 for admissible traffic throughput and memory with 256/1024/4096 nodes, benchmark_type=4 for admissible traffic on 1-16 pipelined cores, benchmark_type=5 for admissible traffic throughput and batch latency with this build's BATCH_SIZE, benchmark_type=6 for admitted share and delay of two traffic classes under each class policy, benchmark_type=7 for admissible traffic throughput with and without rack uplink capacity checks, benchmark_type=8 for admissible traffic throughput and spent demand handling time, prefetching backlog entries 0-16 edges ahead, benchmark_type=9 for the share of short flows that miss their deadline under each bin policy, benchmark_type=10 for admissible traffic on 2-4 pipelined cores with and without work stealing, under uniform, incast and hotspot traffic\n");
+}
+
+// Returns the maximum resident set size of the process so far, in MB
+double get_max_rss_mb(void)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return usage.ru_maxrss / 1024.0;
 }
 
 int main(int argc, char **argv)
 {
-    if (argc != 2) {
+#ifdef BENCHMARK_ALLOC_ENGINES
+    const struct alloc_engine *engine = NULL;
+#endif
+    int opt;
+
+    while ((opt = getopt(argc, argv, "e:")) != -1) {
+        switch (opt) {
+#ifdef BENCHMARK_ALLOC_ENGINES
+        case 'e':
+            engine = alloc_engine_by_name(optarg);
+            if (engine == NULL) {
+                fprintf(stderr, "unknown engine %s\n", optarg);
+                print_usage(argv);
+                return -1;
+            }
+            break;
+#endif
+        default:
+            print_usage(argv);
+            return -1;
+        }
+    }
+    if (optind != argc - 1) {
         print_usage(argv);
         return -1;
     }
 
     int type;
-    sscanf(argv[1], "%d", &type);
+    sscanf(argv[optind], "%d", &type);
     enum benchmark_type benchmark_type;
     if (type == 0)
         benchmark_type = ADMISSIBLE;
@@ -155,24 +703,65 @@ int main(int argc, char **argv)
         benchmark_type = PATH_SELECTION_OVERSUBSCRIPTION;
     else if (type == 2)
         benchmark_type = PATH_SELECTION_RACKS;
+    else if (type == 3)
+        benchmark_type = ADMISSIBLE_SCALING;
+    else if (type == 4)
+        benchmark_type = ADMISSIBLE_MULTICORE;
+    else if (type == 5)
+        benchmark_type = ADMISSIBLE_BATCH_WIDTH;
+    else if (type == 6)
+        benchmark_type = ADMISSIBLE_TCLASS;
+    else if (type == 7)
+        benchmark_type = ADMISSIBLE_OVERSUBSCRIPTION;
+    else if (type == 8)
+        benchmark_type = ADMISSIBLE_PREFETCH;
+    else if (type == 9)
+        benchmark_type = ADMISSIBLE_DEADLINE;
+    else if (type == 10)
+        benchmark_type = ADMISSIBLE_WORK_STEALING;
     else {
         print_usage(argv);
         return -1;
     }
+#ifdef BENCHMARK_ALLOC_ENGINES
+    if (engine != NULL && benchmark_type != ADMISSIBLE) {
+        fprintf(stderr, "-e only applies to benchmark_type=0\n");
+        return -1;
+    }
+#endif
+    if (!SUPPORTS_OVERSUBSCRIPTION &&
+        (benchmark_type == PATH_SELECTION_OVERSUBSCRIPTION ||
+         benchmark_type == ADMISSIBLE_OVERSUBSCRIPTION)) {
+        fprintf(stderr, "benchmark_type=%d needs rack uplink capacity checks "
+                "(use benchmark_graph_algo_racks)\n", type);
+        return -1;
+    }
 
     // keep both durations an even number of batches so that bin pointers return to queue_0
     uint32_t warm_up_duration = ((10000 + 127) / 128) * 128;
     uint32_t duration = warm_up_duration + ((50000 + 127) / 128) * 128;
     double mean = 10; // Mean request size and inter-arrival time
 
+    // large clusters generate many more requests per timeslot, run shorter
+    if (benchmark_type == ADMISSIBLE_SCALING || benchmark_type == ADMISSIBLE_MULTICORE ||
+        benchmark_type == ADMISSIBLE_PREFETCH || benchmark_type == ADMISSIBLE_WORK_STEALING) {
+        warm_up_duration = ((2000 + 127) / 128) * 128;
+        duration = warm_up_duration + ((8000 + 127) / 128) * 128;
+    }
+
+    // path selection consumes admitted traffic only after the whole run
+    bool keeps_admitted = (benchmark_type == PATH_SELECTION_OVERSUBSCRIPTION ||
+                           benchmark_type == PATH_SELECTION_RACKS);
+    uint32_t admitted_mempool_size = keeps_admitted ? ADMITTED_TRAFFIC_MEMPOOL_SIZE
+                                                    : ADMITTED_TRAFFIC_MEMPOOL_SIZE_SMALL;
+    if (benchmark_type == ADMISSIBLE_MULTICORE || benchmark_type == ADMISSIBLE_WORK_STEALING)
+        admitted_mempool_size = ADMITTED_TRAFFIC_MEMPOOL_SIZE_MULTICORE;
+
     /* sanity checks */
-#if (ALGO_N_CORES != 1)
-#error "benchmark only supports ALGO_N_CORES == 1"
-#endif
 
-    if (ADMITTED_TRAFFIC_MEMPOOL_SIZE < duration - warm_up_duration) {
+    if (keeps_admitted && admitted_mempool_size < duration - warm_up_duration) {
     	printf("need at least %u elements in admitted_traffic to run experiments, got %u\n",
-    			duration- warm_up_duration, ADMITTED_TRAFFIC_MEMPOOL_SIZE);
+    			duration- warm_up_duration, admitted_mempool_size);
     	exit(-1);
     }
     if ((1 << ADMITTED_OUT_RING_LOG_SIZE) <= duration - warm_up_duration) {
@@ -186,9 +775,9 @@ int main(int argc, char **argv)
     // Each experiment tries out a different combination of target network utilization
     // and number of nodes
     const double *fractions;
-    const uint32_t *sizes;
-    const uint16_t *capacities;
-    const uint8_t *racks;
+    const uint32_t *sizes = NULL;
+    const uint16_t *capacities = NULL;
+    const uint8_t *racks = NULL;
     uint8_t num_fractions;
     uint8_t num_parameter_2;
     if (benchmark_type == ADMISSIBLE) {
@@ -207,6 +796,95 @@ int main(int argc, char **argv)
         // init parameter 2 - inter-rack capacities
         num_parameter_2 = NUM_CAPACITIES_P;
         capacities = path_capacities;
+        if (NUM_NODES_P > MAX_NODES) {
+            fprintf(stderr, "need %u nodes, MAX_NODES is %u (use benchmark_graph_algo_large)\n",
+                    NUM_NODES_P, MAX_NODES);
+            return -1;
+        }
+    } else if (benchmark_type == ADMISSIBLE_SCALING) {
+        // init fractions
+        num_fractions = NUM_FRACTIONS_S;
+        fractions = scaling_fractions;
+
+        // init parameter 2 - sizes that fit in this build
+        num_parameter_2 = 0;
+        for (j = 0; j < NUM_SIZES_S; j++) {
+            if (scaling_sizes[j] <= MAX_NODES)
+                num_parameter_2++;
+            else
+                fprintf(stderr, "skipping %u nodes, MAX_NODES is %u (rebuild with a larger FP_NODES_SHIFT)\n",
+                        scaling_sizes[j], MAX_NODES);
+        }
+        sizes = scaling_sizes;
+    } else if (benchmark_type == ADMISSIBLE_MULTICORE) {
+        // init fractions
+        num_fractions = NUM_FRACTIONS_M;
+        fractions = multicore_fractions;
+
+        // init parameter 2 - numbers of cores that fit in this build
+        num_parameter_2 = 0;
+        for (j = 0; j < NUM_CORES_M; j++) {
+            if (multicore_cores[j] <= ALGO_N_CORES)
+                num_parameter_2++;
+            else
+                fprintf(stderr, "skipping %u cores, ALGO_N_CORES is %u (use benchmark_graph_algo_multicore)\n",
+                        multicore_cores[j], ALGO_N_CORES);
+        }
+        sizes = multicore_cores;
+    } else if (benchmark_type == ADMISSIBLE_BATCH_WIDTH) {
+        // init fractions
+        num_fractions = NUM_FRACTIONS_B;
+        fractions = batch_width_fractions;
+
+        // init parameter 2 - sizes
+        num_parameter_2 = NUM_SIZES_A;
+        sizes = admissible_sizes;
+    } else if (benchmark_type == ADMISSIBLE_TCLASS) {
+        // init fractions
+        num_fractions = NUM_FRACTIONS_T;
+        fractions = tclass_fractions;
+
+        // init parameter 2 - class policies
+        num_parameter_2 = NUM_POLICIES_T;
+    } else if (benchmark_type == ADMISSIBLE_OVERSUBSCRIPTION) {
+        // init fractions
+        num_fractions = NUM_FRACTIONS_O;
+        fractions = oversub_fractions;
+
+        // init parameter 2 - oversubscription ratios
+        num_parameter_2 = NUM_RATIOS_O;
+        sizes = oversub_ratios;
+        if (admissible_sizes[0] <= MAX_NODES_PER_RACK)
+            fprintf(stderr, "all %u nodes are in one rack, so no traffic uses the uplinks "
+                    "(use benchmark_graph_algo_racks)\n", admissible_sizes[0]);
+    } else if (benchmark_type == ADMISSIBLE_PREFETCH) {
+        // init fractions
+        num_fractions = NUM_FRACTIONS_F;
+        fractions = prefetch_fractions;
+
+        // init parameter 2 - prefetch offsets
+        num_parameter_2 = NUM_OFFSETS_F;
+        sizes = prefetch_offsets;
+    } else if (benchmark_type == ADMISSIBLE_DEADLINE) {
+        // init fractions
+        num_fractions = NUM_FRACTIONS_D;
+        fractions = deadline_fractions;
+
+        // init parameter 2 - bin policies
+        num_parameter_2 = NUM_POLICIES_D;
+    } else if (benchmark_type == ADMISSIBLE_WORK_STEALING) {
+        // init fractions
+        num_fractions = NUM_FRACTIONS_W;
+        fractions = stealing_fractions;
+
+        // init parameter 2 - workload x cores x stealing off/on
+        num_parameter_2 = NUM_WORKLOADS_W * NUM_CORES_W * 2;
+        sizes = stealing_cores;
+        for (j = 0; j < NUM_CORES_W; j++) {
+            if (stealing_cores[j] > ALGO_N_CORES)
+                fprintf(stderr, "skipping %u cores, ALGO_N_CORES is %u (use benchmark_graph_algo_multicore)\n",
+                        stealing_cores[j], ALGO_N_CORES);
+        }
     } else {
         // init fractions
         num_fractions = NUM_FRACTIONS_P;
@@ -219,7 +897,7 @@ int main(int argc, char **argv)
 
     // Data structures
     struct admissible_state *status;
-    struct fp_ring *q_bin;
+    struct fp_ring *q_bin[Q_BIN_RINGS];
     struct fp_ring *q_head;
     struct fp_ring *q_admitted_out;
     struct fp_ring *q_spent;
@@ -229,20 +907,24 @@ int main(int argc, char **argv)
     struct fp_ring *q_ready_partitions[NUM_BIN_RINGS];
 
     /* init queues */
-    q_bin = fp_ring_create(2 * FP_NODES_SHIFT);
-    q_head = fp_ring_create(2 * FP_NODES_SHIFT);
+    for (i = 0; i < Q_BIN_RINGS; i++) {
+            q_bin[i] = fp_ring_create_flags(BIN_RING_LOG_SIZE,
+                                            FP_RING_F_SP_ENQ | FP_RING_F_SC_DEQ);
+            if (!q_bin[i]) exit(-1);
+    }
+    q_head = fp_ring_create(BIN_RING_LOG_SIZE);
     q_admitted_out = fp_ring_create(ADMITTED_OUT_RING_LOG_SIZE);
-    q_spent = fp_ring_create(2 * FP_NODES_SHIFT);
-    bin_mempool = fp_mempool_create(BIN_MEMPOOL_SIZE, bin_num_bytes(SMALL_BIN_SIZE));
-    admitted_traffic_mempool = fp_mempool_create(ADMITTED_TRAFFIC_MEMPOOL_SIZE,
-    		sizeof(struct admitted_traffic));
+    q_spent = fp_ring_create(BIN_RING_LOG_SIZE);
+    bin_mempool = fp_mempool_create(BIN_MEMPOOL_SIZE, bin_num_bytes(SMALL_BIN_SIZE),
+    		BIN_MEMPOOL_CACHE_SIZE);
+    admitted_traffic_mempool = fp_mempool_create(admitted_mempool_size,
+    		sizeof(struct admitted_traffic), ADMITTED_TRAFFIC_CACHE_SIZE);
     for (i = 0; i < NUM_BIN_RINGS; i++) {
             q_new_demands[i] = fp_ring_create(BIN_RING_SHIFT);
             if (!q_new_demands[i]) exit(-1);
             q_ready_partitions[i] = fp_ring_create(READY_PARTITIONS_Q_SIZE);
             if (!q_ready_partitions[i]) exit(-1);
     }
-    if (!q_bin) exit(-1);
     if (!q_head) exit(-1);
     if (!q_admitted_out) exit(-1);
     if (!q_spent) exit(-1);
@@ -253,12 +935,18 @@ int main(int argc, char **argv)
     status = create_admissible_state(false, 0, 0, 0, q_head, q_admitted_out,
                                      q_spent, bin_mempool,
                                      admitted_traffic_mempool,
-                                     &q_bin, &q_new_demands[0],
+                                     &q_bin[0], &q_new_demands[0],
                                      &q_ready_partitions[0]);
     if (status == NULL) {
         printf("Error initializing admissible_status!\n");
         exit(-1);
     }
+    // only the multi-core benchmark runs more than one admission core
+    set_admission_n_cores(status, 1);
+    if (benchmark_type == ADMISSIBLE_MULTICORE || benchmark_type == ADMISSIBLE_WORK_STEALING) {
+        fp_set_lcore_id(0);
+        pin_thread_to_cpu(pthread_self(), 0);
+    }
 
     /* allocate space to record times */
     uint16_t num_batches = (duration - warm_up_duration) / BATCH_SIZE;
@@ -273,10 +961,33 @@ int main(int argc, char **argv)
     uint16_t *per_timeslot_num_admitted = malloc(sizeof(uint16_t) * num_timeslots);
     assert(per_timeslot_num_admitted != NULL);
 
+    /* allocate space to record batch start and end times in multi-core runs */
+    uint32_t num_all_batches = duration / BATCH_SIZE;
+    uint64_t *batch_start = malloc(sizeof(uint64_t) * num_all_batches);
+    uint64_t *batch_end = malloc(sizeof(uint64_t) * num_all_batches);
+    uint64_t *batch_latency = malloc(sizeof(uint64_t) * num_batches);
+    assert(batch_start != NULL && batch_end != NULL && batch_latency != NULL);
+
     if (benchmark_type == ADMISSIBLE)
         printf("target_utilization, nodes, time, observed_utilization, time/utilzn\n");
     else if (benchmark_type == PATH_SELECTION_OVERSUBSCRIPTION)
         printf("target_utilization, oversubscription_ratio, time, observed_utilization, time/utilzn, num_admitted\n"); 
+    else if (benchmark_type == ADMISSIBLE_SCALING)
+        printf("target_utilization, nodes, time, observed_utilization, tslots_per_sec, backlog_entries, backlog_table_kb, dense_backlog_kb, max_rss_mb\n");
+    else if (benchmark_type == ADMISSIBLE_MULTICORE)
+        printf("target_utilization, cores, nodes, tslots_per_sec, observed_utilization, batch_p50_us, batch_p90_us, batch_p99_us, batch_max_us, q_bin_mean, q_bin_max\n");
+    else if (benchmark_type == ADMISSIBLE_BATCH_WIDTH)
+        printf("batch_size, target_utilization, nodes, tslots_per_sec, observed_utilization, batch_p50_us, batch_p99_us, batch_max_us\n");
+    else if (benchmark_type == ADMISSIBLE_TCLASS)
+        printf("policy, target_utilization, nodes, observed_utilization, tclass, demand_share, admitted_share, mean_delay_tslots\n");
+    else if (benchmark_type == ADMISSIBLE_OVERSUBSCRIPTION)
+        printf("oversubscription, inter_rack_capacity, target_utilization, nodes, nodes_per_rack, tslots_per_sec, observed_utilization\n");
+    else if (benchmark_type == ADMISSIBLE_PREFETCH)
+        printf("prefetch_offset, target_utilization, nodes, tslots_per_sec, observed_utilization, spent_us_per_tslot\n");
+    else if (benchmark_type == ADMISSIBLE_DEADLINE)
+        printf("policy, target_utilization, nodes, observed_utilization, short_flows, deadline_miss, short_fct_mean\n");
+    else if (benchmark_type == ADMISSIBLE_WORK_STEALING)
+        printf("workload, work_stealing, target_utilization, cores, nodes, tslots_per_sec, observed_utilization, batch_p50_us, batch_p99_us, q_bin_mean, stolen_batches\n");
     else
         printf("target_utilization, num_racks, time, observed_utilization, time/utilzn, num_admitted\n"); 
 
@@ -285,14 +996,62 @@ int main(int argc, char **argv)
         for (j = 0; j < num_parameter_2; j++) {
             double fraction = fractions[i];
             uint32_t num_nodes;
-            uint8_t num_racks;
-            uint16_t inter_rack_capacity;
+            uint32_t n_cores = 1;
+            uint8_t num_racks = 0;
+            uint16_t inter_rack_capacity = 0;
+            enum stealing_workload workload = WORKLOAD_UNIFORM;
+            bool work_stealing = false;
 
             // Initialize data structures
-            if (benchmark_type == ADMISSIBLE) {
+            if (benchmark_type == ADMISSIBLE || benchmark_type == ADMISSIBLE_SCALING ||
+                benchmark_type == ADMISSIBLE_BATCH_WIDTH) {
                 num_nodes = sizes[j];
                 reset_admissible_state(status, false, 0, 0, num_nodes);
             }
+            else if (benchmark_type == ADMISSIBLE_MULTICORE) {
+                num_nodes = NUM_NODES_M;
+                n_cores = sizes[j];
+                reset_admissible_state(status, false, 0, 0, num_nodes);
+                set_admission_n_cores(status, n_cores);
+            }
+            else if (benchmark_type == ADMISSIBLE_WORK_STEALING) {
+                workload = j / (NUM_CORES_W * 2);
+                n_cores = sizes[(j / 2) % NUM_CORES_W];
+                work_stealing = j % 2;
+                if (n_cores > ALGO_N_CORES)
+                    continue;
+                num_nodes = NUM_NODES_M;
+                reset_admissible_state(status, false, 0, 0, num_nodes);
+                set_admission_n_cores(status, n_cores);
+            }
+            else if (benchmark_type == ADMISSIBLE_TCLASS) {
+                num_nodes = admissible_sizes[0];
+                reset_admissible_state(status, false, 0, 0, num_nodes);
+                set_admission_tclass_policy(status,
+                        (j == 2) ? TCLASS_POLICY_WEIGHTED : TCLASS_POLICY_STRICT,
+                        NUM_TCLASSES_T, tclass_weights);
+            }
+            else if (benchmark_type == ADMISSIBLE_DEADLINE) {
+                num_nodes = admissible_sizes[0];
+                reset_admissible_state(status, false, 0, 0, num_nodes);
+                set_admission_bin_policy(status, deadline_policies[j]);
+            }
+            else if (benchmark_type == ADMISSIBLE_PREFETCH) {
+                // the largest cluster of the scaling benchmark that fits this build
+                num_nodes = scaling_sizes[0];
+                for (k = 0; k < NUM_SIZES_S; k++) {
+                    if (scaling_sizes[k] <= MAX_NODES)
+                        num_nodes = scaling_sizes[k];
+                }
+                reset_admissible_state(status, false, 0, 0, num_nodes);
+                set_admission_prefetch_offset(status, sizes[j]);
+            }
+            else if (benchmark_type == ADMISSIBLE_OVERSUBSCRIPTION) {
+                num_nodes = admissible_sizes[0];
+                inter_rack_capacity = sizes[j] ? MAX_NODES_PER_RACK / sizes[j] : 0;
+                reset_admissible_state(status, sizes[j] != 0, inter_rack_capacity, 0,
+                                       num_nodes);
+            }
             else if (benchmark_type == PATH_SELECTION_OVERSUBSCRIPTION) {
                 num_nodes = NUM_NODES_P;
                 inter_rack_capacity = capacities[j];
@@ -307,19 +1066,184 @@ int main(int argc, char **argv)
             }
 
             struct bin *b;
-            while (fp_ring_dequeue(q_bin, (void **)&b) == 0) {
-            	if (b != NULL)
+            for (k = 0; k < Q_BIN_RINGS; k++) {
+                while (fp_ring_dequeue(q_bin[k], (void **)&b) == 0) {
+                    if (b != NULL)
                         fp_mempool_put(bin_mempool, b);
+                }
             }
 
             // Allocate enough space for new requests
             // (this is sufficient for <= 1 request per node per timeslot)
             uint32_t max_requests = duration * num_nodes;
+            // requests average mean timeslots, so allow 5x the expected number
+            if (benchmark_type == ADMISSIBLE_SCALING || benchmark_type == ADMISSIBLE_MULTICORE ||
+                benchmark_type == ADMISSIBLE_PREFETCH || benchmark_type == ADMISSIBLE_WORK_STEALING)
+                max_requests = 5 * duration * (num_nodes / mean);
             struct request_info *requests = malloc(max_requests * sizeof(struct request_info));
+            assert(requests != NULL);
 
             // Generate new requests
             uint32_t num_requests = generate_requests_poisson(requests, max_requests, num_nodes,
                                                               duration, fraction, mean);
+            if (benchmark_type == ADMISSIBLE_WORK_STEALING)
+                skew_requests(requests, num_requests, num_nodes, workload);
+
+#ifdef BENCHMARK_ALLOC_ENGINES
+            if (engine != NULL) {
+                // A new engine state per experiment
+                struct alloc_engine_params params;
+                struct admissible_state *engine_state;
+                struct request_info *next_request;
+                memset(&params, 0, sizeof(params));
+                params.num_nodes = num_nodes;
+                params.q_admitted_out = q_admitted_out;
+                params.admitted_traffic_mempool = admitted_traffic_mempool;
+                engine_state = engine->init(&params);
+                if (engine_state == NULL) {
+                    printf("Error initializing %s engine!\n", engine->name);
+                    exit(-1);
+                }
+
+                run_experiment_engine(engine, engine_state, requests, 0, warm_up_duration,
+                                      num_requests, q_admitted_out,
+                                      admitted_traffic_mempool, &next_request);
+
+                uint64_t start_time = current_time();
+                uint32_t num_admitted = run_experiment_engine(engine, engine_state,
+                        next_request, warm_up_duration, duration,
+                        num_requests - (next_request - requests), q_admitted_out,
+                        admitted_traffic_mempool, &next_request);
+                uint64_t end_time = current_time();
+
+                double utilzn = ((double) num_admitted) / ((duration - warm_up_duration) * num_nodes);
+                double time_per_experiment = (end_time - start_time)/ (PROCESSOR_SPEED * 1000 * num_batches * BATCH_SIZE);
+                printf("%f, %d, %f, %f, %f\n", fraction, num_nodes, time_per_experiment,
+                       utilzn, time_per_experiment / utilzn);
+
+                engine->destroy(engine_state);
+                free(requests);
+                continue;
+            }
+#endif
+
+            if (benchmark_type == ADMISSIBLE_MULTICORE ||
+                benchmark_type == ADMISSIBLE_WORK_STEALING) {
+                // Warm-up and experiment in one run, so cores keep allocating batches in turn
+                struct multicore_stats stats;
+                uint32_t warm_up_batches = warm_up_duration / BATCH_SIZE;
+                run_experiment_multicore(requests, num_requests, status, n_cores,
+                                         work_stealing, num_all_batches, warm_up_batches,
+                                         &q_bin[0], batch_start, batch_end, &stats);
+
+                uint64_t first_start = batch_start[warm_up_batches];
+                uint64_t last_end = 0;
+                uint32_t b;
+                for (b = warm_up_batches; b < num_all_batches; b++) {
+                    batch_latency[b - warm_up_batches] = batch_end[b] - batch_start[b];
+                    if (batch_start[b] < first_start)
+                        first_start = batch_start[b];
+                    if (batch_end[b] > last_end)
+                        last_end = batch_end[b];
+                }
+                qsort(batch_latency, num_batches, sizeof(uint64_t), compare_uint64);
+
+                double cycles_per_us = PROCESSOR_SPEED * 1000;
+                double tslots_per_sec = (num_batches * BATCH_SIZE) /
+                        ((last_end - first_start) / (cycles_per_us * 1e6));
+                double utilzn = ((double) stats.num_admitted) / ((duration - warm_up_duration) * num_nodes);
+                if (benchmark_type == ADMISSIBLE_WORK_STEALING) {
+                    printf("%s, %d, %f, %d, %d, %f, %f, %f, %f, %f, %lu\n",
+                           stealing_workload_names[workload], work_stealing, fraction,
+                           n_cores, num_nodes, tslots_per_sec, utilzn,
+                           batch_latency[num_batches / 2] / cycles_per_us,
+                           batch_latency[num_batches * 99 / 100] / cycles_per_us,
+                           stats.q_bin_samples ? ((double) stats.q_bin_sum) / stats.q_bin_samples : 0,
+                           stats.stolen_batches);
+                    free(requests);
+                    continue;
+                }
+                printf("%f, %d, %d, %f, %f, %f, %f, %f, %f, %f, %u\n", fraction, n_cores,
+                       num_nodes, tslots_per_sec, utilzn,
+                       batch_latency[num_batches / 2] / cycles_per_us,
+                       batch_latency[num_batches * 9 / 10] / cycles_per_us,
+                       batch_latency[num_batches * 99 / 100] / cycles_per_us,
+                       batch_latency[num_batches - 1] / cycles_per_us,
+                       stats.q_bin_samples ? ((double) stats.q_bin_sum) / stats.q_bin_samples : 0,
+                       stats.q_bin_max);
+
+                free(requests);
+                continue;
+            }
+
+            if (benchmark_type == ADMISSIBLE_TCLASS) {
+                // Warm-up and experiment in one run, to track demand across both
+                struct tclass_stats stats;
+                uint64_t total_requested = 0;
+                uint64_t total_admitted = 0;
+                run_experiment_tclass(requests, warm_up_duration, duration, num_requests,
+                                      status, j != 0, &stats);
+
+                for (k = 0; k < NUM_TCLASSES_T; k++) {
+                    total_requested += stats.requested[k];
+                    total_admitted += stats.admitted[k];
+                }
+                double utilzn = ((double) total_admitted) / ((duration - warm_up_duration) * num_nodes);
+                for (k = 0; k < NUM_TCLASSES_T; k++) {
+                    printf("%s, %f, %d, %f, %d, %f, %f, %f\n", tclass_policy_names[j],
+                           fraction, num_nodes, utilzn, k,
+                           ((double) stats.requested[k]) / total_requested,
+                           ((double) stats.admitted[k]) / total_admitted,
+                           stats.admitted[k] ? ((double) stats.queued_tslots[k]) / stats.admitted[k] : 0);
+                }
+
+                free(requests);
+                continue;
+            }
+
+            if (benchmark_type == ADMISSIBLE_DEADLINE) {
+                // Warm-up and experiment in one run, so requests complete across both
+                struct fct_state fs;
+                uint32_t n_due = 0, n_missed = 0, n_done = 0;
+                double short_fct_sum = 0;
+                uint32_t r;
+                // drop demands left over from the previous experiment, which
+                // would complete requests of this one
+                flush_backlog(status);
+                while (fp_ring_dequeue(q_head, (void **)&b) == 0)
+                    fp_mempool_put(bin_mempool, b);
+                while (fp_ring_dequeue(q_spent, (void **)&b) == 0)
+                    fp_mempool_put(bin_mempool, b);
+                fct_init(&fs, requests, num_requests, num_nodes);
+                uint32_t num_admitted = run_experiment_deadline(requests, warm_up_duration,
+                                                                duration, num_requests,
+                                                                status, &fs);
+
+                // Short flows issued after warm-up that were due before the end
+                for (r = 0; r < num_requests; r++) {
+                    uint32_t deadline = benchmark_request_deadline(&requests[r]);
+                    uint32_t issued = requests[r].timeslot & ~(BATCH_SIZE - 1);
+                    if (deadline == 0 || requests[r].timeslot < warm_up_duration ||
+                        issued + deadline > duration)
+                        continue;
+                    n_due++;
+                    if (fs.fct[r] == 0 || fs.fct[r] > deadline)
+                        n_missed++;
+                    if (fs.fct[r] != 0) {
+                        n_done++;
+                        short_fct_sum += fs.fct[r];
+                    }
+                }
+
+                double utilzn = ((double) num_admitted) / ((duration - warm_up_duration) * num_nodes);
+                printf("%s, %f, %d, %f, %u, %f, %f\n", deadline_policy_names[j], fraction,
+                       num_nodes, utilzn, n_due, n_due ? ((double) n_missed) / n_due : 0,
+                       n_done ? short_fct_sum / n_done : 0);
+
+                fct_free(&fs);
+                free(requests);
+                continue;
+            }
 
             // Issue/process some requests. This is a warm-up period so that there are pending
             // requests once we start timing
@@ -353,6 +1277,90 @@ int main(int argc, char **argv)
 //                           utilzn, time_per_experiment / utilzn);
                 }
             }
+            else if (benchmark_type == ADMISSIBLE_SCALING) {
+                // Start timining
+                uint64_t start_time = current_time();
+
+                // Run the experiment
+                uint32_t num_admitted = run_experiment(next_request, warm_up_duration, duration,
+                                                       num_requests - (next_request - requests),
+                                                       status, &next_request, per_batch_times);
+                uint64_t end_time = current_time();
+
+                double utilzn = ((double) num_admitted) / ((duration - warm_up_duration) * num_nodes);
+                double time_per_tslot = (end_time - start_time)/ (PROCESSOR_SPEED * 1000 * num_batches * BATCH_SIZE);
+
+                // memory: the sparse backlog table vs. dense per-pair backlog and
+                // last allocation arrays
+                struct backlog *backlog = &((struct seq_admissible_status *) status)->backlog;
+                double dense_kb = ((double) num_nodes * num_nodes *
+                                   (sizeof(uint32_t) + sizeof(uint64_t) + 1.0 / 8)) / 1024;
+                printf("%f, %d, %f, %f, %f, %u, %lu, %f, %f\n", fraction, num_nodes,
+                       time_per_tslot, utilzn, 1e6 / time_per_tslot, backlog->n_entries,
+                       sizeof(struct backlog) / 1024, dense_kb, get_max_rss_mb());
+            }
+            else if (benchmark_type == ADMISSIBLE_BATCH_WIDTH) {
+                // Start timing
+                uint64_t start_time = current_time();
+
+                // Run the experiment
+                uint32_t num_admitted = run_experiment(next_request, warm_up_duration, duration,
+                                                       num_requests - (next_request - requests),
+                                                       status, &next_request, per_batch_times);
+                uint64_t end_time = current_time();
+
+                // a batch is admitted only after all of it is allocated, so the time
+                // to allocate a batch bounds how early its first timeslot can be sent
+                uint32_t b;
+                for (b = 0; b < num_batches; b++)
+                    batch_latency[b] = per_batch_times[b];
+                qsort(batch_latency, num_batches, sizeof(uint64_t), compare_uint64);
+
+                double cycles_per_us = PROCESSOR_SPEED * 1000;
+                double utilzn = ((double) num_admitted) / ((duration - warm_up_duration) * num_nodes);
+                double tslots_per_sec = (num_batches * BATCH_SIZE) /
+                        ((end_time - start_time) / (cycles_per_us * 1e6));
+                printf("%d, %f, %d, %f, %f, %f, %f, %f\n", BATCH_SIZE, fraction, num_nodes,
+                       tslots_per_sec, utilzn,
+                       batch_latency[num_batches / 2] / cycles_per_us,
+                       batch_latency[num_batches * 99 / 100] / cycles_per_us,
+                       batch_latency[num_batches - 1] / cycles_per_us);
+            }
+            else if (benchmark_type == ADMISSIBLE_PREFETCH) {
+                // Start timing
+                uint64_t spent_time;
+                uint64_t start_time = current_time();
+
+                // Run the experiment
+                uint32_t num_admitted = run_experiment_prefetch(next_request, warm_up_duration,
+                                                                duration,
+                                                                num_requests - (next_request - requests),
+                                                                status, &next_request, &spent_time);
+                uint64_t end_time = current_time();
+
+                double utilzn = ((double) num_admitted) / ((duration - warm_up_duration) * num_nodes);
+                double tslots_per_sec = (num_batches * BATCH_SIZE) /
+                        ((end_time - start_time) / (PROCESSOR_SPEED * 1e9));
+                printf("%u, %f, %d, %f, %f, %f\n", sizes[j], fraction, num_nodes,
+                       tslots_per_sec, utilzn,
+                       spent_time / (PROCESSOR_SPEED * 1000 * num_batches * BATCH_SIZE));
+            }
+            else if (benchmark_type == ADMISSIBLE_OVERSUBSCRIPTION) {
+                // Start timing
+                uint64_t start_time = current_time();
+
+                // Run the experiment
+                uint32_t num_admitted = run_experiment(next_request, warm_up_duration, duration,
+                                                       num_requests - (next_request - requests),
+                                                       status, &next_request, per_batch_times);
+                uint64_t end_time = current_time();
+
+                double utilzn = ((double) num_admitted) / ((duration - warm_up_duration) * num_nodes);
+                double tslots_per_sec = (num_batches * BATCH_SIZE) /
+                        ((end_time - start_time) / (PROCESSOR_SPEED * 1e9));
+                printf("%u, %d, %f, %d, %d, %f, %f\n", sizes[j], inter_rack_capacity,
+                       fraction, num_nodes, MAX_NODES_PER_RACK, tslots_per_sec, utilzn);
+            }
             else if (benchmark_type == PATH_SELECTION_OVERSUBSCRIPTION ||
                      benchmark_type == PATH_SELECTION_RACKS) {
                 // Run the admissible algorithm to generate admitted traffic
@@ -418,6 +1426,8 @@ int main(int argc, char **argv)
                     }
                 }
             }
+
+            free(requests);
         }
     }
 
@@ -426,4 +1436,7 @@ int main(int argc, char **argv)
     free(per_batch_times);
     free(per_timeslot_times);
     free(per_timeslot_num_admitted);
+    free(batch_start);
+    free(batch_end);
+    free(batch_latency);
 }
@@ -0,0 +1,239 @@
+/*
+ * benchmark_path_sel.c
+ *
+ * Measures path selection throughput in timeslots per second against the
+ * number of path selection cores sharing a path_sel_pipeline. The main thread
+ * feeds random admitted matchings into the pipeline and checks that they come
+ * back in the order they went in, with valid paths. The serial rows are
+ * path selection in a loop on one thread, without the pipeline, with Euler
+ * splits (when NUM_PATHS is a power of two) and with Kapoor-Rizzi. The
+ * pipeline uses select_paths, which picks one of the two.
+ *
+ * usage: ./benchmark_path_sel [timeslots]
+ */
+
+#define _GNU_SOURCE /* for pthread_setaffinity_np */
+
+#include "path_sel_pipeline.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_RACKS                       (MAX_NODES / MAX_NODES_PER_RACK)
+#define POOL_SIZE                       256 /* timeslots in flight */
+#define RING_LOG_SIZE                   10
+#define NUM_CORE_COUNTS                 4
+#define DEFAULT_TIMESLOTS               100000
+#define SPINS_BEFORE_YIELD              1024
+
+const uint16_t core_counts [NUM_CORE_COUNTS] =
+        {1, 2, 4, 8};
+
+struct path_sel_pipeline pipeline;
+struct admitted_traffic pool[POOL_SIZE];
+
+struct path_sel_thread {
+        pthread_t thread;
+        uint16_t core_index;
+        volatile bool *stop;
+} __attribute__((aligned(64)));
+
+uint64_t time_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Pins a thread to a CPU, wrapping around if there are fewer CPUs
+void pin_thread_to_cpu(pthread_t thread, uint32_t cpu)
+{
+        cpu_set_t cpu_set;
+        long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpu % (num_cpus > 0 ? num_cpus : 1), &cpu_set);
+        if (pthread_setaffinity_np(thread, sizeof(cpu_set), &cpu_set) != 0)
+                fprintf(stderr, "could not pin thread to cpu %u\n", cpu);
+}
+
+// Fills admitted with a random permutation of all nodes
+void generate_matching(struct admitted_traffic *admitted)
+{
+        uint16_t dsts[MAX_NODES];
+        uint16_t i, j, tmp;
+
+        for (i = 0; i < MAX_NODES; i++)
+                dsts[i] = i;
+        for (i = MAX_NODES - 1; i > 0; i--) {
+                j = rand() % (i + 1);
+                tmp = dsts[i];
+                dsts[i] = dsts[j];
+                dsts[j] = tmp;
+        }
+
+        init_admitted_traffic(admitted);
+        for (i = 0; i < MAX_NODES; i++)
+                insert_admitted_edge(admitted, i, dsts[i]);
+}
+
+// Clears the paths selected for admitted, so it can be selected again
+void clear_paths(struct admitted_traffic *admitted)
+{
+        uint16_t i;
+
+        for (i = 0; i < admitted->size; i++)
+                admitted->edges[i].dst &= PATH_MASK;
+}
+
+// Selects paths for n_timeslots with select_fn in a loop, returns the time
+// taken in ns
+uint64_t run_serial(uint32_t n_timeslots,
+                    void (*select_fn)(struct admitted_traffic *, uint8_t),
+                    uint32_t *n_invalid)
+{
+        uint32_t i;
+
+        uint64_t start_time = time_ns();
+        for (i = 0; i < n_timeslots; i++) {
+                select_fn(&pool[i % POOL_SIZE], NUM_RACKS);
+                if (i < POOL_SIZE && !paths_are_valid(&pool[i], NUM_RACKS))
+                        (*n_invalid)++;
+                clear_paths(&pool[i % POOL_SIZE]);
+        }
+        return time_ns() - start_time;
+}
+
+// Polls the pipeline until told to stop
+void *run_path_sel_core(void *arg)
+{
+        struct path_sel_thread *t = (struct path_sel_thread *) arg;
+        uint32_t spins = 0;
+
+        fp_set_lcore_id(1 + t->core_index);
+        while (!__atomic_load_n(t->stop, __ATOMIC_ACQUIRE)) {
+                if (path_sel_pipeline_poll(&pipeline)) {
+                        spins = 0;
+                        continue;
+                }
+
+                /* let other threads run when sharing a cpu */
+                if (++spins == SPINS_BEFORE_YIELD) {
+                        sched_yield();
+                        spins = 0;
+                }
+                fp_pause();
+        }
+        return NULL;
+}
+
+// Feeds n_timeslots through the pipeline, returns the time taken in ns
+uint64_t run_pipeline(uint32_t n_timeslots, struct fp_ring *q_admitted,
+                      struct fp_ring *q_path_selected, uint32_t *n_invalid)
+{
+        struct admitted_traffic *admitted;
+        uint32_t sent = 0, received = 0, spins = 0;
+
+        uint64_t start_time = time_ns();
+        while (received < n_timeslots) {
+                /* keep up to POOL_SIZE timeslots in flight */
+                while (sent < n_timeslots && sent - received < POOL_SIZE) {
+                        if (fp_ring_enqueue(q_admitted, &pool[sent % POOL_SIZE]) != 0)
+                                break;
+                        sent++;
+                }
+
+                if (fp_ring_dequeue(q_path_selected, (void **) &admitted) != 0) {
+                        if (++spins == SPINS_BEFORE_YIELD) {
+                                sched_yield();
+                                spins = 0;
+                        }
+                        fp_pause();
+                        continue;
+                }
+
+                if (admitted != &pool[received % POOL_SIZE]) {
+                        printf("timeslot %u delivered out of order\n", received);
+                        exit(-1);
+                }
+                if (received < POOL_SIZE &&
+                    !paths_are_valid(admitted, NUM_RACKS))
+                        (*n_invalid)++;
+                clear_paths(admitted);
+                received++;
+        }
+        return time_ns() - start_time;
+}
+
+int main(int argc, char **argv) {
+        struct path_sel_thread threads[8];
+        uint32_t n_timeslots = (argc > 1) ? strtoul(argv[1], NULL, 10)
+                : DEFAULT_TIMESLOTS;
+        struct fp_ring *q_admitted, *q_path_selected;
+        uint32_t i, c, n_invalid;
+        uint64_t elapsed;
+
+        fp_set_lcore_id(0);
+
+        srand(1);
+        for (i = 0; i < POOL_SIZE; i++)
+                generate_matching(&pool[i]);
+
+        q_admitted = fp_ring_create(RING_LOG_SIZE);
+        q_path_selected = fp_ring_create(RING_LOG_SIZE);
+
+        printf("mode, method, racks, paths, cores, timeslots, tslots_per_sec, "
+               "ns_per_tslot, invalid\n");
+
+        /* each method in a loop */
+        if ((NUM_PATHS & (NUM_PATHS - 1)) == 0) {
+                n_invalid = 0;
+                elapsed = run_serial(n_timeslots, select_paths_euler, &n_invalid);
+                printf("serial, euler, %u, %u, %u, %u, %f, %f, %u\n", NUM_RACKS,
+                       NUM_PATHS, 1, n_timeslots,
+                       (double) n_timeslots * 1e9 / elapsed,
+                       (double) elapsed / n_timeslots, n_invalid);
+        }
+        n_invalid = 0;
+        elapsed = run_serial(n_timeslots, select_paths_kapoor_rizzi, &n_invalid);
+        printf("serial, kapoor_rizzi, %u, %u, %u, %u, %f, %f, %u\n", NUM_RACKS,
+               NUM_PATHS, 1, n_timeslots, (double) n_timeslots * 1e9 / elapsed,
+               (double) elapsed / n_timeslots, n_invalid);
+
+        for (c = 0; c < NUM_CORE_COUNTS; c++) {
+                uint16_t n_cores = core_counts[c];
+                volatile bool stop = false;
+
+                path_sel_pipeline_init(&pipeline, q_admitted, q_path_selected,
+                                       NUM_RACKS);
+
+                for (i = 0; i < n_cores; i++) {
+                        threads[i].core_index = i;
+                        threads[i].stop = &stop;
+                        if (pthread_create(&threads[i].thread, NULL,
+                                           run_path_sel_core, &threads[i]) != 0) {
+                                printf("Error creating path selection thread\n");
+                                exit(-1);
+                        }
+                        pin_thread_to_cpu(threads[i].thread, i + 1);
+                }
+
+                n_invalid = 0;
+                elapsed = run_pipeline(n_timeslots, q_admitted, q_path_selected,
+                                       &n_invalid);
+
+                __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+                for (i = 0; i < n_cores; i++)
+                        pthread_join(threads[i].thread, NULL);
+
+                printf("pipeline, %s, %u, %u, %u, %u, %f, %f, %u\n",
+                       PATH_SEL_KAPOOR_RIZZI ? "kapoor_rizzi" : "euler",
+                       NUM_RACKS, NUM_PATHS, n_cores, n_timeslots,
+                       (double) n_timeslots * 1e9 / elapsed,
+                       (double) elapsed / n_timeslots, n_invalid);
+        }
+}
@@ -5,196 +5,565 @@
  *      Author: aousterh
  */
 
+#define _GNU_SOURCE /* for pthread_setaffinity_np */
+
 #include <inttypes.h>
 #include <math.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "rdtsc.h"  // For timing
-#include "admissible_traffic_sjf.h"
-#include "admissible_structures_sjf.h"
+#include "admissible.h"
 #include "generate_requests.h"
+#include "request_completion.h"
 
 #define NUM_FRACTIONS_A 11
 #define NUM_SIZES_A 5
-#define NUM_NODES_P 256
+#define NUM_POLICIES 2
+#define NUM_FRACTIONS_M 2
+#define NUM_CORES_M 5
+#define NUM_NODES_M 256
+#define MIN_KEPT_UP 0.98 /* utilization, as a fraction of the load, of runs
+                            that keep up with the load */
 #define PROCESSOR_SPEED 2.8
+#define SHORT_FLOW_TSLOTS 10 /* flows up to this size count as short */
+#define BIN_MEMPOOL_SIZE (2 * LARGE_BIN_SIZE / SMALL_BIN_SIZE)
+#define BIN_MEMPOOL_CACHE_SIZE			NUM_BINS
+#define BIN_RING_LOG_SIZE				16 /* must hold BIN_MEMPOOL_SIZE bins */
+#define ADMITTED_TRAFFIC_CACHE_SIZE		(2 * BATCH_SIZE)
+/* every core can hold a batch while the comm core catches up, plus caches */
+#define ADMITTED_TRAFFIC_MEMPOOL_SIZE	(4 * ALGO_N_CORES * ADMITTED_PER_BATCH + \
+		(ALGO_N_CORES + 1) * 2 * ADMITTED_TRAFFIC_CACHE_SIZE)
+#define ADMITTED_OUT_RING_LOG_SIZE		16
 
 const double admissible_fractions [NUM_FRACTIONS_A] =
     {0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 0.95, 0.99};
 const uint32_t admissible_sizes [NUM_SIZES_A] =
     {2048, 1024, 512, 256, 128/*, 64, 32, 16*/};
+const enum bin_policy policies [NUM_POLICIES] =
+    {BIN_POLICY_LRU, BIN_POLICY_SJF};
+const char *policy_names [NUM_POLICIES] = {"lru", "sjf"};
+const double multicore_fractions [NUM_FRACTIONS_M] =
+    {0.5, 0.9};
+const uint32_t multicore_cores [NUM_CORES_M] =
+    {1, 2, 4, 8, 16};
+
+// State shared by the threads of a multi-core run. Batch b is allocated by
+// core b % n_cores, as in the arbiter.
+struct multicore_run {
+    struct admissible_state *status;
+    uint32_t n_cores;
+    uint32_t num_batches;
+    uint32_t batches_issued;   // requests for batches < batches_issued were added
+    uint32_t batches_started;  // batches < batches_started started allocating
+    uint8_t *batch_done;       // set once the batch's admitted traffic is recorded
+    struct admitted_traffic **admitted; // admitted traffic of every timeslot
+};
+
+struct multicore_core {
+    struct multicore_run *run;
+    uint32_t core_index;
+    pthread_t thread;
+};
+
+// Results of a multi-core run
+struct multicore_stats {
+    uint32_t num_admitted;   // timeslots admitted after warm-up, before draining
+    uint32_t over_admitted;  // timeslots admitted to flows with no unfinished request
+};
+
+int compare_uint32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
 
 // Runs one experiment. Returns the number of packets admitted.
 uint32_t run_experiment(struct request_info *requests, uint32_t start_time, uint32_t end_time,
-                        uint32_t num_requests, struct admissible_status *status,
-                        struct request_info **next_request,
-                        struct admission_core_state *core,
-                        struct admitted_traffic **admitted_batch)
+                        uint32_t num_requests, struct admissible_state *status,
+                        struct request_info **next_request, struct fct_state *fs,
+                        struct request_info *all_requests)
 {
     struct admitted_traffic *admitted;
-    struct fp_ring *queue_tmp;
 
     uint32_t b;
-    uint8_t i;
+    uint32_t i, e;
     uint32_t num_admitted = 0;
     struct request_info *current_request = requests;
 
     assert(requests != NULL);
-    assert(core->q_bin_in->tail == core->q_bin_in->head + NUM_BINS);
 
     for (b = (start_time >> BATCH_SHIFT); b < (end_time >> BATCH_SHIFT); b++) {
         // Issue all new requests for this batch
         while ((current_request->timeslot >> BATCH_SHIFT) == (b % (65536 >> BATCH_SHIFT)) &&
                current_request < requests + num_requests) {
-            add_backlog(status, current_request->src,
-                              current_request->dst, current_request->backlog);
+            add_backlog(status, current_request->src, current_request->dst,
+                        current_request->backlog);
             current_request++;
         }
- 
+        flush_backlog(status);
+
         // Get admissible traffic
-        get_admissible_traffic(core, status, admitted_batch, 0, 1, 0);
-
-        for (i = 0; i < BATCH_SIZE; i++) {
-        	/* get admitted traffic */
-        	fp_ring_dequeue(status->q_admitted_out, (void **)&admitted);
-        	/* update statistics */
-        	num_admitted += admitted->size;
-        	/* return admitted traffic to core */
-        	admitted_batch[i] = admitted;
+        get_admissible_traffic(status, 0, 0, 1, 0);
+        handle_spent_demands(status);
+
+        for (i = 0; i < ADMITTED_PER_BATCH; i++) {
+            uint32_t timeslot = b * BATCH_SIZE + i * BATCH_SIZE / ADMITTED_PER_BATCH;
+
+            /* get admitted traffic */
+            fp_ring_dequeue(get_q_admitted_out(status), (void **)&admitted);
+            /* update statistics */
+            num_admitted += admitted->size;
+            for (e = 0; e < admitted->size; e++)
+                fct_admit(fs, all_requests, admitted->edges[e].src,
+                          admitted->edges[e].dst, timeslot);
+            /* return admitted traffic to core */
+            fp_mempool_put(get_admitted_traffic_mempool(status), admitted);
         }
     }
 
     *next_request = current_request;
 
-    assert(core->q_bin_in->tail == core->q_bin_in->head + NUM_BINS);
 	return num_admitted;
 }
 
-int main(void)
+// Pins a thread to a CPU, wrapping around if there are fewer CPUs
+void pin_thread_to_cpu(pthread_t thread, uint32_t cpu)
+{
+    cpu_set_t cpu_set;
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu % (num_cpus > 0 ? num_cpus : 1), &cpu_set);
+    if (pthread_setaffinity_np(thread, sizeof(cpu_set), &cpu_set) != 0)
+        fprintf(stderr, "could not pin thread to cpu %u\n", cpu);
+}
+
+// Runs one admission core: allocates batches core_index, core_index + n_cores, ...
+// Each batch starts after its requests were issued and the previous batch started.
+void *run_admission_core(void *arg)
+{
+    struct multicore_core *core = (struct multicore_core *) arg;
+    struct multicore_run *run = core->run;
+    struct seq_admissible_status *seq = (struct seq_admissible_status *) run->status;
+    uint32_t b;
+
+    fp_set_lcore_id(1 + core->core_index);
+
+    for (b = core->core_index; b < run->num_batches; b += run->n_cores) {
+        while (__atomic_load_n(&run->batches_issued, __ATOMIC_ACQUIRE) <= b ||
+               __atomic_load_n(&run->batches_started, __ATOMIC_ACQUIRE) != b)
+            sched_yield();
+        __atomic_store_n(&run->batches_started, b + 1, __ATOMIC_RELEASE);
+
+        get_admissible_traffic(run->status, core->core_index, 0, 1, 0);
+
+        // Cores running concurrently interleave their timeslots in q_admitted_out,
+        // so take this batch's timeslots from the core itself
+        memcpy(&run->admitted[b * BATCH_SIZE], &seq->cores[core->core_index].admitted[0],
+               BATCH_SIZE * sizeof(struct admitted_traffic *));
+        __atomic_store_n(&run->batch_done[b], 1, __ATOMIC_RELEASE);
+    }
+
+    return NULL;
+}
+
+// Runs the allocator on n_cores threads for num_batches batches, while this
+// thread acts as the comm core: it issues requests up to n_cores batches
+// ahead of allocation, handles spent demands and counts admitted traffic
+// per timeslot, in timeslot order.
+void run_experiment_multicore(struct request_info *requests, uint32_t num_requests,
+                              struct admissible_state *status, uint32_t n_cores,
+                              uint32_t num_batches, uint32_t warm_up_batches,
+                              uint32_t measured_batches, struct fct_state *fs,
+                              struct multicore_stats *stats)
+{
+    struct multicore_run run;
+    struct multicore_core cores[ALGO_N_CORES];
+    struct request_info *current_request = requests;
+    struct admitted_traffic *admitted;
+    uint32_t b_issue = 0;
+    uint32_t b_done = 0;
+    uint32_t i, e;
+
+    assert(n_cores <= ALGO_N_CORES);
+
+    run.status = status;
+    run.n_cores = n_cores;
+    run.num_batches = num_batches;
+    run.batches_issued = 0;
+    run.batches_started = 0;
+    run.batch_done = calloc(num_batches, sizeof(uint8_t));
+    run.admitted = malloc(num_batches * BATCH_SIZE * sizeof(struct admitted_traffic *));
+    if (!run.batch_done || !run.admitted) exit(-1);
+    memset(stats, 0, sizeof(*stats));
+
+    for (i = 0; i < n_cores; i++) {
+        cores[i].run = &run;
+        cores[i].core_index = i;
+        if (pthread_create(&cores[i].thread, NULL, run_admission_core, &cores[i]) != 0) {
+            printf("Error creating admission core thread\n");
+            exit(-1);
+        }
+        pin_thread_to_cpu(cores[i].thread, 1 + i);
+    }
+
+    while (b_done < num_batches) {
+        uint32_t started = __atomic_load_n(&run.batches_started, __ATOMIC_ACQUIRE);
+        bool idle = true;
+
+        // Issue all new requests for the next batch, if it is close enough
+        if (b_issue < num_batches && b_issue < started + n_cores) {
+            while (current_request < requests + num_requests &&
+                   (current_request->timeslot >> BATCH_SHIFT) == (b_issue % (65536 >> BATCH_SHIFT))) {
+                // Batches still allocating can admit the request before its
+                // own batch, so its FCT counts from the oldest uncounted batch
+                fct_set_issued(fs, current_request - requests, b_done * BATCH_SIZE);
+                add_backlog(status, current_request->src, current_request->dst,
+                            current_request->backlog);
+                current_request++;
+            }
+            flush_backlog(status);
+            __atomic_store_n(&run.batches_issued, ++b_issue, __ATOMIC_RELEASE);
+            idle = false;
+        }
+
+        handle_spent_demands(status);
+
+        // Timeslots are counted from run.admitted below, and returned to the
+        // mempool from there
+        while (fp_ring_dequeue(get_q_admitted_out(status), (void **)&admitted) == 0)
+            idle = false;
+
+        while (b_done < num_batches &&
+               __atomic_load_n(&run.batch_done[b_done], __ATOMIC_ACQUIRE)) {
+            for (i = 0; i < BATCH_SIZE; i++) {
+                uint32_t timeslot = b_done * BATCH_SIZE + i;
+
+                admitted = run.admitted[timeslot];
+                if (b_done >= warm_up_batches && b_done < measured_batches)
+                    stats->num_admitted += admitted->size;
+                for (e = 0; e < admitted->size; e++) {
+                    if (!fct_try_admit(fs, requests, admitted->edges[e].src,
+                                       admitted->edges[e].dst, timeslot))
+                        stats->over_admitted++;
+                }
+                fp_mempool_put(get_admitted_traffic_mempool(status), admitted);
+            }
+            b_done++;
+            idle = false;
+        }
+
+        if (idle)
+            sched_yield();
+    }
+
+    for (i = 0; i < n_cores; i++)
+        pthread_join(cores[i].thread, NULL);
+
+    free(run.batch_done);
+    free(run.admitted);
+}
+
+// Drops bins and demands left in the queues by the previous experiment
+void drain_queues(struct admissible_state *status, struct fp_ring **q_bin,
+                  struct fp_ring *q_head, struct fp_ring *q_spent,
+                  struct fp_mempool *bin_mempool)
+{
+    struct bin *b;
+    uint32_t k;
+
+    for (k = 0; k < Q_BIN_RINGS; k++) {
+        while (fp_ring_dequeue(q_bin[k], (void **)&b) == 0) {
+            if (b != NULL)
+                fp_mempool_put(bin_mempool, b);
+        }
+    }
+    /* drop demands left over from the previous experiment */
+    flush_backlog(status);
+    while (fp_ring_dequeue(q_head, (void **)&b) == 0)
+        fp_mempool_put(bin_mempool, b);
+    while (fp_ring_dequeue(q_spent, (void **)&b) == 0)
+        fp_mempool_put(bin_mempool, b);
+}
+
+// Runs both policies on 1 to max_cores admission cores. After the requests,
+// the cores keep allocating until the backlog drains, so every request must
+// complete, and no flow may get more timeslots than it requested. Returns
+// the number of runs that failed these checks.
+uint32_t benchmark_sjf_multicore(struct admissible_state *status, uint32_t max_cores,
+                                 struct fp_ring **q_bin, struct fp_ring *q_head,
+                                 struct fp_ring *q_spent, struct fp_mempool *bin_mempool)
 {
-    uint16_t i, j, k;
+    uint32_t i, j, p, k;
+    uint32_t num_failed = 0;
+    uint32_t num_nodes = NUM_NODES_M;
+    double mean = 10; // Mean request size and inter-arrival time
+
+    // multi-core runs are shorter, as in benchmark_graph_algo
+    uint32_t warm_up_duration = ((2000 + 127) / 128) * 128;
+    uint32_t duration = warm_up_duration + ((8000 + 127) / 128) * 128;
+    uint32_t drain_duration = ((8000 + 127) / 128) * 128;
+    uint32_t warm_up_batches = warm_up_duration / BATCH_SIZE;
+    uint32_t measured_batches = duration / BATCH_SIZE;
+    uint32_t num_batches = (duration + drain_duration) / BATCH_SIZE;
+
+    printf("target_utilization, cores, nodes, observed_utilization, policy, fct_mean, "
+           "fct_p99, short_fct_mean, completed, over_admitted\n");
+
+    for (i = 0; i < NUM_FRACTIONS_M; i++) {
+        double fraction = multicore_fractions[i];
+
+        // requests average mean timeslots, so allow 5x the expected number
+        uint32_t max_requests = 5 * duration * (num_nodes / mean);
+        struct request_info *requests = malloc(max_requests * sizeof(struct request_info));
+        uint32_t *fcts = malloc(max_requests * sizeof(uint32_t));
+        if (!requests || !fcts) exit(-1);
+
+        // Generate new requests, the same for all runs
+        uint32_t num_requests = generate_requests_poisson(requests, max_requests, num_nodes,
+                                                          duration, fraction, mean);
+        uint32_t first_measured = 0;
+        while (first_measured < num_requests &&
+               requests[first_measured].timeslot < warm_up_duration)
+            first_measured++;
+
+        for (j = 0; j < NUM_CORES_M; j++) {
+            uint32_t n_cores = multicore_cores[j];
+            double short_fct[NUM_POLICIES];
+            bool kept_up = true;
+
+            if (n_cores > max_cores || n_cores > ALGO_N_CORES)
+                continue;
+
+            for (p = 0; p < NUM_POLICIES; p++) {
+                struct fct_state fs;
+                struct multicore_stats stats;
+
+                // Initialize data structures
+                reset_admissible_state(status, false, 0, 0, num_nodes);
+                set_admission_n_cores(status, n_cores);
+                set_admission_bin_policy(status, policies[p]);
+                drain_queues(status, q_bin, q_head, q_spent, bin_mempool);
+                fct_init(&fs, requests, num_requests, num_nodes);
+
+                // Warm-up, experiment and draining in one run, so cores keep
+                // allocating batches in turn
+                run_experiment_multicore(requests, num_requests, status, n_cores,
+                                         num_batches, warm_up_batches, measured_batches,
+                                         &fs, &stats);
+
+                double utilzn = ((double) stats.num_admitted) /
+                        ((duration - warm_up_duration) * num_nodes);
+
+                // FCTs of requests issued after the warm-up; all requests complete
+                uint32_t n_done = 0, n_short = 0, n_all_done = 0;
+                double fct_sum = 0, short_fct_sum = 0;
+                for (k = 0; k < num_requests; k++) {
+                    if (fs.fct[k] == 0)
+                        continue;
+                    n_all_done++;
+                    if (k < first_measured)
+                        continue;
+                    fcts[n_done++] = fs.fct[k];
+                    fct_sum += fs.fct[k];
+                    if (requests[k].backlog <= SHORT_FLOW_TSLOTS) {
+                        n_short++;
+                        short_fct_sum += fs.fct[k];
+                    }
+                }
+                qsort(fcts, n_done, sizeof(uint32_t), compare_uint32);
+                short_fct[p] = n_short ? short_fct_sum / n_short : 0.0;
+                if (utilzn < MIN_KEPT_UP * fraction)
+                    kept_up = false;
+
+                printf("%f, %d, %d, %f, %s, %f, %u, %f, %f, %u\n", fraction, n_cores,
+                       num_nodes, utilzn, policy_names[p],
+                       n_done ? fct_sum / n_done : 0.0,
+                       n_done ? fcts[n_done * 99 / 100] : 0, short_fct[p],
+                       num_requests ? (double) n_all_done / num_requests : 0.0,
+                       stats.over_admitted);
+
+                if (n_all_done != num_requests || stats.over_admitted != 0) {
+                    fprintf(stderr, "%s on %u cores at %f: %u of %u requests completed, "
+                            "%u timeslots over-admitted\n", policy_names[p], n_cores,
+                            fraction, n_all_done, num_requests, stats.over_admitted);
+                    num_failed++;
+                }
+
+                fct_free(&fs);
+            }
+
+            // SJF should still serve short requests first when the bins are
+            // split between cores. Cores that fall behind the load queue all
+            // flows alike, so the order only shows while they keep up.
+            if (!kept_up) {
+                fprintf(stderr, "%u cores at %f fall behind the load, not comparing "
+                        "policies\n", n_cores, fraction);
+            } else if (short_fct[1] > short_fct[0]) {
+                fprintf(stderr, "sjf on %u cores at %f: short requests slower than "
+                        "under lru (%f > %f)\n", n_cores, fraction, short_fct[1],
+                        short_fct[0]);
+                num_failed++;
+            }
+        }
+
+        free(fcts);
+        free(requests);
+    }
+
+    return num_failed;
+}
+
+int main(int argc, char **argv)
+{
+    uint16_t i, j, p;
+    uint32_t k;
 
     // keep both durations an even number of batches so that bin pointers return to queue_0
     uint32_t warm_up_duration = ((10000 + 127) / 128) * 128;
     uint32_t duration = warm_up_duration + ((50000 + 127) / 128) * 128;
     double mean = 10; // Mean request size and inter-arrival time
 
-    // Each experiment tries out a different combination of target network utilization
-    // and number of nodes
-    const double *fractions;
-    const uint32_t *sizes;
-    const uint16_t *capacities;
-    uint8_t num_fractions;
-    uint8_t num_parameter_2;
-    
-    // init fractions
-    num_fractions = NUM_FRACTIONS_A;
-    fractions = admissible_fractions;
-
-    // init parameter 2 - sizes
-    num_parameter_2 = NUM_SIZES_A;
-    sizes = admissible_sizes;
-  
     // Data structures
-    struct admissible_status *status;
-    struct admission_core_state core;
-    struct fp_ring *q_bin;
-    struct fp_ring *q_urgent;
+    struct admissible_state *status;
+    struct fp_ring *q_bin[Q_BIN_RINGS];
     struct fp_ring *q_head;
     struct fp_ring *q_admitted_out;
-    struct admitted_traffic **admitted_batch;
-    struct admitted_traffic **all_admitted;
+    struct fp_ring *q_spent;
+    struct fp_mempool *bin_mempool;
+    struct fp_mempool *admitted_traffic_mempool;
 
     /* init queues */
-    q_bin = fp_ring_create(NUM_BINS_SHIFT);
-    q_urgent = fp_ring_create(2 * FP_NODES_SHIFT + 1);
-    q_head = fp_ring_create(2 * FP_NODES_SHIFT);
-    q_admitted_out = fp_ring_create(BATCH_SHIFT);
-    if (!q_bin) exit(-1);
-    if (!q_urgent) exit(-1);
+    for (i = 0; i < Q_BIN_RINGS; i++) {
+        q_bin[i] = fp_ring_create_flags(BIN_RING_LOG_SIZE,
+                FP_RING_F_SP_ENQ | FP_RING_F_SC_DEQ);
+        if (!q_bin[i]) exit(-1);
+    }
+    q_head = fp_ring_create(BIN_RING_LOG_SIZE);
+    q_admitted_out = fp_ring_create(ADMITTED_OUT_RING_LOG_SIZE);
+    q_spent = fp_ring_create(BIN_RING_LOG_SIZE);
+    bin_mempool = fp_mempool_create(BIN_MEMPOOL_SIZE, bin_num_bytes(SMALL_BIN_SIZE),
+            BIN_MEMPOOL_CACHE_SIZE);
+    admitted_traffic_mempool = fp_mempool_create(ADMITTED_TRAFFIC_MEMPOOL_SIZE,
+            sizeof(struct admitted_traffic), ADMITTED_TRAFFIC_CACHE_SIZE);
     if (!q_head) exit(-1);
     if (!q_admitted_out) exit(-1);
+    if (!q_spent) exit(-1);
+    if (!bin_mempool) exit(-1);
+    if (!admitted_traffic_mempool) exit(-1);
 
-    /* init core */
-    if (alloc_core_init(&core, q_bin, q_bin, q_urgent, q_urgent) != 0) {
-        printf("Error initializing alloc core!\n");
-	exit(-1);
+    /* init global status */
+    status = create_admissible_state(false, 0, 0, 0, q_head, q_admitted_out,
+                                     q_spent, bin_mempool, admitted_traffic_mempool,
+                                     &q_bin[0], NULL, NULL);
+    if (status == NULL) {
+        printf("Error initializing admissible_status!\n");
+        exit(-1);
     }
+    set_admission_n_cores(status, 1);
 
-    /* init global status */
-    status = create_admissible_status(false, 0, 0, 0, q_head, q_admitted_out);
+    // benchmark_sjf <max_cores> checks SJF on up to max_cores admission cores
+    if (argc > 1) {
+        uint32_t max_cores = atoi(argv[1]);
+        if (max_cores < 1 || max_cores > ALGO_N_CORES) {
+            fprintf(stderr, "usage: %s [max_cores], max_cores from 1 to %u "
+                    "(use benchmark_sjf_multicore for more)\n", argv[0], ALGO_N_CORES);
+            exit(-1);
+        }
+        fp_set_lcore_id(0);
+        pin_thread_to_cpu(pthread_self(), 0);
+        return benchmark_sjf_multicore(status, max_cores, &q_bin[0], q_head, q_spent,
+                                       bin_mempool) ? 1 : 0;
+    }
 
-    /* make allocated_traffic containers */
-    admitted_batch = malloc(sizeof(struct admitted_traffic *) * BATCH_SIZE);
-    if (!admitted_batch) exit(-1);
+    printf("target_utilization, nodes, time, observed_utilization, time/utilzn, "
+           "policy, fct_mean, fct_p99, short_fct_mean, completed\n");
 
-    for (i = 0; i < BATCH_SIZE; i++) {
-        admitted_batch[i] = create_admitted_traffic();
-        if (!admitted_batch[i]) exit(-1);
-    }
-        
-    /* fill bin_queue with empty bins */
-    for (i = 0; i < NUM_BINS; i++) {
-        fp_ring_enqueue(q_bin, create_bin(LARGE_BIN_SIZE));
-    }
+    for (i = 0; i < NUM_FRACTIONS_A; i++) {
 
-    printf("target_utilization, nodes, time, observed_utilization, time/utilzn\n");
-    
-    for (i = 0; i < num_fractions; i++) {
-
-        for (j = 0; j < num_parameter_2; j++) {
-            double fraction = fractions[i];
-            uint32_t num_nodes;
-            uint16_t inter_rack_capacity;
-
-            // Initialize data structures
-            num_nodes = sizes[j];
-            reset_admissible_status(status, false, 0, 0, num_nodes);
-        
-            for (k = 0; k < NUM_BINS; k++) {
-            	struct bin *b;
-            	fp_ring_dequeue(q_bin, (void **)&b);
-                init_bin(b);
-                fp_ring_enqueue(q_bin, b);
-            }
-            void *vp;
-            while (fp_ring_dequeue(q_urgent, &vp) == 0)
-            	/* continue to dequeue */ ;
+        for (j = 0; j < NUM_SIZES_A; j++) {
+            double fraction = admissible_fractions[i];
+            uint32_t num_nodes = admissible_sizes[j];
 
-            fp_ring_enqueue(q_urgent, (void*)URGENT_Q_HEAD_TOKEN);
+            if (num_nodes > MAX_NODES)
+                continue;
 
             // Allocate enough space for new requests
             // (this is sufficient for <= 1 request per node per timeslot)
             uint32_t max_requests = duration * num_nodes;
             struct request_info *requests = malloc(max_requests * sizeof(struct request_info));
+            uint32_t *fcts = malloc(max_requests * sizeof(uint32_t));
+            if (!requests || !fcts) exit(-1);
 
-            // Generate new requests
+            // Generate new requests, the same for both policies
             uint32_t num_requests = generate_requests_poisson(requests, max_requests, num_nodes,
                                                               duration, fraction, mean);
 
-            // Issue/process some requests. This is a warm-up period so that there are pending
-            // requests once we start timing
-            struct request_info *next_request;
-            run_experiment(requests, 0, warm_up_duration, num_requests,
-                           status, &next_request, &core, admitted_batch);
-   
-            // Start timining
-            uint64_t start_time = current_time();
-
-            // Run the experiment
-            uint32_t num_admitted = run_experiment(next_request, warm_up_duration, duration,
-                                                   num_requests - (next_request - requests),
-                                                   status, &next_request, &core, admitted_batch);
-            uint64_t end_time = current_time();
-            double time_per_experiment = (end_time - start_time) / (PROCESSOR_SPEED * 1000 *
-                                                                    (duration - warm_up_duration));
-
-            double utilzn = ((double) num_admitted) / ((duration - warm_up_duration) * num_nodes);
-
-            // Print stats - percent of network capacity utilized and computation time
-            // per admitted timeslot (in microseconds) for different numbers of nodes
-            printf("%f, %d, %f, %f, %f\n", fraction, num_nodes, time_per_experiment,
-                   utilzn, time_per_experiment / utilzn);
+            for (p = 0; p < NUM_POLICIES; p++) {
+                struct fct_state fs;
+
+                // Initialize data structures
+                reset_admissible_state(status, false, 0, 0, num_nodes);
+                set_admission_bin_policy(status, policies[p]);
+                drain_queues(status, q_bin, q_head, q_spent, bin_mempool);
+                fct_init(&fs, requests, num_requests, num_nodes);
+
+                // Issue/process some requests. This is a warm-up period so that there are pending
+                // requests once we start timing
+                struct request_info *next_request;
+                run_experiment(requests, 0, warm_up_duration, num_requests,
+                               status, &next_request, &fs, requests);
+                uint32_t first_measured = next_request - requests;
+
+                // Start timining
+                uint64_t start_time = current_time();
+
+                // Run the experiment
+                uint32_t num_admitted = run_experiment(next_request, warm_up_duration, duration,
+                                                       num_requests - first_measured,
+                                                       status, &next_request, &fs, requests);
+                uint64_t end_time = current_time();
+                double time_per_experiment = (end_time - start_time) / (PROCESSOR_SPEED * 1000 *
+                                                                        (duration - warm_up_duration));
+
+                double utilzn = ((double) num_admitted) / ((duration - warm_up_duration) * num_nodes);
+
+                // FCTs of requests issued after the warm-up that completed
+                uint32_t issued = next_request - requests - first_measured;
+                uint32_t n_done = 0, n_short = 0;
+                double fct_sum = 0, short_fct_sum = 0;
+                for (k = first_measured; k < first_measured + issued; k++) {
+                    if (fs.fct[k] == 0)
+                        continue;
+                    fcts[n_done++] = fs.fct[k];
+                    fct_sum += fs.fct[k];
+                    if (requests[k].backlog <= SHORT_FLOW_TSLOTS) {
+                        n_short++;
+                        short_fct_sum += fs.fct[k];
+                    }
+                }
+                qsort(fcts, n_done, sizeof(uint32_t), compare_uint32);
+
+                // Print stats - percent of network capacity utilized and computation time
+                // per admitted timeslot (in microseconds) for different numbers of nodes,
+                // and flow completion times in timeslots
+                printf("%f, %d, %f, %f, %f, %s, %f, %u, %f, %f\n", fraction, num_nodes,
+                       time_per_experiment, utilzn, time_per_experiment / utilzn,
+                       policy_names[p], n_done ? fct_sum / n_done : 0.0,
+                       n_done ? fcts[n_done * 99 / 100] : 0,
+                       n_short ? short_fct_sum / n_short : 0.0,
+                       issued ? (double) n_done / issued : 0.0);
+
+                fct_free(&fs);
+            }
+
+            free(fcts);
+            free(requests);
         }
     }
 
@@ -15,6 +15,7 @@ struct backlog_edge {
     uint16_t src;
     uint16_t dst;
     uint16_t backlog;
+    uint8_t tclass;  // traffic class
     uint32_t metric;
 };
 
@@ -37,18 +38,26 @@ bool is_empty_bin(struct bin *bin) {
     return bin->size == 0;
 }
 
-// Insert new edge to the back of this bin
+// Insert new edge of traffic class tclass to the back of this bin
 static inline __attribute__((always_inline))
-void enqueue_bin(struct bin *bin, uint16_t src, uint16_t dst, uint16_t backlog,
-		uint32_t metric) {
+void enqueue_bin_tclass(struct bin *bin, uint16_t src, uint16_t dst,
+		uint16_t backlog, uint32_t metric, uint8_t tclass) {
     assert(bin != NULL);
     uint32_t n = bin->size++;
     bin->edges[n].src = src;
     bin->edges[n].dst = dst;
     bin->edges[n].backlog = backlog;
+    bin->edges[n].tclass = tclass;
     bin->edges[n].metric = metric;
 }
 
+// Insert new edge to the back of this bin
+static inline __attribute__((always_inline))
+void enqueue_bin(struct bin *bin, uint16_t src, uint16_t dst, uint16_t backlog,
+		uint32_t metric) {
+    enqueue_bin_tclass(bin, src, dst, backlog, metric, 0);
+}
+
 // Insert new edge to the back of this bin, when given an edge already.
 static inline __attribute__((always_inline))
 void enqueue_bin_edge(struct bin *bin, struct backlog_edge *edge) {
@@ -0,0 +1,202 @@
+/*
+ * chunk_bin.h
+ *
+ * Bins of backlog edges built from fixed-size chunks, for an admission core's
+ *   priority bins. Each core keeps its free chunks in a pool of its own, and
+ *   takes more from a mempool shared by the cores when they run out, so cores
+ *   only hold the chunks their bins actually use. Chunks store each field in
+ *   its own array, so the allocation loop reads src and dst contiguously.
+ */
+
+#ifndef CHUNK_BIN_H_
+#define CHUNK_BIN_H_
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "bin.h"
+#include "platform.h"
+
+#define CHUNK_BIN_CHUNK_SHIFT		6
+#define CHUNK_BIN_CHUNK_SIZE		(1 << CHUNK_BIN_CHUNK_SHIFT)
+#define CHUNK_BIN_CHUNK_MASK		(CHUNK_BIN_CHUNK_SIZE - 1)
+
+/* chunks a pool takes from the shared mempool at a time */
+#define CHUNK_POOL_GROW_CHUNKS		32
+
+struct bin_chunk {
+	uint16_t src[CHUNK_BIN_CHUNK_SIZE];
+	uint16_t dst[CHUNK_BIN_CHUNK_SIZE];
+	uint16_t backlog[CHUNK_BIN_CHUNK_SIZE];
+	uint32_t metric[CHUNK_BIN_CHUNK_SIZE];
+	uint8_t tclass[CHUNK_BIN_CHUNK_SIZE];
+	struct bin_chunk *next;
+} __attribute__((aligned(64)));
+
+/**
+ * A bin of edges, in order of insertion
+ *    size: number of edges
+ *    head: first chunk, or NULL if the bin has no chunks
+ *    tail: chunk that receives the next edge, valid if head != NULL
+ */
+struct chunk_bin {
+	uint32_t size;
+	struct bin_chunk *head;
+	struct bin_chunk *tail;
+};
+
+/**
+ * Free chunks of one core. Not thread-safe.
+ *    mempool: shared mempool the chunks are taken from
+ *    free_list: singly linked list of free chunks
+ *    n_free: number of chunks in free_list
+ *    n_chunks: number of chunks taken from mempool, free or in bins
+ */
+struct chunk_pool {
+	struct fp_mempool *mempool;
+	struct bin_chunk *free_list;
+	uint32_t n_free;
+	uint32_t n_chunks;
+};
+
+/**
+ * Takes @n_chunks more chunks from the pool's mempool
+ * @returns 0 on success, -1 if the mempool ran out (chunks taken before that
+ *   are kept)
+ */
+static inline int chunk_pool_grow(struct chunk_pool *pool, uint32_t n_chunks)
+{
+	void *chunks[CHUNK_POOL_GROW_CHUNKS];
+	uint32_t i, n;
+
+	while (n_chunks > 0) {
+		n = (n_chunks < CHUNK_POOL_GROW_CHUNKS) ? n_chunks
+				: CHUNK_POOL_GROW_CHUNKS;
+		if (fp_mempool_get_bulk(pool->mempool, chunks, n) != 0)
+			return -1;
+		for (i = 0; i < n; i++) {
+			struct bin_chunk *chunk = (struct bin_chunk *)chunks[i];
+			chunk->next = pool->free_list;
+			pool->free_list = chunk;
+		}
+		pool->n_free += n;
+		pool->n_chunks += n;
+		n_chunks -= n;
+	}
+	return 0;
+}
+
+/**
+ * Initializes the pool with @n_chunks free chunks from @mempool, whose
+ *   objects must hold a struct bin_chunk
+ * @returns 0 on success, -1 if the mempool does not have enough chunks
+ */
+static inline int chunk_pool_init(struct chunk_pool *pool,
+		struct fp_mempool *mempool, uint32_t n_chunks)
+{
+	pool->mempool = mempool;
+	pool->free_list = NULL;
+	pool->n_free = 0;
+	pool->n_chunks = 0;
+	return chunk_pool_grow(pool, n_chunks);
+}
+
+// Returns free chunks beyond the first @n_keep to the mempool
+static inline void chunk_pool_trim(struct chunk_pool *pool, uint32_t n_keep)
+{
+	while (pool->n_free > n_keep) {
+		struct bin_chunk *chunk = pool->free_list;
+		pool->free_list = chunk->next;
+		pool->n_free--;
+		pool->n_chunks--;
+		fp_mempool_put(pool->mempool, chunk);
+	}
+}
+
+// Returns the pool's free chunks to the mempool. Bins holding its chunks
+// must be reset first, or their chunks are only freed with the mempool
+static inline void chunk_pool_free(struct chunk_pool *pool)
+{
+	if (pool->mempool != NULL)
+		chunk_pool_trim(pool, 0);
+	pool->mempool = NULL;
+}
+
+static inline __attribute__((always_inline))
+void chunk_bin_init(struct chunk_bin *bin) {
+	bin->size = 0;
+	bin->head = NULL;
+	bin->tail = NULL;
+}
+
+// Empties the bin, returning its chunks to the pool
+static inline __attribute__((always_inline))
+void chunk_bin_reset(struct chunk_bin *bin, struct chunk_pool *pool)
+{
+	assert(bin != NULL);
+
+	if (bin->head != NULL) {
+		bin->tail->next = pool->free_list;
+		pool->free_list = bin->head;
+		pool->n_free += (bin->size + CHUNK_BIN_CHUNK_MASK) >> CHUNK_BIN_CHUNK_SHIFT;
+	}
+	chunk_bin_init(bin);
+}
+
+static inline __attribute__((always_inline))
+uint32_t chunk_bin_size(struct chunk_bin *bin) {
+	return bin->size;
+}
+
+/**
+ * Insert new edge to the back of this bin
+ * @returns 0 on success, -ENOBUFS if the bin needs a new chunk and neither
+ *   the pool nor its mempool has one left
+ */
+static inline __attribute__((always_inline))
+int chunk_bin_enqueue(struct chunk_bin *bin, struct chunk_pool *pool,
+		uint16_t src, uint16_t dst, uint16_t backlog, uint32_t metric,
+		uint8_t tclass)
+{
+	uint32_t offset = bin->size & CHUNK_BIN_CHUNK_MASK;
+	struct bin_chunk *chunk;
+
+	if (offset == 0) {
+		if (unlikely(pool->free_list == NULL)
+				&& chunk_pool_grow(pool, CHUNK_POOL_GROW_CHUNKS) != 0
+				&& pool->free_list == NULL)
+			return -ENOBUFS;
+		chunk = pool->free_list;
+		pool->free_list = chunk->next;
+		pool->n_free--;
+		chunk->next = NULL;
+		if (bin->head == NULL)
+			bin->head = chunk;
+		else
+			bin->tail->next = chunk;
+		bin->tail = chunk;
+	}
+
+	chunk = bin->tail;
+	chunk->src[offset] = src;
+	chunk->dst[offset] = dst;
+	chunk->backlog[offset] = backlog;
+	chunk->metric[offset] = metric;
+	chunk->tclass[offset] = tclass;
+	bin->size++;
+	return 0;
+}
+
+// Insert an edge from a transfer bin to the back of this bin, see
+// chunk_bin_enqueue for the return value
+static inline __attribute__((always_inline))
+int chunk_bin_enqueue_edge(struct chunk_bin *bin, struct chunk_pool *pool,
+		struct backlog_edge *edge)
+{
+	return chunk_bin_enqueue(bin, pool, edge->src, edge->dst, edge->backlog,
+			edge->metric, edge->tclass);
+}
+
+#endif /* CHUNK_BIN_H_ */
@@ -1,15 +1,15 @@
 /*
- * euler_split.c
+ * euler_split_matrix.c
  *
  *  Created on: October 21, 2013
  *      Author: aousterh
  */
 
-#include "euler_split.h"
-#include "graph.h"
+#include "euler_split_matrix.h"
+#include "graph_matrix.h"
 
 // Splits graph_in into graph_1 and graph_2
-void split(struct graph *graph_in, struct graph *graph_1,
+void split_matrix(struct graph *graph_in, struct graph *graph_1,
            struct graph *graph_2) {
     assert(graph_in != NULL);
     assert(graph_1 != NULL);
@@ -0,0 +1,18 @@
+/*
+ * euler_split_matrix.h
+ *
+ *  Created on: October 20, 2013
+ *      Author: aousterh
+ */
+
+#ifndef EULER_SPLIT_MATRIX_H_
+#define EULER_SPLIT_MATRIX_H_
+
+#include "graph_matrix.h"
+
+// Splits graph_in into graph_1 and graph_2, with edges stored as counts in
+// a matrix (graph_matrix.h) rather than as bitmaps (graph.h)
+void split_matrix(struct graph *graph_in, struct graph *graph_1,
+                  struct graph *graph_2);
+
+#endif /* EULER_SPLIT_MATRIX_H_ */
@@ -0,0 +1,118 @@
+/*
+ * euler_split_sliced.c
+ *
+ * Euler splits of up to 64 graphs at once. Each half gets half of the edges
+ * between every pair of vertices, rounded down, which for bit-sliced counts
+ * is a shift by one plane for all graphs at once. The pairs with an odd
+ * count are left over. They form a simple graph with even degrees in each
+ * timeslot, small enough to keep as one bitmap per vertex, and are split by
+ * walking it one graph at a time.
+ */
+
+#include "euler_split_sliced.h"
+#include "graph_sliced.h"
+
+// Walks the simple graph with neighbor bitmaps rows (left vertices) and cols
+// (right vertices) as split() does, leaving the edges walked from left to
+// right in rows. cols ends up empty
+static void split_odd_edges(uint64_t *rows, uint64_t *cols, uint8_t n) {
+    uint64_t half_1[SLICED_MAX_NODES];
+    uint8_t node, u, v;
+
+    for (u = 0; u < n; u++)
+        half_1[u] = 0;
+
+    for (node = 0; node < n; node++) {
+        u = node;
+
+        while (rows[node] != 0) {
+            // Peel off two edges, one for each half
+            v = __builtin_ctzll(rows[u]);
+            rows[u] &= ~(0x1ULL << v);
+            cols[v] &= ~(0x1ULL << u);
+            half_1[u] |= 0x1ULL << v;
+
+            assert(cols[v] != 0);  // degrees are even
+            u = __builtin_ctzll(cols[v]);
+            rows[u] &= ~(0x1ULL << v);
+            cols[v] &= ~(0x1ULL << u);
+        }
+    }
+
+    for (u = 0; u < n; u++)
+        rows[u] = half_1[u];
+}
+
+// Splits each of the graphs in graph_in into graph_1 and graph_2
+void split_sliced(struct graph_sliced *graph_in, struct graph_sliced *graph_1,
+                  struct graph_sliced *graph_2) {
+    assert(graph_in != NULL);
+    assert(graph_1 != NULL);
+    assert(graph_2 != NULL);
+
+    uint8_t n = graph_in->n;
+    uint64_t rows[SLICED_MAX_GRAPHS][SLICED_MAX_NODES];
+    uint64_t cols[SLICED_MAX_GRAPHS][SLICED_MAX_NODES];
+    uint64_t words[64];
+    uint64_t odd_graphs = 0;
+    int b, t, u, v;
+
+    graph_1->n = n;
+    graph_2->n = n;
+
+    // Each half gets count / 2 edges between every pair
+    for (b = 0; b < SLICED_COUNT_BITS - 1; b++) {
+        for (u = 0; u < n; u++) {
+            for (v = 0; v < n; v++) {
+                graph_1->counts[b][u][v] = graph_in->counts[b + 1][u][v];
+                graph_2->counts[b][u][v] = graph_in->counts[b + 1][u][v];
+            }
+        }
+    }
+    for (u = 0; u < n; u++) {
+        for (v = 0; v < n; v++) {
+            graph_1->counts[SLICED_COUNT_BITS - 1][u][v] = 0;
+            graph_2->counts[SLICED_COUNT_BITS - 1][u][v] = 0;
+            odd_graphs |= graph_in->counts[0][u][v];
+        }
+    }
+    if (odd_graphs == 0)
+        return;
+
+    // Turn the odd pairs into neighbor bitmaps per graph. Row u of the
+    // parity plane, transposed, holds the neighbors of u in every graph
+    for (u = 0; u < n; u++) {
+        for (v = 0; v < 64; v++)
+            words[v] = (v < n) ? graph_in->counts[0][u][v] : 0;
+        transpose_64x64(words);
+        for (t = 0; t < SLICED_MAX_GRAPHS; t++)
+            rows[t][u] = words[t];
+    }
+    for (v = 0; v < n; v++) {
+        for (u = 0; u < 64; u++)
+            words[u] = (u < n) ? graph_in->counts[0][u][v] : 0;
+        transpose_64x64(words);
+        for (t = 0; t < SLICED_MAX_GRAPHS; t++)
+            cols[t][v] = words[t];
+    }
+
+    // Walk the graphs that have odd pairs
+    uint64_t graphs;
+    for (graphs = odd_graphs; graphs != 0; graphs &= graphs - 1) {
+        t = __builtin_ctzll(graphs);
+        split_odd_edges(rows[t], cols[t], n);
+    }
+
+    // Add the odd edges walked from left to right to graph_1, the rest to
+    // graph_2, transposing back to one word per pair
+    for (u = 0; u < n; u++) {
+        for (t = 0; t < SLICED_MAX_GRAPHS; t++)
+            words[t] = rows[t][u];
+        transpose_64x64(words);
+        for (v = 0; v < n; v++) {
+            uint64_t odd = graph_in->counts[0][u][v];
+            graph_sliced_add_edges(graph_1, u, v, words[v]);
+            graph_sliced_add_edges(graph_2, u, v, odd & ~words[v]);
+        }
+    }
+}
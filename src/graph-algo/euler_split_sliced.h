@@ -0,0 +1,15 @@
+/*
+ * euler_split_sliced.h
+ */
+
+#ifndef EULER_SPLIT_SLICED_H_
+#define EULER_SPLIT_SLICED_H_
+
+#include "graph_sliced.h"
+
+// Splits each of the graphs in graph_in into graph_1 and graph_2, halving
+// every vertex degree (which must all be even). graph_in is unchanged
+void split_sliced(struct graph_sliced *graph_in, struct graph_sliced *graph_1,
+                  struct graph_sliced *graph_2);
+
+#endif /* EULER_SPLIT_SLICED_H_ */
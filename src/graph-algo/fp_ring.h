@@ -13,62 +13,227 @@
 #define		fp_ring_enqueue			rte_ring_enqueue
 #define		fp_ring_enqueue_bulk	rte_ring_enqueue_bulk
 #define		fp_ring_dequeue			rte_ring_dequeue
+#define		fp_ring_dequeue_bulk	rte_ring_dequeue_bulk
 #define		fp_ring_dequeue_burst	rte_ring_dequeue_burst
+#define		fp_ring_count			rte_ring_count
+#define		fp_ring_free_count		rte_ring_free_count
+#define		fp_ring_empty			rte_ring_empty
+
+#define		FP_RING_F_SP_ENQ		RING_F_SP_ENQ
+#define		FP_RING_F_SC_DEQ		RING_F_SC_DEQ
+
+#include <stdio.h>
+
+/* DPDK rings need unique names, rings created here are numbered */
+__attribute__((weak)) uint32_t fp_ring_n_created;
+
+/**
+ * Creates a new ring with 2^{log_size} elements
+ * @param flags: FP_RING_F_SP_ENQ and/or FP_RING_F_SC_DEQ, or 0
+ */
+static inline
+struct fp_ring *fp_ring_create_flags(uint32_t log_size, unsigned flags) {
+	char name[RTE_RING_NAMESIZE];
+
+	snprintf(name, sizeof(name), "fp_ring_%u",
+			__sync_fetch_and_add(&fp_ring_n_created, 1));
+	return rte_ring_create(name, 1 << log_size, SOCKET_ID_ANY, flags);
+}
+
+/**
+ * Creates a new multi-producer/multi-consumer ring, with 2^{log_size} elements
+ */
+static inline
+struct fp_ring *fp_ring_create(uint32_t log_size) {
+	return fp_ring_create_flags(log_size, 0);
+}
+
+/* this DPDK can't free rings, they are kept until the process exits */
+static inline
+void fp_ring_destroy(struct fp_ring *ring) {
+}
 
 #else
 
 #include <assert.h>
+#include <sched.h>
+#include <stdint.h>
 #include <stdlib.h>
 
-/* A data-structure to communicate pointers between components */
-struct fp_ring {
+/* flags for fp_ring_create_flags, same meaning as RING_F_SP_ENQ/RING_F_SC_DEQ */
+#define FP_RING_F_SP_ENQ		0x0001 /* only one thread enqueues */
+#define FP_RING_F_SC_DEQ		0x0002 /* only one thread dequeues */
+
+/* spins waiting for a preceding enqueue/dequeue to finish before yielding */
+#define FP_RING_SPINS_BEFORE_YIELD	1024
+
+/**
+ * Head and tail of one side of the ring. An enqueue (dequeue) first reserves
+ *   slots by moving head, fills (empties) them, then moves tail to publish
+ *   them to the other side.
+ */
+struct fp_ring_headtail {
 	uint32_t head;
 	uint32_t tail;
+	uint32_t single; /* non-zero if only one thread uses this side */
+} __attribute__((aligned(64)));
+
+/**
+ * A lock-free ring to communicate pointers between components, with the same
+ *   semantics as DPDK's rte_ring: can hold 2^{log_size} - 1 elements, and is
+ *   multi-producer/multi-consumer unless created with FP_RING_F_* flags.
+ */
+struct fp_ring {
 	uint32_t mask;
-	void *elem[0]; // must be last in struct
+	struct fp_ring_headtail prod;
+	struct fp_ring_headtail cons;
+	void *elem[0] __attribute__((aligned(64))); // must be last in struct
 };
 
 /**
- * Creates a new backlog queue, with 2^{log_size} elements
+ * Creates a new ring with 2^{log_size} elements
+ * @param flags: FP_RING_F_SP_ENQ and/or FP_RING_F_SC_DEQ, or 0
  */
 static inline
-struct fp_ring *fp_ring_create(uint32_t log_size) {
+struct fp_ring *fp_ring_create_flags(uint32_t log_size, unsigned flags) {
 	uint32_t num_elems = (1 << log_size);
 	uint32_t mem_size = sizeof(struct fp_ring)
 							+ num_elems * sizeof(void *);
-    struct fp_ring *ring = malloc(mem_size);
-    assert(ring != NULL);
+	struct fp_ring *ring;
 
-    ring->mask = num_elems - 1;
-	ring->head = 0;
-	ring->tail = 0;
-    return ring;
+	if (posix_memalign((void **)&ring, 64, mem_size) != 0)
+		return NULL;
+
+	ring->mask = num_elems - 1;
+	ring->prod.head = ring->prod.tail = 0;
+	ring->prod.single = !!(flags & FP_RING_F_SP_ENQ);
+	ring->cons.head = ring->cons.tail = 0;
+	ring->cons.single = !!(flags & FP_RING_F_SC_DEQ);
+	return ring;
 }
 
-// Insert new bin to the back of this backlog queue
+/**
+ * Creates a new multi-producer/multi-consumer ring, with 2^{log_size} elements
+ */
 static inline
-int fp_ring_enqueue(struct fp_ring *ring, void *elem) {
-	assert(ring != NULL);
-	assert(ring->tail != ring->head + ring->mask);
+struct fp_ring *fp_ring_create(uint32_t log_size) {
+	return fp_ring_create_flags(log_size, 0);
+}
+
+// Internal. Wait until preceding operations on this side have published their
+// slots, then publish ours.
+static inline __attribute__((always_inline))
+void _fp_ring_update_tail(struct fp_ring_headtail *ht, uint32_t old_val,
+		uint32_t new_val)
+{
+	uint32_t spins = 0;
 
-	ring->elem[ring->tail & ring->mask] = elem;
-	ring->tail++;
-        
-	return 0;
+	if (!ht->single) {
+		while (__atomic_load_n(&ht->tail, __ATOMIC_RELAXED) != old_val) {
+			__builtin_ia32_pause();
+			if (++spins == FP_RING_SPINS_BEFORE_YIELD) {
+				/* the other thread might not be running */
+				sched_yield();
+				spins = 0;
+			}
+		}
+	}
+	__atomic_store_n(&ht->tail, new_val, __ATOMIC_RELEASE);
 }
 
-// Insert new bin to the back of this backlog queue
-static inline
-int fp_ring_enqueue_bulk(struct fp_ring *ring, void **elems, unsigned n) {
-	int i;
+/**
+ * Internal. Reserves up to n slots on one side of the ring.
+ * @param other_tail: the tail of the other side of the ring
+ * @param capacity: mask for enqueue (slots are free up to the consumer's tail),
+ *   0 for dequeue (slots are full up to the producer's tail)
+ * @param fixed: if true, reserve exactly n slots or none
+ * @returns the number of slots reserved, with their start in *old_head
+ */
+static inline __attribute__((always_inline))
+unsigned _fp_ring_move_head(struct fp_ring_headtail *ht, uint32_t *other_tail,
+		uint32_t capacity, unsigned n, int fixed, uint32_t *old_head)
+{
+	uint32_t head, entries;
+	unsigned cur_n;
+	int success;
 
-	assert(ring != NULL);
-	assert(ring->tail + n <= ring->head + ring->mask);
+	do {
+		cur_n = n;
+		head = __atomic_load_n(&ht->head, __ATOMIC_RELAXED);
+		entries = capacity + __atomic_load_n(other_tail, __ATOMIC_ACQUIRE)
+					- head;
+		if (__builtin_expect(cur_n > entries, 0)) {
+			if (fixed || entries == 0)
+				return 0;
+			cur_n = entries;
+		}
+
+		if (ht->single) {
+			ht->head = head + cur_n;
+			success = 1;
+		} else {
+			success = __atomic_compare_exchange_n(&ht->head, &head,
+					head + cur_n, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+		}
+	} while (__builtin_expect(!success, 0));
 
+	*old_head = head;
+	return cur_n;
+}
+
+// Internal. Enqueue up to n elements, returns the number enqueued
+static inline __attribute__((always_inline))
+unsigned _fp_ring_do_enqueue(struct fp_ring *ring, void * const *elems,
+		unsigned n, int fixed)
+{
+	uint32_t head;
+	unsigned i;
+
+	n = _fp_ring_move_head(&ring->prod, &ring->cons.tail, ring->mask, n,
+			fixed, &head);
 	for (i = 0; i < n; i++)
-		fp_ring_enqueue(ring, elems[i]);
+		ring->elem[(head + i) & ring->mask] = elems[i];
+
+	if (n != 0)
+		_fp_ring_update_tail(&ring->prod, head, head + n);
+	return n;
+}
+
+// Internal. Dequeue up to n elements, returns the number dequeued
+static inline __attribute__((always_inline))
+unsigned _fp_ring_do_dequeue(struct fp_ring *ring, void **elems, unsigned n,
+		int fixed)
+{
+	uint32_t head;
+	unsigned i;
+
+	n = _fp_ring_move_head(&ring->cons, &ring->prod.tail, 0, n, fixed, &head);
+	for (i = 0; i < n; i++)
+		elems[i] = ring->elem[(head + i) & ring->mask];
+
+	if (n != 0)
+		_fp_ring_update_tail(&ring->cons, head, head + n);
+	return n;
+}
 
-	return 0;
+/**
+ * Insert new element to the back of the ring
+ * @returns 0 on success, -ENOBUFS if the ring is full
+ */
+static inline
+int fp_ring_enqueue(struct fp_ring *ring, void *elem) {
+	assert(ring != NULL);
+	return _fp_ring_do_enqueue(ring, &elem, 1, 1) ? 0 : -ENOBUFS;
+}
+
+/**
+ * Insert n elements to the back of the ring, either all of them or none
+ * @returns 0 on success, -ENOBUFS if there isn't room for all n
+ */
+static inline
+int fp_ring_enqueue_bulk(struct fp_ring *ring, void **elems, unsigned n) {
+	assert(ring != NULL);
+	return (_fp_ring_do_enqueue(ring, elems, n, 1) == n) ? 0 : -ENOBUFS;
 }
 
 /**
@@ -78,37 +243,61 @@ int fp_ring_enqueue_bulk(struct fp_ring *ring, void **elems, unsigned n) {
 static inline int fp_ring_dequeue(struct fp_ring *ring, void **obj_p) {
 	assert(ring != NULL);
 	assert(obj_p != NULL);
+	return _fp_ring_do_dequeue(ring, obj_p, 1, 1) ? 0 : -ENOENT;
+}
 
-	if (ring->head == ring->tail)
-		return -ENOENT;
-
-	*obj_p = ring->elem[ring->head++ & ring->mask];
-	return 0;
+/**
+ * Dequeue n elements, either all of them or none
+ * @returns 0 on success, -ENOENT if there are less than n elements
+ */
+static inline
+int fp_ring_dequeue_bulk(struct fp_ring *r, void **obj_table, unsigned n) {
+	assert(r != NULL);
+	return (_fp_ring_do_dequeue(r, obj_table, n, 1) == n) ? 0 : -ENOENT;
 }
 
+/**
+ * Dequeue up to n elements
+ * @returns the number of elements dequeued
+ */
 static inline
 int fp_ring_dequeue_burst(struct fp_ring *r, void **obj_table, unsigned n) {
-	int rc = 0;
-	int i;
-	for (i = 0; i < n; i++) {
-		if (fp_ring_dequeue(r, &obj_table[i]) == 0)
-			rc++;
-		else
-			break;
-	}
-	return rc;
+	assert(r != NULL);
+	return _fp_ring_do_dequeue(r, obj_table, n, 0);
 }
 
-// Insert new bin to the back of this backlog queue
+// Returns the number of elements in the ring
+static inline unsigned fp_ring_count(struct fp_ring *ring) {
+	assert(ring != NULL);
+	return (__atomic_load_n(&ring->prod.tail, __ATOMIC_RELAXED)
+			- __atomic_load_n(&ring->cons.tail, __ATOMIC_RELAXED)) & ring->mask;
+}
+
+// Returns the number of free slots in the ring
+static inline unsigned fp_ring_free_count(struct fp_ring *ring) {
+	assert(ring != NULL);
+	return ring->mask - fp_ring_count(ring);
+}
+
+// Returns non-zero if the ring is empty
 static inline int fp_ring_empty(struct fp_ring *ring) {
 	assert(ring != NULL);
-	return (ring->head == ring->tail);
+	return (__atomic_load_n(&ring->prod.tail, __ATOMIC_RELAXED)
+			== __atomic_load_n(&ring->cons.tail, __ATOMIC_RELAXED));
+}
+
+/**
+ * Frees a ring, whether or not it is empty. Does nothing if ring is NULL
+ */
+static inline
+void fp_ring_destroy(struct fp_ring *ring) {
+	free(ring);
 }
 
 static inline
 void destroy_pointer_queue(struct fp_ring *queue) {
     assert(queue != NULL);
-	assert(queue->head == queue->tail);
+	assert(fp_ring_empty(queue));
 
     free(queue);
 }
@@ -15,13 +15,26 @@
 #include <stdlib.h>
 
 #define MAX(X, Y) ((X) > (Y) ? (X) : (Y))
-#define MAX_DEGREE 64  // This cannot exceed 64, the width of the bitmaps
+// override with e.g. -DMAX_DEGREE=256 -DMAX_GRAPH_NODES=128 for larger graphs
+#ifndef MAX_DEGREE
+#define MAX_DEGREE 64  // A multiple of 64, the width of the bitmap words
+#endif
+#ifndef MAX_GRAPH_NODES
 #define MAX_GRAPH_NODES 64
+#endif
+#define DEGREE_WORDS (MAX_DEGREE / 64)
 
-// The active edges in this graph
+#if (MAX_DEGREE % 64 != 0) || (MAX_DEGREE > 256)
+#error "MAX_DEGREE must be a multiple of 64, at most 256 (neighbor indices are 8 bits)"
+#endif
+#if (MAX_GRAPH_NODES > 128)
+#error "MAX_GRAPH_NODES must be at most 128 (vertex ids are 8 bits)"
+#endif
+
+// The active edges in this graph, a bitmap of neighbor indices per vertex
 struct graph_edges {
-    uint64_t neighbor_bitmaps[2 * MAX_GRAPH_NODES];
-} __attribute__((__packed__));
+    uint64_t neighbor_bitmaps[2 * MAX_GRAPH_NODES][DEGREE_WORDS];
+};  // not packed, so bitmap words can be passed around by pointer
 
 // This tracks the id and index of a neighbor
 struct neighbor {
@@ -45,6 +58,52 @@ struct graph_structure {
 // Helper method for debugging
 static void print_graph(struct graph_structure *structure, struct graph_edges *edges);
 
+// Returns the word of a neighbor bitmap that holds bit i
+static inline
+int bitmap_word(uint16_t i) {
+    return (DEGREE_WORDS == 1) ? 0 : (i >> 6);
+}
+
+// Returns true if bit i of a neighbor bitmap is set
+static inline
+bool bitmap_is_set(const uint64_t *bitmap, uint16_t i) {
+    return (bitmap[bitmap_word(i)] >> (i & 63)) & 0x1ULL;
+}
+
+// Sets bit i of a neighbor bitmap
+static inline
+void bitmap_set(uint64_t *bitmap, uint16_t i) {
+    bitmap[bitmap_word(i)] |= (0x1ULL << (i & 63));
+}
+
+// Clears bit i of a neighbor bitmap
+static inline
+void bitmap_clear(uint64_t *bitmap, uint16_t i) {
+    bitmap[bitmap_word(i)] &= ~(0x1ULL << (i & 63));
+}
+
+// Returns the index of the lowest set bit of a neighbor bitmap, which must
+// have a bit set
+static inline
+uint8_t bitmap_first_set(const uint64_t *bitmap) {
+    int w = 0;
+    while (w < DEGREE_WORDS - 1 && bitmap[w] == 0)
+        w++;
+    assert(bitmap[w] != 0);
+    return (uint8_t) (w * 64 + __builtin_ctzll(bitmap[w]));  // tzcnt
+}
+
+// Returns the index of the lowest clear bit of a neighbor bitmap, which must
+// have a bit clear
+static inline
+uint8_t bitmap_first_clear(const uint64_t *bitmap) {
+    int w = 0;
+    while (w < DEGREE_WORDS - 1 && ~bitmap[w] == 0)
+        w++;
+    assert(~bitmap[w] != 0);
+    return (uint8_t) (w * 64 + __builtin_ctzll(~bitmap[w]));
+}
+
 // Initialize the bipartite graph structure
 static inline
 void graph_structure_init(struct graph_structure *structure, uint8_t n) {
@@ -60,9 +119,10 @@ void graph_edges_init(struct graph_edges *edges, uint8_t n) {
     assert(edges != NULL);
     assert(n <= MAX_GRAPH_NODES);
     
-    int i;
+    int i, w;
     for (i = 0; i < 2 * n; i++)
-        edges->neighbor_bitmaps[i] = 0;
+        for (w = 0; w < DEGREE_WORDS; w++)
+            edges->neighbor_bitmaps[i][w] = 0;
 }
 
 // Returns true if vertex has at least one neighbor, false otherwise
@@ -71,32 +131,35 @@ bool has_neighbor(struct graph_edges *edges, uint8_t vertex) {
     assert(edges != NULL);
     assert(vertex < 2 * MAX_GRAPH_NODES);
 
-    return (edges->neighbor_bitmaps[vertex] != 0);
+    int w;
+    for (w = 0; w < DEGREE_WORDS; w++) {
+        if (edges->neighbor_bitmaps[vertex][w] != 0)
+            return true;
+    }
+    return false;
 }
 
 // Returns the degree of vertex
 static inline
-uint8_t get_degree(struct graph_edges *edges, uint8_t vertex) {
+uint16_t get_degree(struct graph_edges *edges, uint8_t vertex) {
     assert(edges != NULL);
     assert(vertex < 2 * MAX_GRAPH_NODES);
 
-    uint8_t degree = 0;
-    uint64_t bitmap = edges->neighbor_bitmaps[vertex];
-    while (bitmap > 0) {
-        degree += bitmap & 0x1ULL;
-        bitmap = bitmap >> 1;
-    }
-    
+    uint16_t degree = 0;
+    int w;
+    for (w = 0; w < DEGREE_WORDS; w++)
+        degree += __builtin_popcountll(edges->neighbor_bitmaps[vertex][w]);
+
     return degree;
 }
 
 // Returns the max degree
 static inline
-uint8_t get_max_degree(struct graph_edges *edges, uint8_t n) {
+uint16_t get_max_degree(struct graph_edges *edges, uint8_t n) {
     assert(edges != NULL);
     assert(n <= MAX_GRAPH_NODES);
 
-    uint8_t max_degree = 0;
+    uint16_t max_degree = 0;
     int i;
     for (i = 0; i < 2 * n; i++)
         max_degree = MAX(max_degree, get_degree(edges, i));
@@ -115,25 +178,19 @@ uint8_t split_edge(struct graph_structure *structure, struct graph_edges *src_ed
     assert(u < 2 * structure->n);
 
     // Find a neighbor
-    uint64_t u_bitmap = src_edges->neighbor_bitmaps[u];
-    assert(u_bitmap != 0);  // otherwise, results of bsfq are undefined
-    uint64_t result;
-    asm("bsfq %1,%0" : "=r"(result) : "r"(u_bitmap));
-    uint8_t edge_index_u = (uint8_t) result;
+    assert(has_neighbor(src_edges, u));  // otherwise, results of bsfq are undefined
+    uint8_t edge_index_u = bitmap_first_set(src_edges->neighbor_bitmaps[u]);
 
     uint8_t v = structure->vertices[u].neighbors[edge_index_u].id;
     uint8_t edge_index_v = structure->vertices[u].neighbors[edge_index_u].index;
-    uint64_t v_bitmap = src_edges->neighbor_bitmaps[v];
     
     // Remove the edge in both source bitmaps
-    src_edges->neighbor_bitmaps[u] = u_bitmap & ~(0x1ULL << edge_index_u);
-    src_edges->neighbor_bitmaps[v] = v_bitmap & ~(0x1ULL << edge_index_v);
+    bitmap_clear(src_edges->neighbor_bitmaps[u], edge_index_u);
+    bitmap_clear(src_edges->neighbor_bitmaps[v], edge_index_v);
  
     // Add the edge in both dest bitmaps
-    u_bitmap = dst_edges->neighbor_bitmaps[u];
-    v_bitmap = dst_edges->neighbor_bitmaps[v];
-    dst_edges->neighbor_bitmaps[u] = u_bitmap | (0x1ULL << edge_index_u);
-    dst_edges->neighbor_bitmaps[v] = v_bitmap | (0x1ULL << edge_index_v);
+    bitmap_set(dst_edges->neighbor_bitmaps[u], edge_index_u);
+    bitmap_set(dst_edges->neighbor_bitmaps[v], edge_index_v);
 
     return v;
 }
@@ -149,19 +206,15 @@ uint8_t remove_edge_to_neighbor(struct graph_structure *structure,
     assert(u < 2 * structure->n);
 
     // Find a neighbor
-    uint64_t u_bitmap = src_edges->neighbor_bitmaps[u];
-    assert(u_bitmap != 0);  // otherwise, results of bsfq are undefined
-    uint64_t result;
-    asm("bsfq %1,%0" : "=r"(result) : "r"(u_bitmap));
-    uint8_t edge_index_u = (uint8_t) result;
+    assert(has_neighbor(src_edges, u));  // otherwise, results of bsfq are undefined
+    uint8_t edge_index_u = bitmap_first_set(src_edges->neighbor_bitmaps[u]);
 
     uint8_t v = structure->vertices[u].neighbors[edge_index_u].id;
     uint8_t edge_index_v = structure->vertices[u].neighbors[edge_index_u].index;
-    uint64_t v_bitmap = src_edges->neighbor_bitmaps[v];
     
     // Remove the edge in both source bitmaps
-    src_edges->neighbor_bitmaps[u] = u_bitmap & ~(0x1ULL << edge_index_u);
-    src_edges->neighbor_bitmaps[v] = v_bitmap & ~(0x1ULL << edge_index_v);
+    bitmap_clear(src_edges->neighbor_bitmaps[u], edge_index_u);
+    bitmap_clear(src_edges->neighbor_bitmaps[v], edge_index_v);
  
     return v;
 }
@@ -177,20 +230,15 @@ void add_edge(struct graph_structure *structure, struct graph_edges *edges,
     assert(v < 2 * n);
  
     // Find empty spots for the edge
-    uint64_t u_bitmap = edges->neighbor_bitmaps[u];
-    assert(~u_bitmap != 0);  // otherwise, results of bsfq are undefined
-    uint64_t result;
-    asm("bsfq %1,%0" : "=r"(result) : "r"(~u_bitmap));
-    uint8_t edge_index_u = (uint8_t) result;
-
-    uint64_t v_bitmap = edges->neighbor_bitmaps[v];
-    assert(~v_bitmap != 0);
-    asm("bsfq %1,%0" : "=r"(result) : "r"(~v_bitmap));
-    uint8_t edge_index_v = (uint8_t) result;
+    assert(get_degree(edges, u) < MAX_DEGREE);  // otherwise, results of bsfq are undefined
+    uint8_t edge_index_u = bitmap_first_clear(edges->neighbor_bitmaps[u]);
+
+    assert(get_degree(edges, v) < MAX_DEGREE);
+    uint8_t edge_index_v = bitmap_first_clear(edges->neighbor_bitmaps[v]);
  
     // Add edge to edges
-    edges->neighbor_bitmaps[u] = u_bitmap | (0x1ULL << edge_index_u);
-    edges->neighbor_bitmaps[v] = v_bitmap | (0x1ULL << edge_index_v);
+    bitmap_set(edges->neighbor_bitmaps[u], edge_index_u);
+    bitmap_set(edges->neighbor_bitmaps[v], edge_index_v);
 
     // Add edge to structure
     struct vertex_info *u_info = &structure->vertices[u];
@@ -208,12 +256,14 @@ void add_edges(struct graph_edges *edges_1, struct graph_edges *edges_2,
     assert(edges_1 != NULL);
     assert(edges_2 != NULL);
 
-    int i;
+    int i, w;
     for (i = 0; i < 2 * n; i++) {
-        uint64_t bitmap_1 = edges_1->neighbor_bitmaps[i];
-        uint64_t bitmap_2 = edges_2->neighbor_bitmaps[i];
-        assert((bitmap_1 & bitmap_2) == 0);
-        edges_1->neighbor_bitmaps[i] = bitmap_1 | bitmap_2;
+        for (w = 0; w < DEGREE_WORDS; w++) {
+            uint64_t bitmap_1 = edges_1->neighbor_bitmaps[i][w];
+            uint64_t bitmap_2 = edges_2->neighbor_bitmaps[i][w];
+            assert((bitmap_1 & bitmap_2) == 0);
+            edges_1->neighbor_bitmaps[i][w] = bitmap_1 | bitmap_2;
+        }
     }
 }
 
@@ -224,9 +274,10 @@ void copy_edges(struct graph_edges *src_edges, struct graph_edges *dst_edges,
     assert(src_edges != NULL);
     assert(dst_edges != NULL);
 
-    int i;
+    int i, w;
     for (i = 0; i < 2 * n; i++)
-        dst_edges->neighbor_bitmaps[i] = src_edges->neighbor_bitmaps[i];
+        for (w = 0; w < DEGREE_WORDS; w++)
+            dst_edges->neighbor_bitmaps[i][w] = src_edges->neighbor_bitmaps[i][w];
 }
 
 // Finds an edge from u to v and marks it as set. Excludes edges set in existing_edges
@@ -239,15 +290,14 @@ void set_edge(struct graph_structure *structure, struct graph_edges *existing_ed
     assert(edges != NULL);
 
     struct vertex_info *u_info = &structure->vertices[u];
-    uint64_t u_bitmap_existing = existing_edges->neighbor_bitmaps[u];
-    uint64_t u_bitmap = edges->neighbor_bitmaps[u];
-    uint64_t v_bitmap = edges->neighbor_bitmaps[v];
+    uint64_t *u_bitmap_existing = existing_edges->neighbor_bitmaps[u];
+    uint64_t *u_bitmap = edges->neighbor_bitmaps[u];
     int i;
     for (i = 0; i < MAX_DEGREE; i++) {
-        if ((u_info->neighbors[i].id == v) && !(u_bitmap & (0x1ULL << i)) &&
-            !(u_bitmap_existing & (0x1ULL << i))) {
-            edges->neighbor_bitmaps[u] = u_bitmap | (0x1ULL << i);
-            edges->neighbor_bitmaps[v] = v_bitmap | (0x1ULL << u_info->neighbors[i].index);
+        if ((u_info->neighbors[i].id == v) && !bitmap_is_set(u_bitmap, i) &&
+            !bitmap_is_set(u_bitmap_existing, i)) {
+            bitmap_set(u_bitmap, i);
+            bitmap_set(edges->neighbor_bitmaps[v], u_info->neighbors[i].index);
             return;
         }
     }
@@ -260,12 +310,14 @@ bool are_equal(struct graph_edges *edges_1, struct graph_edges *edges_2,
     assert(edges_1 != NULL);
     assert(edges_2 != NULL);
 
-    int i;
+    int i, w;
     for (i = 0; i < 2 * n; i++) {
-        uint64_t bitmap_1 = edges_1->neighbor_bitmaps[i];
-        uint64_t bitmap_2 = edges_2->neighbor_bitmaps[i];
-        if (bitmap_1 != bitmap_2)
-            return false;
+        for (w = 0; w < DEGREE_WORDS; w++) {
+            uint64_t bitmap_1 = edges_1->neighbor_bitmaps[i][w];
+            uint64_t bitmap_2 = edges_2->neighbor_bitmaps[i][w];
+            if (bitmap_1 != bitmap_2)
+                return false;
+        }
     }
 
     return true;
@@ -325,12 +377,15 @@ void print_graph(struct graph_structure *structure, struct graph_edges *edges) {
     assert(edges != NULL);
     printf("printing graph\n");
 
-    int i, j;
+    int i, j, w;
     for (i = 0; i < 2 * structure->n; i++) {
         struct vertex_info *v_info = &structure->vertices[i];
-        printf("neighbors of %d: %"PRIx64"\t", i, edges->neighbor_bitmaps[i]);
+        printf("neighbors of %d: ", i);
+        for (w = DEGREE_WORDS - 1; w >= 0; w--)
+            printf("%016"PRIx64, edges->neighbor_bitmaps[i][w]);
+        printf("\t");
         for (j = 0; j < MAX_DEGREE; j++) {
-            if ((edges->neighbor_bitmaps[i] >> j) & 0x1ULL)
+            if (bitmap_is_set(edges->neighbor_bitmaps[i], j))
                 printf("%d (%d), ", v_info->neighbors[j].id, v_info->neighbors[j].index);
         }
         printf("\n");
@@ -343,12 +398,14 @@ bool is_consistent(struct graph_structure *structure, struct graph_edges *edges)
     assert(structure != NULL);
     assert(edges != NULL);
 
-    int i, j;
+    int i, j, w;
     for (i = 0; i < 2 * structure->n; i++) {
         struct vertex_info *v_info = &structure->vertices[i];
-        for (j = 0; j < MAX_DEGREE; j++) {
-            if ((edges->neighbor_bitmaps[i] >> j) & 0x1ULL) {
+        for (w = 0; w < DEGREE_WORDS; w++) {
+            uint64_t bitmap = edges->neighbor_bitmaps[i][w];
+            for (; bitmap != 0; bitmap &= bitmap - 1) {
                 // There is an edge here!
+                j = w * 64 + __builtin_ctzll(bitmap);
                 uint8_t other = v_info->neighbors[j].id;
                 uint8_t v_index_for_other = v_info->neighbors[j].index;
                 struct vertex_info *other_info = &structure->vertices[other];
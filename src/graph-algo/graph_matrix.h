@@ -1,12 +1,12 @@
 /*
- * graph.h
+ * graph_matrix.h
  *
  *  Created on: October 20, 2013
  *      Author: aousterh
  */
 
-#ifndef GRAPH_H_
-#define GRAPH_H_
+#ifndef GRAPH_MATRIX_H_
+#define GRAPH_MATRIX_H_
 
 #include <assert.h>
 #include <inttypes.h>
@@ -212,4 +212,4 @@ void destroy_graph_test(struct graph * graph) {
     free(graph);
 }
 
-#endif /* GRAPH_H_ */
+#endif /* GRAPH_MATRIX_H_ */
@@ -0,0 +1,98 @@
+/*
+ * graph_sliced.h
+ *
+ * Bipartite multigraphs of up to 64 timeslots at once, bit-sliced: edge
+ * counts are kept as in graph_matrix.h, but each word holds one bit of the
+ * count for every graph, so arithmetic on counts runs on all graphs at once.
+ */
+
+#ifndef GRAPH_SLICED_H_
+#define GRAPH_SLICED_H_
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define SLICED_MAX_GRAPHS 64  // one per bit of a word
+#define SLICED_MAX_NODES 64   // a row of the matrix fits in a word
+#ifndef SLICED_COUNT_BITS
+#define SLICED_COUNT_BITS 6   // edges between a pair of vertices, up to 63
+#endif
+
+// Graph representation. Bit t of counts[b][u][v] is bit b of the number of
+// edges from left vertex u to right vertex v in graph t.
+// n is the number of nodes on each side of the bipartite graphs
+struct graph_sliced {
+    uint8_t n;
+    uint64_t counts[SLICED_COUNT_BITS][SLICED_MAX_NODES][SLICED_MAX_NODES];
+};
+
+// Initializes the bipartite graphs with no edges
+static inline
+void graph_sliced_init(struct graph_sliced *graph, uint8_t n) {
+    assert(graph != NULL);
+    assert(n <= SLICED_MAX_NODES);
+
+    graph->n = n;
+
+    int b, u, v;
+    for (b = 0; b < SLICED_COUNT_BITS; b++)
+        for (u = 0; u < n; u++)
+            for (v = 0; v < n; v++)
+                graph->counts[b][u][v] = 0;
+}
+
+// Adds an edge from left vertex u to right vertex v in each graph in the
+// bitmap graphs (a bit-sliced increment)
+static inline
+void graph_sliced_add_edges(struct graph_sliced *graph, uint8_t u, uint8_t v,
+                            uint64_t graphs) {
+    assert(graph != NULL);
+    assert(u < graph->n);
+    assert(v < graph->n);
+
+    uint64_t carry = graphs;
+    int b;
+    for (b = 0; b < SLICED_COUNT_BITS && carry != 0; b++) {
+        uint64_t word = graph->counts[b][u][v];
+        graph->counts[b][u][v] = word ^ carry;
+        carry &= word;
+    }
+    assert(carry == 0);  // otherwise, a count overflowed
+}
+
+// Returns the number of edges from left vertex u to right vertex v in graph t
+static inline
+uint8_t graph_sliced_get_count(struct graph_sliced *graph, uint8_t t,
+                               uint8_t u, uint8_t v) {
+    assert(graph != NULL);
+    assert(t < SLICED_MAX_GRAPHS);
+    assert(u < graph->n);
+    assert(v < graph->n);
+
+    uint8_t count = 0;
+    int b;
+    for (b = 0; b < SLICED_COUNT_BITS; b++)
+        count |= ((graph->counts[b][u][v] >> t) & 0x1ULL) << b;
+
+    return count;
+}
+
+// Transposes a 64x64 bit matrix in place, bit j of word i moves to bit i of
+// word j. Swaps blocks of 32, 16, ... 1 bits, each step on 32 pairs of words
+static inline
+void transpose_64x64(uint64_t *m) {
+    uint64_t mask = 0x00000000FFFFFFFFULL;
+    int j, k;
+
+    for (j = 32; j != 0; j >>= 1, mask ^= mask << j) {
+        for (k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+            uint64_t t = ((m[k] >> j) ^ m[k | j]) & mask;
+            m[k] ^= t << j;
+            m[k | j] ^= t;
+        }
+    }
+}
+
+#endif /* GRAPH_SLICED_H_ */
@@ -18,6 +18,250 @@ void kr_init(struct kr *kr, uint8_t degree) {
     kr->num_steps = 0;
 }
 
+// A graph in the plan of a KR: its degree and index in the matching_set
+struct kr_bin {
+    uint8_t degree;
+    uint8_t index;
+};
+
+// State while building the plan of a KR
+struct kr_builder {
+    struct kr *kr;
+    uint8_t num_matchings;
+    bool used[MAX_MATCHINGS];
+};
+
+// Returns a free index, among the matchings or the work space, and marks it used
+static uint8_t kr_take_index(struct kr_builder *builder, bool work_space) {
+    uint8_t first = work_space ? builder->num_matchings : 0;
+    uint8_t i;
+    for (i = first; i < first + builder->num_matchings; i++) {
+        if (!builder->used[i]) {
+            builder->used[i] = true;
+            return i;
+        }
+    }
+    assert(false);  // the plan always fits
+    return 0;
+}
+
+// Plans an Euler split of d into out_1 and out_2
+static void kr_split_even(struct kr_builder *builder, struct kr_bin d,
+                          struct kr_bin *out_1, struct kr_bin *out_2) {
+    assert(d.degree % 2 == 0);
+
+    // graphs of degree 2 split into matchings
+    bool work_space = (d.degree != 2);
+    uint8_t index_1 = kr_take_index(builder, work_space);
+    uint8_t index_2 = kr_take_index(builder, work_space);
+    builder->used[d.index] = false;
+
+    set_kr_step(builder->kr, d.index, index_1, index_2);
+
+    out_1->degree = out_2->degree = d.degree / 2;
+    out_1->index = index_1;
+    out_2->index = index_2;
+}
+
+// Plans an Euler split of the union of d_1 and d_2 into out_1 and out_2.
+// The last step that produced one of the two is changed to add its output
+// to the other instead, so the union is built without copying
+static void kr_split_odd(struct kr_builder *builder, struct kr_bin d_1,
+                         struct kr_bin d_2, struct kr_bin *out_1,
+                         struct kr_bin *out_2) {
+    struct kr *kr = builder->kr;
+    uint8_t degree = d_1.degree + d_2.degree;
+    assert(degree % 2 == 0);
+
+    uint8_t index_1 = kr_take_index(builder, true);
+    uint8_t index_2 = kr_take_index(builder, true);
+    builder->used[d_1.index] = false;
+    builder->used[d_2.index] = false;
+
+    int i;
+    uint8_t source = 0;
+    for (i = kr->num_steps - 1; i >= 0; i--) {
+        struct kr_step *step = &kr->steps[i];
+        if (step->dst1_index == d_1.index) {
+            step->dst1_index = source = d_2.index;
+            break;
+        } else if (step->dst1_index == d_2.index) {
+            step->dst1_index = source = d_1.index;
+            break;
+        } else if (step->dst2_index == d_1.index) {
+            step->dst2_index = source = d_2.index;
+            break;
+        } else if (step->dst2_index == d_2.index) {
+            step->dst2_index = source = d_1.index;
+            break;
+        }
+    }
+    assert(i >= 0);
+
+    set_kr_step(kr, source, index_1, index_2);
+
+    out_1->degree = out_2->degree = degree / 2;
+    out_1->index = index_1;
+    out_2->index = index_2;
+}
+
+// Plans HIT-EVEN on (a, b, c)
+static void kr_hit_even(struct kr_builder *builder, struct kr_bin *a,
+                        struct kr_bin *b, struct kr_bin *c) {
+    assert(a->degree % 2 == 1);
+    assert(b->degree % 2 == 1);
+    assert(a->degree != b->degree);
+    assert(b->degree == c->degree);
+
+    while (b->degree % 2 == 1) {
+        struct kr_bin old_a = *a;
+        *a = *c;
+        if (old_a.degree >= b->degree)
+            kr_split_odd(builder, old_a, *b, b, c);
+        else
+            kr_split_odd(builder, *b, old_a, b, c);
+    }
+}
+
+// Initialize a KR with the steps of the approximate method for an even degree
+void kr_build(struct kr *kr, uint8_t degree) {
+    assert(kr != NULL);
+    assert(degree >= 2 && degree % 2 == 0);
+    assert(degree <= KR_MAX_DEGREE);
+
+    struct kr_builder builder;
+    struct kr_bin a, b, c, d;
+    struct kr_bin rest[MAX_MATCHINGS];  // bins after a, b and c, last first
+    struct kr_bin work[MAX_MATCHINGS];
+    struct kr_bin matchings[MAX_MATCHINGS];
+    uint8_t n_rest = 0, n_work = 0, n_matchings = 0;
+    int i;
+
+    kr_init(kr, degree);
+    builder.kr = kr;
+    builder.num_matchings = degree + 1;
+    for (i = 0; i < MAX_MATCHINGS; i++)
+        builder.used[i] = false;
+
+    // solving begins with the arbitrary matching at index 0 and the graph
+    // at index num_matchings
+    a.degree = 1;
+    a.index = 0;
+    d.degree = degree;
+    d.index = builder.num_matchings;
+    builder.used[a.index] = true;
+    builder.used[d.index] = true;
+
+    // ALMOST-SOLVE, with the arbitrary matching instead of SLICE-ONE
+    kr_split_even(&builder, d, &b, &c);
+    while (a.degree != b.degree) {
+        while (b.degree % 2 == 0) {
+            rest[n_rest++] = c;
+            kr_split_even(&builder, b, &b, &c);
+        }
+        if (a.degree != b.degree)
+            kr_hit_even(&builder, &a, &b, &c);
+    }
+
+    // Split the bins down to matchings, in the order a, b, c, rest
+    for (i = 0; i < n_rest; i++)
+        work[n_work++] = rest[i];
+    work[n_work++] = c;
+    work[n_work++] = b;
+    work[n_work++] = a;
+    while (n_work > 0) {
+        struct kr_bin g = work[--n_work];
+        while (g.degree != 1) {
+            struct kr_bin g_1;
+            if (g.degree % 2 == 1) {
+                // add a matching, and split
+                assert(n_matchings > 0);
+                kr_split_odd(&builder, g, matchings[--n_matchings], &g, &g_1);
+            } else {
+                kr_split_even(&builder, g, &g, &g_1);
+            }
+            work[n_work++] = g_1;
+        }
+        matchings[n_matchings++] = g;
+    }
+    assert(n_matchings == builder.num_matchings);
+}
+
+// Finds an augmenting path from src in a matching of edges, which matches
+// dst vertices to the index of their edge from src. Returns true and
+// augments the matching if found
+static bool augment(struct graph_structure *structure, struct graph_edges *edges,
+                    uint8_t src, int16_t *match_of_dst, bool *visited) {
+    uint8_t n = structure->n;
+    struct vertex_info *src_info = &structure->vertices[src];
+    int i, w;
+
+    for (w = 0; w < DEGREE_WORDS; w++) {
+        uint64_t bitmap = edges->neighbor_bitmaps[src][w];
+        for (; bitmap != 0; bitmap &= bitmap - 1) {
+            i = w * 64 + __builtin_ctzll(bitmap);
+            uint8_t dst = src_info->neighbors[i].id - n;
+            if (visited[dst])
+                continue;
+            visited[dst] = true;
+
+            int16_t other = match_of_dst[dst];
+            if (other < 0 ||
+                augment(structure, edges,
+                        structure->vertices[n + dst].neighbors[other].id,
+                        match_of_dst, visited)) {
+                match_of_dst[dst] = src_info->neighbors[i].index;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Moves a perfect matching of the regular graph edges_in to matching_out.
+// Regular bipartite graphs always have one, found with augmenting paths
+void slice_one(struct graph_structure *structure, struct graph_edges *edges_in,
+               struct graph_edges *matching_out) {
+    assert(structure != NULL);
+    assert(edges_in != NULL);
+    assert(matching_out != NULL);
+
+    uint8_t n = structure->n;
+    int16_t match_of_dst[MAX_GRAPH_NODES];  // edge index at the dst, or -1
+    bool visited[MAX_GRAPH_NODES];
+    uint8_t src, dst;
+
+    for (dst = 0; dst < n; dst++)
+        match_of_dst[dst] = -1;
+
+    for (src = 0; src < n; src++) {
+        // most sources match directly
+        uint8_t index = bitmap_first_set(edges_in->neighbor_bitmaps[src]);
+        struct neighbor *neighbor = &structure->vertices[src].neighbors[index];
+        if (match_of_dst[neighbor->id - n] < 0) {
+            match_of_dst[neighbor->id - n] = neighbor->index;
+            continue;
+        }
+
+        for (dst = 0; dst < n; dst++)
+            visited[dst] = false;
+        bool found = augment(structure, edges_in, src, match_of_dst, visited);
+        assert(found);
+        (void) found;
+    }
+
+    // Move the matched edges
+    graph_edges_init(matching_out, n);
+    for (dst = 0; dst < n; dst++) {
+        uint8_t index = match_of_dst[dst];
+        struct neighbor *neighbor = &structure->vertices[n + dst].neighbors[index];
+        bitmap_clear(edges_in->neighbor_bitmaps[n + dst], index);
+        bitmap_clear(edges_in->neighbor_bitmaps[neighbor->id], neighbor->index);
+        bitmap_set(matching_out->neighbor_bitmaps[n + dst], index);
+        bitmap_set(matching_out->neighbor_bitmaps[neighbor->id], neighbor->index);
+    }
+}
+
 // Splits graph_in into matchings, using the arbitary matching
 // Uses the approximate method
 void solve(struct kr *kr, struct graph_structure *structure,
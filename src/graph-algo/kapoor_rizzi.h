@@ -10,9 +10,15 @@
 
 #include "graph.h"
 
+#ifndef MAX_MATCHINGS
 #define MAX_MATCHINGS 48
+#endif
 #define MAX_STEPS 128
 
+// The largest degree kr_build can plan for, the matchings of the solution
+// and as many graphs of work space must fit in MAX_MATCHINGS
+#define KR_MAX_DEGREE ((MAX_MATCHINGS / 2 - 1) & ~1)
+
 // Specification of one step
 // Note that all indices must be unique
 struct kr_step {
@@ -35,6 +41,14 @@ struct matching_set {
 // Initialize a KR
 void kr_init(struct kr *kr, uint8_t degree);
 
+// Initialize a KR with the steps of the approximate method for an even degree,
+// as kr_util.py does. The matchings of a solution end up at indices 0 to degree
+void kr_build(struct kr *kr, uint8_t degree);
+
+// Moves a perfect matching of the regular graph edges_in to matching_out
+void slice_one(struct graph_structure *structure, struct graph_edges *edges_in,
+               struct graph_edges *matching_out);
+
 // Splits graph_in into matchings, using the arbitary_matching
 // Uses the approximate method
 void solve(struct kr *kr, struct graph_structure *structure,
@@ -0,0 +1,165 @@
+/*
+ * maxmin.c
+ *
+ * Max-min fair rates by progressive filling, see maxmin.h.
+ */
+
+#include "maxmin.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "../protocol/topology.h"
+
+/* marks a flow whose rate is still growing */
+#define MAXMIN_GROWING		-1.0
+
+// A flow that might reach its demand before its links fill, for sorting
+struct maxmin_limited {
+	double demand;
+	uint32_t flow;
+};
+
+/**
+ * State of the computation. Links from sources are 0..num_nodes-1, links to
+ *   destinations follow.
+ */
+struct maxmin_state {
+	uint16_t num_nodes;
+	double capacity[2 * MAX_NODES];		/* not yet taken by stopped flows */
+	double share[2 * MAX_NODES];		/* of the capacity per growing flow */
+	uint32_t n_growing[2 * MAX_NODES];
+	uint32_t first[2 * MAX_NODES + 1];	/* of the link's flows in link_flows */
+	uint32_t *link_flows;
+};
+
+static int compare_limited(const void *a, const void *b)
+{
+	double x = ((const struct maxmin_limited *) a)->demand;
+	double y = ((const struct maxmin_limited *) b)->demand;
+	return (x > y) - (x < y);
+}
+
+static inline void update_share(struct maxmin_state *st, uint32_t link)
+{
+	st->share[link] = (st->n_growing[link] > 0)
+			? st->capacity[link] / st->n_growing[link] : HUGE_VAL;
+}
+
+static inline void stop_flow(struct maxmin_state *st, struct maxmin_flow *flow,
+		double rate)
+{
+	uint32_t src_link = flow->src;
+	uint32_t dst_link = st->num_nodes + flow->dst;
+
+	flow->rate = rate;
+	st->capacity[src_link] -= rate;
+	st->capacity[dst_link] -= rate;
+	st->n_growing[src_link]--;
+	st->n_growing[dst_link]--;
+	update_share(st, src_link);
+	update_share(st, dst_link);
+}
+
+uint32_t maxmin_fair_rates(struct maxmin_flow *flows, uint32_t n_flows,
+		uint16_t num_nodes)
+{
+	struct maxmin_state st;
+	struct maxmin_limited *limited;
+	uint32_t n_links = 2 * num_nodes;
+	uint32_t n_limited = 0, next_limited = 0;
+	uint32_t n_growing = 0;
+	uint32_t rounds = 0;
+	uint32_t i, link;
+
+	assert(num_nodes <= MAX_NODES);
+
+	/* nothing to allocate, and malloc(0) may return NULL */
+	if (n_flows == 0)
+		return 0;
+
+	st.num_nodes = num_nodes;
+	st.link_flows = malloc(2 * n_flows * sizeof(uint32_t));
+	limited = malloc(n_flows * sizeof(struct maxmin_limited));
+	assert(st.link_flows != NULL && limited != NULL);
+
+	for (link = 0; link < n_links; link++) {
+		st.capacity[link] = 1.0;
+		st.n_growing[link] = 0;
+	}
+
+	/* count the growing flows of each link, then list them */
+	for (i = 0; i < n_flows; i++) {
+		if (flows[i].demand <= 0) {
+			flows[i].rate = 0;
+			continue;
+		}
+		flows[i].rate = MAXMIN_GROWING;
+		st.n_growing[flows[i].src]++;
+		st.n_growing[num_nodes + flows[i].dst]++;
+		n_growing++;
+		/* a link carries at most 1, so only lower demands can stop a flow */
+		if (flows[i].demand < 1.0) {
+			limited[n_limited].demand = flows[i].demand;
+			limited[n_limited++].flow = i;
+		}
+	}
+	st.first[0] = 0;
+	for (link = 0; link < n_links; link++)
+		st.first[link + 1] = st.first[link] + st.n_growing[link];
+	for (i = 0; i < n_flows; i++) {
+		if (flows[i].rate != MAXMIN_GROWING)
+			continue;
+		/* fill each link's list from its end, moving first[] back by one */
+		st.link_flows[--st.first[flows[i].src + 1]] = i;
+		st.link_flows[--st.first[num_nodes + flows[i].dst + 1]] = i;
+	}
+	/* restore first[] */
+	for (link = 0; link < n_links; link++) {
+		st.first[link + 1] = st.first[link] + st.n_growing[link];
+		update_share(&st, link);
+	}
+	qsort(limited, n_limited, sizeof(struct maxmin_limited), compare_limited);
+
+	while (n_growing > 0) {
+		uint32_t bottleneck = 0;
+
+		/* the link that fills first, if all growing flows grow together */
+		for (link = 1; link < n_links; link++)
+			if (st.share[link] < st.share[bottleneck])
+				bottleneck = link;
+		double level = (st.share[bottleneck] > 0) ? st.share[bottleneck] : 0;
+		rounds++;
+
+		/* flows that reach their demand first stop there. that only raises
+		 * the share of their links, so all of them can stop at once */
+		while (next_limited < n_limited &&
+				flows[limited[next_limited].flow].rate != MAXMIN_GROWING)
+			next_limited++;
+		if (next_limited < n_limited && limited[next_limited].demand <= level) {
+			while (next_limited < n_limited
+					&& limited[next_limited].demand <= level) {
+				struct maxmin_flow *flow = &flows[limited[next_limited++].flow];
+				if (flow->rate != MAXMIN_GROWING)
+					continue;
+				stop_flow(&st, flow, flow->demand);
+				n_growing--;
+			}
+			continue;
+		}
+
+		/* otherwise the bottleneck's growing flows stop at its fair share */
+		for (i = st.first[bottleneck]; i < st.first[bottleneck + 1]; i++) {
+			struct maxmin_flow *flow = &flows[st.link_flows[i]];
+			if (flow->rate != MAXMIN_GROWING)
+				continue;
+			stop_flow(&st, flow, level);
+			n_growing--;
+		}
+	}
+
+	free(st.link_flows);
+	free(limited);
+	return rounds;
+}
@@ -0,0 +1,37 @@
+/*
+ * maxmin.h
+ *
+ * Max-min fair rates for a set of flows between endpoints whose links to the
+ * network carry one timeslot per timeslot in each direction.
+ */
+
+#ifndef MAXMIN_H_
+#define MAXMIN_H_
+
+#include <stdint.h>
+
+/**
+ * A flow for the rate computation
+ * @src: source endpoint
+ * @dst: destination endpoint
+ * @demand: the most the flow can use, in timeslots per timeslot
+ * @rate: the flow's max-min fair rate, set by maxmin_fair_rates()
+ */
+struct maxmin_flow {
+	uint16_t src;
+	uint16_t dst;
+	double demand;
+	double rate;
+};
+
+/**
+ * Sets the rate of each of the @n_flows flows, between endpoints below
+ *   @num_nodes, to its max-min fair share by progressive filling: all flows
+ *   not yet bottlenecked grow at the same pace, and stop when their source or
+ *   destination link is full or they reach their demand.
+ * @returns the number of filling rounds
+ */
+uint32_t maxmin_fair_rates(struct maxmin_flow *flows, uint32_t n_flows,
+		uint16_t num_nodes);
+
+#endif /* MAXMIN_H_ */
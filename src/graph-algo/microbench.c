@@ -1,18 +1,8 @@
 
-#define MAX_NODES 		64
+#define FP_NODES_SHIFT	6  // 2^FP_NODES_SHIFT = MAX_NODES
 
 #define BATCH_SIZE 8  // must be consistent with bitmaps in batch_state
 #define BATCH_SHIFT 3  // 2^BATCH_SHIFT = BATCH_SIZE
-/* packing of bitmasks into 64 bit words */
-#if 0
-#define BITMASKS_PER_64_BIT 	(64 >> BATCH_SHIFT)
-#define BITMASK_WORD(node)		(node >> (6 - BATCH_SHIFT))
-#define BITMASK_SHIFT(node)		((node << BATCH_SHIFT) & (64 - 1))
-#else
-#define BITMASKS_PER_64_BIT 	1
-#define BITMASK_WORD(node)		node
-#define BITMASK_SHIFT(node)		0
-#endif
 
 #define TEST_NUM_BINS				(4*1000*1000)
 #define TEST_SEED					0xDEADBEEFDEADBEEFULL
@@ -23,8 +13,141 @@
 #define RAND_A					6364136223846793005
 #define RAND_C					1442695040888963407
 
+#define TEST_SIMD_NUM_BINS			(200*1000)
+#define TEST_SIMD_EDGES_PER_BIN		256
+
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+#include "batch.h"
+#include "batch_simd.h"
+#include "chunk_bin.h"
+#include "rdtsc.h"
+
+/**
+ * Allocates every edge of the bin to its first available timeslot, one edge
+ *   at a time, like try_allocation().
+ * @returns the number of edges allocated
+ */
+static uint32_t alloc_bin_scalar(struct batch_state *state,
+		struct chunk_bin *bin)
+{
+	struct bin_chunk *chunk = bin->head;
+	uint32_t n_alloc = 0;
+	uint32_t i, j;
+
+	for (i = 0; i < chunk_bin_size(bin); i += CHUNK_BIN_CHUNK_SIZE) {
+		for (j = 0; j < CHUNK_BIN_CHUNK_SIZE && i + j < chunk_bin_size(bin); j++) {
+			uint16_t src = chunk->src[j];
+			uint16_t dst = chunk->dst[j];
+			uint64_t bitmap = batch_state_get_avail_bitmap(state, src, dst);
+			uint64_t set_bit = bitmap & (-bitmap);
+			batch_state_set_occupied_conditional(state, src, dst,
+					__builtin_ctzll(bitmap | (1ULL << BATCH_SIZE)) & (BATCH_SIZE - 1),
+					set_bit);
+			n_alloc += (set_bit != 0);
+		}
+		chunk = chunk->next;
+	}
+	return n_alloc;
+}
+
+/**
+ * Allocates like alloc_bin_scalar(), computing available timeslots a group
+ *   of edges at a time, like try_allocation_chunk_simd(). Bins must hold a
+ *   multiple of CHUNK_BIN_CHUNK_SIZE edges.
+ */
+static uint32_t alloc_bin_simd(struct batch_state *state,
+		struct chunk_bin *bin, enum batch_simd_level level)
+{
+	uint64_t bitmaps[BATCH_SIMD_MAX_GROUP];
+	uint32_t group_size = batch_simd_group_size(level);
+	struct bin_chunk *chunk;
+	uint32_t n_alloc = 0;
+	uint32_t i, j;
+
+	for (chunk = bin->head; chunk != NULL; chunk = chunk->next) {
+		for (i = 0; i < CHUNK_BIN_CHUNK_SIZE; i += group_size) {
+			uint32_t conflicts = batch_state_get_avail_bitmaps(level, state,
+					&chunk->src[i], &chunk->dst[i], bitmaps);
+			for (j = 0; j < group_size; j++) {
+				uint16_t src = chunk->src[i + j];
+				uint16_t dst = chunk->dst[i + j];
+				uint64_t bitmap = bitmaps[j];
+				if (conflicts & (1 << j))
+					bitmap = batch_state_get_avail_bitmap(state, src, dst);
+				uint64_t set_bit = bitmap & (-bitmap);
+				batch_state_set_occupied_conditional(state, src, dst,
+						__builtin_ctzll(bitmap | (1ULL << BATCH_SIZE)) & (BATCH_SIZE - 1),
+						set_bit);
+				n_alloc += (set_bit != 0);
+			}
+		}
+	}
+	return n_alloc;
+}
+
+/**
+ * Runs the scalar allocation and every vector allocation supported by the
+ *   CPU on the same pseudo-random bins, and prints cycles per edge. The
+ *   number of allocations must be the same for all.
+ */
+static void bench_simd_allocation(void)
+{
+	struct batch_state state;
+	struct chunk_pool pool;
+	struct chunk_bin bin;
+	enum batch_simd_level max_level = batch_simd_detect();
+	enum batch_simd_level level;
+	uint64_t rand_x = TEST_SEED;
+	uint64_t scalar_alloc = 0;
+	uint32_t i, j;
+
+	struct fp_mempool *chunk_mempool = fp_mempool_create(
+			TEST_SIMD_EDGES_PER_BIN / CHUNK_BIN_CHUNK_SIZE,
+			sizeof(struct bin_chunk), 0);
+	if (chunk_mempool == NULL || chunk_pool_init(&pool, chunk_mempool,
+			TEST_SIMD_EDGES_PER_BIN / CHUNK_BIN_CHUNK_SIZE) != 0) {
+		printf("could not allocate bin chunks\n");
+		exit(-1);
+	}
+	chunk_bin_init(&bin);
+
+	for (level = BATCH_SIMD_NONE; level <= max_level; level++) {
+		uint64_t total_alloc = 0;
+		uint64_t total_cycles = 0;
+
+		rand_x = TEST_SEED;
+		for (i = 0; i < TEST_SIMD_NUM_BINS; i++) {
+			/* fill a bin with random edges */
+			chunk_bin_reset(&bin, &pool);
+			for (j = 0; j < TEST_SIMD_EDGES_PER_BIN; j++) {
+				rand_x = rand_x * RAND_A + RAND_C;
+				chunk_bin_enqueue(&bin, &pool, (rand_x >> 32) & (MAX_NODES - 1),
+						(rand_x >> 48) % (MAX_NODES - 1), 1, 0, 0);
+			}
+			batch_state_init(&state, false, 0, 0, MAX_NODES);
+
+			uint64_t start = current_time();
+			if (level == BATCH_SIMD_NONE)
+				total_alloc += alloc_bin_scalar(&state, &bin);
+			else
+				total_alloc += alloc_bin_simd(&state, &bin, level);
+			total_cycles += current_time() - start;
+		}
+
+		if (level == BATCH_SIMD_NONE)
+			scalar_alloc = total_alloc;
+		printf("simd level %d: allocated %llu, %.2f cycles/edge%s\n", level,
+				(unsigned long long)total_alloc,
+				(double)total_cycles / (TEST_SIMD_NUM_BINS * TEST_SIMD_EDGES_PER_BIN),
+				(total_alloc == scalar_alloc) ? "" : " MISMATCH");
+	}
+	chunk_bin_reset(&bin, &pool);
+	chunk_pool_free(&pool);
+	fp_mempool_destroy(chunk_mempool);
+}
 
 int main() {
     uint64_t src_endnodes [MAX_NODES / BITMASKS_PER_64_BIT];
@@ -93,4 +216,6 @@ int main() {
     }
 
     printf("batch_total %llu\n", batch_total);
+
+    bench_simd_allocation();
 }
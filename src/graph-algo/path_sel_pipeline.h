@@ -0,0 +1,141 @@
+/*
+ * path_sel_pipeline.h
+ *
+ * Path selection on several cores. Cores take whole timeslots of admitted
+ * traffic from a shared ring, select paths for them independently, and hand
+ * them back in the order they were taken. Each timeslot gets a ticket as it is
+ * taken. Finished timeslots wait in a window indexed by ticket until all
+ * earlier ones are out, and whichever core finishes the next one due delivers
+ * every consecutive finished timeslot.
+ */
+
+#ifndef PATH_SEL_PIPELINE_H_
+#define PATH_SEL_PIPELINE_H_
+
+#include "admitted.h"
+#include "fp_ring.h"
+#include "path_selection.h"
+
+/* timeslots in flight between taking and delivering, a power of two */
+#ifndef PATH_SEL_WINDOW
+#define PATH_SEL_WINDOW		64
+#endif
+
+struct path_sel_pipeline {
+	struct fp_ring *q_admitted;
+	struct fp_ring *q_path_selected;
+	uint8_t num_racks;
+
+	/* taking timeslots from q_admitted */
+	uint32_t take_lock __attribute__((aligned(64)));
+	uint64_t next_ticket;
+
+	/* delivering timeslots to q_path_selected */
+	uint32_t deliver_lock __attribute__((aligned(64)));
+	uint64_t next_to_deliver;
+
+	/* finished timeslots by ticket, NULL until finished */
+	struct admitted_traffic *done[PATH_SEL_WINDOW] __attribute__((aligned(64)));
+};
+
+/**
+ * Initialize a pipeline taking timeslots from 'q_admitted' and delivering them
+ *    to 'q_path_selected'
+ */
+static inline
+void path_sel_pipeline_init(struct path_sel_pipeline *pipeline,
+		struct fp_ring *q_admitted, struct fp_ring *q_path_selected,
+		uint8_t num_racks)
+{
+	uint32_t i;
+
+	pipeline->q_admitted = q_admitted;
+	pipeline->q_path_selected = q_path_selected;
+	pipeline->num_racks = num_racks;
+	pipeline->take_lock = 0;
+	pipeline->next_ticket = 0;
+	pipeline->deliver_lock = 0;
+	pipeline->next_to_deliver = 0;
+	for (i = 0; i < PATH_SEL_WINDOW; i++)
+		pipeline->done[i] = NULL;
+}
+
+/**
+ * Takes the next timeslot and its ticket, returns false if there is none or
+ *    the window is full
+ */
+static inline
+bool _path_sel_take(struct path_sel_pipeline *pipeline,
+		struct admitted_traffic **admitted, uint64_t *ticket)
+{
+	bool taken = false;
+
+	if (__atomic_exchange_n(&pipeline->take_lock, 1, __ATOMIC_ACQUIRE) != 0)
+		return false; /* another core is taking one */
+
+	/* don't take a timeslot that would overwrite one not yet delivered */
+	if (pipeline->next_ticket - __atomic_load_n(&pipeline->next_to_deliver,
+			__ATOMIC_ACQUIRE) < PATH_SEL_WINDOW
+	    && fp_ring_dequeue(pipeline->q_admitted, (void **)admitted) == 0) {
+		*ticket = pipeline->next_ticket++;
+		taken = true;
+	}
+
+	__atomic_store_n(&pipeline->take_lock, 0, __ATOMIC_RELEASE);
+	return taken;
+}
+
+/**
+ * Delivers all finished timeslots that are next in order, unless another
+ *    core is delivering already
+ */
+static inline
+void _path_sel_deliver(struct path_sel_pipeline *pipeline)
+{
+	struct admitted_traffic *admitted;
+	uint32_t index;
+
+	while (__atomic_exchange_n(&pipeline->deliver_lock, 1, __ATOMIC_SEQ_CST) == 0) {
+		index = pipeline->next_to_deliver & (PATH_SEL_WINDOW - 1);
+		while ((admitted = __atomic_load_n(&pipeline->done[index],
+				__ATOMIC_ACQUIRE)) != NULL) {
+			__atomic_store_n(&pipeline->done[index], NULL, __ATOMIC_RELAXED);
+			while (fp_ring_enqueue(pipeline->q_path_selected,
+					(void *)admitted) != 0)
+				/* busy wait */;
+			__atomic_store_n(&pipeline->next_to_deliver,
+					pipeline->next_to_deliver + 1, __ATOMIC_RELEASE);
+			index = pipeline->next_to_deliver & (PATH_SEL_WINDOW - 1);
+		}
+		__atomic_store_n(&pipeline->deliver_lock, 0, __ATOMIC_SEQ_CST);
+
+		/* a core that finished the next timeslot while we held the lock
+		 * left it to us, check once more */
+		if (__atomic_load_n(&pipeline->done[index], __ATOMIC_SEQ_CST) == NULL)
+			break;
+	}
+}
+
+/**
+ * Selects paths for one timeslot and delivers what is ready in order.
+ *    Returns false if there was no timeslot to take. Any number of cores
+ *    may call this on the same pipeline
+ */
+static inline
+bool path_sel_pipeline_poll(struct path_sel_pipeline *pipeline)
+{
+	struct admitted_traffic *admitted;
+	uint64_t ticket;
+
+	if (!_path_sel_take(pipeline, &admitted, &ticket))
+		return false;
+
+	select_paths(admitted, pipeline->num_racks);
+
+	__atomic_store_n(&pipeline->done[ticket & (PATH_SEL_WINDOW - 1)],
+			admitted, __ATOMIC_SEQ_CST);
+	_path_sel_deliver(pipeline);
+	return true;
+}
+
+#endif /* PATH_SEL_PIPELINE_H_ */
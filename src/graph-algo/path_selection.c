@@ -8,30 +8,39 @@
 #include "admissible_structures.h"
 #include "euler_split.h"
 #include "graph.h"
+#include "kapoor_rizzi.h"
 #include "path_selection.h"
 
-#define NUM_GRAPHS 3
+#if (NUM_PATHS < 2)
+#error "path selection splits traffic into at least two paths"
+#endif
+#if !PATH_SEL_KAPOOR_RIZZI && ((NUM_PATHS & (NUM_PATHS - 1)) != 0)
+#error "Euler splits need a power-of-two NUM_PATHS, use PATH_SEL_KAPOOR_RIZZI"
+#endif
+#if (MAX_RACKS > MAX_GRAPH_NODES)
+#error "the rack graph needs MAX_GRAPH_NODES of at least MAX_RACKS"
+#endif
 
-// Data structure for holding all admitted edge indices
-// for a particular pair of src/dst racks
-struct racks_to_nodes {
-    uint16_t size;
-    uint16_t admitted_indices[MAX_NODES_PER_RACK];
-};
+#define NO_ADMITTED_INDEX 0xFFFF  // ends a list of admitted indices
 
 // Data structure for mapping from rack numbers back to
-// src/dst ids
+// src/dst ids. The admitted edges of each pair of src/dst racks
+// form a list, most recently added first
 struct racks_to_nodes_mapping {
-    struct racks_to_nodes mappings[MAX_RACKS * MAX_RACKS];
+    uint16_t first[MAX_RACKS * MAX_RACKS];
+    uint16_t next[MAX_NODES];
 };
 
 // Initialize a rack to nodes mapping as empty
-static void init_racks_to_nodes_mapping(struct racks_to_nodes_mapping *map) {
+static void init_racks_to_nodes_mapping(struct racks_to_nodes_mapping *map,
+                                        uint8_t num_racks) {
     assert(map != NULL);
 
-    uint16_t i;
-    for (i = 0; i < MAX_RACKS * MAX_RACKS; i++)
-        map->mappings[i].size = 0;
+    uint16_t src, dst;
+    for (src = 0; src < num_racks; src++) {
+        for (dst = 0; dst < num_racks; dst++)
+            map->first[src * MAX_RACKS + dst] = NO_ADMITTED_INDEX;
+    }
 }
 
 // Obtain the index in a racks_to_nodes_mapping of a particular
@@ -50,12 +59,15 @@ void print_racks_to_nodes_mapping_counts(struct racks_to_nodes_mapping *map,
     assert(map != NULL);
 
     uint16_t total_count = 0;
-    uint16_t src, dst;
+    uint16_t src, dst, i, count;
     for (src = 0; src < num_racks; src++) {
         for (dst = 0; dst < num_racks; dst++) {
             uint32_t index = get_rack_pair_index(src, dst);
-            printf("src %d dst %d: %d\n", src, dst, map->mappings[index].size);
-            total_count += map->mappings[index].size;
+            count = 0;
+            for (i = map->first[index]; i != NO_ADMITTED_INDEX; i = map->next[i])
+                count++;
+            printf("src %d dst %d: %d\n", src, dst, count);
+            total_count += count;
         }
     }
     printf("total count: %d\n", total_count);
@@ -76,15 +88,14 @@ static void map_racks_to_nodes(struct admitted_traffic *admitted,
         uint16_t dst_rack = fp_rack_from_node_id(edge->dst);
 
         uint32_t rack_pair_index = get_rack_pair_index(src_rack, dst_rack);
-        struct racks_to_nodes *rack_pair = &map->mappings[rack_pair_index];
-        rack_pair->admitted_indices[rack_pair->size] = i;
-        rack_pair->size++;
+        map->next[i] = map->first[rack_pair_index];
+        map->first[rack_pair_index] = i;
     }
 }
 
 // Construct the graph structure and edges for the admitted traffic
-// Ensure that it is a regular graph
-static void construct_graph(struct admitted_traffic *admitted,
+// Ensure that it is a regular graph, returns its degree
+static uint16_t construct_graph(struct admitted_traffic *admitted,
                      struct graph_structure *structure,
                      struct graph_edges *edges) {
     assert(structure != NULL);
@@ -92,8 +103,8 @@ static void construct_graph(struct admitted_traffic *admitted,
 
     // Set all rack counts to zero initially
     uint8_t num_racks = structure->n;
-    uint8_t src_rack_counts[num_racks];
-    uint8_t dst_rack_counts[num_racks];
+    uint16_t src_rack_counts[num_racks];
+    uint16_t dst_rack_counts[num_racks];
     uint16_t i;
     for (i = 0; i < num_racks; i++) {
         src_rack_counts[i] = 0;
@@ -117,7 +128,7 @@ static void construct_graph(struct admitted_traffic *admitted,
     }
 
     // Find maximum necessary degree
-    uint8_t max_degree = 0;
+    uint16_t max_degree = 0;
     for (i = 0; i < num_racks; i++) {
         if (src_rack_counts[i] > max_degree)
             max_degree = src_rack_counts[i];
@@ -129,6 +140,7 @@ static void construct_graph(struct admitted_traffic *admitted,
     if (max_degree % NUM_PATHS != 0) {
         max_degree = (max_degree / NUM_PATHS + 1) * NUM_PATHS;
     }
+    assert(max_degree <= MAX_DEGREE);
 
     // Add dummy edges so that all racks have max_degree
     // TODO: implement merging approach instead?
@@ -146,6 +158,8 @@ static void construct_graph(struct admitted_traffic *admitted,
         num_edges++;
     }
     assert(is_consistent(structure, edges));
+
+    return max_degree;
 }
 
 // Assign an edge from src_rack to dst_rack in the admitted traffic to path.
@@ -158,15 +172,14 @@ static void assign_to_path(struct racks_to_nodes_mapping *map,
     assert(path < NUM_PATHS);
 
     uint32_t rack_pair_index = get_rack_pair_index(src_rack, dst_rack);
-    struct racks_to_nodes *rack_pair = &map->mappings[rack_pair_index];
+    uint16_t admitted_index = map->first[rack_pair_index];
     
-    if (rack_pair->size > 0) {
+    if (admitted_index != NO_ADMITTED_INDEX) {
         // This is not a dummy edge
-        uint16_t admitted_index = rack_pair->admitted_indices[rack_pair->size - 1];
         assert(admitted_index < admitted->size);
         struct admitted_edge *edge = &admitted->edges[admitted_index];
         edge->dst = (edge->dst & PATH_MASK) + (path << PATH_SHIFT);
-        rack_pair->size--;
+        map->first[rack_pair_index] = map->next[admitted_index];
     }
 } 
 
@@ -212,13 +225,115 @@ static void split_and_populate_paths(struct graph_structure *structure,
     }
 }
 
+// Splits the edges into n_paths sets, one per path from first_path on, and
+// sets the path information for these edges. Each Euler split halves the
+// degree, until the last one assigns paths.
+static void split_into_paths(struct graph_structure *structure,
+                             struct graph_edges *edges,
+                             struct racks_to_nodes_mapping *map,
+                             struct admitted_traffic *admitted,
+                             uint8_t first_path, uint8_t n_paths) {
+    assert(n_paths >= 2);
+
+    if (n_paths == 2) {
+        split_and_populate_paths(structure, edges, map, admitted, first_path,
+                                 first_path + 1);
+        return;
+    }
+
+    struct graph_edges edges_1, edges_2;
+    graph_edges_init(&edges_1, structure->n);
+    graph_edges_init(&edges_2, structure->n);
+    split(structure, edges, &edges_1, &edges_2);
+
+    split_into_paths(structure, &edges_1, map, admitted, first_path, n_paths / 2);
+    split_into_paths(structure, &edges_2, map, admitted, first_path + n_paths / 2,
+                     n_paths / 2);
+}
+
+// Sets the path information for the edges of a perfect matching
+static void populate_path_from_matching(struct graph_structure *structure,
+                                        struct graph_edges *matching,
+                                        struct racks_to_nodes_mapping *map,
+                                        struct admitted_traffic *admitted,
+                                        uint8_t path) {
+    assert(is_perfect_matching(matching, structure->n));
+    assert(path < NUM_PATHS);
+
+    uint8_t num_racks = structure->n;
+
+    uint8_t src;
+    for (src = 0; src < num_racks; src++) {
+        uint8_t index = bitmap_first_set(matching->neighbor_bitmaps[src]);
+        uint8_t dst = structure->vertices[src].neighbors[index].id;
+        assign_to_path(map, admitted, src, dst - num_racks, path);
+    }
+}
+
+// Colors the edges of a regular graph of this degree with perfect matchings
+// and sets the path information for them, matchings_per_path consecutive
+// matchings per path. *next_matching counts the matchings so far.
+// Even degrees are Euler split. An odd degree gets a perfect matching sliced
+// off, and Kapoor-Rizzi colors the rest, using that matching as the arbitrary
+// one so the coloring is exact.
+static void color_into_paths(struct graph_structure *structure,
+                             struct graph_edges *edges, uint16_t degree,
+                             struct racks_to_nodes_mapping *map,
+                             struct admitted_traffic *admitted,
+                             uint16_t matchings_per_path,
+                             uint16_t *next_matching) {
+    assert(degree >= 1);
+
+    if (degree == 1) {
+        populate_path_from_matching(structure, edges, map, admitted,
+                                    *next_matching / matchings_per_path);
+        (*next_matching)++;
+        return;
+    }
+
+    if (degree % 2 == 0) {
+        struct graph_edges edges_1, edges_2;
+        graph_edges_init(&edges_1, structure->n);
+        graph_edges_init(&edges_2, structure->n);
+        split(structure, edges, &edges_1, &edges_2);
+
+        color_into_paths(structure, &edges_1, degree / 2, map, admitted,
+                         matchings_per_path, next_matching);
+        color_into_paths(structure, &edges_2, degree / 2, map, admitted,
+                         matchings_per_path, next_matching);
+        return;
+    }
+
+    struct graph_edges matching;
+    slice_one(structure, edges, &matching);
+
+    if (degree - 1 > KR_MAX_DEGREE) {
+        // too many matchings for one solution, split the rest instead
+        color_into_paths(structure, &matching, 1, map, admitted,
+                         matchings_per_path, next_matching);
+        color_into_paths(structure, edges, degree - 1, map, admitted,
+                         matchings_per_path, next_matching);
+        return;
+    }
+
+    struct kr kr;
+    struct matching_set solution;
+    kr_build(&kr, degree - 1);
+    solve(&kr, structure, edges, &matching, &solution);
+
+    uint8_t i;
+    for (i = 0; i < solution.num_matchings; i++)
+        color_into_paths(structure, &solution.matchings[i], 1, map, admitted,
+                         matchings_per_path, next_matching);
+}
+
 // Returns true if the assignment of paths is valid; false otherwise
 bool paths_are_valid(struct admitted_traffic *admitted, uint8_t num_racks) {
     assert(admitted != NULL);
 
     uint16_t i, j;
-    uint8_t src_rack_path_counts [MAX_RACKS * NUM_PATHS];
-    uint8_t dst_rack_path_counts [MAX_RACKS * NUM_PATHS];
+    uint16_t src_rack_path_counts [MAX_RACKS * NUM_PATHS];
+    uint16_t dst_rack_path_counts [MAX_RACKS * NUM_PATHS];
 
     for (i = 0; i < num_racks * NUM_PATHS; i++) {
         src_rack_path_counts[i] = 0;
@@ -266,33 +381,57 @@ bool paths_are_valid(struct admitted_traffic *admitted, uint8_t num_racks) {
     return true;
 }
 
-// Selects paths for traffic in admitted. Modifies the highest two
-// bits of the destination to specify the path_id.
-void select_paths(struct admitted_traffic *admitted, uint8_t num_racks) {
+// Selects paths for traffic in admitted, with Kapoor-Rizzi if
+// use_kapoor_rizzi and Euler splits otherwise
+static inline
+void select_paths_with(struct admitted_traffic *admitted, uint8_t num_racks,
+                       bool use_kapoor_rizzi) {
     assert(admitted != NULL);
     assert(num_racks <= MAX_RACKS);
 
     // Compute the mapping from rack ids to node ids
     struct racks_to_nodes_mapping map;
-    init_racks_to_nodes_mapping(&map);
+    init_racks_to_nodes_mapping(&map, num_racks);
     map_racks_to_nodes(admitted, &map);
 
-    // Initialize the graphs
+    // Initialize the graph
     struct graph_structure structure;
     graph_structure_init(&structure, num_racks);
-    struct graph_edges edges[NUM_GRAPHS];
-    uint8_t i;
-    for (i = 0; i < NUM_GRAPHS; i++)
-        graph_edges_init(&edges[i], num_racks);
+    struct graph_edges edges;
+    graph_edges_init(&edges, num_racks);
  
     // Construct the input graph, make it regular
-    construct_graph(admitted, &structure, &edges[0]);
+    uint16_t degree = construct_graph(admitted, &structure, &edges);
+
+    if (use_kapoor_rizzi) {
+        // Color the graph with perfect matchings, degree / NUM_PATHS per path
+        uint16_t next_matching = 0;
+        if (degree > 0)
+            color_into_paths(&structure, &edges, degree, &map, admitted,
+                             degree / NUM_PATHS, &next_matching);
+        assert(next_matching == degree);
+    } else {
+        // Perform Euler splits to get NUM_PATHS sets of edges, marking the
+        // paths in admitted in the last split
+        split_into_paths(&structure, &edges, &map, admitted, 0, NUM_PATHS);
+    }
+}
 
-    // Perform an Euler splits to get NUM_COLOR/2 sets of edges
-    split(&structure, &edges[0], &edges[1], &edges[2]);
+// Selects paths with Euler splits. NUM_PATHS must be a power of two
+void select_paths_euler(struct admitted_traffic *admitted, uint8_t num_racks) {
+    assert((NUM_PATHS & (NUM_PATHS - 1)) == 0);
 
-    // Perform the remaining two splits to get NUM_COLOR sets of edges
-    // and simultaneously mark the paths in admitted
-    split_and_populate_paths(&structure, &edges[1], &map, admitted, 0, 1);
-    split_and_populate_paths(&structure, &edges[2], &map, admitted, 2, 3);
+    select_paths_with(admitted, num_racks, false);
+}
+
+// Selects paths by edge coloring with Kapoor-Rizzi, for any NUM_PATHS
+void select_paths_kapoor_rizzi(struct admitted_traffic *admitted,
+                               uint8_t num_racks) {
+    select_paths_with(admitted, num_racks, true);
+}
+
+// Selects paths for traffic in admitted. Modifies the highest
+// FP_PATH_BITS of the destination to specify the path_id.
+void select_paths(struct admitted_traffic *admitted, uint8_t num_racks) {
+    select_paths_with(admitted, num_racks, PATH_SEL_KAPOOR_RIZZI);
 }
@@ -10,14 +10,28 @@
 
 #include "admitted.h"
 
-#define NUM_PATHS 4  // if not 4, NUM_GRAPHS and related code must be modified
-#define PATH_MASK 0x3FFF  // 2^PATH_SHIFT - 1
-#define PATH_SHIFT 14
+#define NUM_PATHS FP_NUM_PATHS  // set with -DFP_PATH_BITS or -DFP_NUM_PATHS
+#define PATH_MASK FP_NODE_MASK  // 2^PATH_SHIFT - 1
+#define PATH_SHIFT FP_PATH_SHIFT
+
+// Euler splits only divide traffic among a power-of-two number of paths.
+// Other path counts use edge coloring with Kapoor-Rizzi, which can also be
+// chosen for any path count with -DPATH_SEL_KAPOOR_RIZZI=1
+#ifndef PATH_SEL_KAPOOR_RIZZI
+#define PATH_SEL_KAPOOR_RIZZI ((NUM_PATHS & (NUM_PATHS - 1)) != 0)
+#endif
 
 // Selects paths for traffic in admitted and writes the path ids
-// to the most significant bits of the destination ip addrs
+// to the most significant FP_PATH_BITS of the destination ip addrs
 void select_paths(struct admitted_traffic *admitted, uint8_t num_racks);
 
+// Selects paths with Euler splits. NUM_PATHS must be a power of two
+void select_paths_euler(struct admitted_traffic *admitted, uint8_t num_racks);
+
+// Selects paths by edge coloring with Kapoor-Rizzi, for any NUM_PATHS
+void select_paths_kapoor_rizzi(struct admitted_traffic *admitted,
+                               uint8_t num_racks);
+
 // Returns true if the assignment of paths is valid; false otherwise
 bool paths_are_valid(struct admitted_traffic *admitted, uint8_t num_racks);
 
@@ -11,29 +11,59 @@
 #include <rte_malloc.h>
 #include <rte_mempool.h>
 #include <rte_branch_prediction.h>
+#include <rte_prefetch.h>
 #include "../protocol/platform/generic.h"
 #include "../arbiter/dpdk-time.h"
 #define fp_free(ptr)                            rte_free(ptr)
 #define fp_calloc(typestr, num, size)           rte_calloc(typestr, num, size, 0)
 #define fp_malloc(typestr, size)		rte_malloc(typestr, size, 0)
 #define fp_pause()								rte_pause()
+#define fp_prefetch0(p)							rte_prefetch0(p)
 
 #define fp_mempool	 			rte_mempool
 #define fp_mempool_get	 		rte_mempool_get
 #define fp_mempool_put	 		rte_mempool_put
 #define fp_mempool_get_bulk		rte_mempool_get_bulk
 
+#include <stdio.h>
+
+/* DPDK mempools need unique names, mempools created here are numbered */
+__attribute__((weak)) uint32_t fp_mempool_n_created;
+
+/**
+ * Creates a mempool of @n objects of @elt_size bytes
+ * @param cache_size: number of objects each lcore keeps for itself
+ */
+static inline struct fp_mempool *fp_mempool_create(unsigned n,
+		unsigned elt_size, unsigned cache_size)
+{
+	char name[RTE_MEMPOOL_NAMESIZE];
+
+	snprintf(name, sizeof(name), "fp_mempool_%u",
+			__sync_fetch_and_add(&fp_mempool_n_created, 1));
+	return rte_mempool_create(name, n, elt_size, cache_size, 0, NULL, NULL,
+			NULL, NULL, SOCKET_ID_ANY, 0);
+}
+
+/* this DPDK can't free mempools, they are kept until the process exits */
+static inline void fp_mempool_destroy(struct fp_mempool *mp)
+{
+}
+
 #else
 
 /** VANILLA **/
+#include <assert.h>
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define fp_free(ptr)                            free(ptr)
 #define fp_calloc(typestr, num, size)           calloc(num, size)
 #define fp_malloc(typestr, size)		malloc(size)
 #define fp_get_time_ns()				(1UL << 40)
-#define fp_pause()						while (0) {}
+#define fp_pause()						__builtin_ia32_pause()
+#define fp_prefetch0(p)					__builtin_prefetch((p), 0, 3)
 
 #ifndef likely
 #define likely(x)  __builtin_expect((x),1)
@@ -43,68 +73,186 @@
 #define unlikely(x)  __builtin_expect((x),0)
 #endif /* unlikely */
 
-/* mempool */
+#include "fp_ring.h"
+
+/* lcores: threads that register an id get a private mempool cache */
+#define FP_MAX_LCORE					64
+#define FP_LCORE_ID_ANY					(~0U)
+
+__attribute__((weak)) __thread unsigned fp_tls_lcore_id = FP_LCORE_ID_ANY;
+
+// Returns the lcore id of the calling thread, or FP_LCORE_ID_ANY
+static inline unsigned fp_lcore_id(void) {
+	return fp_tls_lcore_id;
+}
+
+/**
+ * Sets the lcore id of the calling thread. Each running thread must have a
+ *   different id, below FP_MAX_LCORE.
+ */
+static inline void fp_set_lcore_id(unsigned lcore_id) {
+	assert(lcore_id < FP_MAX_LCORE || lcore_id == FP_LCORE_ID_ANY);
+	fp_tls_lcore_id = lcore_id;
+}
+
+/* mempool. admission cores cache two batches of admitted traffic */
+#define FP_MEMPOOL_CACHE_MAX_SIZE		128
+
+/**
+ * Per-lcore cache of free objects, like rte_mempool's. Puts flush the cache
+ *   down to cache_size objects when it reaches 1.5 * cache_size, gets refill
+ *   it to cache_size objects beyond the request.
+ */
+struct fp_mempool_cache {
+	uint32_t len;
+	void *objs[2 * FP_MEMPOOL_CACHE_MAX_SIZE];
+} __attribute__((aligned(64)));
+
+/**
+ * A fixed-size pool of objects that can be used from multiple threads. Free
+ *   objects are kept in a multi-producer/multi-consumer ring, fronted by
+ *   per-lcore caches.
+ */
 struct fp_mempool {
 	uint32_t total_elements;
-	uint32_t cur_elements;
-	void **elements;
+	uint32_t cache_size;
+	uint32_t cache_flushthresh;
+	void *slab;
+	struct fp_ring *ring;
+	struct fp_mempool_cache cache[FP_MAX_LCORE];
 };
-static struct fp_mempool * fp_mempool_create(unsigned n, unsigned elt_size) {
+
+/**
+ * Creates a mempool of @n objects of @elt_size bytes
+ * @param cache_size: number of objects each lcore keeps for itself, at most
+ *   FP_MEMPOOL_CACHE_MAX_SIZE; 0 disables caching
+ */
+static inline struct fp_mempool *fp_mempool_create(unsigned n, unsigned elt_size,
+		unsigned cache_size)
+{
 	struct fp_mempool *mp;
+	uint32_t log_size = 0;
+	size_t stride;
 	unsigned i;
+
+	if (cache_size > FP_MEMPOOL_CACHE_MAX_SIZE)
+		return NULL;
+
 	/* allocate the struct */
-	mp = malloc(sizeof(struct fp_mempool));
-	if (mp == NULL)
+	if (posix_memalign((void **)&mp, 64, sizeof(struct fp_mempool)) != 0)
 		return NULL;
-	/* populate the mempool struct */
 	mp->total_elements = n;
-	mp->cur_elements = 0;
-	/* allocate the pointer table */
-	mp->elements = malloc(n * sizeof(void *));
-	if (mp->elements == NULL)
-		goto cannot_alloc_ptrs;
-
-	/* allocate structs */
-	for (i = 0; i < n; i++) {
-		mp->elements[i] = malloc(elt_size);
-		if (mp->elements[i] == NULL)
-			goto cannot_alloc_elements;
-		mp->cur_elements++; /* cur_elements counts successfully alloc. elem. */
-	}
+	mp->cache_size = cache_size;
+	mp->cache_flushthresh = 3 * cache_size / 2;
+	for (i = 0; i < FP_MAX_LCORE; i++)
+		mp->cache[i].len = 0;
+
+	/* the ring holds at most 2^{log_size} - 1 elements */
+	while ((1U << log_size) <= n)
+		log_size++;
+	mp->ring = fp_ring_create(log_size);
+	if (mp->ring == NULL)
+		goto cannot_alloc_ring;
+
+	/* allocate all objects in one cache-aligned slab */
+	stride = (elt_size + 63) & ~(size_t)63;
+	if (posix_memalign(&mp->slab, 64, stride * n) != 0)
+		goto cannot_alloc_slab;
+	for (i = 0; i < n; i++)
+		fp_ring_enqueue(mp->ring, (char *)mp->slab + i * stride);
+
 	return mp;
 
-cannot_alloc_elements:
-	/* free all elements we successfully allocated */
-	for (i = 0; i < mp->cur_elements; i++)
-		free(mp->elements[i]);
-	/* free the array itself */
-	free(mp->elements);
-cannot_alloc_ptrs:
-	/* free the struct */
+cannot_alloc_slab:
+	free(mp->ring);
+cannot_alloc_ring:
 	free(mp);
 	return NULL;
 }
-static inline int __attribute__((always_inline))
-fp_mempool_get(struct fp_mempool *mp, void **obj_p) {
-	if (unlikely(mp->cur_elements == 0))
-		return -ENOENT;
-	*obj_p = mp->elements[--(mp->cur_elements)];
-	return 0;
+
+/**
+ * Frees a mempool and all its objects, whether or not they were put back.
+ *   Does nothing if mp is NULL
+ */
+static inline void fp_mempool_destroy(struct fp_mempool *mp)
+{
+	if (mp == NULL)
+		return;
+	free(mp->slab);
+	free(mp->ring);
+	free(mp);
 }
-static inline void __attribute__((always_inline))
-fp_mempool_put(struct fp_mempool *mp, void *obj) {
-	mp->elements[mp->cur_elements++] = obj;
+
+// Internal. Returns the calling lcore's cache, or NULL if it should not cache
+static inline __attribute__((always_inline))
+struct fp_mempool_cache *_fp_mempool_cache(struct fp_mempool *mp) {
+	unsigned lcore_id = fp_lcore_id();
+	if (mp->cache_size == 0 || lcore_id >= FP_MAX_LCORE)
+		return NULL;
+	return &mp->cache[lcore_id];
 }
+
+/**
+ * Gets @n objects from the mempool, either all of them or none
+ * @returns 0 on success, -ENOENT if not enough objects are available
+ */
 static inline int __attribute__((always_inline))
 fp_mempool_get_bulk(struct fp_mempool *mp, void **obj_table, unsigned n)
 {
-	if(unlikely(mp->cur_elements < n))
-		return -ENOENT;
-	mp->cur_elements -= n;
-	memcpy(obj_table, &mp->elements[mp->cur_elements], n * sizeof(void *));
+	struct fp_mempool_cache *cache = _fp_mempool_cache(mp);
+	unsigned i;
+
+	if (cache == NULL || n >= mp->cache_size)
+		return fp_ring_dequeue_bulk(mp->ring, obj_table, n);
+
+	if (cache->len < n) {
+		/* refill the cache up to cache_size objects beyond the request */
+		unsigned req = n + mp->cache_size - cache->len;
+		if (unlikely(fp_ring_dequeue_bulk(mp->ring, &cache->objs[cache->len],
+				req) != 0))
+			return fp_ring_dequeue_bulk(mp->ring, obj_table, n);
+		cache->len += req;
+	}
+
+	for (i = 0; i < n; i++)
+		obj_table[i] = cache->objs[--cache->len];
 	return 0;
 }
 
+/**
+ * Gets an object from the mempool
+ * @returns 0 on success, -ENOENT if the mempool is empty
+ */
+static inline int __attribute__((always_inline))
+fp_mempool_get(struct fp_mempool *mp, void **obj_p) {
+	return fp_mempool_get_bulk(mp, obj_p, 1);
+}
+
+/**
+ * Returns an object to the mempool
+ */
+static inline void __attribute__((always_inline))
+fp_mempool_put(struct fp_mempool *mp, void *obj) {
+	struct fp_mempool_cache *cache = _fp_mempool_cache(mp);
+	int rc;
+
+	if (cache == NULL) {
+		rc = fp_ring_enqueue(mp->ring, obj);
+		assert(rc == 0);
+		(void)rc;
+		return;
+	}
+
+	cache->objs[cache->len++] = obj;
+	if (cache->len >= mp->cache_flushthresh) {
+		/* return everything beyond cache_size to the shared ring */
+		rc = fp_ring_enqueue_bulk(mp->ring, &cache->objs[mp->cache_size],
+				cache->len - mp->cache_size);
+		assert(rc == 0);
+		(void)rc;
+		cache->len = mp->cache_size;
+	}
+}
 
 #endif
 
@@ -0,0 +1,487 @@
+/*
+ * replay_trace.c
+ *
+ * Replays the demand in an allocator trace (see alloc_trace.h) through one of
+ * the allocation engines (see alloc_engine.h), at full speed or at the pace of
+ * the recording, and reports throughput, per-batch latency and how the
+ * allocation compares with the one recorded in the trace.
+ *
+ * Demands recorded at timeslot t are added before allocating the batch that
+ * contains t + 1, as the arbiter records them with the last timeslot it had
+ * received from the admission cores.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "fp_ring.h"
+#include "generate_requests.h"
+#include "alloc_engine.h"
+#include "alloc_trace.h"
+#include "platform.h"
+
+/* admitted traffic is consumed after every batch */
+#define ADMITTED_TRAFFIC_MEMPOOL_SIZE(engine)	(4 * (engine)->admitted_per_batch)
+#define ADMITTED_TRAFFIC_CACHE_SIZE(engine)		(2 * (engine)->batch_size)
+#define ADMITTED_OUT_RING_LOG_SIZE		16
+
+/* synthetic workloads (-g) */
+#define SYNTHETIC_NUM_NODES				256
+#define SYNTHETIC_DURATION				((50000 + 127) / 128 * 128)
+#define SYNTHETIC_FIRST_TIMESLOT		(1 << 20) /* arbitrary, like the arbiter's */
+#define SYNTHETIC_MEAN					10 /* mean request size and inter-arrival time */
+
+// A demand with the timeslot it was recorded at
+struct replay_demand {
+    uint64_t timeslot;
+    struct alloc_trace_demand demand;
+};
+
+// An admitted edge with the timeslot it was admitted in
+struct replay_edge {
+    uint64_t timeslot;
+    uint16_t src;
+    uint16_t dst;
+};
+
+// The workload to replay and the allocation recorded with it
+struct replay_input {
+    uint16_t num_nodes;
+    uint64_t first_timeslot;
+    uint64_t end_timeslot;          // one past the last timeslot in the trace
+    struct replay_demand *demands;
+    uint32_t num_demands;
+    struct replay_edge *recorded;   // sorted by timeslot, src and dst
+    uint32_t num_recorded;
+    uint64_t num_recorded_tslots;   // timeslots with an admitted record
+    uint64_t recorded_end;          // one past the last admitted record
+};
+
+// Comparison of the replayed allocation with the recorded one
+struct replay_divergence {
+    uint64_t tslots_compared;
+    uint64_t tslots_matching;
+    uint64_t edges_replayed;
+    uint64_t edges_recorded;
+    uint64_t edges_matching;
+    bool diverged;
+    uint64_t first_divergent_tslot;
+};
+
+int compare_replay_edge(const void *a, const void *b)
+{
+    const struct replay_edge *x = a, *y = b;
+    if (x->timeslot != y->timeslot)
+        return (x->timeslot < y->timeslot) ? -1 : 1;
+    if (x->src != y->src)
+        return (int) x->src - (int) y->src;
+    return (int) x->dst - (int) y->dst;
+}
+
+int compare_uint64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+uint64_t time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Grows *arr to hold at least n elements of size elt_size
+void *grow_array(void *arr, uint32_t *capacity, uint32_t n, size_t elt_size)
+{
+    if (n <= *capacity)
+        return arr;
+    *capacity = (*capacity == 0) ? 1024 : 2 * *capacity;
+    arr = realloc(arr, *capacity * elt_size);
+    if (arr == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(-1);
+    }
+    return arr;
+}
+
+// Loads a trace into memory, to replay with batches of batch_size timeslots.
+// Returns 0 on success.
+int load_trace(const char *path, uint16_t batch_size, struct replay_input *input)
+{
+    struct alloc_trace trace;
+    struct alloc_trace_record rec;
+    uint32_t demands_capacity = 0, recorded_capacity = 0;
+    uint64_t last_admitted_tslot = 0;
+    uint16_t e;
+    int ret;
+
+    if (alloc_trace_open_read(&trace, path) != 0) {
+        fprintf(stderr, "could not read trace %s\n", path);
+        return -1;
+    }
+
+    memset(input, 0, sizeof(*input));
+    input->num_nodes = trace.header.num_nodes;
+    input->first_timeslot = trace.header.first_timeslot;
+    input->end_timeslot = input->first_timeslot;
+
+    while ((ret = alloc_trace_read_record(&trace, &rec)) == 1) {
+        if (rec.type == ALLOC_TRACE_DEMAND) {
+            input->demands = grow_array(input->demands, &demands_capacity,
+                                        input->num_demands + 1,
+                                        sizeof(struct replay_demand));
+            input->demands[input->num_demands].timeslot = rec.timeslot;
+            input->demands[input->num_demands].demand = rec.demand;
+            input->num_demands++;
+        } else {
+            if (input->num_recorded_tslots == 0 || rec.timeslot != last_admitted_tslot)
+                input->num_recorded_tslots++;
+            last_admitted_tslot = rec.timeslot;
+            if (rec.timeslot + 1 > input->recorded_end)
+                input->recorded_end = rec.timeslot + 1;
+            input->recorded = grow_array(input->recorded, &recorded_capacity,
+                                         input->num_recorded + rec.n_edges,
+                                         sizeof(struct replay_edge));
+            for (e = 0; e < rec.n_edges; e++) {
+                struct replay_edge *edge = &input->recorded[input->num_recorded++];
+                edge->timeslot = rec.timeslot;
+                edge->src = rec.edges[e].src;
+                edge->dst = rec.edges[e].dst;
+            }
+        }
+        if (rec.timeslot + 1 > input->end_timeslot)
+            input->end_timeslot = rec.timeslot + 1;
+    }
+    alloc_trace_close(&trace);
+
+    // a trace cut short, e.g. by a crash, can still be replayed up to the cut
+    if (ret < 0)
+        fprintf(stderr, "trace %s is truncated or corrupt, replaying the %u demands "
+                "before the bad record\n", path, input->num_demands);
+    if (input->num_nodes == 0 || input->num_nodes > MAX_NODES) {
+        fprintf(stderr, "trace has %u nodes, MAX_NODES is %u\n",
+                input->num_nodes, MAX_NODES);
+        return -1;
+    }
+    if (trace.header.batch_size != batch_size)
+        fprintf(stderr, "trace was recorded with batches of %u timeslots, replaying "
+                "with %u\n", trace.header.batch_size, batch_size);
+
+    qsort(input->recorded, input->num_recorded, sizeof(struct replay_edge),
+          compare_replay_edge);
+    return 0;
+}
+
+// Generates a Poisson workload at the given fraction of network capacity, with
+// demands arriving a batch of batch_size timeslots ahead
+void generate_input(double fraction, uint16_t batch_size, struct replay_input *input)
+{
+    uint32_t num_nodes = SYNTHETIC_NUM_NODES;
+    uint32_t duration = SYNTHETIC_DURATION;
+    // requests average mean timeslots, so allow 5x the expected number
+    uint32_t max_requests = 5 * duration * (num_nodes / SYNTHETIC_MEAN);
+    struct request_info *requests = malloc(max_requests * sizeof(struct request_info));
+    uint32_t i, n;
+
+    assert(requests != NULL);
+    n = generate_requests_poisson(requests, max_requests, num_nodes, duration,
+                                  fraction, SYNTHETIC_MEAN);
+
+    memset(input, 0, sizeof(*input));
+    input->num_nodes = num_nodes;
+    input->first_timeslot = SYNTHETIC_FIRST_TIMESLOT;
+    input->end_timeslot = SYNTHETIC_FIRST_TIMESLOT + duration;
+    input->demands = malloc(n * sizeof(struct replay_demand));
+    assert(input->demands != NULL);
+
+    // a request in batch b arrives while the batch before it is allocated, as
+    // in benchmark_graph_algo
+    for (i = 0; i < n && requests[i].timeslot < duration; i++) {
+        struct replay_demand *d = &input->demands[input->num_demands++];
+        d->timeslot = SYNTHETIC_FIRST_TIMESLOT - 1 +
+            (requests[i].timeslot & ~(uint32_t) (batch_size - 1));
+        d->demand.src = requests[i].src;
+        d->demand.dst = requests[i].dst;
+        d->demand.amount = requests[i].backlog;
+        d->demand.tclass = 0;
+        d->demand.deadline = 0;
+    }
+    free(requests);
+}
+
+// Compares the edges replayed in timeslot with those recorded, advancing
+// *recorded_pos past the recorded edges of earlier timeslots
+void compare_timeslot(struct replay_input *input, uint32_t *recorded_pos,
+                      uint64_t timeslot, struct replay_edge *replayed,
+                      uint32_t n_replayed, struct replay_divergence *div)
+{
+    uint32_t r = *recorded_pos;
+    uint32_t end, p = 0, matching = 0;
+    uint32_t n_recorded;
+
+    while (r < input->num_recorded && input->recorded[r].timeslot < timeslot)
+        r++;
+    end = r;
+    while (end < input->num_recorded && input->recorded[end].timeslot == timeslot)
+        end++;
+    n_recorded = end - r;
+    *recorded_pos = end;
+
+    // both lists are sorted, count the edges they share
+    qsort(replayed, n_replayed, sizeof(struct replay_edge), compare_replay_edge);
+    while (p < n_replayed && r < end) {
+        int c = compare_replay_edge(&replayed[p], &input->recorded[r]);
+        if (c == 0) {
+            matching++;
+            p++;
+            r++;
+        } else if (c < 0) {
+            p++;
+        } else {
+            r++;
+        }
+    }
+
+    div->tslots_compared++;
+    div->edges_replayed += n_replayed;
+    div->edges_recorded += n_recorded;
+    div->edges_matching += matching;
+    if (matching == n_replayed && matching == n_recorded) {
+        div->tslots_matching++;
+    } else if (!div->diverged) {
+        div->diverged = true;
+        div->first_divergent_tslot = timeslot;
+    }
+}
+
+void print_usage(char **argv) {
+    uint32_t i;
+
+    fprintf(stderr, "usage: %s [options] <trace>\n", argv[0]);
+    fprintf(stderr, "       %s [options] -g <load>\n", argv[0]);
+    fprintf(stderr, "  -e engine   allocate with engine:");
+    for (i = 0; alloc_engines[i] != NULL; i++)
+        fprintf(stderr, " %s", alloc_engines[i]->name);
+    fprintf(stderr, " (default: %s)\n", alloc_engines[0]->name);
+    fprintf(stderr, "  -g load     replay a synthetic Poisson workload of %u nodes at this "
+            "fraction of capacity instead of a trace\n", SYNTHETIC_NUM_NODES);
+    fprintf(stderr, "  -p ns       pace the replay at ns per timeslot (default: full speed)\n");
+    fprintf(stderr, "  -c cap      check rack uplinks, with cap timeslots per uplink per "
+            "timeslot\n");
+    fprintf(stderr, "  -o trace    record the replayed demand and allocation\n");
+}
+
+int main(int argc, char **argv)
+{
+    struct replay_input input;
+    struct replay_divergence div;
+    uint64_t pace_ns = 0;
+    int inter_rack_capacity = -1;
+    double synthetic_load = 0;
+    const char *out_path = NULL;
+    struct alloc_trace out;
+    const struct alloc_engine *engine = alloc_engines[0];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "e:g:p:c:o:")) != -1) {
+        switch (opt) {
+        case 'e':
+            engine = alloc_engine_by_name(optarg);
+            if (engine == NULL) {
+                fprintf(stderr, "unknown engine %s\n", optarg);
+                print_usage(argv);
+                return -1;
+            }
+            break;
+        case 'g':
+            synthetic_load = atof(optarg);
+            break;
+        case 'p':
+            pace_ns = strtoull(optarg, NULL, 10);
+            break;
+        case 'c':
+            inter_rack_capacity = atoi(optarg);
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        default:
+            print_usage(argv);
+            return -1;
+        }
+    }
+    if (synthetic_load > 0 && optind == argc) {
+        generate_input(synthetic_load, engine->batch_size, &input);
+    } else if (synthetic_load <= 0 && optind == argc - 1) {
+        if (load_trace(argv[optind], engine->batch_size, &input) != 0)
+            return -1;
+    } else {
+        print_usage(argv);
+        return -1;
+    }
+
+    if (out_path != NULL &&
+        alloc_trace_open_write(&out, out_path, input.num_nodes, engine->batch_size,
+                               input.first_timeslot) != 0) {
+        fprintf(stderr, "could not write trace %s\n", out_path);
+        return -1;
+    }
+
+    // Data structures
+    struct admissible_state *status;
+    struct alloc_engine_params params;
+    struct fp_ring *q_admitted_out;
+    struct fp_mempool *admitted_traffic_mempool;
+
+    /* init queues */
+    q_admitted_out = fp_ring_create(ADMITTED_OUT_RING_LOG_SIZE);
+    admitted_traffic_mempool = fp_mempool_create(ADMITTED_TRAFFIC_MEMPOOL_SIZE(engine),
+    		sizeof(struct admitted_traffic), ADMITTED_TRAFFIC_CACHE_SIZE(engine));
+    if (!q_admitted_out) exit(-1);
+    if (!admitted_traffic_mempool) exit(-1);
+
+    /* init engine state. pim seeds its cores with rand(), so seed it the same
+     * way in every replay for the allocation to be deterministic */
+    memset(&params, 0, sizeof(params));
+    params.num_nodes = input.num_nodes;
+    params.oversubscribed = (inter_rack_capacity >= 0);
+    params.inter_rack_capacity = (inter_rack_capacity >= 0) ? inter_rack_capacity : 0;
+    params.q_admitted_out = q_admitted_out;
+    params.admitted_traffic_mempool = admitted_traffic_mempool;
+    srand(1);
+    status = engine->init(&params);
+    if (status == NULL) {
+        printf("Error initializing %s engine!\n", engine->name);
+        exit(-1);
+    }
+
+    uint16_t batch_size = engine->batch_size;
+    uint64_t num_batches = (input.end_timeslot - input.first_timeslot +
+                            batch_size - 1) / batch_size;
+    uint64_t *batch_ns = malloc(num_batches * sizeof(uint64_t));
+    struct replay_edge *replayed = malloc(MAX_NODES * sizeof(struct replay_edge));
+    assert(batch_ns != NULL && replayed != NULL);
+
+    bool compare = (input.num_recorded_tslots > 0);
+    uint32_t next_demand = 0, recorded_pos = 0, n_replayed = 0;
+    bool pending_compare = false;  // replayed holds a timeslot to compare
+    uint64_t num_admitted = 0;
+    uint64_t b, prev_tslot = 0;
+    uint32_t a, e;
+    memset(&div, 0, sizeof(div));
+
+    uint64_t replay_start = time_ns();
+    for (b = 0; b < num_batches; b++) {
+        uint64_t batch_start_tslot = input.first_timeslot + b * batch_size;
+
+        // in real-time mode, wait for the batch's first timeslot
+        if (pace_ns != 0)
+            while (time_ns() - replay_start < b * batch_size * pace_ns)
+                ;
+
+        uint64_t start = time_ns();
+
+        // Issue the demands recorded before this batch
+        while (next_demand < input.num_demands &&
+               input.demands[next_demand].timeslot < batch_start_tslot) {
+            struct replay_demand *d = &input.demands[next_demand++];
+            engine->add_backlog(status, d->demand.src, d->demand.dst,
+                                d->demand.amount, d->demand.tclass,
+                                d->demand.deadline);
+            if (out_path != NULL)
+                alloc_trace_write_demand(&out, d->timeslot, d->demand.src,
+                                         d->demand.dst, d->demand.amount,
+                                         d->demand.tclass, d->demand.deadline);
+        }
+        engine->flush_backlog(status);
+
+        // Get admissible traffic
+        engine->get_admissible_traffic(status, 0, 0, 1, 0);
+        engine->handle_spent(status);
+
+        batch_ns[b] = time_ns() - start;
+
+        // Compare and record the admitted traffic, one timeslot at a time
+        for (a = 0; a < engine->admitted_per_batch; a++) {
+            struct admitted_traffic *admitted;
+            uint64_t tslot = batch_start_tslot + a * batch_size / engine->admitted_per_batch;
+
+            bool compared = (tslot < input.recorded_end);
+
+            fp_ring_dequeue(q_admitted_out, (void **) &admitted);
+            if (tslot != prev_tslot && pending_compare) {
+                compare_timeslot(&input, &recorded_pos, prev_tslot, replayed,
+                                 n_replayed, &div);
+                n_replayed = 0;
+                pending_compare = false;
+            }
+            prev_tslot = tslot;
+            for (e = 0; compared && e < admitted->size; e++) {
+                replayed[n_replayed].timeslot = tslot;
+                replayed[n_replayed].src = admitted->edges[e].src;
+                replayed[n_replayed].dst = admitted->edges[e].dst;
+                n_replayed++;
+            }
+            pending_compare |= compared;
+            if (out_path != NULL)
+                alloc_trace_write_admitted(&out, tslot, admitted);
+            num_admitted += admitted->size;
+            fp_mempool_put(admitted_traffic_mempool, admitted);
+        }
+    }
+    if (pending_compare)
+        compare_timeslot(&input, &recorded_pos, prev_tslot, replayed, n_replayed,
+                         &div);
+    uint64_t replay_ns = time_ns() - replay_start;
+
+    if (out_path != NULL && alloc_trace_close(&out) != 0)
+        fprintf(stderr, "error writing trace %s\n", out_path);
+
+    /* report */
+    uint64_t alloc_ns = 0;
+    for (b = 0; b < num_batches; b++)
+        alloc_ns += batch_ns[b];
+    qsort(batch_ns, num_batches, sizeof(uint64_t), compare_uint64);
+
+    uint64_t num_tslots = num_batches * batch_size;
+    printf("engine %s, nodes %u, timeslots %" PRIu64 ", batches %" PRIu64 ", demands %u\n",
+           engine->name, input.num_nodes, num_tslots, num_batches, input.num_demands);
+    printf("admitted %" PRIu64 " (utilization %f)\n", num_admitted,
+           (double) num_admitted / ((double) num_tslots * input.num_nodes));
+    printf("elapsed %.3f s, allocating %.3f s, %.0f tslots/sec\n",
+           replay_ns / 1e9, alloc_ns / 1e9,
+           alloc_ns ? num_tslots * 1e9 / alloc_ns : 0.0);
+    if (num_batches > 0)
+        printf("batch latency us: p50 %.2f, p99 %.2f, max %.2f\n",
+               batch_ns[num_batches / 2] / 1e3,
+               batch_ns[num_batches * 99 / 100] / 1e3,
+               batch_ns[num_batches - 1] / 1e3);
+    if (!compare) {
+        printf("no recorded allocation to compare with\n");
+    } else {
+        printf("matching timeslots %" PRIu64 "/%" PRIu64 ", matching edges %" PRIu64
+               " (replayed %" PRIu64 ", recorded %" PRIu64 ")\n",
+               div.tslots_matching, div.tslots_compared, div.edges_matching,
+               div.edges_replayed, div.edges_recorded);
+        if (div.diverged)
+            printf("first divergence at timeslot %" PRIu64 " (%" PRIu64
+                   " after the first)\n", div.first_divergent_tslot,
+                   div.first_divergent_tslot - input.first_timeslot);
+        else
+            printf("no divergence\n");
+    }
+
+    engine->destroy(status);
+    fp_mempool_destroy(admitted_traffic_mempool);
+    fp_ring_destroy(q_admitted_out);
+    free(batch_ns);
+    free(replayed);
+    free(input.demands);
+    free(input.recorded);
+
+    return (compare && div.diverged) ? 1 : 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * request_completion.h
+ *
+ * Completion times of generated requests (see generate_requests.h) in the
+ * benchmarks, from the traffic the allocator admits.
+ */
+
+#ifndef REQUEST_COMPLETION_H_
+#define REQUEST_COMPLETION_H_
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "batch.h"
+#include "generate_requests.h"
+
+#define NO_REQUEST (~0U)
+
+/**
+ * Completion of requests. Requests between the same src and dst share a
+ * backlog in the allocator, so they complete in arrival order: each admitted
+ * timeslot goes to the oldest unfinished request of its flow. Requests are
+ * issued at the start of their batch, and their FCT is counted from there,
+ * unless set otherwise with fct_set_issued().
+ */
+struct fct_state {
+    uint16_t num_nodes;
+    uint32_t *head;      /* oldest unfinished request per flow, or NO_REQUEST */
+    uint32_t *tail;      /* newest request per flow */
+    uint32_t *next;      /* next request of the same flow */
+    uint16_t *remaining; /* timeslots left per request */
+    uint32_t *issued;    /* timeslot each request was issued at */
+    uint32_t *fct;       /* completion time per request, 0 until completed */
+};
+
+static inline void fct_init(struct fct_state *fs, struct request_info *requests,
+                            uint32_t num_requests, uint16_t num_nodes)
+{
+    uint32_t n_flows = (uint32_t) num_nodes * num_nodes;
+    uint32_t i;
+
+    fs->num_nodes = num_nodes;
+    fs->head = malloc(n_flows * sizeof(uint32_t));
+    fs->tail = malloc(n_flows * sizeof(uint32_t));
+    fs->next = malloc(num_requests * sizeof(uint32_t));
+    fs->remaining = malloc(num_requests * sizeof(uint16_t));
+    fs->issued = malloc(num_requests * sizeof(uint32_t));
+    fs->fct = calloc(num_requests, sizeof(uint32_t));
+    if (!fs->head || !fs->tail || !fs->next || !fs->remaining || !fs->issued ||
+        !fs->fct)
+        exit(-1);
+
+    for (i = 0; i < n_flows; i++)
+        fs->head[i] = NO_REQUEST;
+    for (i = 0; i < num_requests; i++) {
+        uint32_t flow = requests[i].src * num_nodes + requests[i].dst;
+        fs->next[i] = NO_REQUEST;
+        fs->remaining[i] = requests[i].backlog;
+        fs->issued[i] = requests[i].timeslot & ~(BATCH_SIZE - 1);
+        if (fs->head[flow] == NO_REQUEST)
+            fs->head[flow] = i;
+        else
+            fs->next[fs->tail[flow]] = i;
+        fs->tail[flow] = i;
+    }
+}
+
+static inline void fct_free(struct fct_state *fs)
+{
+    free(fs->head);
+    free(fs->tail);
+    free(fs->next);
+    free(fs->remaining);
+    free(fs->issued);
+    free(fs->fct);
+}
+
+// Counts request r as issued at timeslot instead of the start of its batch
+static inline void fct_set_issued(struct fct_state *fs, uint32_t r, uint32_t timeslot)
+{
+    fs->issued[r] = timeslot;
+}
+
+// Counts a timeslot admitted from src to dst at timeslot. Returns false,
+// counting nothing, if the flow has no unfinished request.
+static inline bool fct_try_admit(struct fct_state *fs, struct request_info *requests,
+                                 uint16_t src, uint16_t dst, uint32_t timeslot)
+{
+    uint32_t flow = src * fs->num_nodes + dst;
+    uint32_t r = fs->head[flow];
+
+    if (r == NO_REQUEST)
+        return false;
+    if (--fs->remaining[r] == 0) {
+        fs->fct[r] = timeslot + 1 - fs->issued[r];
+        fs->head[flow] = fs->next[r];
+    }
+    return true;
+}
+
+// Counts a timeslot admitted from src to dst at timeslot
+static inline void fct_admit(struct fct_state *fs, struct request_info *requests,
+                             uint16_t src, uint16_t dst, uint32_t timeslot)
+{
+    bool counted = fct_try_admit(fs, requests, src, dst, timeslot);
+
+    assert(counted);
+    (void) counted;
+}
+
+#endif /* REQUEST_COMPLETION_H_ */
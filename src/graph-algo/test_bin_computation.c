@@ -1,11 +1,24 @@
 
 #include "admissible_traffic.h"
 
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #define SPECIAL_START		(NUM_BINS-BATCH_SIZE)
 #define BASE				1024
 
+static struct seq_admissible_status status;
+
+/* unlike assert(), also checks in builds with NDEBUG */
+static void check(bool ok, const char *what, int i)
+{
+	if (!ok) {
+		printf("FAIL\t%s, i = %d\n", what, i);
+		exit(-1);
+	}
+}
+
 int main()
 {
 	int i;
@@ -38,5 +51,68 @@ int main()
 		assert(computed_bin == bin);
 	}
 
-}
+	/* shortest-job-first bins: one per backlog, then one per power of two */
+	check(bin_index_from_backlog(1) == 0, "sjf first bin", 1);
+	check(bin_index_from_backlog(NUM_BINS) == NUM_BINS - 1,
+			"sjf last single-backlog bin", NUM_BINS);
+	check(bin_index_from_backlog(NUM_BINS + 1) == NUM_BINS,
+			"sjf first power-of-two bin", NUM_BINS + 1);
+	check(bin_index_from_backlog(2 * NUM_BINS) == NUM_BINS,
+			"sjf first power-of-two bin", 2 * NUM_BINS);
+	check(bin_index_from_backlog(2 * NUM_BINS + 1) == NUM_BINS + 1,
+			"sjf second power-of-two bin", 2 * NUM_BINS + 1);
+	for (i = 1; i < 65536; i++) {
+		check(bin_index_from_backlog(i) < NUM_BINS + BATCH_SIZE,
+				"sjf bin in range", i);
+		check(bin_index_from_backlog(i) >= bin_index_from_backlog(i - 1),
+				"sjf bins ordered by backlog", i);
+	}
 
+	/* earliest-deadline-first bins: late flows first, no deadline last */
+	check(bin_index_from_deadline(BASE - 1, BASE) == 0, "edf late bin", -1);
+	check(bin_index_from_deadline(BASE, BASE) == 0, "edf late bin", 0);
+	check(bin_index_from_deadline(BASE + 1, BASE) == 1, "edf slack bin", 1);
+	check(bin_index_from_deadline(BASE + NUM_BINS / 2, BASE) == NUM_BINS / 2,
+			"edf last slack bin", NUM_BINS / 2);
+	check(bin_index_from_deadline(BASE + NUM_BINS / 2 + 1, BASE)
+			== NUM_BINS / 2 + 1, "edf first power-of-two bin", NUM_BINS / 2 + 1);
+	check(bin_index_from_deadline(BASE + NUM_BINS, BASE) == NUM_BINS / 2 + 1,
+			"edf first power-of-two bin", NUM_BINS);
+	check(bin_index_from_deadline(BASE + NUM_BINS + 1, BASE)
+			== NUM_BINS / 2 + 2, "edf second power-of-two bin", NUM_BINS + 1);
+	for (i = 1; i < 65536; i++) {
+		check(bin_index_from_deadline(BASE + i, BASE) < NUM_BINS,
+				"edf bin in range", i);
+		check(bin_index_from_deadline(BASE + i, BASE)
+				>= bin_index_from_deadline(BASE + i - 1, BASE),
+				"edf bins ordered by deadline", i);
+	}
+
+	/* flows without a deadline follow the deadline bins, in LRU order */
+	status.bin_policy = BIN_POLICY_EDF;
+	status.n_tclass_ranges = 1;
+	check(tclass_bin_index(&status, TCLASS_HAS_DEADLINE, BASE - 1, 1, BASE) == 0,
+			"edf late flow", -1);
+	check(tclass_bin_index(&status, TCLASS_HAS_DEADLINE, BASE + 65535, 1, BASE)
+			< NUM_BINS, "edf far deadline before no deadline", 65535);
+	for (i = 0; i < BASE; i++) {
+		check(tclass_bin_index(&status, 0, i, 1, BASE)
+				== NUM_BINS + bin_index_from_timeslot(i, BASE),
+				"edf no-deadline bin", i);
+		check(tclass_bin_index(&status, 0, i + 1, 1, BASE)
+				>= tclass_bin_index(&status, 0, i, 1, BASE),
+				"edf no-deadline bins in LRU order", i);
+	}
+	check(tclass_bin_index(&status, 0, BASE, 1, BASE) < EDF_RANGE_BINS,
+			"edf no-deadline bin in range", BASE);
+
+	/* after an allocation, flows without a deadline go with the late ones */
+	status.cores[0].current_timeslot = BASE;
+	check(bin_after_alloc(0, 1, 0, 1, 0, 3, &status.cores[0], &status)
+			== 2 * NUM_BINS + 3, "edf no-deadline bin after alloc", 3);
+	check(bin_after_alloc(0, 1, BASE + 8, 1, TCLASS_HAS_DEADLINE, 3,
+			&status.cores[0], &status) == 8, "edf bin after alloc", 8);
+
+	printf("PASS\n");
+	return 0;
+}
@@ -19,36 +19,124 @@ void create_complete_bipartite_graph(struct graph_structure *structure,
     }
 }
 
-// Returns true if graph_1 and graph_2 represent a valid Euler Split of graph_in
-/*bool check_graphs(struct graph *graph_in, struct graph *graph_1,
-                  struct graph *graph_2) {
-
-    // Check that graphs have the correct degree
-    uint8_t input_degree = get_max_degree(graph_in);
-    if (get_max_degree(graph_1) != input_degree / 2 ||
-        get_max_degree(graph_2) != input_degree / 2)
-        return false;
+// Constructs a random d-regular bipartite multigraph, the union of d random
+// perfect matchings
+void create_random_regular_bipartite_graph(struct graph_structure *structure,
+                                           struct graph_edges *edges, uint8_t n,
+                                           uint16_t d) {
+    uint8_t dsts[MAX_GRAPH_NODES];
+    int i, j, k;
+    uint8_t tmp;
+
+    for (i = 0; i < n; i++)
+        dsts[i] = i;
+    for (k = 0; k < d; k++) {
+        for (i = n - 1; i > 0; i--) {
+            j = rand() % (i + 1);
+            tmp = dsts[i];
+            dsts[i] = dsts[j];
+            dsts[j] = tmp;
+        }
+        for (i = 0; i < n; i++)
+            add_edge(structure, edges, i, n + dsts[i]);
+    }
+}
+
+// Returns true if edges_1 and edges_2 are a valid Euler split of edges_in
+bool check_split(struct graph_structure *structure, struct graph_edges *edges_in,
+                 struct graph_edges *edges_1, struct graph_edges *edges_2) {
+    uint8_t n = structure->n;
+    int i, w;
 
     // Check that vertices have the correct degree
-    int i;
-    for (i = 0; i < graph_in->n * 2; i++) {
-        if (get_degree(graph_1, i) != input_degree / 2 ||
-            get_degree(graph_2, i) != input_degree / 2)
+    for (i = 0; i < 2 * n; i++) {
+        uint16_t degree = get_degree(edges_in, i);
+        if (get_degree(edges_1, i) != degree / 2 ||
+            get_degree(edges_2, i) != degree / 2)
             return false;
     }
 
-    // Check that the combination of the two graphs equals the original graph
-    add_graph(graph_1, graph_2);
-    if (!are_equal(graph_in, graph_1))
+    // Check that the two halves are disjoint and make up the original graph
+    for (i = 0; i < 2 * n; i++) {
+        for (w = 0; w < DEGREE_WORDS; w++) {
+            uint64_t bitmap_1 = edges_1->neighbor_bitmaps[i][w];
+            uint64_t bitmap_2 = edges_2->neighbor_bitmaps[i][w];
+            if ((bitmap_1 & bitmap_2) != 0 ||
+                (bitmap_1 | bitmap_2) != edges_in->neighbor_bitmaps[i][w])
+                return false;
+        }
+    }
+
+    return is_consistent(structure, edges_1) && is_consistent(structure, edges_2);
+}
+
+// Splits edges recursively while the degree is even, down to matchings when
+// the degree is a power of two. Returns true if every split was valid
+bool check_recursive_split(struct graph_structure *structure,
+                           struct graph_edges *edges) {
+    struct graph_edges edges_copy, edges_1, edges_2;
+    uint16_t degree = get_max_degree(edges, structure->n);
+
+    if (degree % 2 != 0)
+        return (degree != 1) || is_perfect_matching(edges, structure->n);
+
+    copy_edges(edges, &edges_copy, structure->n);
+    graph_edges_init(&edges_1, structure->n);
+    graph_edges_init(&edges_2, structure->n);
+    split(structure, &edges_copy, &edges_1, &edges_2);
+
+    if (has_neighbor(&edges_copy, 0) || !check_split(structure, edges, &edges_1, &edges_2))
         return false;
 
+    return check_recursive_split(structure, &edges_1) &&
+        check_recursive_split(structure, &edges_2);
+}
+
+// Checks Euler splits of complete and random regular bipartite graphs, up to
+// MAX_GRAPH_NODES vertices per side and MAX_DEGREE
+bool check_splits(void) {
+    struct graph_structure g_structure;
+    struct graph_edges g;
+    const uint8_t sizes[] = {2, 8, 20, 33, MAX_GRAPH_NODES};
+    const uint16_t degrees[] = {2, 4, 6, 16, 64, MAX_DEGREE};
+    uint32_t s, d;
+
+    srand(1);
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        uint8_t n = sizes[s];
+
+        if (n <= MAX_DEGREE) {
+            graph_structure_init(&g_structure, n);
+            graph_edges_init(&g, n);
+            create_complete_bipartite_graph(&g_structure, &g, n);
+            if (!check_recursive_split(&g_structure, &g)) {
+                printf("FAIL\tcomplete, n = %d\n", n);
+                return false;
+            }
+        }
+
+        for (d = 0; d < sizeof(degrees) / sizeof(degrees[0]); d++) {
+            graph_structure_init(&g_structure, n);
+            graph_edges_init(&g, n);
+            create_random_regular_bipartite_graph(&g_structure, &g, n, degrees[d]);
+            if (!check_recursive_split(&g_structure, &g)) {
+                printf("FAIL\trandom regular, n = %d, degree = %d\n", n,
+                       degrees[d]);
+                return false;
+            }
+        }
+    }
+
     return true;
-    }*/
+}
 
 int main(void) {
     struct graph_structure g_structure;
     struct graph_edges g, g1, g2;
 
+    if (!check_splits())
+        exit(-1);
+
     // Simple test of complete bipartite graphs
     int n;
     int it;
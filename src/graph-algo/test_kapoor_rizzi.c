@@ -0,0 +1,140 @@
+/*
+ * test_kapoor_rizzi.c
+ *
+ * Checks that slice_one finds perfect matchings and that solve, with the
+ * steps from kr_build, colors random regular bipartite graphs of every odd
+ * degree up to KR_MAX_DEGREE + 1 into perfect matchings.
+ */
+
+#include "kapoor_rizzi.h"
+#include "graph.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_TRIALS 20
+
+// Constructs a random d-regular bipartite multigraph, the union of d random
+// perfect matchings
+void create_random_regular_bipartite_graph(struct graph_structure *structure,
+                                           struct graph_edges *edges, uint8_t n,
+                                           uint16_t d) {
+    uint8_t dsts[MAX_GRAPH_NODES];
+    int i, j, k;
+    uint8_t tmp;
+
+    for (i = 0; i < n; i++)
+        dsts[i] = i;
+    for (k = 0; k < d; k++) {
+        for (i = n - 1; i > 0; i--) {
+            j = rand() % (i + 1);
+            tmp = dsts[i];
+            dsts[i] = dsts[j];
+            dsts[j] = tmp;
+        }
+        for (i = 0; i < n; i++)
+            add_edge(structure, edges, i, n + dsts[i]);
+    }
+}
+
+// Returns true if the num_parts graphs in parts are disjoint and make up
+// edges_in
+bool check_union(struct graph_edges *edges_in, struct graph_edges *parts,
+                 uint8_t num_parts, uint8_t n) {
+    int i, p, w;
+
+    for (i = 0; i < 2 * n; i++) {
+        for (w = 0; w < DEGREE_WORDS; w++) {
+            uint64_t seen = 0;
+            for (p = 0; p < num_parts; p++) {
+                uint64_t bitmap = parts[p].neighbor_bitmaps[i][w];
+                if ((seen & bitmap) != 0)
+                    return false;
+                seen |= bitmap;
+            }
+            if (seen != edges_in->neighbor_bitmaps[i][w])
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns true if the num_matchings graphs in matchings are consistent,
+// perfect matchings, and are disjoint and make up edges_in
+bool check_matchings(struct graph_structure *structure,
+                     struct graph_edges *edges_in,
+                     struct graph_edges *matchings, uint8_t num_matchings) {
+    int m;
+
+    for (m = 0; m < num_matchings; m++) {
+        if (!is_perfect_matching(&matchings[m], structure->n) ||
+            !is_consistent(structure, &matchings[m]))
+            return false;
+    }
+
+    return check_union(edges_in, matchings, num_matchings, structure->n);
+}
+
+// Slices one matching off a random graph of each odd degree and colors the
+// rest with Kapoor-Rizzi. Returns true if every coloring was valid
+bool check_colorings(uint8_t n) {
+    struct graph_structure structure;
+    struct graph_edges edges, edges_copy, slices[2];
+    struct kr kr;
+    static struct matching_set solution;
+    uint8_t degree;
+    int t;
+
+    for (degree = 1; degree <= KR_MAX_DEGREE + 1; degree += 2) {
+        for (t = 0; t < NUM_TRIALS; t++) {
+            graph_structure_init(&structure, n);
+            graph_edges_init(&edges, n);
+            create_random_regular_bipartite_graph(&structure, &edges, n, degree);
+
+            // slice_one leaves a regular graph of one less degree
+            copy_edges(&edges, &edges_copy, n);
+            slice_one(&structure, &edges_copy, &slices[0]);
+            copy_edges(&edges_copy, &slices[1], n);
+            if (!is_perfect_matching(&slices[0], n) ||
+                !is_consistent(&structure, &slices[0]) ||
+                !check_union(&edges, slices, 2, n)) {
+                printf("FAIL\tslice_one, n = %d, degree = %d\n", n, degree);
+                return false;
+            }
+            if (degree == 1)
+                continue;
+
+            kr_build(&kr, degree - 1);
+            if (kr.num_steps > MAX_STEPS) {
+                printf("FAIL\tkr_build, degree = %d, steps = %d\n", degree - 1,
+                       kr.num_steps);
+                return false;
+            }
+
+            solve(&kr, &structure, &edges_copy, &slices[0], &solution);
+            if (solution.num_matchings != degree ||
+                !check_matchings(&structure, &edges, solution.matchings,
+                                 degree)) {
+                printf("FAIL\tsolve, n = %d, degree = %d\n", n, degree);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+int main(void) {
+    const uint8_t sizes[] = {2, 8, 33, MAX_GRAPH_NODES};
+    uint32_t s;
+
+    srand(1);
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        if (!check_colorings(sizes[s]))
+            exit(-1);
+    }
+
+    printf("PASS\n");
+    return 0;
+}
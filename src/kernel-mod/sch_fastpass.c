@@ -118,6 +118,13 @@ module_param(max_preload, uint, 0444);
 MODULE_PARM_DESC(max_preload, "how futuristic can an allocation be and still be accepted");
 EXPORT_SYMBOL_GPL(max_preload);
 
+/* sockets don't tell the qdisc about deadlines, so the only deadline requests
+ * carry is this one, for demand of the first class */
+static u32 tclass0_deadline = 0;
+module_param(tclass0_deadline, uint, 0444);
+MODULE_PARM_DESC(tclass0_deadline, "timeslots within which new demand of traffic class 0 should be allocated, 0 for no deadline");
+EXPORT_SYMBOL_GPL(tclass0_deadline);
+
 /*
  * Per flow structure, dynamically allocated
  */
@@ -129,6 +136,7 @@ struct fp_dst {
 	u64		used_tslots;		/* timeslots in which packets moved */
 	spinlock_t lock;
 	uint8_t state;
+	u8		tclass;				/* class of the latest timeslot added */
 };
 
 struct fp_sched_stat {
@@ -504,7 +512,7 @@ static void handle_areq(void *param, u16 *dst_and_count, int n)
 	trigger_tx(q);
 
 	for (i = 0; i < n; i++) {
-		dst_id = ntohs(dst_and_count[2*i]);
+		dst_id = ntohs(dst_and_count[2*i]) & FASTPASS_AREQ_DST_MASK;
 		count_low = ntohs(dst_and_count[2*i + 1]);
 
 		dst = get_dst(q, dst_id);
@@ -660,6 +668,9 @@ static void send_request(struct fp_sched_data *q)
 
 		q->requested_tslots += (new_requested - dst->requested_tslots);
 		dst->requested_tslots = new_requested;
+		pd->areq[pd->n_areq].tclass = dst->tclass;
+		pd->areq[pd->n_areq].deadline = (dst->tclass == 0) ?
+				min_t(u32, tclass0_deadline, 0xFFFF) : 0;
 		release_dst(q, dst);
 
 		pd->areq[pd->n_areq].src_dst_key = dst_id;
@@ -906,6 +917,7 @@ static int fastpass_proc_show(struct seq_file *seq, void *v)
 	seq_printf(seq, ", proc_dump_dst %u", proc_dump_dst);
 	seq_printf(seq, ", miss_threshold %u", miss_threshold);
 	seq_printf(seq, ", max_preload %u", max_preload);
+	seq_printf(seq, ", tclass0_deadline %u", tclass0_deadline);
 
 	/* timeslot statistics */
 	seq_printf(seq, "\n  horizon mask 0x%016llx",
@@ -1098,10 +1110,11 @@ static void fpq_stop_qdisc(void *priv) {
 	fastpass_proc_cleanup(q);
 }
 
-static void fpq_add_timeslot(void *priv, u64 dst_id)
+static void fpq_add_timeslot(void *priv, u64 dst_id, u8 tclass)
 {
 	struct fp_sched_data *q = (struct fp_sched_data *)priv;
 	struct fp_dst *dst = get_dst(q, dst_id);
+	dst->tclass = tclass;
 	flow_inc_demand(q, dst_id, dst, 1);
 	release_dst(q, dst);
 }
@@ -27,7 +27,7 @@ static int simple_new_qdisc(void *priv, struct net *qdisc_net, u32 tslot_mul,
 static void simple_stop_qdisc(void *priv) {
 	return;
 }
-static void simple_add_timeslot(void *priv, u64 src_dst_key) {
+static void simple_add_timeslot(void *priv, u64 src_dst_key, u8 tclass) {
 	tsq_admit_now(priv, src_dst_key);
 }
 
@@ -377,6 +377,27 @@ cannot_classify:
 	return &q->reg_prio;
 }
 
+/**
+ * Returns the arbiter traffic class of a data packet, from its priority:
+ *   control and interactive packets in class 0, interactive bulk in 1, best
+ *   effort in 2 and bulk in 3. Arbiters using fewer classes fold the rest
+ *   into their last class.
+ */
+static u8 classify_tclass(struct sk_buff *skb)
+{
+	switch (skb->priority & TC_PRIO_MAX) {
+	case TC_PRIO_CONTROL:
+	case TC_PRIO_INTERACTIVE:
+		return 0;
+	case TC_PRIO_INTERACTIVE_BULK:
+		return 1;
+	case TC_PRIO_BESTEFFORT:
+		return 2;
+	default:
+		return 3;
+	}
+}
+
 /* returns the flow for the given packet, allocates a new flow if needed */
 static struct tsq_dst *classify_data(struct sk_buff *skb, struct tsq_sched_data *q)
 {
@@ -445,6 +466,7 @@ static void enqueue_single_skb(struct Qdisc *sch, struct sk_buff *skb)
 	s64 cost;
 	bool created_new_timeslot = false;
 	u64 src_dst_key;
+	u8 tclass = classify_tclass(skb);
 
 	cost = (s64) psched_l2t_ns(&q->data_rate, qdisc_pkt_len(skb));
 
@@ -488,7 +510,8 @@ static void enqueue_single_skb(struct Qdisc *sch, struct sk_buff *skb)
 	spin_unlock(&q->hash_tbl_lock);
 
 	if (created_new_timeslot)
-		q->timeslot_ops->add_timeslot(sched_data_to_priv(q), src_dst_key);
+		q->timeslot_ops->add_timeslot(sched_data_to_priv(q), src_dst_key,
+				tclass);
 
 	fp_debug("enqueued data packet of len %d to flow 0x%llX\n",
 			qdisc_pkt_len(skb), dst->src_dst_key);
@@ -10,7 +10,7 @@ struct tsq_ops {
 	int			(* new_qdisc)(void *priv, struct net *qdisc_net, u32 tslot_mul,
 								u32 tslot_shift);
 	void		(* stop_qdisc)(void *priv);
-	void		(* add_timeslot)(void *priv, u64 src_dst_key);
+	void		(* add_timeslot)(void *priv, u64 src_dst_key, u8 tclass);
 };
 
 struct tsq_qdisc_entry {
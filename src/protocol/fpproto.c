@@ -24,6 +24,12 @@ struct fastpass_areq {
 	__be16	count;
 };
 
+struct fastpass_areq_deadline {
+	__be16	dst;
+	__be16	count;
+	__be16	deadline;
+};
+
 /**
  * Computes the base sequence number from a reset timestamp
  */
@@ -492,13 +498,16 @@ incomplete_alloc_payload:
 }
 
 /**
- * Processes A-REQ payload.
+ * Processes A-REQ payload, with 4-byte requests or with 6-byte requests that
+ *   carry deadlines.
  * On success, returns the payload length in bytes. On failure returns -1.
  */
-static int process_areq(struct fpproto_conn *conn, u8 *data, u8 *data_end)
+static int process_areq(struct fpproto_conn *conn, u8 *data, u8 *data_end,
+		bool with_deadline)
 {
 	u8 *curp = data;
 	u32 n_dst;
+	u32 req_len = with_deadline ? 6 : 4;
 	u16 payload_type;
 
 	if (curp + 2 > data_end)
@@ -507,13 +516,15 @@ static int process_areq(struct fpproto_conn *conn, u8 *data, u8 *data_end)
 	payload_type = ntohs(*(u16 *)curp);
 	n_dst = payload_type & 0x3F;
 	curp += 2;
-	if (curp + 4 * n_dst > data_end)
+	if (curp + req_len * n_dst > data_end)
 		goto incomplete;
 
-	if (conn->ops->handle_areq)
+	if (with_deadline && conn->ops->handle_areq_deadline)
+		conn->ops->handle_areq_deadline(conn->ops_param, (u16 *)curp, n_dst);
+	else if (!with_deadline && conn->ops->handle_areq)
 		conn->ops->handle_areq(conn->ops_param, (u16 *)curp, n_dst);
 
-	curp += 4 * n_dst;
+	curp += req_len * n_dst;
 	return curp - data;
 
 incomplete:
@@ -708,7 +719,9 @@ handle_payload:
 		break;
 
 	case FASTPASS_PTYPE_AREQ:
-		payload_length = process_areq(conn, curp, data_end);
+	case FASTPASS_PTYPE_AREQ_DEADLINE:
+		payload_length = process_areq(conn, curp, data_end,
+				payload_type == FASTPASS_PTYPE_AREQ_DEADLINE);
 
 		fp_debug("process_areq returned %d\n", payload_length);
 		if (unlikely(payload_length == -1))
@@ -828,6 +841,9 @@ int fpproto_encode_packet(struct fpproto_pktdesc *pd, u8 *pkt, u32 max_len,
 {
 	int i;
 	struct fastpass_areq *areq;
+	struct fastpass_areq_deadline *areq_deadline;
+	bool with_deadline = false;
+	u32 req_len;
 
 	u8 *curp = pkt;
 	u32 remaining_len = max_len;
@@ -881,11 +897,16 @@ int fpproto_encode_packet(struct fpproto_pktdesc *pd, u8 *pkt, u32 max_len,
 
 	/* Must encode the A-REQ *after* allocations for correct endnode handling */
 	if (pd->n_areq > 0) {
-		if (unlikely(remaining_len < 2 + 4 * pd->n_areq))
+		for (i = 0; i < pd->n_areq; i++)
+			with_deadline |= (pd->areq[i].deadline != 0);
+		req_len = with_deadline ? 6 : 4;
+
+		if (unlikely(remaining_len < 2 + req_len * pd->n_areq))
 			return -3;
 
 		/* A-REQ type short */
-		*(__be16 *)curp = htons((FASTPASS_PTYPE_AREQ << 12) |
+		*(__be16 *)curp = htons(((with_deadline ? FASTPASS_PTYPE_AREQ_DEADLINE
+												: FASTPASS_PTYPE_AREQ) << 12) |
 						  (pd->n_areq & 0x3F));
 		curp += 2;
 		remaining_len -= 2;
@@ -893,10 +914,16 @@ int fpproto_encode_packet(struct fpproto_pktdesc *pd, u8 *pkt, u32 max_len,
 		/* A-REQ requests */
 		for (i = 0; i < pd->n_areq; i++) {
 			areq = (struct fastpass_areq *)curp;
-			areq->dst = htons((__be16)pd->areq[i].src_dst_key);
+			areq->dst = htons((__be16)(
+					((u16)pd->areq[i].tclass << FASTPASS_AREQ_TCLASS_SHIFT)
+					| ((u16)pd->areq[i].src_dst_key & FASTPASS_AREQ_DST_MASK)));
 			areq->count = htons((u16)pd->areq[i].tslots);
-			curp += 4;
-			remaining_len -= 4;
+			if (with_deadline) {
+				areq_deadline = (struct fastpass_areq_deadline *)curp;
+				areq_deadline->deadline = htons(pd->areq[i].deadline);
+			}
+			curp += req_len;
+			remaining_len -= req_len;
 		}
 	}
 
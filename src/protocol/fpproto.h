@@ -62,7 +62,11 @@ extern bool fastpass_debug;
 
 /* COMMON TO END_NODE AND CONTROLLER */
 #define FASTPASS_PKT_MAX_AREQ			10
-#define FASTPASS_PKT_AREQ_LEN			(2 + 4 * FASTPASS_PKT_MAX_AREQ)
+/* with deadlines, every A-REQ takes 6 bytes instead of 4 */
+#define FASTPASS_PKT_AREQ_LEN			(2 + 6 * FASTPASS_PKT_MAX_AREQ)
+/* the top bits of an A-REQ's dst field carry the flow's traffic class */
+#define FASTPASS_AREQ_TCLASS_SHIFT		14
+#define FASTPASS_AREQ_DST_MASK			((1 << FASTPASS_AREQ_TCLASS_SHIFT) - 1)
 
 #define FASTPASS_MAX_PAYLOAD		(FASTPASS_PKT_HDR_LEN + \
 									FASTPASS_PKT_RESET_LEN + \
@@ -74,15 +78,23 @@ extern bool fastpass_debug;
 #define FASTPASS_PTYPE_AREQ			0x2
 #define FASTPASS_PTYPE_ALLOC		0x3
 #define FASTPASS_PTYPE_ACK			0x4
+#define FASTPASS_PTYPE_AREQ_DEADLINE	0x5
 
 /**
  * An A-REQ for a single destination
  * @src_dst_key: the key for the flow
  * @tslots: the total number of tslots requested
+ * @tclass: the flow's traffic class, 0 is served first
+ * @deadline: timeslots from the request within which the new demand should be
+ *   allocated, or 0 for none. Packets with a deadline on any A-REQ use the
+ *   longer A-REQ payload type. End nodes only set it on class 0 demand, when
+ *   sch_fastpass is loaded with tclass0_deadline.
  */
 struct fpproto_areq_desc {
 	u64		src_dst_key;
 	u64		tslots;
+	u8		tclass;
+	u16		deadline;
 };
 
 /**
@@ -149,6 +161,14 @@ struct fpproto_ops {
 	 */
 	void	(*handle_areq)(void *param, u16 *dst_and_count, int n);
 
+	/**
+	 * Called for every A-REQ payload with deadlines
+	 * @dst_count_deadline: a 16-bit destination, a 16-bit demand count, then
+	 *   a 16-bit deadline, in network byte-order
+	 * @n: the number of dst+count+deadline triplets
+	 */
+	void	(*handle_areq_deadline)(void *param, u16 *dst_count_deadline, int n);
+
 	/**
 	 * Sets a timer for the connection
 	 */
@@ -4,13 +4,36 @@
 
 #include "platform/generic.h"
 
-//#define MAX_NODES 1024
-//#define FP_NODES_SHIFT 10  // 2^FP_NODES_SHIFT = MAX_NODES
-#define MAX_NODES 256
+/* override with e.g. -DFP_NODES_SHIFT=12 for up to 4096 nodes. ids must
+ * leave the top FP_PATH_BITS of a u16 free for the path (see fp_alloc_path) */
+#ifndef FP_NODES_SHIFT
 #define FP_NODES_SHIFT 8  // 2^FP_NODES_SHIFT = MAX_NODES
+#endif
+/* override with e.g. -DFP_PATH_BITS=4 for 16 paths, one per spine switch.
+ * -DFP_NUM_PATHS sets fewer paths than the bits hold, e.g. 12 */
+#ifndef FP_PATH_BITS
+#define FP_PATH_BITS 2
+#endif
+#ifndef FP_NUM_PATHS
+#define FP_NUM_PATHS (1 << FP_PATH_BITS)
+#endif
+#if (FP_NUM_PATHS > (1 << FP_PATH_BITS))
+#error "FP_NUM_PATHS must fit in FP_PATH_BITS"
+#endif
+#define FP_PATH_SHIFT (16 - FP_PATH_BITS)
+#define FP_NODE_MASK ((1 << FP_PATH_SHIFT) - 1)
+#if (FP_NODES_SHIFT > FP_PATH_SHIFT)
+#error "node ids must fit below the path bits of an allocation"
+#endif
+#define MAX_NODES (1 << FP_NODES_SHIFT)
+#ifndef MAX_RACKS
 #define MAX_RACKS 16
+#endif
+/* override with e.g. -DTOR_SHIFT=5 for racks of 32 machines */
+#ifndef TOR_SHIFT
 #define TOR_SHIFT 8  // number of machines per rack is at most 2^TOR_SHIFT
-#define MAX_NODES_PER_RACK 256  // = 2^TOR_SHIFT
+#endif
+#define MAX_NODES_PER_RACK (1 << TOR_SHIFT)
 #define OUT_OF_BOUNDARY_NODE_ID (MAX_NODES-1)  // highest node id
 
 #define FB_RACK_PERFECT_HASH_CONST	0x33
@@ -35,12 +58,12 @@ static inline u16 fp_map_mac_to_id(u64 mac) {
 
 /* returns the destination node from the allocated dst */
 static inline u16 fp_alloc_node(u16 alloc) {
-	return alloc & 0x3FFF;
+	return alloc & FP_NODE_MASK;
 }
 
 /* return the path from the allocation */
 static inline u16 fp_alloc_path(u16 alloc) {
-	return alloc >> 14;
+	return alloc >> FP_PATH_SHIFT;
 }
 
 // Returns the ID of the rack corresponding to id